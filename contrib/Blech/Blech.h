@@ -66,8 +66,12 @@ Using Blech:
 
 #define BLECHVERSION "Lax/Blech 1.7.4"
 
+#include "BlechFilter.h"
+
+#include <algorithm>
 #include <unordered_map>
 #include <string>
+#include <string_view>
 
 #ifdef BLECH_DEBUG_FULL
 #define BLECH_DEBUG
@@ -142,6 +146,7 @@ struct BLECHEVENT
 	uint32_t       ID;
 	void*          pData;
 	std::string    OriginalString;
+	std::string    Anchor;         // longest literal part, see BlechFilter
 	fBlechCallback Callback;
 
 	BlechNode* pBlechNode;
@@ -501,6 +506,8 @@ public:
 	{
 		if (!text || !text[0])
 			return 0;
+		if (m_pFilter && !m_pFilter->MayMatch(this, text))
+			return 0;
 		BlechDebug("Feed(%s)", text);
 		unsigned int Root = (unsigned char)text[0];
 
@@ -530,6 +537,20 @@ public:
 		const char* Part = Text;
 		eBlechStringType StringType = BST_NORMAL;
 		BlechNode* pNode = nullptr;
+		std::string_view Anchor;
+
+		// The longest literal part is what a BlechFilter looks for. Parts with characters outside of
+		// ASCII are skipped, as those aren't compared the same way by the filter.
+		auto AddPart = [&](const char* Begin, const char* End)
+		{
+			if (StringType == BST_NORMAL && static_cast<size_t>(End - Begin) > Anchor.size()
+				&& std::all_of(Begin, End, [](char c) { return static_cast<unsigned char>(c) < 0x80; }))
+			{
+				Anchor = std::string_view(Begin, End - Begin);
+			}
+
+			return AddNode(pNode, Begin, End, StringType);
+		};
 
 		while (char c = *pText)
 		{
@@ -538,14 +559,14 @@ public:
 				if (StringType == BST_NORMAL && pText[1] == m_scanVarDelimiter)
 				{
 					if (Part != pText)
-						pNode = AddNode(pNode, Part, pText, StringType);
+						pNode = AddPart(Part, pText);
 					Part = &pText[1];
 					pText++;
 				}
 				else
 				{
 					if (Part != pText)
-						pNode = AddNode(pNode, Part, pText, StringType);
+						pNode = AddPart(Part, pText);
 					Part = &pText[1];
 					if (StringType == BST_SCANVAR)
 						StringType = BST_NORMAL;
@@ -559,14 +580,14 @@ public:
 					if (StringType == BST_NORMAL && pText[1] == m_printVarDelimiter)
 					{
 						if (Part != pText)
-							pNode = AddNode(pNode, Part, pText, StringType);
+							pNode = AddPart(Part, pText);
 						Part = &pText[1];
 						pText++;
 					}
 					else
 					{
 						if (Part != pText)
-							pNode = AddNode(pNode, Part, pText, StringType);
+							pNode = AddPart(Part, pText);
 						Part = &pText[1];
 						if (StringType == BST_PRINTVAR)
 							StringType = BST_NORMAL;
@@ -578,7 +599,7 @@ public:
 		}
 		if (*Part)
 		{
-			pNode = AddNode(pNode, Part, pText, StringType);
+			pNode = AddPart(Part, pText);
 		}
 
 		// add event to node
@@ -590,9 +611,13 @@ public:
 		rEvent.ID = m_lastID;
 		rEvent.pBlechNode = pNode;
 		rEvent.OriginalString = Text;
+		rEvent.Anchor = Anchor;
 
 		pNode->AddEvent(&rEvent);
 
+		if (m_pFilter)
+			m_pFilter->AddEvent(this, rEvent.ID, rEvent.Anchor);
+
 		return rEvent.ID;
 	}
 
@@ -607,6 +632,9 @@ public:
 
 		rEvent.OriginalString.clear();
 
+		if (m_pFilter)
+			m_pFilter->RemoveEvent(this, ID);
+
 		BlechNode* pNode = rEvent.pBlechNode;
 		// find the PBLECHEVENTNODE for this event and remove it
 		PBLECHEVENTNODE pEventNode = pNode->pEvents;
@@ -641,6 +669,22 @@ public:
 		return m_eventMap.empty();
 	}
 
+	// Share a BlechFilter with other Blech instances, so that lines none of the events can match
+	// are skipped. Pass nullptr to stop using the filter.
+	void SetFilter(BlechFilter* pFilter)
+	{
+		if (m_pFilter)
+			m_pFilter->RemoveAll(this);
+
+		m_pFilter = pFilter;
+
+		if (m_pFilter)
+		{
+			for (const auto& [ID, rEvent] : m_eventMap)
+				m_pFilter->AddEvent(this, ID, rEvent.Anchor);
+		}
+	}
+
 	char Version[32];
 
 private:
@@ -703,6 +747,9 @@ private:
 
 		m_eventMap.clear();
 		m_lastID = 0;
+
+		if (m_pFilter)
+			m_pFilter->RemoveAll(this);
 	}
 
 
@@ -1366,4 +1413,5 @@ private:
 	fBlechVariableValue m_variableValue = nullptr;
 	BlechEventMap m_eventMap;
 	BlechNode* m_tree[256];
+	BlechFilter* m_pFilter = nullptr;
 };
\ No newline at end of file
@@ -0,0 +1,197 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <mq/base/AhoCorasick.h>
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class Blech;
+
+// Lets any number of Blech instances share one pass over each line to find out which of them can
+// match it at all.
+//
+// Every literal part of an event (the text outside of #scan# and |print| variables) has to be in a
+// line for the event to match it. The filter looks for the longest literal part of every event of
+// every attached Blech at once, and a Blech that has no event whose part is in the line can skip
+// the line entirely. Events without a literal part can match anything, so a Blech with one of
+// those is always fed.
+//
+// Attach a Blech with Blech::SetFilter, after which its Feed checks with the filter first. The
+// results for the last two lines are kept, so Blechs that are fed the same line (or alternate
+// between a line and its stripped version) only scan it once. The filter must outlive the Blechs
+// attached to it, and is not thread safe.
+class BlechFilter
+{
+public:
+	BlechFilter() = default;
+	BlechFilter(const BlechFilter&) = delete;
+	BlechFilter& operator=(const BlechFilter&) = delete;
+
+	// Returns false if feeding the text to the Blech can't match any of its events.
+	bool MayMatch(const Blech* pBlech, std::string_view text)
+	{
+		auto iter = m_subscribers.find(pBlech);
+		if (iter == m_subscribers.end())
+			return true;
+
+		Subscriber& subscriber = iter->second;
+		if (subscriber.Unanchored > 0)
+			return true;
+
+		if (m_dirty)
+			Rebuild();
+
+		const size_t slot = Scan(text);
+		return subscriber.Hits[slot] == m_scans[slot].ScanID;
+	}
+
+private:
+	friend class Blech;
+
+	struct Subscriber
+	{
+		std::unordered_map<unsigned int, std::string> Anchors;   // by event id, empty if none
+		unsigned int Unanchored = 0;
+		uint64_t Hits[2] = { 0, 0 };                            // the last scan of each slot that found an anchor
+	};
+
+	struct ScanResult
+	{
+		std::string Text;
+		uint64_t ScanID = 0;                                    // 0 = nothing scanned since the last rebuild
+	};
+
+	void AddEvent(const Blech* pBlech, unsigned int id, std::string_view anchor)
+	{
+		Subscriber& subscriber = m_subscribers[pBlech];
+		subscriber.Anchors[id] = std::string(anchor);
+		if (anchor.empty())
+			++subscriber.Unanchored;
+
+		m_dirty = true;
+	}
+
+	void RemoveEvent(const Blech* pBlech, unsigned int id)
+	{
+		auto iter = m_subscribers.find(pBlech);
+		if (iter == m_subscribers.end())
+			return;
+
+		Subscriber& subscriber = iter->second;
+		auto anchorIter = subscriber.Anchors.find(id);
+		if (anchorIter == subscriber.Anchors.end())
+			return;
+
+		if (anchorIter->second.empty())
+			--subscriber.Unanchored;
+		subscriber.Anchors.erase(anchorIter);
+
+		if (subscriber.Anchors.empty())
+			m_subscribers.erase(iter);
+
+		m_dirty = true;
+	}
+
+	void RemoveAll(const Blech* pBlech)
+	{
+		if (m_subscribers.erase(pBlech))
+			m_dirty = true;
+	}
+
+	void Rebuild()
+	{
+		m_automaton.Clear();
+		m_owners.clear();
+
+		// Events that share an anchor share its entry in the automaton.
+		std::unordered_map<std::string, size_t> anchorIndex;
+
+		for (auto& [pBlech, subscriber] : m_subscribers)
+		{
+			subscriber.Hits[0] = subscriber.Hits[1] = 0;
+
+			for (const auto& [id, anchor] : subscriber.Anchors)
+			{
+				if (anchor.empty())
+					continue;
+
+				std::string key = anchor;
+				for (char& ch : key)
+				{
+					if (ch >= 'A' && ch <= 'Z')
+						ch = ch - 'A' + 'a';
+				}
+
+				auto [iter, added] = anchorIndex.try_emplace(std::move(key), m_owners.size());
+				if (added)
+				{
+					m_automaton.Add(iter->first);
+					m_owners.emplace_back();
+				}
+
+				std::vector<Subscriber*>& owners = m_owners[iter->second];
+				if (owners.empty() || owners.back() != &subscriber)
+					owners.push_back(&subscriber);
+			}
+		}
+
+		m_automaton.Build();
+		m_scans[0] = {};
+		m_scans[1] = {};
+		m_dirty = false;
+	}
+
+	// Returns the slot with the results for the text, scanning it if it isn't one of the last two.
+	size_t Scan(std::string_view text)
+	{
+		for (size_t slot = 0; slot < 2; ++slot)
+		{
+			if (m_scans[slot].ScanID != 0 && m_scans[slot].Text == text)
+			{
+				m_lastSlot = slot;
+				return slot;
+			}
+		}
+
+		const size_t slot = 1 - m_lastSlot;
+		m_lastSlot = slot;
+
+		ScanResult& result = m_scans[slot];
+		result.Text.assign(text.data(), text.size());
+		result.ScanID = ++m_lastScanID;
+
+		m_automaton.Find(text,
+			[&](size_t index, size_t)
+			{
+				for (Subscriber* pSubscriber : m_owners[index])
+					pSubscriber->Hits[slot] = result.ScanID;
+			});
+
+		return slot;
+	}
+
+	std::unordered_map<const Blech*, Subscriber> m_subscribers;
+	mq::AhoCorasick m_automaton;
+	std::vector<std::vector<Subscriber*>> m_owners;             // by automaton index
+	bool m_dirty = false;
+
+	ScanResult m_scans[2];
+	size_t m_lastSlot = 0;
+	uint64_t m_lastScanID = 0;
+};
@@ -44,6 +44,10 @@ struct MQTopLevelObject
 	std::string Name;
 	MQTopLevelObjectFunction Function;
 	MQPlugin* Owner;
+
+	// Returns the same result for the same index until the game state changes. See
+	// MQ2Type::SetMemberFrameStable.
+	bool FrameStable = false;
 };
 using MQDataItem DEPRECATE("Use MQTopLevelObject instead of MQDataItem") = MQTopLevelObject;
 
@@ -155,12 +159,28 @@ MQLIB_API bool ParseMacroData(char* szOriginal, size_t BufferSize);
 // Same as ParseMacroData, but returns the same char pointer back. Prefer to use ParseMacroData
 MQLIB_API char* ParseMacroParameter(char* szOriginal, size_t BufferSize);
 
+// Evaluates a list of expressions like "Me.Buff[1].Name" (the surrounding ${} is optional) and
+// returns the text of each result, or "NULL" where ParseMacroData would have written it. Steps
+// that expressions share from the start, like Me.Buff[1] in Me.Buff[1].Name and
+// Me.Buff[1].Duration, are evaluated once for the whole batch, so a shared method only runs once.
+MQLIB_OBJECT std::vector<std::string> EvaluateDataExpressions(const std::vector<std::string>& expressions);
+
 // Returns -1 if member doesn't exist. 0 if it fails, and 1 if it succeeds.
 MQLIB_API int EvaluateMacroDataMember(MQ2Type* Type, MQVarPtr VarPtr, MQTypeVar& Result, const char* Member, char* pIndex);
 
 // Returns false if the given name is neither a member nor a method of the given type.
 MQLIB_OBJECT bool FindMacroDataMember(MQ2Type* Type, const std::string& Member);
 
+// Copies a string result of a member or TLO somewhere that it stays valid until the next ${}
+// evaluation starts on this thread, instead of into DataTypeTemp. Nested evaluations each get
+// their own copy. When called outside of an evaluation, this writes to DataTypeTemp.
+MQLIB_OBJECT char* StoreEvaluationString(std::string_view value);
+
+// Forgets the results that were memoized for frame stable members. This happens on every pulse
+// and whenever a command or a method runs. Call it after changing game state in any other way
+// that a frame stable member could observe.
+MQLIB_API void InvalidateFrameMemo();
+
 //----------------------------------------------------------------------------
 // Macro Variables
 
@@ -22,6 +22,7 @@
 #include "eqlib/CXStr.h"
 #include "eqlib/Items.h"
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -39,6 +40,7 @@ namespace mq {
 
 namespace datatypes {
 	class MQ2Type;
+	class MQTypeMemberIndex;
 }
 using datatypes::MQ2Type;
 struct MQTypeVar;
@@ -401,6 +403,7 @@ struct MQTypeMember
 	int          ID;
 	uint32_t     Type;
 	const char* Name;
+	bool         FrameStable = false;
 
 	MQTypeMember(int ID, const char* Name)
 		: ID(ID), Name(Name), Type(0) {}
@@ -450,6 +453,15 @@ public:
 
 	MQLIB_OBJECT bool CanEvaluateMethodOrMember(const std::string& Name);
 
+	// Returns true if the member, or the inherited member of the same name, is frame stable.
+	MQLIB_OBJECT bool IsMemberFrameStable(const std::string& Name);
+
+	MQLIB_OBJECT std::vector<std::string> GetMemberNames() const;
+	MQLIB_OBJECT std::vector<std::string> GetMethodNames() const;
+
+	// Changes whenever any type adds or removes a member or method, or changes its parent.
+	MQLIB_OBJECT static uint32_t GetMembersGeneration();
+
 	inline bool InheritsFrom(MQ2Type* testType)
 	{
 		MQ2Type* parentType = m_parent;
@@ -469,10 +481,7 @@ public:
 	inline bool InheritedMember(const char* Name) { return m_parent && m_parent->FindMember(Name); }
 	inline bool InheritedMember(const std::string& Name) { return m_parent && m_parent->FindMember(Name); }
 
-	inline void SetInheritance(MQ2Type* pNewInherit)
-	{
-		m_parent = pNewInherit;
-	}
+	MQLIB_OBJECT void SetInheritance(MQ2Type* pNewInherit);
 	inline  MQ2Type* GetParent() const { return m_parent; }
 
 	// Override this function to convert this type to the requested type. Return true if the conversion is successful. The
@@ -514,6 +523,12 @@ protected:
 	MQLIB_OBJECT bool AddMethod(int ID, const char* Name);
 	MQLIB_OBJECT bool RemoveMethod(const char* Name);
 
+	// Marks a member whose value only depends on game state and its index, and that has no side
+	// effects. When FrameMemoization is enabled, ${} expressions that start at a frame stable TLO
+	// and only go through frame stable members are evaluated once per pulse and then answered from
+	// a memo until InvalidateFrameMemo is called.
+	MQLIB_OBJECT bool SetMemberFrameStable(const char* Name, bool frameStable = true);
+
 	std::string m_typeName;
 	bool m_owned = false;
 	bool m_initialized = false;
@@ -521,10 +536,22 @@ protected:
 	mutable std::mutex m_mutex;
 
 private:
+	const MQTypeMemberIndex* GetIndex(std::atomic<const MQTypeMemberIndex*>& index,
+		const std::unordered_map<std::string, int>& names, const std::vector<std::unique_ptr<MQTypeMember>>& members) const;
+
 	std::vector<std::unique_ptr<MQTypeMember>> Members;
 	std::vector<std::unique_ptr<MQTypeMember>> Methods;
 	std::unordered_map<std::string, int> MemberMap;
 	std::unordered_map<std::string, int> MethodMap;
+
+	// Lookups go through a read only index that is built the first time it is needed after the
+	// members change, and published with an atomic pointer so that finding a member never locks
+	// or allocates. Replaced indexes and removed members are kept until the type is destroyed
+	// because another thread may still be reading them.
+	mutable std::atomic<const MQTypeMemberIndex*> m_memberIndex{ nullptr };
+	mutable std::atomic<const MQTypeMemberIndex*> m_methodIndex{ nullptr };
+	mutable std::vector<std::unique_ptr<const MQTypeMemberIndex>> m_indexes;
+	std::vector<std::unique_ptr<MQTypeMember>> m_removedMembers;
 };
 
 } // namespace datatypes
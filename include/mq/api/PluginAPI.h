@@ -29,8 +29,24 @@ namespace mq {
 
 class PluginInterface;
 
+/**
+ * A line of chat, as passed to OnWriteChatColorBatch.
+ */
+struct MQChatLine
+{
+	/** The line as it was written, with MQ color codes. */
+	const char* Line = nullptr;
+
+	/** The line with the MQ color codes stripped out. */
+	const char* PlainText = nullptr;
+
+	uint32_t    Color = 0;
+	uint32_t    Filter = 0;
+};
+
 // Plugin Function Types
 using fMQWriteChatColor      = int (*)(const char*, uint32_t, uint32_t);
+using fMQWriteChatColorBatch = void(*)(const MQChatLine* Lines, size_t Count);
 using fMQPulse               = void(*)();
 using fMQIncomingChat        = bool(*)(const char* Line, uint32_t Color);
 using fMQInitializePlugin    = void(*)();
@@ -83,6 +99,7 @@ struct MQPlugin
 	fMQLoadPlugin        LoadPlugin = nullptr;
 	fMQUnloadPlugin      UnloadPlugin = nullptr;
 	fMQGetPluginInterface GetPluginInterface = nullptr;
+	fMQWriteChatColorBatch WriteChatColorBatch = nullptr;
 
 	MQPlugin*            pLast = nullptr;
 	MQPlugin*            pNext = nullptr;
@@ -17,10 +17,52 @@
 #include "eqlib/Globals.h"
 #include "eqlib/PlayerClient.h"
 
+#include <string_view>
+#include <vector>
+
 using namespace eqlib;
 
 namespace mq {
 
+/**
+ * The names that a spawn can be looked up by.
+ */
+enum class SpawnNameKind
+{
+	Name,                // The spawn's name, like a_rat00
+	CleanName,           // The name without underscores and numbers, like a rat
+	DisplayedName,       // The name shown in game, like a rat
+};
+
+/**
+ * Finds the spawn with the given spawn ID. Lookups go through an index that
+ * is kept up to date as spawns are added and removed.
+ *
+ * @param spawnID The spawn ID to look for
+ * @return The spawn, or nullptr if there is no spawn with that ID.
+ */
+MQLIB_OBJECT PlayerClient* FindSpawnByID(uint32_t spawnID);
+
+/**
+ * Finds a spawn by one of its names, ignoring case. Lookups go through an
+ * index that is kept up to date as spawns are added, removed and renamed,
+ * so they don't depend on the number of spawns in the zone.
+ *
+ * @param name The name to look for
+ * @param kind Which of the spawn's names to compare against
+ * @return The first spawn with that name, or nullptr if there is none.
+ */
+MQLIB_OBJECT PlayerClient* FindSpawnByName(std::string_view name, SpawnNameKind kind = SpawnNameKind::Name);
+
+/**
+ * Finds every spawn with the given name, ignoring case. See FindSpawnByName.
+ *
+ * @param name The name to look for
+ * @param kind Which of the spawn's names to compare against
+ * @return The spawns with that name.
+ */
+MQLIB_OBJECT std::vector<PlayerClient*> FindSpawnsByName(std::string_view name, SpawnNameKind kind = SpawnNameKind::Name);
+
 /**
  * Returns true if the given spawn is marked by the group or raid.
  *
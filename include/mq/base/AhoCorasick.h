@@ -0,0 +1,226 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Implements an Aho-Corasick automaton for finding many strings in a text at once.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace mq {
+
+// Finds every occurrence of a set of strings in a text with one pass over the text, no matter how
+// many strings there are. Matching ignores the case of ASCII letters.
+//
+// Add the strings and then Build. Strings added after Build aren't found until Build is called
+// again. Find doesn't change the automaton, so one that is built can be shared between threads.
+class AhoCorasick
+{
+public:
+	AhoCorasick()
+	{
+		Clear();
+	}
+
+	// Returns the index of the string, which is what Find reports when the string is found. Empty
+	// strings are never found.
+	size_t Add(std::string_view pattern)
+	{
+		const size_t index = m_patternLengths.size();
+		m_patternLengths.push_back(pattern.size());
+
+		if (pattern.empty())
+			return index;
+
+		int32_t node = 0;
+		for (char ch : pattern)
+		{
+			const uint8_t c = Fold(ch);
+			int32_t next = FindChild(node, c);
+
+			if (next < 0)
+			{
+				next = static_cast<int32_t>(m_nodes.size());
+				m_nodes.emplace_back();
+				m_nodes[node].Children.emplace_back(c, next);
+			}
+
+			node = next;
+		}
+
+		m_nodes[node].Patterns.push_back(static_cast<uint32_t>(index));
+		m_built = false;
+		return index;
+	}
+
+	// Computes the transitions. Needs to be called after adding strings and before Find.
+	void Build()
+	{
+		// Letters that appear in the strings get their own column in the transition table, every
+		// other character shares column 0, which always goes back toward the root.
+		m_classes.fill(0);
+		m_classCount = 1;
+
+		for (const Node& node : m_nodes)
+		{
+			for (const auto& [c, child] : node.Children)
+			{
+				if (m_classes[c] == 0)
+					m_classes[c] = static_cast<uint8_t>(m_classCount++);
+			}
+		}
+
+		for (int c = 'A'; c <= 'Z'; ++c)
+			m_classes[c] = m_classes[c - 'A' + 'a'];
+
+		m_next.assign(m_nodes.size() * m_classCount, 0);
+		m_fail.assign(m_nodes.size(), 0);
+		m_output.assign(m_nodes.size(), -1);
+
+		// Breadth first, so that the failure node of every node is done before the node itself.
+		std::deque<int32_t> queue;
+
+		for (const auto& [c, child] : m_nodes[0].Children)
+		{
+			m_next[m_classes[c]] = child;
+			queue.push_back(child);
+		}
+
+		while (!queue.empty())
+		{
+			const int32_t node = queue.front();
+			queue.pop_front();
+
+			const int32_t fail = m_fail[node];
+
+			// Nearest node down the failure chain, including this one, where a string ends.
+			m_output[node] = !m_nodes[node].Patterns.empty() ? node : m_output[fail];
+
+			for (size_t cls = 0; cls < m_classCount; ++cls)
+				m_next[node * m_classCount + cls] = m_next[fail * m_classCount + cls];
+
+			for (const auto& [c, child] : m_nodes[node].Children)
+			{
+				m_fail[child] = m_next[fail * m_classCount + m_classes[c]];
+				m_next[node * m_classCount + m_classes[c]] = child;
+				queue.push_back(child);
+			}
+		}
+
+		m_built = true;
+	}
+
+	void Clear()
+	{
+		m_nodes.clear();
+		m_nodes.emplace_back();
+		m_patternLengths.clear();
+		m_built = false;
+
+		m_classes.fill(0);
+		m_classCount = 1;
+		m_next.assign(m_classCount, 0);
+		m_fail.assign(1, 0);
+		m_output.assign(1, -1);
+	}
+
+	// Number of strings added since the last Clear.
+	size_t size() const { return m_patternLengths.size(); }
+	bool empty() const { return m_patternLengths.empty(); }
+
+	bool IsBuilt() const { return m_built; }
+
+	// Calls found(index, offset) for every occurrence of every string in the text, where offset is
+	// where the occurrence starts. Occurrences are reported in the order that they end.
+	template <typename Found>
+	void Find(std::string_view text, Found&& found) const
+	{
+		if (!m_built)
+			return;
+
+		int32_t node = 0;
+
+		for (size_t i = 0; i < text.size(); ++i)
+		{
+			node = m_next[node * m_classCount + m_classes[static_cast<uint8_t>(text[i])]];
+
+			for (int32_t out = m_output[node]; out > 0; out = m_output[m_fail[out]])
+			{
+				for (uint32_t index : m_nodes[out].Patterns)
+					found(static_cast<size_t>(index), i + 1 - m_patternLengths[index]);
+			}
+		}
+	}
+
+	// Returns true if any of the strings is in the text.
+	bool ContainsAny(std::string_view text) const
+	{
+		if (!m_built)
+			return false;
+
+		int32_t node = 0;
+
+		for (size_t i = 0; i < text.size(); ++i)
+		{
+			node = m_next[node * m_classCount + m_classes[static_cast<uint8_t>(text[i])]];
+
+			if (m_output[node] > 0)
+				return true;
+		}
+
+		return false;
+	}
+
+private:
+	struct Node
+	{
+		std::vector<std::pair<uint8_t, int32_t>> Children;
+		std::vector<uint32_t> Patterns;                // strings that end at this node
+	};
+
+	static uint8_t Fold(char ch)
+	{
+		const uint8_t c = static_cast<uint8_t>(ch);
+		return c >= 'A' && c <= 'Z' ? static_cast<uint8_t>(c - 'A' + 'a') : c;
+	}
+
+	int32_t FindChild(int32_t node, uint8_t c) const
+	{
+		for (const auto& [childChar, child] : m_nodes[node].Children)
+		{
+			if (childChar == c)
+				return child;
+		}
+
+		return -1;
+	}
+
+	std::vector<Node> m_nodes;
+	std::vector<size_t> m_patternLengths;
+	bool m_built = false;
+
+	std::array<uint8_t, 256> m_classes;
+	size_t m_classCount = 1;
+	std::vector<int32_t> m_next;                       // by node * m_classCount + class
+	std::vector<int32_t> m_fail;
+	std::vector<int32_t> m_output;                     // -1 when no string ends down the failure chain
+};
+
+} // namespace mq
@@ -0,0 +1,128 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Implements a fixed size queue for handing items from many threads to one without locks.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace mq {
+
+// A queue with room for a fixed number of items, that any number of threads can push to and one
+// thread can pop from at the same time without taking a lock. The items are allocated up front and
+// reused, and are filled in and read in place, so pushing and popping never allocate.
+//
+// When the queue is full, pushing fails instead of waiting, which leaves it to the caller to decide
+// what to do with the item. Each slot has a sequence number that says whether it's free, being
+// filled in or ready to be popped (after Dmitry Vyukov's bounded MPMC queue, with the consumer side
+// simplified for a single consumer).
+template <typename T>
+class MpscRingBuffer
+{
+public:
+	// The capacity is rounded up to a power of two.
+	explicit MpscRingBuffer(size_t capacity)
+	{
+		size_t size = 2;
+		while (size < capacity)
+			size *= 2;
+
+		m_cells = std::make_unique<Cell[]>(size);
+		m_mask = size - 1;
+
+		for (size_t i = 0; i < size; ++i)
+			m_cells[i].Sequence.store(i, std::memory_order_relaxed);
+	}
+
+	MpscRingBuffer(const MpscRingBuffer&) = delete;
+	MpscRingBuffer& operator=(const MpscRingBuffer&) = delete;
+
+	size_t Capacity() const { return m_mask + 1; }
+
+	// Claims a slot and calls fill(T&) to fill it in. Returns false, without calling fill, if the
+	// queue is full. Safe to call from any thread.
+	template <typename Fill>
+	bool TryPush(Fill&& fill)
+	{
+		Cell* cell;
+		size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+
+		for (;;)
+		{
+			cell = &m_cells[pos & m_mask];
+			const size_t sequence = cell->Sequence.load(std::memory_order_acquire);
+			const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+			if (diff == 0)
+			{
+				if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				// the slot still holds the item from one lap ago
+				return false;
+			}
+			else
+			{
+				pos = m_enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		fill(cell->Value);
+		cell->Sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Calls consume(T&) with the oldest item and frees its slot. Returns false if there isn't one
+	// ready. Only one thread may pop.
+	template <typename Consume>
+	bool TryPop(Consume&& consume)
+	{
+		Cell& cell = m_cells[m_dequeuePos & m_mask];
+		if (cell.Sequence.load(std::memory_order_acquire) != m_dequeuePos + 1)
+			return false;
+
+		consume(cell.Value);
+		cell.Sequence.store(m_dequeuePos + m_mask + 1, std::memory_order_release);
+		++m_dequeuePos;
+		return true;
+	}
+
+	// Whether there is an item ready to pop. Only meaningful on the thread that pops.
+	bool IsEmpty() const
+	{
+		return m_cells[m_dequeuePos & m_mask].Sequence.load(std::memory_order_acquire) != m_dequeuePos + 1;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> Sequence;
+		T Value;
+	};
+
+	std::unique_ptr<Cell[]> m_cells;
+	size_t m_mask = 0;
+
+	// kept on separate cache lines so that producers and the consumer don't contend
+	alignas(64) std::atomic<size_t> m_enqueuePos{ 0 };
+	alignas(64) size_t m_dequeuePos = 0;
+};
+
+} // namespace mq
@@ -0,0 +1,97 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Implements filters that narrow down a set of items stored as arrays of fields.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MQ_SIMD_SSE2 1
+#include <emmintrin.h>
+#else
+#define MQ_SIMD_SSE2 0
+#endif
+
+namespace mq {
+
+// Each filter takes a mask with one byte per item, 1 for the items that are still in the set and
+// 0 for the rest, and clears the items that don't pass. Filters can be applied one after the other
+// to the same mask. The SSE2 versions handle 4 or 16 items at a time, the rest are done one by one.
+
+// Keep the items within the given squared distance of (cx, cy).
+inline void FilterWithinDistance(const float* x, const float* y, size_t count,
+	float cx, float cy, float maxDistanceSquared, uint8_t* mask)
+{
+	size_t i = 0;
+
+#if MQ_SIMD_SSE2
+	const __m128 centerX = _mm_set1_ps(cx);
+	const __m128 centerY = _mm_set1_ps(cy);
+	const __m128 maxDistSq = _mm_set1_ps(maxDistanceSquared);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), centerX);
+		const __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), centerY);
+		const __m128 distSq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+		const int within = _mm_movemask_ps(_mm_cmple_ps(distSq, maxDistSq));
+
+		mask[i + 0] &= static_cast<uint8_t>(within & 1);
+		mask[i + 1] &= static_cast<uint8_t>((within >> 1) & 1);
+		mask[i + 2] &= static_cast<uint8_t>((within >> 2) & 1);
+		mask[i + 3] &= static_cast<uint8_t>((within >> 3) & 1);
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		const float dx = x[i] - cx;
+		const float dy = y[i] - cy;
+		mask[i] &= (dx * dx + dy * dy <= maxDistanceSquared) ? 1 : 0;
+	}
+}
+
+// Keep the items whose value is in [min, max].
+inline void FilterInRange(const uint8_t* values, size_t count, uint8_t min, uint8_t max, uint8_t* mask)
+{
+	size_t i = 0;
+
+#if MQ_SIMD_SSE2
+	const __m128i low = _mm_set1_epi8(static_cast<char>(min));
+	const __m128i high = _mm_set1_epi8(static_cast<char>(max));
+	const __m128i one = _mm_set1_epi8(1);
+
+	for (; i + 16 <= count; i += 16)
+	{
+		// SSE2 has no unsigned byte compare, but v is in range exactly when clamping it doesn't change it.
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+		const __m128i inRange = _mm_and_si128(
+			_mm_cmpeq_epi8(_mm_max_epu8(v, low), v),
+			_mm_cmpeq_epi8(_mm_min_epu8(v, high), v));
+
+		__m128i* out = reinterpret_cast<__m128i*>(mask + i);
+		_mm_storeu_si128(out, _mm_and_si128(_mm_loadu_si128(out), _mm_and_si128(inRange, one)));
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		mask[i] &= (values[i] >= min && values[i] <= max) ? 1 : 0;
+	}
+}
+
+} // namespace mq
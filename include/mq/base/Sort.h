@@ -0,0 +1,57 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Sorts for items that are kept in order from one update to the next.
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace mq {
+
+// Insertion sort, which is close to linear when the items are almost in order already, like a
+// list sorted by distance is after a little movement. Gives up once it has moved items more than
+// maxMoves places in total and returns false, leaving the items partly sorted.
+template <typename T, typename Compare>
+bool InsertionSort(std::vector<T>& items, Compare comp, size_t maxMoves)
+{
+	size_t moves = 0;
+
+	for (size_t i = 1; i < items.size(); ++i)
+	{
+		if (!comp(items[i], items[i - 1]))
+			continue;
+
+		T item = std::move(items[i]);
+		size_t j = i;
+
+		do
+		{
+			items[j] = std::move(items[j - 1]);
+			--j;
+			++moves;
+		} while (j > 0 && comp(item, items[j - 1]));
+
+		items[j] = std::move(item);
+
+		if (moves > maxMoves)
+			return false;
+	}
+
+	return true;
+}
+
+} // namespace mq
@@ -0,0 +1,274 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Implements a uniform grid for finding the items near a point.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mq {
+
+// Sorts items into square cells by their x/y position, so that a search around a point only has
+// to look at the items in the cells around it. Items are identified by pointer and are not owned
+// by the grid.
+//
+// Positions are only as current as the last Update. Slack is how far an item may have moved since
+// then: every search is widened by it, so an item that drifted out of its cell is still found.
+// Searches return candidates, the caller has to check the real distance.
+//
+// The grid is not thread safe.
+template <typename T>
+class SpatialGrid
+{
+public:
+	explicit SpatialGrid(float cellSize, float slack = 0.0f)
+		: m_cellSize(cellSize)
+		, m_slack(slack)
+	{
+	}
+
+	SpatialGrid(const SpatialGrid&) = delete;
+	SpatialGrid& operator=(const SpatialGrid&) = delete;
+
+	// Add an item, or move it to a new position. Moving within the same cell doesn't touch the cells.
+	// Returns true if the item was added.
+	bool Update(T* item, float x, float y)
+	{
+		const int32_t cx = ToCell(x);
+		const int32_t cy = ToCell(y);
+		const uint64_t key = MakeKey(cx, cy);
+
+		auto [iter, added] = m_items.try_emplace(item);
+		Entry& entry = iter->second;
+		entry.stamp = m_stamp;
+
+		if (!added)
+		{
+			if (entry.key == key)
+				return false;
+
+			RemoveFromCell(entry);
+		}
+
+		std::vector<T*>& cell = m_cells[key];
+		entry.key = key;
+		entry.index = static_cast<uint32_t>(cell.size());
+		cell.push_back(item);
+
+		if (m_items.size() == 1 && added)
+		{
+			m_minX = m_maxX = cx;
+			m_minY = m_maxY = cy;
+		}
+		else
+		{
+			m_minX = (std::min)(m_minX, cx);
+			m_maxX = (std::max)(m_maxX, cx);
+			m_minY = (std::min)(m_minY, cy);
+			m_maxY = (std::max)(m_maxY, cy);
+		}
+
+		return added;
+	}
+
+	// Returns false if the item wasn't in the grid.
+	bool Remove(T* item)
+	{
+		auto iter = m_items.find(item);
+		if (iter == m_items.end())
+			return false;
+
+		RemoveFromCell(iter->second);
+		m_items.erase(iter);
+		return true;
+	}
+
+	void Clear()
+	{
+		m_items.clear();
+		m_cells.clear();
+	}
+
+	// Start a full refresh. Items that aren't passed to Update before EndRefresh are removed, so
+	// an item that was missed by Remove doesn't stay in the grid.
+	void BeginRefresh()
+	{
+		++m_stamp;
+	}
+
+	// Returns the number of items that were removed.
+	size_t EndRefresh()
+	{
+		size_t removed = 0;
+
+		for (auto iter = m_items.begin(); iter != m_items.end();)
+		{
+			if (iter->second.stamp != m_stamp)
+			{
+				RemoveFromCell(iter->second);
+				iter = m_items.erase(iter);
+				++removed;
+			}
+			else
+			{
+				++iter;
+			}
+		}
+
+		return removed;
+	}
+
+	bool Contains(T* item) const { return m_items.count(item) != 0; }
+
+	size_t size() const { return m_items.size(); }
+	bool empty() const { return m_items.empty(); }
+	float GetSlack() const { return m_slack; }
+
+	// Returns the number of cells that a search of the given radius looks at. When this is more
+	// than the number of items, it is cheaper to look at every item.
+	size_t CellsInRadius(float radius) const
+	{
+		const double cells = std::ceil(2.0 * (static_cast<double>(radius) + m_slack) / m_cellSize) + 1.0;
+		return cells * cells > static_cast<double>(SIZE_MAX) ? SIZE_MAX : static_cast<size_t>(cells * cells);
+	}
+
+	// Calls visit(T*) for every item that may be within radius of (x, y).
+	template <typename Visit>
+	void ForEachInRadius(float x, float y, float radius, Visit&& visit) const
+	{
+		ForEachByDistance(x, y, radius, std::forward<Visit>(visit), [](float) { return false; });
+	}
+
+	// Calls visit(T*) for every item that may be within radius of (x, y), one ring of cells at a
+	// time moving out from the point. Before each ring, done(distance) is called with the distance
+	// from the point that all of the items not visited yet are at least at. The search stops if it
+	// returns true.
+	template <typename Visit, typename Done>
+	void ForEachByDistance(float x, float y, float radius, Visit&& visit, Done&& done) const
+	{
+		if (m_items.empty())
+			return;
+
+		const float reach = radius + m_slack;
+
+		// Only the cells that are both in range and have ever had an item in them.
+		const int32_t minX = (std::max)(ToCell(x - reach), m_minX);
+		const int32_t maxX = (std::min)(ToCell(x + reach), m_maxX);
+		const int32_t minY = (std::max)(ToCell(y - reach), m_minY);
+		const int32_t maxY = (std::min)(ToCell(y + reach), m_maxY);
+		if (minX > maxX || minY > maxY)
+			return;
+
+		const int32_t cx = ToCell(x);
+		const int32_t cy = ToCell(y);
+		const int64_t rings = (std::max)({
+			static_cast<int64_t>(cx) - minX, static_cast<int64_t>(maxX) - cx,
+			static_cast<int64_t>(cy) - minY, static_cast<int64_t>(maxY) - cy, int64_t{ 0 } });
+
+		for (int64_t ring = 0; ring <= rings; ++ring)
+		{
+			if (ring > 0)
+			{
+				// Everything left is outside of the square made by the previous rings.
+				const double inner = (std::min)({
+					x - static_cast<double>(cx - ring + 1) * m_cellSize,
+					static_cast<double>(cx + ring) * m_cellSize - x,
+					y - static_cast<double>(cy - ring + 1) * m_cellSize,
+					static_cast<double>(cy + ring) * m_cellSize - y });
+
+				if (done(static_cast<float>((std::max)(inner - m_slack, 0.0))))
+					return;
+			}
+
+			for (int64_t ry = cy - ring; ry <= cy + ring; ++ry)
+			{
+				if (ry < minY || ry > maxY)
+					continue;
+
+				// The top and bottom rows of a ring are whole, the rows between only have their ends.
+				const bool edge = ry == cy - ring || ry == cy + ring;
+				const int64_t step = edge || ring == 0 ? 1 : 2 * ring;
+
+				for (int64_t rx = cx - ring; rx <= cx + ring; rx += step)
+				{
+					if (rx < minX || rx > maxX)
+						continue;
+
+					auto iter = m_cells.find(MakeKey(static_cast<int32_t>(rx), static_cast<int32_t>(ry)));
+					if (iter == m_cells.end())
+						continue;
+
+					for (T* item : iter->second)
+						visit(item);
+				}
+			}
+		}
+	}
+
+private:
+	struct Entry
+	{
+		uint64_t key = 0;
+		uint32_t index = 0;
+		uint32_t stamp = 0;
+	};
+
+	int32_t ToCell(float value) const
+	{
+		// Keep coordinates that are way out of range (or not a number) from overflowing the cell.
+		constexpr double limit = 1 << 30;
+		const double cell = std::floor(static_cast<double>(value) / m_cellSize);
+		return static_cast<int32_t>(cell > -limit ? (cell < limit ? cell : limit) : -limit);
+	}
+
+	static uint64_t MakeKey(int32_t x, int32_t y)
+	{
+		return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+	}
+
+	void RemoveFromCell(const Entry& entry)
+	{
+		std::vector<T*>& cell = m_cells[entry.key];
+
+		// Swap the last item of the cell into the hole.
+		if (entry.index + 1 != cell.size())
+		{
+			T* moved = cell.back();
+			cell[entry.index] = moved;
+			m_items[moved].index = entry.index;
+		}
+
+		cell.pop_back();
+	}
+
+	std::unordered_map<T*, Entry> m_items;
+	std::unordered_map<uint64_t, std::vector<T*>> m_cells;
+	float m_cellSize;
+	float m_slack;
+	uint32_t m_stamp = 0;
+
+	// Bounds of the cells that have had items since the last Clear.
+	int32_t m_minX = 0;
+	int32_t m_maxX = 0;
+	int32_t m_minY = 0;
+	int32_t m_maxY = 0;
+};
+
+} // namespace mq
@@ -0,0 +1,185 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Implements a bump allocator for short lived strings.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace mq {
+
+// Hands out memory for strings from large chunks, and frees all of it at once. Allocating is a
+// pointer bump, and nothing is freed until Reset or Rewind, so every string stays where it is
+// for as long as the arena is in use.
+//
+// Reset keeps the chunks, so an arena that is reused for similar work stops allocating after
+// the first use. The arena is not thread safe, use one per thread.
+class StringArena
+{
+public:
+	static constexpr size_t DefaultChunkSize = 64 * 1024;
+
+	// A position in the arena that it can be rewound to.
+	struct Marker
+	{
+		size_t chunk = 0;
+		size_t used = 0;
+	};
+
+	// Rewinds the arena to where it was when the scope was entered.
+	class Scope
+	{
+	public:
+		explicit Scope(StringArena& arena)
+			: m_arena(arena)
+			, m_marker(arena.GetMarker())
+		{
+		}
+
+		~Scope()
+		{
+			m_arena.Rewind(m_marker);
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		StringArena& m_arena;
+		Marker m_marker;
+	};
+
+	explicit StringArena(size_t chunkSize = DefaultChunkSize)
+		: m_chunkSize(chunkSize)
+	{
+	}
+
+	StringArena(const StringArena&) = delete;
+	StringArena& operator=(const StringArena&) = delete;
+
+	// Returns size bytes of uninitialized memory.
+	char* Allocate(size_t size)
+	{
+		if (m_chunks.empty() || m_chunks[m_current].size - m_used < size)
+			NextChunk(size);
+
+		char* ptr = m_chunks[m_current].data.get() + m_used;
+		m_used += size;
+		return ptr;
+	}
+
+	// Copies a string into the arena and null terminates it.
+	char* Store(std::string_view value)
+	{
+		char* ptr = Allocate(value.size() + 1);
+		memcpy(ptr, value.data(), value.size());
+		ptr[value.size()] = 0;
+		return ptr;
+	}
+
+	Marker GetMarker() const
+	{
+		return { m_current, m_used };
+	}
+
+	// Free everything that was allocated after the marker was taken.
+	void Rewind(const Marker& marker)
+	{
+		m_current = marker.chunk;
+		m_used = marker.used;
+	}
+
+	// Free everything.
+	void Reset()
+	{
+		m_current = 0;
+		m_used = 0;
+	}
+
+	// Returns true if ptr points into memory that was allocated after the marker was taken.
+	bool AllocatedSince(const Marker& marker, const void* ptr) const
+	{
+		if (m_chunks.empty())
+			return false;
+
+		const char* p = static_cast<const char*>(ptr);
+		for (size_t i = marker.chunk; i <= m_current; ++i)
+		{
+			const char* begin = m_chunks[i].data.get() + (i == marker.chunk ? marker.used : 0);
+			const char* end = m_chunks[i].data.get() + (i == m_current ? m_used : m_chunks[i].size);
+
+			if (p >= begin && p < end)
+				return true;
+		}
+
+		return false;
+	}
+
+	// Bytes handed out since the last Reset.
+	size_t GetUsed() const
+	{
+		size_t used = m_used;
+		for (size_t i = 0; i < m_current && i < m_chunks.size(); ++i)
+			used += m_chunks[i].size;
+		return used;
+	}
+
+	// Bytes held by the arena.
+	size_t GetCapacity() const
+	{
+		size_t capacity = 0;
+		for (const Chunk& chunk : m_chunks)
+			capacity += chunk.size;
+		return capacity;
+	}
+
+private:
+	struct Chunk
+	{
+		std::unique_ptr<char[]> data;
+		size_t size = 0;
+	};
+
+	void NextChunk(size_t size)
+	{
+		// Reuse the chunks that are left over from before the last Reset when they are big enough.
+		// A chunk that is too small is skipped, wasting its space until the next Reset.
+		size_t next = m_chunks.empty() ? 0 : m_current + 1;
+		while (next < m_chunks.size() && m_chunks[next].size < size)
+			++next;
+
+		if (next == m_chunks.size())
+		{
+			Chunk& chunk = m_chunks.emplace_back();
+			chunk.size = (std::max)(m_chunkSize, size);
+			chunk.data = std::make_unique<char[]>(chunk.size);
+		}
+
+		m_current = next;
+		m_used = 0;
+	}
+
+	std::vector<Chunk> m_chunks;
+	size_t m_chunkSize;
+	size_t m_current = 0;
+	size_t m_used = 0;
+};
+
+} // namespace mq
@@ -0,0 +1,349 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Implements a deadline queue for timers that are checked once per pulse.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace mq {
+
+// A min-heap of callbacks keyed on an absolute deadline. The queue has no clock of its own:
+// deadlines are in whatever unit the owner passes to Process (milliseconds, heartbeat ticks...).
+//
+// Schedule, Reschedule and Cancel are O(log n), and Process only visits the entries that have
+// expired, so a large number of pending deadlines doesn't cost anything per pulse. Entries that
+// share a deadline fire in the order they were scheduled.
+//
+// The queue is not thread safe, synchronize access to it if it is shared between threads.
+class TimerQueue
+{
+public:
+	using Callback = std::function<void()>;
+
+	// Identifies a scheduled callback. Ids are never reused, so holding on to the id of a
+	// callback that already fired or was cancelled is harmless.
+	using TimerId = uint64_t;
+	static constexpr TimerId InvalidTimerId = 0;
+
+	static constexpr uint64_t NoDeadline = (std::numeric_limits<uint64_t>::max)();
+
+	TimerQueue() = default;
+	TimerQueue(const TimerQueue&) = delete;
+	TimerQueue& operator=(const TimerQueue&) = delete;
+
+	// Schedule a callback to run the first time Process is called with now >= deadline.
+	TimerId Schedule(uint64_t deadline, Callback callback)
+	{
+		uint32_t slot;
+		if (!m_freeSlots.empty())
+		{
+			slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else
+		{
+			slot = static_cast<uint32_t>(m_entries.size());
+			m_entries.emplace_back();
+		}
+
+		Entry& entry = m_entries[slot];
+		entry.deadline = deadline;
+		entry.sequence = m_sequence++;
+		entry.callback = std::move(callback);
+		entry.heapIndex = static_cast<uint32_t>(m_heap.size());
+
+		m_heap.push_back(slot);
+		SiftUp(entry.heapIndex);
+
+		return MakeId(slot, entry.generation);
+	}
+
+	// Move a pending callback to a new deadline. Returns false if the id is no longer pending.
+	bool Reschedule(TimerId id, uint64_t deadline)
+	{
+		Entry* entry = GetEntry(id);
+		if (!entry)
+			return false;
+
+		entry->deadline = deadline;
+		entry->sequence = m_sequence++;
+
+		// A deferred entry goes back into the heap when Process is done with it.
+		if (!entry->deferred)
+		{
+			SiftUp(entry->heapIndex);
+			SiftDown(entry->heapIndex);
+		}
+		return true;
+	}
+
+	// Remove a pending callback without running it. Returns false if the id is no longer pending.
+	bool Cancel(TimerId id)
+	{
+		Entry* entry = GetEntry(id);
+		if (!entry)
+			return false;
+
+		if (entry->deferred)
+			RemoveDeferred(entry->heapIndex);
+		else
+			RemoveAt(entry->heapIndex);
+		return true;
+	}
+
+	bool IsScheduled(TimerId id) const
+	{
+		return GetEntry(id) != nullptr;
+	}
+
+	// Returns the deadline of a pending callback, or NoDeadline if it isn't pending.
+	uint64_t GetDeadline(TimerId id) const
+	{
+		const Entry* entry = GetEntry(id);
+		return entry ? entry->deadline : NoDeadline;
+	}
+
+	// Returns the earliest pending deadline, or NoDeadline if the queue is empty.
+	uint64_t NextDeadline() const
+	{
+		uint64_t deadline = m_heap.empty() ? NoDeadline : m_entries[m_heap.front()].deadline;
+		for (uint32_t slot : m_deferred)
+			deadline = (std::min)(deadline, m_entries[slot].deadline);
+
+		return deadline;
+	}
+
+	// Run every callback whose deadline is <= now, earliest first. Callbacks may schedule or
+	// cancel other callbacks. Anything scheduled while processing waits for the next call, even
+	// if it is already due, so a callback that reschedules itself can't stall the caller.
+	// Returns the number of callbacks that ran.
+	size_t Process(uint64_t now)
+	{
+		const uint64_t lastSequence = m_sequence;
+		size_t count = 0;
+
+		while (!m_heap.empty())
+		{
+			Entry& entry = m_entries[m_heap.front()];
+			if (entry.deadline > now)
+				break;
+
+			if (entry.sequence >= lastSequence)
+			{
+				// Scheduled during this call. Set it aside so that the entries behind it still run.
+				Defer(0);
+				continue;
+			}
+
+			Callback callback = std::move(entry.callback);
+			RemoveAt(0);
+
+			if (callback)
+				callback();
+			++count;
+		}
+
+		for (uint32_t slot : m_deferred)
+		{
+			Entry& entry = m_entries[slot];
+			entry.deferred = false;
+			entry.heapIndex = static_cast<uint32_t>(m_heap.size());
+
+			m_heap.push_back(slot);
+			SiftUp(entry.heapIndex);
+		}
+		m_deferred.clear();
+
+		return count;
+	}
+
+	// Drop every pending callback without running it.
+	void Clear()
+	{
+		while (!m_deferred.empty())
+			RemoveDeferred(static_cast<uint32_t>(m_deferred.size() - 1));
+		while (!m_heap.empty())
+			RemoveAt(static_cast<uint32_t>(m_heap.size() - 1));
+	}
+
+	bool empty() const { return m_heap.empty() && m_deferred.empty(); }
+	size_t size() const { return m_heap.size() + m_deferred.size(); }
+
+private:
+	struct Entry
+	{
+		uint64_t deadline = 0;
+		uint64_t sequence = 0;
+		Callback callback;
+		uint32_t heapIndex = 0;                    // index in m_deferred if deferred
+		uint32_t generation = 1;
+		bool deferred = false;
+	};
+
+	static TimerId MakeId(uint32_t slot, uint32_t generation)
+	{
+		return (static_cast<uint64_t>(generation) << 32) | (static_cast<uint64_t>(slot) + 1);
+	}
+
+	const Entry* GetEntry(TimerId id) const
+	{
+		const uint64_t slot = (id & 0xffffffff) - 1;
+		if (id == InvalidTimerId || slot >= m_entries.size())
+			return nullptr;
+
+		const Entry& entry = m_entries[static_cast<size_t>(slot)];
+		const std::vector<uint32_t>& list = entry.deferred ? m_deferred : m_heap;
+		if (entry.generation != static_cast<uint32_t>(id >> 32)
+			|| entry.heapIndex >= list.size()
+			|| list[entry.heapIndex] != slot)
+		{
+			return nullptr;
+		}
+
+		return &entry;
+	}
+
+	Entry* GetEntry(TimerId id)
+	{
+		return const_cast<Entry*>(std::as_const(*this).GetEntry(id));
+	}
+
+	bool Less(uint32_t a, uint32_t b) const
+	{
+		const Entry& left = m_entries[m_heap[a]];
+		const Entry& right = m_entries[m_heap[b]];
+
+		if (left.deadline != right.deadline)
+			return left.deadline < right.deadline;
+		return left.sequence < right.sequence;
+	}
+
+	void Swap(uint32_t a, uint32_t b)
+	{
+		std::swap(m_heap[a], m_heap[b]);
+		m_entries[m_heap[a]].heapIndex = a;
+		m_entries[m_heap[b]].heapIndex = b;
+	}
+
+	void SiftUp(uint32_t index)
+	{
+		while (index > 0)
+		{
+			uint32_t parent = (index - 1) / 2;
+			if (!Less(index, parent))
+				break;
+
+			Swap(index, parent);
+			index = parent;
+		}
+	}
+
+	void SiftDown(uint32_t index)
+	{
+		const uint32_t count = static_cast<uint32_t>(m_heap.size());
+
+		while (true)
+		{
+			uint32_t smallest = index;
+			uint32_t left = index * 2 + 1;
+			uint32_t right = left + 1;
+
+			if (left < count && Less(left, smallest))
+				smallest = left;
+			if (right < count && Less(right, smallest))
+				smallest = right;
+			if (smallest == index)
+				break;
+
+			Swap(index, smallest);
+			index = smallest;
+		}
+	}
+
+	// Take an entry out of the heap without freeing it.
+	void Unlink(uint32_t index)
+	{
+		const uint32_t last = static_cast<uint32_t>(m_heap.size() - 1);
+
+		if (index != last)
+		{
+			// Fill the hole with the last entry and move it to wherever it belongs.
+			Swap(index, last);
+			m_heap.pop_back();
+
+			Entry& moved = m_entries[m_heap[index]];
+			SiftUp(index);
+			SiftDown(moved.heapIndex);
+		}
+		else
+		{
+			m_heap.pop_back();
+		}
+	}
+
+	void RemoveAt(uint32_t index)
+	{
+		const uint32_t slot = m_heap[index];
+		Unlink(index);
+		FreeSlot(slot);
+	}
+
+	// Move an entry from the heap to the list that Process puts back when it is done.
+	void Defer(uint32_t index)
+	{
+		const uint32_t slot = m_heap[index];
+		Unlink(index);
+
+		Entry& entry = m_entries[slot];
+		entry.deferred = true;
+		entry.heapIndex = static_cast<uint32_t>(m_deferred.size());
+		m_deferred.push_back(slot);
+	}
+
+	void RemoveDeferred(uint32_t index)
+	{
+		const uint32_t slot = m_deferred[index];
+
+		m_deferred[index] = m_deferred.back();
+		m_entries[m_deferred[index]].heapIndex = index;
+		m_deferred.pop_back();
+
+		FreeSlot(slot);
+	}
+
+	void FreeSlot(uint32_t slot)
+	{
+		Entry& entry = m_entries[slot];
+		entry.callback = nullptr;
+		entry.heapIndex = 0;
+		entry.deferred = false;
+		++entry.generation;
+		m_freeSlots.push_back(slot);
+	}
+
+	std::vector<Entry> m_entries;
+	std::vector<uint32_t> m_freeSlots;
+	std::vector<uint32_t> m_heap;
+	std::vector<uint32_t> m_deferred;              // due, but scheduled during the current Process
+	uint64_t m_sequence = 0;
+};
+
+} // namespace mq
@@ -18,7 +18,8 @@
 
 #include "mq/utils/Args.h"
 
-#include <regex>
+#include "mq/base/AhoCorasick.h"
+
 #include <memory>
 #include <Yaml.hpp>
 
@@ -123,24 +124,11 @@ private:
 	Anonymization strategy;
 	std::string target;
 	std::set<std::string> alternates;
-	std::regex search_string;
-
-private:
-	void build_regex()
-	{
-		search_string = std::regex(
-			fmt::format("\\b({}{})\\b", name, std::accumulate(alternates.cbegin(), alternates.cend(), std::string(),
-				[](const std::string& text, std::string_view alt) -> std::string {
-					return fmt::format("{}|{}", text, alt);
-				})),
-			std::regex_constants::icase);
-	}
 
 public:
 	anon_replacer(std::string_view name, Anonymization strategy, std::string_view target = "")
 		: name(name), strategy(strategy), target(target)
 	{
-		build_regex();
 	}
 
 	anon_replacer(Yaml::Node& node)
@@ -153,8 +141,6 @@ public:
 			for (auto alt = node["alternates"].Begin(); alt != node["alternates"].End(); alt++)
 				alternates.emplace((*alt).second.As<std::string>());
 		}
-
-		build_regex();
 	}
 
 	anon_replacer(SPAWNINFO* pSpawn, Anonymization strategy, std::string_view target = "")
@@ -164,20 +150,33 @@ public:
 	{
 		if (pSpawn->Lastname[0])
 			add_alternate(pSpawn->Name);
-
-		build_regex();
 	}
 
 	void add_alternate(std::string_view alternate)
 	{
 		alternates.emplace(std::string(alternate));
-		build_regex();
 	}
 
 	void drop_alternate(std::string_view alternate)
 	{
 		alternates.erase(std::string(alternate));
-		build_regex();
+	}
+
+	// the name and every alternate, with the `\s` that separates a first and last name turned into a space
+	template <typename Visit>
+	void for_each_pattern(Visit&& visit) const
+	{
+		auto unescape = [](std::string_view pattern)
+		{
+			std::string text(pattern);
+			for (size_t pos = text.find("\\s"); pos != std::string::npos; pos = text.find("\\s", pos + 1))
+				text.replace(pos, 2, " ");
+			return text;
+		};
+
+		visit(unescape(name));
+		for (const std::string& alt : alternates)
+			visit(unescape(alt));
 	}
 
 	void update_strategy(Anonymization strategy)
@@ -264,13 +263,6 @@ public:
 		}
 	}
 
-	std::string replace_text(std::string_view text) const
-	{
-		std::string result;
-		std::regex_replace(std::back_inserter(result), std::cbegin(text), std::cend(text), search_string, anonymize());
-		return result;
-	}
-
 	Yaml::Node Serialize()
 	{
 		Yaml::Node node;
@@ -295,8 +287,155 @@ static ci_unordered::map<std::string_view, std::unique_ptr<anon_replacer>> guild
 static ci_unordered::map<std::string_view, std::unique_ptr<anon_replacer>> raid_memoization;
 static std::unique_ptr<anon_replacer> self_replacer;
 
+// Finds the names of every replacer in a text with one pass over the text. The names and alternates
+// of the replacers in use go into one case-insensitive automaton, which is only rebuilt when the set
+// of replacers changes or one of them is invalidated.
+//
+// As with a `\b(name|alternates)\b` regex, a name only matches as a whole word. Where names overlap,
+// the one that starts first wins, then the longest, then the one from the replacer that comes first.
+class anon_matcher
+{
+	struct pattern
+	{
+		size_t owner;    // index into roster
+		size_t length;
+	};
+
+	struct match
+	{
+		size_t start;
+		size_t length;
+		size_t owner;
+	};
+
+	mq::AhoCorasick automaton;
+	std::vector<anon_replacer*> roster;
+	std::vector<pattern> patterns;  // by automaton index
+	std::vector<match> matches;
+	bool dirty = true;
+
+	static bool is_word_char(char ch)
+	{
+		return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_';
+	}
+
+	// the same as `\b`: a word character on exactly one side of pos
+	static bool is_word_boundary(std::string_view text, size_t pos)
+	{
+		const bool before = pos > 0 && is_word_char(text[pos - 1]);
+		const bool after = pos < text.length() && is_word_char(text[pos]);
+		return before != after;
+	}
+
+public:
+	// needs to be called when the names of a replacer change, or a replacer is destroyed (so that a
+	// new one at the same address isn't mistaken for it)
+	void invalidate()
+	{
+		dirty = true;
+	}
+
+	bool is_dirty() const
+	{
+		return dirty;
+	}
+
+	// the replacers to look for, in order of precedence
+	void update(const std::vector<anon_replacer*>& active)
+	{
+		if (!dirty && active == roster)
+			return;
+
+		roster = active;
+		patterns.clear();
+		automaton.Clear();
+
+		for (size_t owner = 0; owner < roster.size(); ++owner)
+		{
+			roster[owner]->for_each_pattern([this, owner](const std::string& text)
+				{
+					if (!text.empty())
+					{
+						automaton.Add(text);
+						patterns.push_back({ owner, text.length() });
+					}
+				});
+		}
+
+		automaton.Build();
+		dirty = false;
+	}
+
+	// writes the text with every name replaced to result, returns false (leaving result alone) if
+	// there was nothing to replace
+	bool replace(std::string_view text, std::string& result)
+	{
+		matches.clear();
+		automaton.Find(text, [this, text](size_t index, size_t start)
+			{
+				const pattern& found = patterns[index];
+				if (is_word_boundary(text, start) && is_word_boundary(text, start + found.length))
+					matches.push_back({ start, found.length, found.owner });
+			});
+
+		if (matches.empty())
+			return false;
+
+		std::sort(std::begin(matches), std::end(matches),
+			[](const match& a, const match& b)
+			{
+				if (a.start != b.start)
+					return a.start < b.start;
+				if (a.length != b.length)
+					return a.length > b.length;
+				return a.owner < b.owner;
+			});
+
+		// replacements are computed once per call, and only for the replacers that matched
+		std::vector<std::pair<size_t, std::string>> replacements;
+
+		result.clear();
+		result.reserve(text.length() + text.length() / 2);
+
+		size_t copied = 0;
+		for (const match& m : matches)
+		{
+			if (m.start < copied)
+				continue;
+
+			auto replacement = std::find_if(std::begin(replacements), std::end(replacements),
+				[&m](const auto& r) { return r.first == m.owner; });
+			if (replacement == std::end(replacements))
+			{
+				replacements.emplace_back(m.owner, roster[m.owner]->anonymize());
+				replacement = std::prev(std::end(replacements));
+			}
+
+			result.append(text.data() + copied, m.start - copied);
+			result.append(replacement->second);
+			copied = m.start + m.length;
+		}
+
+		result.append(text.data() + copied, text.length() - copied);
+		return true;
+	}
+};
+
+static anon_matcher matcher;
+
+// finds (or creates) the replacer for a member of a group, fellowship, guild or raid
+static anon_replacer* GetMemoizedReplacer(ci_unordered::map<std::string_view, std::unique_ptr<anon_replacer>>& memoization,
+	const char* name, Anonymization strategy)
+{
+	auto memoized = memoization.find(name);
+	if (memoized == memoization.end())
+		memoized = memoization.emplace(name, std::make_unique<anon_replacer>(name, strategy)).first;
+
+	return memoized->second.get();
+}
+
 // the source string_view here will be used to index
-// creating a regex that looks like `(source|all|the|alternates)`
+// and the matcher looks for the source and all of its alternates as whole words
 
 // helper function to find a replacer by name
 static std::vector<std::unique_ptr<anon_replacer>>::iterator FindReplacer(std::string_view Name)
@@ -314,6 +453,7 @@ static void SetAnonymization(AnonymizationClasses AnonClass, Anonymization Strat
 		{
 			anon_group = Strategy;
 			group_memoization.clear();
+			matcher.invalidate();
 		}
 		break;
 
@@ -322,6 +462,7 @@ static void SetAnonymization(AnonymizationClasses AnonClass, Anonymization Strat
 		{
 			anon_fellowship = Strategy;
 			fellowship_memoization.clear();
+			matcher.invalidate();
 		}
 		break;
 
@@ -330,6 +471,7 @@ static void SetAnonymization(AnonymizationClasses AnonClass, Anonymization Strat
 		{
 			anon_guild = Strategy;
 			guild_memoization.clear();
+			matcher.invalidate();
 		}
 		break;
 
@@ -338,6 +480,7 @@ static void SetAnonymization(AnonymizationClasses AnonClass, Anonymization Strat
 		{
 			anon_raid = Strategy;
 			raid_memoization.clear();
+			matcher.invalidate();
 		}
 		break;
 
@@ -346,7 +489,10 @@ static void SetAnonymization(AnonymizationClasses AnonClass, Anonymization Strat
 		{
 			anon_self = Strategy;
 			if (!self_replacer)
+			{
 				self_replacer = std::make_unique<anon_replacer>(pLocalPlayer, anon_self);
+				matcher.invalidate();
+			}
 			else
 				self_replacer->update_strategy(Strategy);
 		}
@@ -378,6 +524,7 @@ static void AddAnonymization(std::string_view Name, Anonymization Strategy, std:
 	else
 	{
 		replacers.emplace_back(std::make_unique<anon_replacer>(Name, Strategy, Replace));
+		matcher.invalidate();
 		WriteChatf("Added anonymization \at%s\ax with \at%s\ax%s",
 			Name.data(),
 			GetStringFromAnonymization(Strategy).data(),
@@ -392,6 +539,7 @@ static void DropAnonymization(std::string_view Name)
 	if (replacer_it != std::end(replacers))
 	{
 		replacers.erase(replacer_it);
+		matcher.invalidate();
 		WriteChatf("Un-Anonymized \at%s\ax.", Name.data());
 	}
 	else
@@ -408,6 +556,7 @@ static void AddAlternate(std::string_view Name, std::string_view Alternate)
 	if (replacer_it != std::end(replacers))
 	{
 		(*replacer_it)->add_alternate(Alternate);
+		matcher.invalidate();
 		WriteChatf("Added Alias \ay%s\ax to \at%s\ax.", Alternate.data(), Name.data());
 	}
 	else
@@ -424,6 +573,7 @@ static void DropAlternate(std::string_view Name, std::string_view Alternate)
 	if (replacer_it != std::end(replacers))
 	{
 		(*replacer_it)->drop_alternate(Alternate);
+		matcher.invalidate();
 		WriteChatf("Dropped Alias \ay%s\ax from \at%s\ax.", Alternate.data(), Name.data());
 	}
 	else
@@ -443,6 +593,7 @@ static void DropAlternate(std::string_view Alternate)
 			{
 				r->drop_alternate(Alternate);
 				changed = true;
+				matcher.invalidate();
 				WriteChatf("Dropped Alias \ay%s\ax from \at%s\ax.", Alternate.data(), r->name.c_str());
 			}
 		});
@@ -459,7 +610,11 @@ static void SetAnon(bool anon_state)
 	if (test_and_set(anon_enabled, anon_state))
 	{
 		if (anon_enabled)
+		{
+			// the roster isn't kept up to date while anonymization is off
+			matcher.invalidate();
 			InstallAnonDetours();
+		}
 		else
 			RemoveAnonDetours();
 	}
@@ -540,6 +695,7 @@ static void Deserialize()
 	guild_memoization.clear();
 	raid_memoization.clear();
 	self_replacer.reset();
+	matcher.invalidate();
 	WriteChatf("Done.");
 }
 
@@ -558,108 +714,60 @@ CXStr& PluginAnonymize(CXStr& Text)
 	return Text;
 }
 
-CXStr Anonymize(const CXStr& Text)
+// Collects the replacers that could apply, and gives them to the matcher. Walking the group, guild
+// and raid takes time in proportion to the size of the guild, so this is done once per pulse (and
+// when a command changed the replacers), not for every text that is drawn.
+static void UpdateAnonRoster()
 {
-	if (!MaybeAnonymize(Text))
-		return Text;
-
-	if (!pLocalPlayer || !pLocalPC)
-		return Text;
-
-	EnterMQ2Benchmark(bmAnonymizer);
+	// every replacer that could apply, in the order that they used to be applied in
+	static std::vector<anon_replacer*> active;
+	active.clear();
 
-	auto new_text = std::accumulate(std::cbegin(replacers), std::cend(replacers), std::string(Text),
-		[](std::string& text, const std::unique_ptr<anon_replacer>& r) -> std::string {
-			return r ? r->replace_text(text) : text;
-		});
+	for (const std::unique_ptr<anon_replacer>& r : replacers)
+	{
+		if (r)
+			active.push_back(r.get());
+	}
 
 	if (anon_self != Anonymization::None)
 	{
 		if (!self_replacer || ci_find_substr(self_replacer->name, pLocalPlayer->Name) != 0)
+		{
 			self_replacer = std::make_unique<anon_replacer>(pLocalPlayer, anon_self);
+			matcher.invalidate();
+		}
 
-		new_text = self_replacer->replace_text(new_text);
+		active.push_back(self_replacer.get());
 	}
 
 	if (anon_group != Anonymization::None && pLocalPC->Group)
 	{
-		new_text = std::accumulate(
-			std::cbegin(*pLocalPC->Group),
-			std::cend(*pLocalPC->Group),
-			new_text,
-			[](std::string& text, const CGroupMember* pMember) -> std::string
-			{
-				if (pMember && pMember->Name[0] != '\0' && ci_equals(text, pMember->Name, false))
-				{
-					auto memoized = group_memoization.find(pMember->Name);
-					if (memoized == group_memoization.end())
-						memoized = group_memoization.emplace(
-							pMember->Name,
-							std::make_unique<anon_replacer>(pMember->Name, anon_group)
-						).first;
-
-					return memoized->second->replace_text(text);
-				}
-
-				return text;
-			}
-		);
+		for (const CGroupMember* pMember : *pLocalPC->Group)
+		{
+			if (pMember && pMember->Name[0] != '\0')
+				active.push_back(GetMemoizedReplacer(group_memoization, pMember->Name.c_str(), anon_group));
+		}
 	}
 
 	if (anon_fellowship != Anonymization::None)
 	{
-		auto& fellowship = pLocalPlayer->Fellowship;
-		new_text = std::accumulate(
-			std::cbegin(fellowship.FellowshipMember),
-			std::cend(fellowship.FellowshipMember),
-			new_text,
-			[](std::string& text, const SFellowshipMember& f) -> std::string
-			{
-				if (f.Name[0] != '\0' && ci_equals(text, f.Name, false))
-				{
-					auto memoized = fellowship_memoization.find(f.Name);
-					if (memoized == fellowship_memoization.end())
-						memoized = fellowship_memoization.emplace(
-							f.Name,
-							std::make_unique<anon_replacer>(f.Name, anon_fellowship)
-						).first;
-
-					return memoized->second->replace_text(text);
-				}
-
-				return text;
-			}
-		);
+		for (const SFellowshipMember& f : pLocalPlayer->Fellowship.FellowshipMember)
+		{
+			if (f.Name[0] != '\0')
+				active.push_back(GetMemoizedReplacer(fellowship_memoization, f.Name, anon_fellowship));
+		}
 	}
 
 	if (anon_guild != Anonymization::None && pGuild)
 	{
 		const char* guild_name = pGuild->GetGuildName(pLocalPC->GuildID);
-		if (guild_name[0] != '\0' && ci_equals(new_text, guild_name, false))
-		{
-			auto memoized = guild_memoization.find(guild_name);
-			if (memoized == guild_memoization.end())
-				memoized = guild_memoization.emplace(
-					guild_name,
-					std::make_unique<anon_replacer>(guild_name, Anonymization::Asterisk)
-				).first;
-
-			new_text = memoized->second->replace_text(new_text);
-		}
+		if (guild_name[0] != '\0')
+			active.push_back(GetMemoizedReplacer(guild_memoization, guild_name, Anonymization::Asterisk));
 
 		for (GuildMember* pMember = pGuild->pFirstGuildMember; pMember; pMember = pMember->pNext)
 		{
-			if (pMember->Name[0] != '\0' && ci_equals(new_text, pMember->Name, false))
-			{
-				auto memoized = guild_memoization.find(pMember->Name);
-				if (memoized == guild_memoization.end())
-					memoized = guild_memoization.emplace(
-						pMember->Name,
-						std::make_unique<anon_replacer>(pMember->Name, anon_guild)
-					).first;
-
-				new_text = memoized->second->replace_text(new_text);
-			}
+			if (pMember->Name[0] != '\0')
+				active.push_back(GetMemoizedReplacer(guild_memoization, pMember->Name, anon_guild));
 		}
 	}
 
@@ -667,23 +775,44 @@ CXStr Anonymize(const CXStr& Text)
 	{
 		for (RaidMember& pMember : pRaid->RaidMember)
 		{
-			if (pMember.Name[0] != '\0' && ci_equals(new_text, pMember.Name, false))
-			{
-				auto memoized = raid_memoization.find(pMember.Name);
-				if (memoized == raid_memoization.end())
-					memoized = raid_memoization.emplace(
-						pMember.Name,
-						std::make_unique<anon_replacer>(pMember.Name, anon_raid)
-					).first;
-
-				new_text = memoized->second->replace_text(new_text);
-			}
+			if (pMember.Name[0] != '\0')
+				active.push_back(GetMemoizedReplacer(raid_memoization, pMember.Name, anon_raid));
 		}
 	}
 
+	matcher.update(active);
+}
+
+void PulseAnonymizer()
+{
+	if (!anon_enabled || !pLocalPlayer || !pLocalPC)
+		return;
+
+	EnterMQ2Benchmark(bmAnonymizer);
+	UpdateAnonRoster();
+	ExitMQ2Benchmark(bmAnonymizer);
+}
+
+CXStr Anonymize(const CXStr& Text)
+{
+	if (!MaybeAnonymize(Text))
+		return Text;
+
+	if (!pLocalPlayer || !pLocalPC)
+		return Text;
+
+	EnterMQ2Benchmark(bmAnonymizer);
+
+	// a command changed the replacers since the last pulse, the matcher may point at ones that are gone
+	if (matcher.is_dirty())
+		UpdateAnonRoster();
+
+	std::string new_text;
+	const bool replaced = matcher.replace(Text, new_text);
+
 	ExitMQ2Benchmark(bmAnonymizer);
 
-	return CXStr(new_text);
+	return replaced ? CXStr(new_text) : Text;
 }
 
 DETOUR_TRAMPOLINE_DEF(float, GetGaugeValueFromEQ_Trampoline, (int, CXStr*, bool*, unsigned long*))
@@ -14,6 +14,7 @@
 
 #include "pch.h"
 #include "MQ2Main.h"
+#include "MQDataAPI.h"
 
 namespace mq {
 
@@ -112,6 +113,17 @@ void Cmd_DumpBenchmarks(SPAWNINFO* pChar, char* szLine)
 	}
 	else
 	{
+		char szArg[MAX_STRING] = { 0 };
+		if (szLine)
+			GetArg(szArg, szLine, 1);
+
+		if (ci_equals(szArg, "calc"))
+		{
+			GetArg(szArg, szLine, 2);
+			BenchmarkCalculate(GetIntFromString(szArg, 10000));
+			return;
+		}
+
 		WriteChatColor("MQ2 Benchmarks");
 		WriteChatColor("--------------");
 
@@ -129,6 +141,30 @@ void Cmd_DumpBenchmarks(SPAWNINFO* pChar, char* szLine)
 			}
 		}
 
+		if (gTurboStats.Frames)
+		{
+			float AvgLines = static_cast<float>(gTurboStats.TotalLines) / static_cast<float>(gTurboStats.Frames);
+			float AvgMS = static_cast<float>(gTurboStats.TotalTime.count()) / static_cast<float>(gTurboStats.Frames) / 1000.f;
+
+			WriteChatf("[\ayMacro Turbo\ax] \at%.1f\ax lines in \at%.3f\axms per frame, \at%I64u\ax of \at%I64u\ax frames deferred (budget: \at%d\axus)",
+				AvgLines, AvgMS, gTurboStats.DeferredFrames, gTurboStats.Frames, gTurboBudget);
+		}
+
+		for (const auto& [path, stats] : pDataAPI->GetFrameMemoStats())
+		{
+			float HitRate = 100.f * static_cast<float>(stats.Hits) / static_cast<float>(stats.Hits + stats.Misses);
+
+			WriteChatf("[\ayMemo: %s\ax] \at%I64u\ax hits, \at%I64u\ax misses (\at%.1f%%\ax)",
+				path.c_str(), stats.Hits, stats.Misses, HitRate);
+		}
+
+		MQObservedObjectStats Observed = GetObservedObjectStats();
+		if (Observed.Observers || Observed.Invalidated)
+		{
+			WriteChatf("[\ayObserved Objects\ax] \at%zu\ax live observers of \at%zu\ax objects (\at%zu\ax tracked), \at%I64u\ax invalidated, \at%I64u\ax sweeps",
+				Observed.LiveObservers, Observed.Objects, Observed.Observers, Observed.Invalidated, Observed.Sweeps);
+		}
+
 		WriteChatColor("--------------");
 		WriteChatColor("End Benchmarks");
 	}
@@ -320,11 +320,16 @@ void ChatSettingsPannel()
 }
 #endif // HAS_CHAT_TIMESTAMPS
 
+// Shared by the chat Blechs, so that each line is scanned once for the events of both.
+static BlechFilter s_chatBlechFilter;
+
 void InitializeChatHook()
 {
 	// initialize Blech
 	pEventBlech = new Blech('#', '|', MQ2DataVariableLookup);
 	pMQ2Blech = new Blech('#', '|', MQ2DataVariableLookup);
+	pEventBlech->SetFilter(&s_chatBlechFilter);
+	pMQ2Blech->SetFilter(&s_chatBlechFilter);
 
 	EzDetour(CEverQuest__dsp_chat, &CChatHook::Detour, &CChatHook::Trampoline);
 	EzDetour(CEverQuest__DoTellWindow, &CChatHook::TellWnd_Detour, &CChatHook::TellWnd_Trampoline);
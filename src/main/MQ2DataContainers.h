@@ -46,6 +46,10 @@ public:
 	virtual operator bool() const = 0;
 	virtual bool operator==(void*) const = 0;
 
+	// The address of the object being observed. Transients that return one are invalidated
+	// through a lookup by address instead of being compared to every invalidated object.
+	virtual void* GetObservedAddress() const { return nullptr; }
+
 	MQTransient() = default;
 };
 
@@ -118,6 +122,11 @@ public:
 		return static_cast<void*>(m_object) == rhs;
 	}
 
+	void* GetObservedAddress() const override
+	{
+		return m_object;
+	}
+
 	std::shared_ptr<MQEQObject<EQType>> Get() { return SharedFromBase<MQEQObject<EQType>>(); }
 
 	EQType& operator*()
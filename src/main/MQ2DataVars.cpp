@@ -16,6 +16,8 @@
 #include "MQ2Main.h"
 #include "MQDataAPI.h"
 
+#include "mq/base/AhoCorasick.h"
+
 #include <variant>
 
 using namespace mq::datatypes;
@@ -23,18 +25,161 @@ namespace mq {
 
 static std::recursive_mutex s_dataVarMutex;
 
+// The same variables as VariableMap, hashed and keyed by views into MQDataVar::szName so that
+// lookups from a const char* or string_view don't build a std::string. VariableMap is exported and
+// keeps its type for plugins, this is what the lookups here use.
+static std::unordered_map<std::string_view, MQDataVar*> s_variableIndex;
+
+// Changes whenever VariableMap does, so lookups can be cached.
+static uint32_t s_variableMapGeneration = 1;
+static uint32_t s_nextVariableLayoutId = 0;
+
+static void AddToVariableMap(MQDataVar* pVar)
+{
+	VariableMap[pVar->szName] = pVar;
+
+	// the key has to point at the name owned by the variable.
+	s_variableIndex.erase(pVar->szName);
+	s_variableIndex.emplace(pVar->szName, pVar);
+
+	++s_variableMapGeneration;
+}
+
+static void RemoveFromVariableMap(MQDataVar* pVar)
+{
+	VariableMap.erase(pVar->szName);
+	s_variableIndex.erase(pVar->szName);
+
+	++s_variableMapGeneration;
+}
+
+//----------------------------------------------------------------------------
+// Stack frame variables
+//
+// Parameters and locals live in the Parameters and LocalVariables lists of their stack frame.
+// Each frame also keeps them in VariableSlots, indexed by the slot that their sub's layout gives
+// the name, so finding one is an array access. Parameters are searched before locals and the
+// most recently added variable comes first, so that is what a slot holds if it ever has more
+// than one candidate.
+
+static MQDataVar* SearchStackVariables(const MQMacroStack* pStack, std::string_view Name)
+{
+	for (MQDataVar* pVar = pStack->Parameters; pVar; pVar = pVar->pNext)
+	{
+		if (Name == pVar->szName)
+			return pVar;
+	}
+
+	for (MQDataVar* pVar = pStack->LocalVariables; pVar; pVar = pVar->pNext)
+	{
+		if (Name == pVar->szName)
+			return pVar;
+	}
+
+	return nullptr;
+}
+
+static MQDataVar* FindStackVariable(const MQMacroStack* pStack, std::string_view Name)
+{
+	if (!pStack->pVariableLayout)
+		return SearchStackVariables(pStack, Name);
+
+	const int slot = pStack->pVariableLayout->FindSlot(Name);
+	if (slot < 0 || slot >= static_cast<int>(pStack->VariableSlots.size()))
+		return nullptr;
+
+	return pStack->VariableSlots[slot];
+}
+
+static MQMacroStack* FindOwningStack(MQDataVar** ppHead)
+{
+	for (MQMacroStack* pStack = gMacroStack; pStack; pStack = pStack->pNext)
+	{
+		if (ppHead == &pStack->Parameters || ppHead == &pStack->LocalVariables)
+			return pStack;
+	}
+
+	return nullptr;
+}
+
+static void AddStackVariable(MQMacroStack* pStack, MQDataVar* pVar)
+{
+	if (!pStack->pVariableLayout)
+		return;
+
+	const int slot = pStack->pVariableLayout->AddSlot(pVar->szName);
+	if (slot >= static_cast<int>(pStack->VariableSlots.size()))
+		pStack->VariableSlots.resize(slot + 1, nullptr);
+
+	MQDataVar*& entry = pStack->VariableSlots[slot];
+	if (entry && entry != pVar)
+	{
+		pStack->HasShadowedVariables = true;
+		entry = SearchStackVariables(pStack, pVar->szName);
+	}
+	else
+	{
+		entry = pVar;
+	}
+}
+
+// Called after the variable has been unlinked from its list.
+static void RemoveStackVariable(MQMacroStack* pStack, MQDataVar* pVar)
+{
+	if (!pStack->pVariableLayout)
+		return;
+
+	const int slot = pStack->pVariableLayout->FindSlot(pVar->szName);
+	if (slot < 0 || slot >= static_cast<int>(pStack->VariableSlots.size()))
+		return;
+
+	MQDataVar*& entry = pStack->VariableSlots[slot];
+	if (entry == pVar)
+	{
+		entry = pStack->HasShadowedVariables ? SearchStackVariables(pStack, pVar->szName) : nullptr;
+	}
+}
+
+void InitMacroStackVariables(MQMacroStack* pStack, int SubLine)
+{
+	std::scoped_lock lock(s_dataVarMutex);
+
+	if (!gMacroBlock)
+		return;
+
+	auto& pLayout = gMacroBlock->VariableLayouts[SubLine];
+	if (!pLayout)
+	{
+		pLayout = std::make_unique<MQSubVariableLayout>();
+		pLayout->Id = ++s_nextVariableLayoutId;
+	}
+
+	pStack->pVariableLayout = pLayout.get();
+	pStack->VariableSlots.assign(pLayout->Names.size(), nullptr);
+
+	// Event parameters are created before the frame they end up in.
+	for (MQDataVar* pVar = pStack->Parameters; pVar; pVar = pVar->pNext)
+	{
+		AddStackVariable(pStack, pVar);
+	}
+}
+
+//----------------------------------------------------------------------------
+
 void DeleteMQ2DataVariable(MQDataVar* pVar)
 {
 	std::scoped_lock lock(s_dataVarMutex);
 
 	if (pVar->ppHead == &pMacroVariables || pVar->ppHead == &pGlobalVariables)
-		VariableMap.erase(pVar->szName);
+		RemoveFromVariableMap(pVar);
 	if (pVar->pNext)
 		pVar->pNext->pPrev = pVar->pPrev;
 	if (pVar->pPrev)
 		pVar->pPrev->pNext = pVar->pNext;
 	else
 		*pVar->ppHead = pVar->pNext;
+	if (MQMacroStack* pStack = FindOwningStack(pVar->ppHead))
+		RemoveStackVariable(pStack, pVar);
 	pVar->Var.Type->FreeVariable(pVar->Var.VarPtr);
 	delete pVar;
 }
@@ -43,35 +188,53 @@ MQDataVar* FindMacroVariable(const char* Name)
 {
 	std::scoped_lock lock(s_dataVarMutex);
 
-	MQDataVar* pFind = nullptr;
-	auto it = VariableMap.find(Name);
-	if (it != VariableMap.end())
-		pFind = it->second;
-
-	if (pFind)
-		return pFind;
+	auto it = s_variableIndex.find(Name);
+	if (it != s_variableIndex.end())
+		return it->second;
 
 	// local?
 	if (gMacroStack)
+		return FindStackVariable(gMacroStack, Name);
+
+	return nullptr;
+}
+
+MQDataVar* FindMacroVariable(std::string_view Name, MQVariableLookupCache& cache)
+{
+	std::scoped_lock lock(s_dataVarMutex);
+
+	if (cache.GlobalGeneration != s_variableMapGeneration)
 	{
-		MQDataVar* pVar = gMacroStack->Parameters;
-		while (pVar)
-		{
-			if (!strcmp(pVar->szName, Name))
-				return pVar;
-			pVar = pVar->pNext;
-		}
+		auto it = s_variableIndex.find(Name);
 
-		pVar = gMacroStack->LocalVariables;
-		while (pVar)
-		{
-			if (!strcmp(pVar->szName, Name))
-				return pVar;
-			pVar = pVar->pNext;
-		}
+		cache.pGlobal = it != s_variableIndex.end() ? it->second : nullptr;
+		cache.GlobalGeneration = s_variableMapGeneration;
 	}
 
-	return nullptr;
+	if (cache.pGlobal)
+		return cache.pGlobal;
+
+	if (!gMacroStack)
+		return nullptr;
+
+	const MQSubVariableLayout* pLayout = gMacroStack->pVariableLayout;
+	if (!pLayout)
+		return SearchStackVariables(gMacroStack, Name);
+
+	// Slots are never removed from a layout, so a missing name only has to be looked up again
+	// if the layout has grown since.
+	const int layoutSize = static_cast<int>(pLayout->Names.size());
+	if (cache.LayoutId != pLayout->Id || (cache.Slot == -1 && cache.LayoutSize != layoutSize))
+	{
+		cache.LayoutId = pLayout->Id;
+		cache.LayoutSize = layoutSize;
+		cache.Slot = pLayout->FindSlot(Name);
+	}
+
+	if (cache.Slot < 0 || cache.Slot >= static_cast<int>(gMacroStack->VariableSlots.size()))
+		return nullptr;
+
+	return gMacroStack->VariableSlots[cache.Slot];
 }
 
 bool IsMacroVariable(const char* variableName)
@@ -181,7 +344,7 @@ static bool AddMQ2DataEventVariable(const char* Name, const char* Index, MQ2Type
 
 	if (pVar->ppHead == &pMacroVariables || pVar->ppHead == &pGlobalVariables)
 	{
-		VariableMap[Name] = pVar;
+		AddToVariableMap(pVar);
 	}
 
 	return true;
@@ -237,7 +400,11 @@ static bool AddMQ2DataVariableBy(const char* Name, const char* Index, MQ2Type* p
 
 	if (!(gMacroStack && (ppHead == &gMacroStack->LocalVariables || ppHead == &gMacroStack->Parameters)))
 	{
-		VariableMap[Name] = pVar;
+		AddToVariableMap(pVar);
+	}
+	else
+	{
+		AddStackVariable(gMacroStack, pVar);
 	}
 
 	return true;
@@ -769,35 +936,229 @@ void CALLBACK EventBlechCallback(unsigned int ID, void* pData, PBLECHVALUE pValu
 	}
 }
 
-static DWORD CALLBACK BeepOnTellThread(void* pData)
+// The text between the speaker and what they said, for each channel that a chat event can come
+// from. When a line has more than one of these, the first one in the table wins.
+struct ChatChannelMarker
 {
-	Beep(750, 200);
-	return 0;
-}
-
-static void TellCheck(const char* szClean)
+	std::string_view Marker;
+	DWORD Filter;                  // the CHAT_ flag that turns on events for the channel
+	const char* Channel;
+	size_t ContentOffset = 0;      // where the content starts after the marker, 0 to look for ", '"
+};
+
+static const ChatChannelMarker s_chatChannelMarkers[] = {
+	{ " tells the guild, ",          CHAT_GUILD, "guild" },
+	{ " tells the group, ",          CHAT_GROUP, "group" },
+	{ " tells you, ",                CHAT_TELL,  "tell" },
+	{ " told you, ",                 CHAT_TELL,  "tell" },
+	// Cannot be said in another language, so we can match through the single quote here
+	{ " says out of character, '",   CHAT_OOC,   "ooc" },
+	{ " shouts, ",                   CHAT_SHOUT, "shout" },
+	{ " auctions, ",                 CHAT_AUC,   "auc" },
+	// What scenario misses the comma?  This is the only reason we need the ContentOffset
+	{ " says '",                     CHAT_SAY,   "say", 7 },
+	{ " says, ",                     CHAT_SAY,   "say" },
+	{ " tells the raid, ",           CHAT_RAID,  "raid" },
+};
+
+// Finds the channel, speaker and content of a chat line with one pass over the line. Only the
+// markers of the channels that are turned on are looked for, and the results point into the line
+// that was scanned, so they are only good for as long as it is.
+class ChatLineClassifier
 {
-	if (!gbFlashOnTells && !gbBeepOnTells)
-		return;
+public:
+	struct ChatLine
+	{
+		std::string_view Channel;
+		std::string_view Speaker;
+		std::string_view Content;
+	};
+
+	// Sets the channels to look for, from the CHAT_ flags, and whether to look for tells no matter
+	// what the flags are.
+	void Update(DWORD channelMask, bool tells)
+	{
+		if (m_built && channelMask == m_channelMask && tells == m_tells)
+			return;
+
+		m_channelMask = channelMask;
+		m_tells = tells;
+		m_automaton.Clear();
+		m_slots.clear();
+
+		for (size_t slot = 0; slot < ChannelCount; ++slot)
+		{
+			const ChatChannelMarker& marker = s_chatChannelMarkers[slot];
+			if ((channelMask & marker.Filter) != 0 || (tells && marker.Filter == CHAT_TELL))
+				AddMarker(slot, marker.Marker);
+		}
+
+		// Custom chat channels: "Name tells channel:1, 'text'", but not "You told channel:1, 'text'"
+		if ((channelMask & CHAT_CHAT) != 0)
+		{
+			AddMarker(ChatYouTold, "You told ");
+			AddMarker(ChatTells, " tells ");
+			AddMarker(ChatColon, ":");
+			AddMarker(ChatQuote, ", '");
+		}
+
+		m_automaton.Build();
+		m_built = true;
+	}
+
+	void Scan(std::string_view line)
+	{
+		m_line = line;
+		std::fill(std::begin(m_found), std::end(m_found), std::string_view::npos);
+
+		m_automaton.Find(line,
+			[this](size_t index, size_t offset)
+			{
+				// Occurrences of a marker are found in order, so the first one is where strstr would stop.
+				const size_t slot = m_slots[index];
+				if (m_found[slot] == std::string_view::npos
+					&& m_line.compare(offset, MarkerText(slot).length(), MarkerText(slot)) == 0)
+				{
+					m_found[slot] = offset;
+				}
+			});
+	}
 
-	if (!pLocalPlayer) return;
+	// Who sent us a tell in the last line scanned, empty if it isn't a tell.
+	std::string_view GetTellSender() const
+	{
+		for (size_t slot = 0; slot < ChannelCount; ++slot)
+		{
+			if (s_chatChannelMarkers[slot].Filter == CHAT_TELL && m_found[slot] != std::string_view::npos)
+				return m_line.substr(0, m_found[slot]);
+		}
 
-	char name[MAX_STRING] = { 0 };
-	bool isTell = false;
-	if (const char* pDest = strstr(szClean, " tells you, "))
+		return {};
+	}
+
+	// Finds the chat event in the last line scanned, on the channels passed to Update.
+	bool GetChatEvent(ChatLine& chat) const
 	{
-		strncpy_s(name, szClean, static_cast<int>(pDest - szClean));
-		isTell = true;
+		for (size_t slot = 0; slot < ChannelCount; ++slot)
+		{
+			const ChatChannelMarker& marker = s_chatChannelMarkers[slot];
+
+			if ((m_channelMask & marker.Filter) != 0 && m_found[slot] != std::string_view::npos)
+			{
+				chat.Channel = marker.Channel;
+				SplitLine(m_found[slot], marker.ContentOffset, chat);
+				return true;
+			}
+		}
+
+		if ((m_channelMask & CHAT_CHAT) != 0
+			&& m_found[ChatYouTold] == std::string_view::npos
+			&& m_found[ChatTells] != std::string_view::npos)
+		{
+			// Without the colon and quote this still is an event, just without a channel.
+			chat.Channel = {};
+			if (m_found[ChatColon] != std::string_view::npos && m_found[ChatQuote] != std::string_view::npos)
+			{
+				// The channel is between " tells " and the colon, or the end of the line without its last character.
+				std::string_view channel = m_line.substr(m_found[ChatTells] + MarkerText(ChatTells).length());
+				if (!channel.empty())
+					channel.remove_suffix(1);
+
+				chat.Channel = channel.substr(0, channel.find(':'));
+			}
+
+			SplitLine(m_found[ChatTells], 0, chat);
+			return true;
+		}
+
+		return false;
 	}
-	else if (pDest = strstr(szClean, " told you, "))
+
+private:
+	enum : size_t
+	{
+		ChannelCount = lengthof(s_chatChannelMarkers),
+		ChatYouTold = ChannelCount,
+		ChatTells,
+		ChatColon,
+		ChatQuote,
+		SlotCount
+	};
+
+	static std::string_view MarkerText(size_t slot)
 	{
-		strncpy_s(name, szClean, static_cast<int>(pDest - szClean));
-		isTell = true;
+		switch (slot)
+		{
+		case ChatYouTold: return "You told ";
+		case ChatTells: return " tells ";
+		case ChatColon: return ":";
+		case ChatQuote: return ", '";
+		default: return s_chatChannelMarkers[slot].Marker;
+		}
 	}
 
-	if (!isTell || strlen(name) >= EQ_MAX_NAME)
+	void AddMarker(size_t slot, std::string_view text)
+	{
+		m_automaton.Add(text);
+		m_slots.push_back(slot);
+	}
+
+	void SplitLine(size_t markerPos, size_t contentOffset, ChatLine& chat) const
+	{
+		chat.Speaker = m_line.substr(0, markerPos);
+
+		const std::string_view rest = m_line.substr(markerPos);
+		if (contentOffset == 0)
+		{
+			// Almost all strings have , ' in them to denote the starting text
+			size_t pos = rest.find(", '");
+			if (pos != std::string_view::npos)
+			{
+				contentOffset = pos + 3;
+			}
+			else
+			{
+				// (SPAM) will not have this, so fall back to comma space. If that isn't found either,
+				// just give the whole thing
+				pos = rest.find(", ");
+				contentOffset = pos != std::string_view::npos ? pos + 2 : 0;
+			}
+		}
+
+		chat.Content = rest.substr(std::min(contentOffset, rest.length()));
+
+		// Only strip the last character if it is the closing quote that was expected
+		if (!chat.Content.empty() && chat.Content.back() == '\'')
+			chat.Content.remove_suffix(1);
+	}
+
+	mq::AhoCorasick m_automaton;
+	std::vector<size_t> m_slots;                   // by automaton index
+	size_t m_found[SlotCount];                     // where each marker first is in the line
+	std::string_view m_line;
+	DWORD m_channelMask = 0;
+	bool m_tells = false;
+	bool m_built = false;
+};
+
+// Chat is only handled on the main thread, so one is shared by every line.
+static ChatLineClassifier s_chatClassifier;
+
+static DWORD CALLBACK BeepOnTellThread(void* pData)
+{
+	Beep(750, 200);
+	return 0;
+}
+
+// Flashes the window or beeps, if turned on, when a player sends us a tell.
+static void TellCheck(std::string_view sender)
+{
+	if (sender.empty() || sender.length() >= EQ_MAX_NAME)
 		return;
 
+	char name[EQ_MAX_NAME] = { 0 };
+	strncpy_s(name, sender.data(), sender.length());
+
 	// don't perform action if its us doing the tell
 	if (!_stricmp(pLocalPlayer->Name, name))
 		return;
@@ -865,155 +1226,89 @@ static void TellCheck(const char* szClean)
 
 void CheckChatForEvent(const char* szMsg)
 {
-	size_t len = strlen(szMsg);
+	std::string_view line = szMsg;
 
-	auto pszCleanOrg = std::make_unique<char[]>(len + 64);
-	char* szClean = pszCleanOrg.get();
-
-	strcpy_s(szClean, len + 64, szMsg);
-
-	if (strchr(szClean, '\x12'))
+	CXStr cleaned;
+	if (strchr(szMsg, '\x12'))
 	{
-		CXStr out = CleanItemTags(szClean, false);
-		strcpy_s(szClean, len + 64, out.c_str());
+		cleaned = CleanItemTags(szMsg, false);
+		line = cleaned;
 	}
 
-	strncpy_s(EventMsg, szClean, MAX_STRING - 1);
+	strncpy_s(EventMsg, line.data(), MAX_STRING - 1);
 	EventMsg[MAX_STRING - 1] = 0;
 	if (pMQ2Blech)
 		pMQ2Blech->Feed(EventMsg);
 	EventMsg[0] = 0;
-	TellCheck(szClean);
 
 	MQMacroBlockPtr pBlock = GetCurrentMacroBlock();
-	if ((pBlock && !pBlock->Line.empty()) && (!pBlock->Paused) && (!gbUnload) && (!gZoning))
-	{
-		char SpeakerName[MAX_STRING] = { 0 };
-		char Content[MAX_STRING] = { 0 };
-		char Channel[MAX_STRING] = { 0 };
-		char* pDest = nullptr;
+	const bool macroEvents = (pBlock && !pBlock->Line.empty()) && (!pBlock->Paused) && (!gbUnload) && (!gZoning);
+	const bool tellCheck = (gbFlashOnTells || gbBeepOnTells) && pLocalPlayer;
+	const DWORD channelMask = macroEvents && gEventFunc[EVENT_CHAT] ? gEventChat : 0;
 
-		int StartCopyAt = 0;
-
-		if ((CHATEVENT(CHAT_GUILD)) && (pDest = strstr(szClean, " tells the guild, ")))
-		{
-			strcpy_s(Channel, "guild");
-		}
-		else if ((CHATEVENT(CHAT_GROUP)) && (pDest = strstr(szClean, " tells the group, ")))
-		{
-			strcpy_s(Channel, "group");
-		}
-		else if ((CHATEVENT(CHAT_TELL)) && (pDest = strstr(szClean, " tells you, ")))
-		{
-			strcpy_s(Channel, "tell");
-		}
-		else if ((CHATEVENT(CHAT_TELL)) && (pDest = strstr(szClean, " told you, ")))
-		{
-			strcpy_s(Channel, "tell");
-		}
-		// Cannot be said in another language, so we can match through the single quote here
-		else if ((CHATEVENT(CHAT_OOC)) && (pDest = strstr(szClean, " says out of character, '")))
-		{
-			strcpy_s(Channel, "ooc");
-		}
-		else if ((CHATEVENT(CHAT_SHOUT)) && (pDest = strstr(szClean, " shouts, ")))
-		{
-			strcpy_s(Channel, "shout");
-		}
-		else if ((CHATEVENT(CHAT_AUC)) && (pDest = strstr(szClean, " auctions, ")))
-		{
-			strcpy_s(Channel, "auc");
-		}
-		// What scenario misses the comma?  This is the only reason we require the StartCopyAt check
-		else if ((CHATEVENT(CHAT_SAY)) && (pDest = strstr(szClean, " says '")))
-		{
-			StartCopyAt = 7;
-			strcpy_s(Channel, "say");
-		}
-		else if ((CHATEVENT(CHAT_SAY)) && (pDest = strstr(szClean, " says, ")))
-		{
-			strcpy_s(Channel, "say");
-		}
-		else if ((CHATEVENT(CHAT_RAID)) && (pDest = strstr(szClean, " tells the raid, ")))
-		{
-			strcpy_s(Channel, "raid");
-		}
-		else if ((CHATEVENT(CHAT_CHAT)) && (strstr(szClean, "You told ") == nullptr)
-			&& (pDest = strstr(szClean, " tells "))
-			&& (strstr(szClean, ":"))
-			&& (strstr(szClean, ", '")))
-		{
-			strcpy_s(Channel, pDest + 7);
-			Channel[strlen(Channel) - 1] = 0;
+	if (tellCheck || channelMask != 0)
+	{
+		s_chatClassifier.Update(channelMask, tellCheck);
+		s_chatClassifier.Scan(line);
 
-			if (const char* colPos = strstr(Channel, ":"))
-			{
-				Channel[colPos - Channel] = 0;
-			}
-		}
+		if (tellCheck)
+			TellCheck(s_chatClassifier.GetTellSender());
 
-		if (pDest != nullptr)
+		ChatLineClassifier::ChatLine chat;
+		if (channelMask != 0 && s_chatClassifier.GetChatEvent(chat))
 		{
-			strncpy_s(SpeakerName, szClean, pDest - szClean);
-			if (StartCopyAt == 0)
-			{
-				// Almost all strings have , ' in them to denote the starting text
-				StartCopyAt = find_substr(pDest, ", '");
-				if (StartCopyAt != -1)
-				{
-					StartCopyAt += 3;
-				}
-				else
-				{
-					// (SPAM) will not have this, so fall back to comma space
-					StartCopyAt = find_substr(pDest, ", ");
-					if (StartCopyAt != -1)
-					{
-						StartCopyAt += 2;
-					}
-				}
-				// If StartCopyAt is still not found, just give the whole thing
-				if (StartCopyAt < 0)
-				{
-					StartCopyAt = 0;
-				}
-			}
-			strcpy_s(Content, pDest + StartCopyAt);
-			// Only strip the last character if it is the closing quote that was expected
-			const size_t lastChar = strlen(Content) - 1;
-			if (Content[lastChar] == '\'')
-			{
-				Content[lastChar] = 0;
-			}
-			AddEvent(EVENT_CHAT, Channel, SpeakerName, Content, NULL);
+			AddEvent(EVENT_CHAT, std::string(chat.Channel).c_str(), std::string(chat.Speaker).c_str(),
+				std::string(chat.Content).c_str(), NULL);
 		}
+	}
 
-		strncpy_s(EventMsg, szClean, MAX_STRING - 1);
+	if (macroEvents)
+	{
+		strncpy_s(EventMsg, line.data(), MAX_STRING - 1);
 		EventMsg[MAX_STRING - 1] = 0;
 		pEventBlech->Feed(EventMsg);
 		EventMsg[0] = '\0';
 	}
 }
 
-void DropTimers()
+// Running timer variables, keyed on the DropTimers tick they expire on.
+static TimerQueue s_macroTimers;
+static uint64_t s_macroTimerTick = 0;
+
+uint32_t MQTimer::GetCurrent() const
 {
-	MQTimer* pTimer = gTimer;
+	uint64_t deadline = s_macroTimers.GetDeadline(TimerId);
+	if (deadline == TimerQueue::NoDeadline)
+		return 0;
 
-	char szOrig[MAX_STRING] = { 0 };
+	return static_cast<uint32_t>(deadline - s_macroTimerTick);
+}
 
-	while (pTimer)
+void MQTimer::SetCurrent(uint32_t value)
+{
+	if (value == 0)
 	{
-		if (pTimer->Current)
-		{
-			pTimer->Current--;
-			if (!pTimer->Current)
-			{
-				_itoa_s(pTimer->Original, szOrig, 10);
-				AddEvent(EVENT_TIMER, pTimer->Name.c_str(), szOrig, NULL);
-			}
-		}
-		pTimer = pTimer->pNext;
+		s_macroTimers.Cancel(TimerId);
+		TimerId = TimerQueue::InvalidTimerId;
+		return;
 	}
+
+	if (s_macroTimers.Reschedule(TimerId, s_macroTimerTick + value))
+		return;
+
+	TimerId = s_macroTimers.Schedule(s_macroTimerTick + value, [this]()
+		{
+			TimerId = TimerQueue::InvalidTimerId;
+
+			char szOrig[MAX_STRING] = { 0 };
+			_itoa_s(Original, szOrig, 10);
+			AddEvent(EVENT_TIMER, Name.c_str(), szOrig, NULL);
+		});
+}
+
+void DropTimers()
+{
+	s_macroTimers.Process(++s_macroTimerTick);
 }
 
 namespace detail
@@ -4530,6 +4530,11 @@ public:
 			DrawTable();
 		}
 
+		if (ImGui::CollapsingHeader("Macro Turbo"))
+		{
+			DrawTurboStats();
+		}
+
 		ResetLastTimes();
 	}
 
@@ -4671,6 +4676,28 @@ public:
 		}
 	}
 
+	void DrawTurboStats()
+	{
+		const MQTurboStats& stats = gTurboStats;
+
+		if (gTurboBudget > 0)
+			ImGui::Text("Budget: %d us, up to %d lines per frame", gTurboBudget, std::max(gMaxTurbo, gTurboLimit));
+		else
+			ImGui::Text("Budget: none, up to %d lines per frame", gMaxTurbo);
+
+		ImGui::Text("Last frame: %u lines in %.3f ms%s", stats.LastLines,
+			static_cast<float>(stats.LastTime.count()) / 1000.f, stats.LastDeferred ? " (deferred)" : "");
+
+		if (stats.Frames)
+		{
+			ImGui::Text("Average: %.1f lines in %.3f ms per frame",
+				static_cast<float>(stats.TotalLines) / static_cast<float>(stats.Frames),
+				static_cast<float>(stats.TotalTime.count()) / static_cast<float>(stats.Frames) / 1000.f);
+		}
+
+		ImGui::Text("Frames: %llu, deferred: %llu", stats.Frames, stats.DeferredFrames);
+	}
+
 private:
 	std::map<std::string, std::unique_ptr<ScrollingData>> m_data;
 	float m_history = 30.0f; // 30 seconds
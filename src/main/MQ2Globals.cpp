@@ -124,6 +124,12 @@ uint64_t gRunning = 0;
 bool gbMoving = false;
 int gMaxTurbo = 80;
 int gTurboLimit = 240;
+int gTurboBudget = 0;
+int gDefaultTurboBudget = 0;
+MQTurboStats gTurboStats;
+bool gbUseMacroImages = false;
+bool gbFrameMemoization = false;
+bool gbBatchWriteChatColor = false;
 bool gReturn = true;
 bool gTargetbuffs = false;
 bool gItemsReceived = false;
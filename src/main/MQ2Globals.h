@@ -17,6 +17,7 @@
 #include "../eqlib/EQLib.h"
 #include "MQ2Internal.h"
 #include "mq/base/GlobalBuffer.h"
+#include "mq/base/SpatialGrid.h"
 
 #include <memory>
 #include <unordered_map>
@@ -58,6 +59,7 @@ MQLIB_API uint32_t bmPluginsSetGameState;
 MQLIB_API uint32_t bmUpdateSpawnSort;
 MQLIB_API uint32_t bmUpdateSpawnCaptions;
 MQLIB_API uint32_t bmCalculate;
+MQLIB_API uint32_t bmMacroTurbo;
 MQLIB_API uint32_t bmBeginZone;
 MQLIB_API uint32_t bmEndZone;
 MQLIB_API uint32_t bmRenderScene;
@@ -153,6 +155,12 @@ MQLIB_VAR uint64_t gRunning;
 MQLIB_VAR bool gbMoving;
 MQLIB_VAR int gMaxTurbo;
 MQLIB_VAR int gTurboLimit;
+MQLIB_VAR int gTurboBudget;
+MQLIB_VAR int gDefaultTurboBudget;
+MQLIB_VAR MQTurboStats gTurboStats;
+MQLIB_VAR bool gbUseMacroImages;
+MQLIB_VAR bool gbFrameMemoization;
+MQLIB_VAR bool gbBatchWriteChatColor;
 
 MQLIB_VAR bool gReturn;
 MQLIB_VAR bool gTargetbuffs;
@@ -310,6 +318,8 @@ MQLIB_VAR int gSpawnCount;
 
 // internal to mq2 only
 extern std::vector<MQSpawnArrayItem> gSpawnsArray;
+extern SpatialGrid<SPAWNINFO> gSpawnGrid;
+extern MQSpawnSnapshot gSpawnSnapshot;
 #if HAS_CHAT_TIMESTAMPS
 extern bool gbTimeStampChat;
 #endif
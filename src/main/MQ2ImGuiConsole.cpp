@@ -765,9 +765,38 @@ struct ImGuiZepConsole : public mq::imgui::ConsoleWidget, public mq::imgui::ImGu
 	// This accepts color in ABGR.
 	void AppendFormattedText(std::string_view text, uint32_t defaultColor = s_defaultColor, bool newline = false)
 	{
-		Zep::GlyphIterator cursor = m_window->GetBufferCursor();
 		bool cursorAtEnd = m_window->IsAtBottom();
 
+		InsertFormattedLine(text, defaultColor, newline);
+		PruneBuffer();
+
+		if (cursorAtEnd)
+		{
+			TriggerAutoScroll();
+		}
+	}
+
+	// Appends a batch of chat lines, pruning the buffer and scrolling once for all of them.
+	void AppendChatLines(const MQChatLine* lines, size_t count)
+	{
+		bool cursorAtEnd = m_window->IsAtBottom();
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			InsertFormattedLine(lines[i].Line, GetColorForChatColor(lines[i].Color).ToABGR(), true);
+		}
+
+		PruneBuffer();
+
+		if (cursorAtEnd)
+		{
+			TriggerAutoScroll();
+		}
+	}
+
+	// Inserts the text at the end of the buffer, parsing its color codes.
+	void InsertFormattedLine(std::string_view text, uint32_t defaultColor, bool newline)
+	{
 		std::string_view lineView = text;
 		ImU32 currentColor = defaultColor;
 
@@ -804,13 +833,6 @@ struct ImGuiZepConsole : public mq::imgui::ConsoleWidget, public mq::imgui::ImGu
 
 		if (newline)
 			InsertText(m_buffer->End(), "\n");
-
-		PruneBuffer();
-
-		if (cursorAtEnd)
-		{
-			TriggerAutoScroll();
-		}
 	}
 
 	void AppendText(std::string_view text, MQColor defaultColor /* = DEFAULT_COLOR */, bool appendNewLine /* = false */) override
@@ -1124,6 +1146,11 @@ public:
 		m_zepEditor->AppendFormattedText(line, defaultColor, newline);
 	}
 
+	void AddWriteChatColorLog(const MQChatLine* lines, size_t count)
+	{
+		m_zepEditor->AppendChatLines(lines, count);
+	}
+
 	void Draw(bool* pOpen)
 	{
 		ImGuiWindowFlags windowFlags = ImGuiWindowFlags_MenuBar;
@@ -1831,4 +1858,10 @@ DWORD ImGuiConsoleAddText(const char* line, DWORD color, DWORD filter)
 	return 0;
 }
 
+void ImGuiConsoleAddTextBatch(const MQChatLine* lines, size_t count)
+{
+	if (gImGuiConsole)
+		gImGuiConsole->AddWriteChatColorLog(lines, count);
+}
+
 } // namespace mq
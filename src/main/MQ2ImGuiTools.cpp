@@ -39,6 +39,7 @@ static void PulseMQ2ImGuiTools();
 static void UpdateSettingsUI();
 
 static int WriteChatColorImGuiAPI(const char* line, uint32_t color, uint32_t filter);
+static void WriteChatColorBatchImGuiAPI(const MQChatLine* lines, size_t count);
 
 static MQModule gImGuiModule = {
 	"ImGuiAPI",                   // Name
@@ -50,6 +51,13 @@ static MQModule gImGuiModule = {
 	UpdateSettingsUI,             // UpdateImGui
 	nullptr,                      // Zoned
 	WriteChatColorImGuiAPI,       // WriteChatColor
+	nullptr,                      // SpawnAdded
+	nullptr,                      // SpawnRemoved
+	nullptr,                      // BeginZone
+	nullptr,                      // EndZone
+	nullptr,                      // LoadPlugin
+	nullptr,                      // UnloadPlugin
+	WriteChatColorBatchImGuiAPI,  // WriteChatColorBatch
 };
 MQModule* GetImGuiToolsModule() { return &gImGuiModule; }
 
@@ -383,4 +391,9 @@ static int WriteChatColorImGuiAPI(const char* line, uint32_t color, uint32_t fil
 	return ImGuiConsoleAddText(line, color, filter);
 }
 
+static void WriteChatColorBatchImGuiAPI(const MQChatLine* lines, size_t count)
+{
+	ImGuiConsoleAddTextBatch(lines, count);
+}
+
 } // namespace mq
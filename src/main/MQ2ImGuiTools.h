@@ -32,5 +32,6 @@ void ShutdownImGuiConsole();
 void UpdateImGuiConsole();
 
 DWORD ImGuiConsoleAddText(const char* line, DWORD color, DWORD filter);
+void ImGuiConsoleAddTextBatch(const MQChatLine* lines, size_t count);
 
 } // namespace mq
@@ -53,12 +53,12 @@ inline PcProfile* GetCharInfo2()
 
 inline PlayerClient* GetSpawnByID(DWORD dwSpawnID)
 {
-	return pSpawnManager->GetSpawnByID(dwSpawnID);
+	return FindSpawnByID(dwSpawnID);
 }
 
 inline PlayerClient* GetSpawnByName(const char* spawnName)
 {
-	return pSpawnManager->GetSpawnByName(spawnName);
+	return spawnName ? FindSpawnByName(spawnName) : nullptr;
 }
 
 inline PlayerClient* GetSpawnByPartialName(char const* spawnName, PlayerBase* exclusion = nullptr)
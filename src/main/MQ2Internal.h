@@ -18,10 +18,18 @@
 #include "mq/api/Main.h"
 #include "mq/api/PluginAPI.h"
 #include "mq/base/PluginHandle.h"
+#include "mq/base/TimerQueue.h"
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 #include <variant>
 
@@ -143,10 +151,88 @@ struct MQSpawnSearch
 	bool bExactName = false;
 	bool bTargetable = false;
 	uint32_t PlayerState = 0;
+	bool bKnownZ = false;                          // zLoc came from the search instead of the player
 };
 using SEARCHSPAWN DEPRECATE("Use MQSpawnSearch instead of SEARCHSPAWN") = MQSpawnSearch;
 using PSEARCHSPAWN DEPRECATE("Use MQSpawnSearch* instead of PSEARCHSPAWN") = MQSpawnSearch *;
 
+// An MQSpawnSearch compiled into just the checks that it uses, with the cheap checks that reject
+// the most spawns first and the string compares last. Matches gives the same result as
+// SpawnMatchesSearch, which compiles the search on every call, so build one of these when the
+// same search is matched against many spawns.
+//
+// The string checks remember their result for each class, race and body type they have seen, so
+// a program should only be used from one thread.
+class MQSpawnSearchProgram
+{
+public:
+	MQLIB_OBJECT explicit MQSpawnSearchProgram(const MQSpawnSearch& search);
+
+	MQLIB_OBJECT bool Matches(SPAWNINFO* pChar, SPAWNINFO* pSpawn) const;
+
+	// The parts of the search that the spawn searches need outside of Matches.
+	double GetRadius() const { return m_fRadius; }
+	bool HasKnownLocation() const { return m_knownLocation; }
+	float GetX() const { return m_xLoc; }
+	float GetY() const { return m_yLoc; }
+	float GetZ() const { return m_zLoc; }
+	uint32_t GetFromSpawnID() const { return m_fromSpawnID; }
+	int GetMinLevel() const { return m_minLevel; }         // 0 = not checked
+	int GetMaxLevel() const { return m_maxLevel; }         // 0 = not checked
+	bool IsTargNext() const { return m_targNext; }
+	bool IsTargPrev() const { return m_targPrev; }
+
+	void SetZ(float z) { m_zLoc = z; }
+
+private:
+	enum class Op : uint8_t;
+
+	// A string compared against the description of a numeric id (class, race, body type).
+	struct DescriptionCheck
+	{
+		std::string Value;
+		mutable std::vector<int8_t> Results;       // by id: 0 = not checked yet, 1 = match, -1 = no match
+
+		template <typename Describe>
+		bool Matches(int id, Describe&& describe) const;
+	};
+
+	bool Run(Op op, SPAWNINFO* pChar, SPAWNINFO* pSpawn) const;
+	bool MatchesType(SPAWNINFO* pSpawn) const;
+	bool MatchesName(SPAWNINFO* pSpawn) const;
+
+	std::vector<Op> m_ops;
+
+	eSpawnType m_spawnType = NONE;
+	int m_minLevel = 0;
+	int m_maxLevel = 0;
+	uint32_t m_spawnID = 0;
+	uint32_t m_notID = 0;
+	uint32_t m_fromSpawnID = 0;
+	int64_t m_guildID = -1;
+	uint32_t m_playerState = 0;
+	float m_pcNearRadius = 0.0f;
+	double m_fRadius = 10000.0;
+	double m_zRadius = 10000.0;
+	float m_xLoc = 0.0f;
+	float m_yLoc = 0.0f;
+	float m_zLoc = 0.0f;
+	bool m_knownLocation = false;
+	bool m_noPet = false;
+	bool m_targNext = false;
+	bool m_targPrev = false;
+	bool m_exactName = false;
+	uint32_t m_alertList = 0;
+	uint32_t m_noAlertList = 0;
+	uint32_t m_nearAlertList = 0;
+	uint32_t m_notNearAlertList = 0;
+	std::string m_name;                            // lower case
+	std::string m_light;
+	DescriptionCheck m_class;
+	DescriptionCheck m_bodyType;
+	DescriptionCheck m_race;
+};
+
 enum SearchItemFlag
 {
 	Lore = 1,
@@ -230,6 +316,18 @@ struct MQWhoSort
 using WHOSORT DEPRECATE("Use MQWhoSort instead of WHOSORT") = MQWhoSort;
 using PWHOSORT DEPRECATE("Use MQWhoSort* instead PWHOSORT") = MQWhoSort*;
 
+struct MQCommand;
+
+// The command of a macro line, looked up ahead of time so that running the line can go
+// straight to its handler. Only valid while Generation matches the command api's.
+struct MQBoundCommand
+{
+	MQCommand* pCommand = nullptr;           // null if the line has to go through DoCommand
+	uint32_t Generation = 0;
+	uint16_t ArgsOffset = 0;                 // where the arguments start in the line
+	bool ArgsHaveData = true;                // arguments contain ${ and have to be parsed
+};
+
 struct MQMacroLine
 {
 	std::string Command;
@@ -238,6 +336,13 @@ struct MQMacroLine
 	// used for loops/while if its 0 no action is taken, otherwise it will jump to the line indicated.
 	int LoopEnd = 0;
 
+	// used for lines ending in {. BlockEnd is the line with the matching } and ChainEnd is the }
+	// that closes the whole if/else chain. Resolved when the macro is loaded, 0 if unpaired.
+	int BlockEnd = 0;
+	int ChainEnd = 0;
+
+	MQBoundCommand BoundCommand;
+
 	std::string SourceFile;
 	int LineNumber = 0;
 
@@ -254,10 +359,103 @@ struct MQMacroLine
 
 	MQMacroLine(const MQMacroLine&) = delete;
 	MQMacroLine& operator=(const MQMacroLine&) = delete;
+	MQMacroLine(MQMacroLine&&) noexcept = default;
+	MQMacroLine& operator=(MQMacroLine&&) noexcept = default;
 };
 using MACROLINE DEPRECATE("Use MQMacroLine instead MACROLINE") = MQMacroLine;
 using PMACROLINE DEPRECATE("Use MQMacroLine* instead of PMACROLINE") = MQMacroLine;
 
+// The lines of a macro in the order they were loaded. Line indices start at 1 and have no gaps,
+// so finding a line or stepping to the next one is an array access. Iterators dereference to
+// (index, line) pairs.
+class MQMacroLineTable
+{
+public:
+	using value_type = std::pair<const int, MQMacroLine>;
+	using container_type = std::vector<value_type>;
+	using iterator = container_type::iterator;
+	using const_iterator = container_type::const_iterator;
+	using reverse_iterator = container_type::reverse_iterator;
+	using const_reverse_iterator = container_type::const_reverse_iterator;
+
+	iterator emplace_back(std::string line, std::string sourceFile, int lineNumber)
+	{
+		m_lines.emplace_back(std::piecewise_construct,
+			std::forward_as_tuple(next_index()),
+			std::forward_as_tuple(std::move(line), std::move(sourceFile), lineNumber));
+
+		return std::prev(m_lines.end());
+	}
+
+	// index that the next added line will get
+	int next_index() const { return static_cast<int>(m_lines.size()) + 1; }
+
+	iterator find(int index)
+	{
+		if (index < 1 || index > static_cast<int>(m_lines.size()))
+			return m_lines.end();
+
+		return m_lines.begin() + (index - 1);
+	}
+
+	const_iterator find(int index) const
+	{
+		if (index < 1 || index > static_cast<int>(m_lines.size()))
+			return m_lines.end();
+
+		return m_lines.begin() + (index - 1);
+	}
+
+	// throws std::out_of_range if there is no such line
+	MQMacroLine& at(int index) { return m_lines.at(static_cast<size_t>(index) - 1).second; }
+	const MQMacroLine& at(int index) const { return m_lines.at(static_cast<size_t>(index) - 1).second; }
+
+	iterator begin() { return m_lines.begin(); }
+	iterator end() { return m_lines.end(); }
+	const_iterator begin() const { return m_lines.begin(); }
+	const_iterator end() const { return m_lines.end(); }
+	reverse_iterator rbegin() { return m_lines.rbegin(); }
+	reverse_iterator rend() { return m_lines.rend(); }
+	const_reverse_iterator rbegin() const { return m_lines.rbegin(); }
+	const_reverse_iterator rend() const { return m_lines.rend(); }
+
+	bool empty() const { return m_lines.empty(); }
+	size_t size() const { return m_lines.size(); }
+	void clear() { m_lines.clear(); }
+	void reserve(size_t count) { m_lines.reserve(count); }
+
+private:
+	container_type m_lines;
+};
+
+// Slots for the parameters and local variables of a sub. A name gets a slot the first time the
+// sub declares it and keeps it on every later call, so a stack frame can keep its variables in an
+// array indexed by slot instead of searching its lists by name.
+struct MQSubVariableLayout
+{
+	uint32_t Id = 0;                                     // unique for the lifetime of the process
+	std::deque<std::string> Names;                       // indexed by slot
+	std::unordered_map<std::string_view, int> Slots;     // keys are views into Names
+
+	int FindSlot(std::string_view name) const
+	{
+		auto iter = Slots.find(name);
+		return iter != Slots.end() ? iter->second : -1;
+	}
+
+	int AddSlot(std::string_view name)
+	{
+		if (int slot = FindSlot(name); slot != -1)
+			return slot;
+
+		const int slot = static_cast<int>(Names.size());
+		Names.emplace_back(name);
+		Slots.emplace(Names.back(), slot);
+
+		return slot;
+	}
+};
+
 struct MQMacroBlock
 {
 	std::string Name;                           // our macro Name
@@ -265,9 +463,12 @@ struct MQMacroBlock
 	int CurrIndex = 0;                          // the current macro line we are on
 	int BindStackIndex = -1;                    // where we were at before calling the bind.
 	std::string BindCmd;                        // the actual command including parameters
-	std::map<int, MQMacroLine> Line;
+	MQMacroLineTable Line;
 	bool Removed = false;
 
+	// variable slots of each sub, by the index of the line the sub starts on
+	std::unordered_map<int, std::unique_ptr<MQSubVariableLayout>> VariableLayouts;
+
 	MQMacroBlock(std::string name) : Name(std::move(name)) {}
 
 	MQMacroBlock(const MQMacroBlock&) = delete;
@@ -282,13 +483,32 @@ struct MQTimer
 {
 	std::string Name;
 	uint32_t Original = 0;
-	uint32_t Current = 0;
+	TimerQueue::TimerId TimerId = TimerQueue::InvalidTimerId;
 	MQTimer* pNext = nullptr;
 	MQTimer* pPrev = nullptr;
+
+	// Remaining time in tenths of a second. Running timers are kept in a deadline queue
+	// that DropTimers processes, so the value is computed from the timer's deadline.
+	MQLIB_OBJECT uint32_t GetCurrent() const;
+	MQLIB_OBJECT void SetCurrent(uint32_t value);
 };
 using MQTIMER DEPRECATE("Use MQTimer instead of MQTIMER") = MQTimer;
 using PMQTIMER DEPRECATE("Use MQTimer* instead of PMQTIMER") = MQTimer*;
 
+// Statistics for the macro lines run by Heartbeat. The Last* values describe the most recent
+// frame that ran macro lines, the rest accumulate until the next macro starts.
+struct MQTurboStats
+{
+	uint32_t LastLines = 0;
+	std::chrono::microseconds LastTime = std::chrono::microseconds::zero();
+	bool LastDeferred = false;             // stopped at the line cap or time budget with work left
+
+	uint64_t Frames = 0;
+	uint64_t DeferredFrames = 0;
+	uint64_t TotalLines = 0;
+	std::chrono::microseconds TotalTime = std::chrono::microseconds::zero();
+};
+
 struct MQKeyPress
 {
 	uint16_t KeyId = 0;
@@ -377,6 +597,7 @@ struct MQModule
 	fMQEndZone           EndZone = 0;
 	fMQLoadPlugin        LoadPlugin = 0;
 	fMQUnloadPlugin      UnloadPlugin = 0;
+	fMQWriteChatColorBatch WriteChatColorBatch = 0;
 
 	bool                 loaded = false;
 	bool                 manualUnload = false;
@@ -428,12 +649,16 @@ public:
 	MQLIB_OBJECT size_t GetCount(uint32_t id) const;
 	MQLIB_OBJECT bool AlertExist(uint32_t id);
 
+	// Changes whenever any alert list is added to, removed from or freed.
+	MQLIB_OBJECT uint32_t GetGeneration() const;
+
 	MQLIB_OBJECT bool ListAlerts(char* szOut, size_t max);
 	MQLIB_OBJECT void FreeAlerts(uint32_t id);
 
 private:
 	mutable std::mutex m_mutex;
 	std::map<uint32_t, std::vector<MQSpawnSearch>> m_alertMap;
+	uint32_t m_generation = 0;
 };
 
 //============================================================================
@@ -649,9 +874,43 @@ struct MQSpawnArrayItem : public MQRank
 	float GetDistanceSquared() const { return Value.DistSq; }
 	float GetDistance() const { return Value.get_Distance(); }
 
+	void SetDistanceSquared(float DistanceSquared) { Value = MQRankValue(DistanceSquared); }
+
 	SPAWNINFO* GetSpawn() const { return VarPtr.Ptr; }
 };
 
+// The fields that spawn searches filter on, copied out of the spawns into one array per field so
+// that they can be scanned without following a pointer per spawn. Refreshed every pulse along with
+// gSpawnsArray, and kept complete between pulses by the spawn add and remove hooks, but positions
+// and levels are only as current as the last refresh.
+struct MQSpawnSnapshot
+{
+	std::vector<SPAWNINFO*> Spawns;                // nullptr once the spawn has been removed
+	std::vector<float> X;
+	std::vector<float> Y;
+	std::vector<uint8_t> Level;
+
+	size_t size() const { return Spawns.size(); }
+
+	void Clear()
+	{
+		Spawns.clear();
+		X.clear();
+		Y.clear();
+		Level.clear();
+	}
+
+	void Add(SPAWNINFO* pSpawn);
+
+	// Only clears the entry, so that indices stay valid until the next refresh.
+	void Remove(SPAWNINFO* pSpawn)
+	{
+		auto iter = std::find(std::begin(Spawns), std::end(Spawns), pSpawn);
+		if (iter != std::end(Spawns))
+			*iter = nullptr;
+	}
+};
+
 struct MQLoop
 {
 	enum Type { None, For, While };
@@ -668,6 +927,11 @@ struct MQMacroStack
 	MQDataVar* Parameters = nullptr;
 	MQDataVar* LocalVariables = nullptr;
 	std::vector<MQLoop> loopStack;
+
+	// Parameters and LocalVariables by their slot in the sub's layout.
+	MQSubVariableLayout* pVariableLayout = nullptr;
+	std::vector<MQDataVar*> VariableSlots;
+	bool HasShadowedVariables = false;          // a slot has more than one variable with its name
 	std::string Return;
 
 	MQMacroStack* pNext = nullptr;
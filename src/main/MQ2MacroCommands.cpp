@@ -19,6 +19,7 @@
 #include "MQDataAPI.h"
 #include "MQPluginHandler.h"
 #include "MQ2KeyBinds.h"
+#include "MQ2MacroImage.h"
 
 #include <fstream>
 #include <regex>
@@ -285,48 +286,57 @@ void FailIf(SPAWNINFO* pChar, const char* szCommand, int StartLine, bool All = f
 			return;
 		}
 
-		lineIter++; // move it forward once...
-		gMacroBlock->CurrIndex = lineIter->first;
-
-		for (; lineIter != gMacroBlock->Line.end() && Scope > 0; lineIter++)
+		// blocks are paired when the macro is loaded, only search for the end if that failed.
+		const int blockEnd = All ? lineIter->second.ChainEnd : lineIter->second.BlockEnd;
+		if (blockEnd)
 		{
-			if (lineIter->second.Command[0] == '}')
-				Scope--;
+			gMacroBlock->CurrIndex = blockEnd;
+		}
+		else
+		{
+			lineIter++; // move it forward once...
+			gMacroBlock->CurrIndex = lineIter->first;
 
-			if (All)
+			for (; lineIter != gMacroBlock->Line.end() && Scope > 0; lineIter++)
 			{
-				if (lineIter->second.Command[lineIter->second.Command.size() - 1] == '{')
-				{
-					Scope++;
-				}
-			}
+				if (lineIter->second.Command[0] == '}')
+					Scope--;
 
-			if (Scope > 0)
-			{
-				if (!All)
+				if (All)
 				{
 					if (lineIter->second.Command[lineIter->second.Command.size() - 1] == '{')
+					{
 						Scope++;
+					}
 				}
 
-				if (!_strnicmp(lineIter->second.Command.c_str(), "sub ", 4))
+				if (Scope > 0)
 				{
-					gMacroBlock->CurrIndex = StartLine;
-					FatalError("{} pairing ran into anther subroutine");
-					return;
-				}
+					if (!All)
+					{
+						if (lineIter->second.Command[lineIter->second.Command.size() - 1] == '{')
+							Scope++;
+					}
 
-				auto forward = lineIter;
-				++forward;
+					if (!_strnicmp(lineIter->second.Command.c_str(), "sub ", 4))
+					{
+						gMacroBlock->CurrIndex = StartLine;
+						FatalError("{} pairing ran into anther subroutine");
+						return;
+					}
 
-				if (forward == gMacroBlock->Line.end())
-				{
-					gMacroBlock->CurrIndex = StartLine;
-					FatalError("Bad {} block pairing");
-					return;
-				}
+					auto forward = lineIter;
+					++forward;
+
+					if (forward == gMacroBlock->Line.end())
+					{
+						gMacroBlock->CurrIndex = StartLine;
+						FatalError("Bad {} block pairing");
+						return;
+					}
 
-				gMacroBlock->CurrIndex = forward->first;
+					gMacroBlock->CurrIndex = forward->first;
+				}
 			}
 		}
 
@@ -356,16 +366,170 @@ void FailIf(SPAWNINFO* pChar, const char* szCommand, int StartLine, bool All = f
 	}
 }
 
+// The condition of the pending /delay. It is prepared once when the delay starts so that
+// checking it every frame doesn't have to rescan and reparse the text when it can be avoided.
+struct MQDelayCondition
+{
+	enum class Kind
+	{
+		Constant,            // no data to parse, the result can't change
+		DataExpression,      // a single ${...} with nothing around it
+		Formula,             // anything else goes through ParseMacroData and Calculate
+	};
+
+	std::string Condition;
+	Kind ConditionKind = Kind::Formula;
+	std::string Expression;  // the text inside ${ } for DataExpression
+
+	uint64_t PollInterval = 0;
+	uint64_t NextPoll = 0;
+};
+static MQDelayCondition s_delayCondition;
+
+static void PrepareDelayCondition(uint64_t pollInterval)
+{
+	MQDelayCondition& cond = s_delayCondition;
+	cond.Condition = gDelayCondition;
+	cond.Expression.clear();
+	cond.PollInterval = pollInterval;
+	cond.NextPoll = 0;
+
+	std::string_view text = trim(std::string_view(cond.Condition));
+
+	if (text.find("${") == std::string_view::npos)
+	{
+		cond.ConditionKind = MQDelayCondition::Kind::Constant;
+	}
+	else if (text.size() > 3
+		&& starts_with(text, "${")
+		&& text.find("${", 2) == std::string_view::npos
+		&& text.find('}') == text.size() - 1
+		&& text.find(PARSE_PARAM_BEG) == std::string_view::npos)
+	{
+		cond.ConditionKind = MQDelayCondition::Kind::DataExpression;
+		cond.Expression = text.substr(2, text.size() - 3);
+	}
+	else
+	{
+		cond.ConditionKind = MQDelayCondition::Kind::Formula;
+	}
+}
+
+// Evaluates the condition of the pending /delay. Returns false if the condition could not be
+// evaluated (the macro has been ended in that case). Unless force is set, the condition is only
+// evaluated once per poll interval and conditionMet is left false in between.
+bool EvaluateDelayCondition(bool force, bool& conditionMet)
+{
+	conditionMet = false;
+
+	MQDelayCondition& cond = s_delayCondition;
+	if (cond.Condition != gDelayCondition)
+	{
+		// Changed from outside of /delay, so we never prepared it.
+		PrepareDelayCondition(0);
+		force = true;
+	}
+
+	if (!force)
+	{
+		// A constant condition was already checked when the delay started.
+		if (cond.ConditionKind == MQDelayCondition::Kind::Constant)
+			return true;
+
+		if (cond.PollInterval)
+		{
+			uint64_t now = MQGetTickCount64();
+			if (now < cond.NextPoll)
+				return true;
+
+			cond.NextPoll = now + cond.PollInterval;
+		}
+	}
+	else if (cond.PollInterval)
+	{
+		cond.NextPoll = MQGetTickCount64() + cond.PollInterval;
+	}
+
+	char szCond[MAX_STRING];
+
+	if (cond.ConditionKind == MQDelayCondition::Kind::DataExpression)
+	{
+		// Same result as parsing the whole condition: the data is converted to a string and
+		// calculated, except that integers and bools can be tested directly.
+		MQTypeVar Result;
+		if (!pDataAPI->ParseCompiledDataPortion(cond.Expression, Result)
+			|| !Result.Type)
+		{
+			return true;
+		}
+
+		if (Result.Type == pIntType || Result.Type == pBoolType || Result.Type == pInt64Type)
+		{
+			conditionMet = Result.Type == pIntType ? Result.Int != 0
+				: Result.Type == pBoolType ? Result.Get<bool>()
+				: Result.Int64 != 0;
+			return true;
+		}
+
+		szCond[0] = 0;
+		if (!Result.Type->ToString(Result.VarPtr, szCond))
+			return true;
+
+		if (strstr(szCond, "${"))
+			ParseMacroData(szCond, MAX_STRING);
+	}
+	else
+	{
+		strcpy_s(szCond, cond.Condition.c_str());
+
+		ParseMacroData(szCond, MAX_STRING);
+	}
+
+	double Result;
+	if (!Calculate(szCond, Result))
+	{
+		FatalError("Failed to parse /delay condition '%s', non-numeric encountered", szCond);
+		return false;
+	}
+
+	// TODO:  Determine the bounds on what "0" should be here since this is a double.
+	conditionMet = Result != 0;
+	return true;
+}
+
+// Converts a /delay time argument to milliseconds. Plain numbers are in deciseconds, and the
+// suffixes m, s and ms select minutes, seconds and milliseconds.
+static int64_t GetDelayMilliseconds(const char* szVal)
+{
+	int64_t VarValue = GetIntFromString(szVal, 0);
+	size_t len = strlen(szVal);
+	if (len == 0)
+		return VarValue * 100;
+
+	if (::tolower(szVal[len - 1]) == 'm')
+		return VarValue * 60000;
+
+	if (::tolower(szVal[len - 1]) == 's')
+	{
+		if (len > 2 && ::tolower(szVal[len - 2]) == 'm')
+			return VarValue;
+
+		return VarValue * 1000;
+	}
+
+	return VarValue * 100;
+}
+
 // ***************************************************************************
 // Function:    Delay
 // Description: Our '/delay' command
-// Usage:       /delay <time> [condition to end early]
+// Usage:       /delay <time> [poll <interval>] [condition to end early]
 // ***************************************************************************
 void Delay(PlayerClient* pChar, const char* szLine)
 {
 	if (szLine[0] == 0)
 	{
-		SyntaxError("Usage: /delay <time> [condition to end early]");
+		SyntaxError("Usage: /delay <time> [poll <interval>] [condition to end early]");
 		return;
 	}
 
@@ -373,41 +537,37 @@ void Delay(PlayerClient* pChar, const char* szLine)
 	GetArg(szVal, szLine, 1);
 
 	ParseMacroData(szVal, MAX_STRING);
-	strcpy_s(gDelayCondition, GetNextArg(szLine));
+	const char* szCondition = GetNextArg(szLine);
 
-	int VarValue = GetIntFromString(szVal, 0);
-	size_t len = strlen(szVal);
+	// An optional poll interval limits how often an expensive condition is checked.
+	uint64_t pollInterval = 0;
 
-	// Measured in deciseconds...
-	if (::tolower(szVal[len - 1]) == 'm')
-		VarValue *= 600;
-	else if (::tolower(szVal[len - 1]) == 's')
+	char szArg[MAX_STRING] = { 0 };
+	GetArg(szArg, szCondition, 1);
+	if (ci_equals(szArg, "poll"))
 	{
-		if (len > 2 && ::tolower(szVal[len - 2]) == 'm')
-			VarValue /= 100;
-		else
-			VarValue *= 10;
+		GetArg(szArg, szCondition, 2);
+		ParseMacroData(szArg, MAX_STRING);
+
+		pollInterval = static_cast<uint64_t>(std::max<int64_t>(GetDelayMilliseconds(szArg), 0));
+		szCondition = GetNextArg(szCondition, 2);
 	}
 
-	gDelay = VarValue;
+	strcpy_s(gDelayCondition, szCondition);
+
+	// Measured in deciseconds...
+	gDelay = static_cast<int>(GetDelayMilliseconds(szVal) / 100);
 	bRunNextCommand = false;
 
+	PrepareDelayCondition(pollInterval);
+
 	if (gDelayCondition[0])
 	{
-		char szCond[MAX_STRING];
-		strcpy_s(szCond, gDelayCondition);
-
-		ParseMacroData(szCond, MAX_STRING);
-
-		double Result;
-		if (!Calculate(szCond, Result))
-		{
-			FatalError("Failed to parse /delay condition '%s', non-numeric encountered", szCond);
+		bool conditionMet;
+		if (!EvaluateDelayCondition(true, conditionMet))
 			return;
-		}
 
-		// TODO:  Determine the bounds on what "0" should be here since this is a double.
-		if (Result != 0)
+		if (conditionMet)
 		{
 			gDelay = 0;
 			bRunNextCommand = true;
@@ -516,6 +676,9 @@ void CleanMacroLine(char* szLine)
 // TODO:  Switch this to take input of filesystem::path instead of const char*  Breaking change?
 bool Include(const char* szFile, int* LineNumber)
 {
+	if (pMacroImageRecorder)
+		pMacroImageRecorder->AddFile(szFile);
+
 	FILE* fMacro = _fsopen(szFile, "rt", _SH_DENYNO);
 	if (fMacro == nullptr)
 	{
@@ -575,93 +738,114 @@ bool Include(const char* szFile, int* LineNumber)
 }
 
 // ***************************************************************************
-// Function:    AddMacroLine
-// Description: Add a line to the MacroBlock
+// Function:    MacroFileExists
+// Description: exists() for the files a macro tries to include. Paths that
+//              don't exist are remembered too, creating one of them changes
+//              which file an #include reads.
 // ***************************************************************************
-bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineNumber, int localLine)
+static bool MacroFileExists(const std::filesystem::path& path)
 {
-	// replace all tabs with spaces
-	if ((szLine[0] == 0) || (szLine[0] == '|'))
-		return true;
+	std::error_code ec;
+	const bool fileExists = std::filesystem::exists(path, ec);
 
-	MQDefine* pDef = pDefines;
+	if (pMacroImageRecorder && !fileExists)
+		pMacroImageRecorder->AddFile(path);
 
-	if (szLine[0] != '#')
+	return fileExists;
+}
+
+// ***************************************************************************
+// Function:    ProcessMacroDirective
+// Description: Handles a # line of a macro. szLine is left pointing at the text
+//              that is added as the macro line, included is set if the line
+//              was an #include that was read in its place.
+// ***************************************************************************
+static bool ProcessMacroDirective(char*& szLine, size_t Linelen, int* LineNumber, bool& included)
+{
+	included = false;
+
+	// Everything but #include and #define is replayed when the macro is loaded from its image.
+	if (pMacroImageRecorder
+		&& _strnicmp(szLine, "#include ", 9) && _strnicmp(szLine, "#include_optional ", 18)
+		&& _strnicmp(szLine, "#define ", 8) && szLine[1] != '!')
 	{
-		while (pDef)
-		{
-			while (strstr(szLine, pDef->szName))
-			{
-				char szNew[MAX_STRING] = { 0 };
-				strncpy_s(szNew, szLine, strstr(szLine, pDef->szName) - szLine);
-				strcat_s(szNew, pDef->szReplace);
-				strcat_s(szNew, strstr(szLine, pDef->szName) + strlen(pDef->szName));
-				strcpy_s(szLine, Linelen, szNew);
-			}
-			pDef = pDef->pNext;
-		}
+		pMacroImageRecorder->Directives.emplace_back(szLine);
 	}
-	else
+
+	if (!_strnicmp(szLine, "#include ", 9) || !_strnicmp(szLine, "#include_optional ", 18))
 	{
-		if (!_strnicmp(szLine, "#include ", 9) || !_strnicmp(szLine, "#include_optional ", 18))
+		bool optional = false;
+		szLine += 8;
+		// account for include_optional
+		if (szLine[0] == '_')
 		{
-			bool optional = false;
-			szLine += 8;
-			// account for include_optional
-			if (szLine[0] == '_')
-			{
-				szLine += 9;
-				optional = true;
-			}
+			szLine += 9;
+			optional = true;
+		}
 
-			while (szLine[0] == ' ')
-			{
-				szLine++;
-			}
-			ParseMacroData(szLine, Linelen);
+		while (szLine[0] == ' ')
+		{
+			szLine++;
+		}
 
-			std::filesystem::path incFilePath = szLine;
-			if (incFilePath.is_relative())
-			{
-				incFilePath = mq::internal_paths::Macros / incFilePath;
-			}
+		// The path can't be checked for changes if it is built from macro data.
+		if (pMacroImageRecorder && strstr(szLine, "${"))
+			pMacroImageRecorder->Cacheable = false;
 
-			std::error_code ec_exists;
-			// If the file exists, use it, but if not try inc, then mac, then settle on inc
-			if (!incFilePath.has_extension() && !exists(incFilePath, ec_exists))
-			{
-				if (!exists(incFilePath.replace_extension("inc"), ec_exists))
-				{
-					if (!exists(incFilePath.replace_extension("mac"), ec_exists))
-					{
-						incFilePath.replace_extension("inc");
-					}
-				}
-			}
+		ParseMacroData(szLine, Linelen);
 
-			if (!optional)
-			{
-				// Include() contains the error messages, so let it error if it doesn't exist
-				return Include(incFilePath.string().c_str(), LineNumber);
-			}
+		std::filesystem::path incFilePath = szLine;
+		if (incFilePath.is_relative())
+		{
+			incFilePath = mq::internal_paths::Macros / incFilePath;
+		}
 
-			// if we're here, it was optional so only include if it exists
-			if (exists(incFilePath, ec_exists))
+		// If the file exists, use it, but if not try inc, then mac, then settle on inc
+		if (!incFilePath.has_extension() && !MacroFileExists(incFilePath))
+		{
+			if (!MacroFileExists(incFilePath.replace_extension("inc")))
 			{
-				return Include(incFilePath.string().c_str(), LineNumber);
+				if (!MacroFileExists(incFilePath.replace_extension("mac")))
+				{
+					incFilePath.replace_extension("inc");
+				}
 			}
 		}
-		else if (!_strnicmp(szLine, "#warning", 8))
+
+		if (!optional)
 		{
-			gWarning = true;
+			// Include() contains the error messages, so let it error if it doesn't exist
+			included = true;
+			return Include(incFilePath.string().c_str(), LineNumber);
 		}
-		else if (!_strnicmp(szLine, "#turbo", 6))
+
+		// if we're here, it was optional so only include if it exists
+		if (MacroFileExists(incFilePath))
 		{
-			gTurbo = true;
+			included = true;
+			return Include(incFilePath.string().c_str(), LineNumber);
+		}
+	}
+	else if (!_strnicmp(szLine, "#warning", 8))
+	{
+		gWarning = true;
+	}
+	else if (!_strnicmp(szLine, "#turbo", 6))
+	{
+		gTurbo = true;
 
-			char szArg[MAX_STRING] = { 0 };
-			GetArg(szArg, szLine, 2);
+		char szArg[MAX_STRING] = { 0 };
+		GetArg(szArg, szLine, 2);
+
+		if (ci_equals(szArg, "budget"))
+		{
+			// #turbo budget <microseconds>: run lines until the frame's time budget is used up
+			GetArg(szArg, szLine, 3);
 
+			gTurboBudget = std::max(GetIntFromString(szArg, 0), 0);
+		}
+		else
+		{
 			gMaxTurbo = GetIntFromString(szArg, 0);
 			if (gMaxTurbo == 0)
 				gMaxTurbo = 80;
@@ -671,146 +855,190 @@ bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineN
 				gMaxTurbo = gTurboLimit;
 			}
 		}
-		else if (!_strnicmp(szLine, "#define ", 8))
-		{
-			char szArg1[MAX_STRING] = { 0 };
-			char szArg2[MAX_STRING] = { 0 };
-			GetArg(szArg1, szLine, 2);
-			GetArg(szArg2, szLine, 3);
+	}
+	else if (!_strnicmp(szLine, "#define ", 8))
+	{
+		char szArg1[MAX_STRING] = { 0 };
+		char szArg2[MAX_STRING] = { 0 };
+		GetArg(szArg1, szLine, 2);
+		GetArg(szArg2, szLine, 3);
 
-			if ((szArg1[0] != 0) && (szArg2[0] != 0))
-			{
-				MQDefine* define = new MQDefine();
+		if ((szArg1[0] != 0) && (szArg2[0] != 0))
+		{
+			MQDefine* define = new MQDefine();
 
-				strcpy_s(define->szName, szArg1);
-				strcpy_s(define->szReplace, szArg2);
-				define->pNext = pDefines;
-				pDefines = define;
-			}
-			else
-			{
-				MacroError("Bad #define: %s", szLine);
-			}
+			strcpy_s(define->szName, szArg1);
+			strcpy_s(define->szReplace, szArg2);
+			define->pNext = pDefines;
+			pDefines = define;
 		}
-		else if (!_strnicmp(szLine, "#event ", 7))
+		else
 		{
-			char szArg1[MAX_STRING] = { 0 };
-			char szArg2[MAX_STRING] = { 0 };
-			GetArg(szArg1, szLine, 2);
-			GetArg(szArg2, szLine, 3);
+			MacroError("Bad #define: %s", szLine);
+		}
+	}
+	else if (!_strnicmp(szLine, "#event ", 7))
+	{
+		char szArg1[MAX_STRING] = { 0 };
+		char szArg2[MAX_STRING] = { 0 };
+		GetArg(szArg1, szLine, 2);
+		GetArg(szArg2, szLine, 3);
 
-			if ((szArg1[0] != 0) && (szArg2[0] != 0))
-			{
-				MQEventList* pEvent = new MQEventList();
+		if ((szArg1[0] != 0) && (szArg2[0] != 0))
+		{
+			MQEventList* pEvent = new MQEventList();
+
+			sprintf_s(pEvent->szName, "Sub Event_%s", szArg1);
 
-				sprintf_s(pEvent->szName, "Sub Event_%s", szArg1);
+			if (char* pDest = strstr(szArg2, "${"))
+			{
+				// its a variable... so we must "/declare" it for them...
+				char szVar[MAX_STRING] = { 0 };
+				strcpy_s(szVar, &pDest[2]);
 
-				if (char* pDest = strstr(szArg2, "${"))
+				if (pDest = strchr(szVar, '}'))
 				{
-					// its a variable... so we must "/declare" it for them...
-					char szVar[MAX_STRING] = { 0 };
-					strcpy_s(szVar, &pDest[2]);
+					pDest[0] = '\0';
 
-					if (pDest = strchr(szVar, '}'))
+					if (VariableMap.find(szVar) == VariableMap.end())
 					{
-						pDest[0] = '\0';
-
-						if (VariableMap.find(szVar) == VariableMap.end())
-						{
-							// we dont know what the macro will varset this to, so we just
-							// default it to the same name as the key...
-							// cant set it to "" cause then it triggers on every single line of
-							// chat before they /varset it to something... (if they ever)
-							AddMQ2DataVariable(szVar, "", datatypes::pStringType, &pMacroVariables, "NULL");
-						}
+						// we dont know what the macro will varset this to, so we just
+						// default it to the same name as the key...
+						// cant set it to "" cause then it triggers on every single line of
+						// chat before they /varset it to something... (if they ever)
+						AddMQ2DataVariable(szVar, "", datatypes::pStringType, &pMacroVariables, "NULL");
 					}
 				}
-
-				strcpy_s(pEvent->szMatch, szArg2);
-				pEvent->BlechID = pEventBlech->AddEvent(pEvent->szMatch, EventBlechCallback, pEvent);
-				pEvent->pEventFunc = 0;
-				pEvent->pNext = pEventList;
-				pEventList = pEvent;
-			}
-			else
-			{
-				MacroError("Bad #event: %s", szLine);
 			}
+
+			strcpy_s(pEvent->szMatch, szArg2);
+			pEvent->BlechID = pEventBlech->AddEvent(pEvent->szMatch, EventBlechCallback, pEvent);
+			pEvent->pEventFunc = 0;
+			pEvent->pNext = pEventList;
+			pEventList = pEvent;
 		}
-		else if (!_strnicmp(szLine, "#bind ", 6) || !_strnicmp(szLine, "#bind_noparse ", 14))
+		else
 		{
-			bool parse = true;
-			if (szLine[5] == '_')
-				parse = false;
+			MacroError("Bad #event: %s", szLine);
+		}
+	}
+	else if (!_strnicmp(szLine, "#bind ", 6) || !_strnicmp(szLine, "#bind_noparse ", 14))
+	{
+		bool parse = true;
+		if (szLine[5] == '_')
+			parse = false;
 
-			if (gParserVersion != 2 && parse == false)
+		if (gParserVersion != 2 && parse == false)
+		{
+			MacroError("#bind_noparse requires enabling Parser Version 2.");
+		}
+		else
+		{
+			char szArg1[MAX_STRING] = { 0 };
+			char szArg2[MAX_STRING] = { 0 };
+			GetArg(szArg1, szLine, 2);
+			GetArg(szArg2, szLine, 3);
+
+			if ((szArg1[0] != 0) && (szArg2[0] != 0))
 			{
-				MacroError("#bind_noparse requires enabling Parser Version 2.");
+				MQBindList* pBind = new MQBindList();
+				// TODO:  Deprecate this so that NoParse_ isn't needed on the sub name
+				sprintf_s(pBind->szFuncName, "Bind_%s%s", parse ? "" : "NoParse_", szArg1);
+				strcpy_s(pBind->szName, szArg2);
+				pBind->Parse = parse;
+				pBind->pNext = pBindList;
+				pBindList = pBind;
 			}
 			else
 			{
-				char szArg1[MAX_STRING] = { 0 };
-				char szArg2[MAX_STRING] = { 0 };
-				GetArg(szArg1, szLine, 2);
-				GetArg(szArg2, szLine, 3);
-
-				if ((szArg1[0] != 0) && (szArg2[0] != 0))
-				{
-					MQBindList* pBind = new MQBindList();
-					// TODO:  Deprecate this so that NoParse_ isn't needed on the sub name
-					sprintf_s(pBind->szFuncName, "Bind_%s%s", parse ? "" : "NoParse_", szArg1);
-					strcpy_s(pBind->szName, szArg2);
-					pBind->Parse = parse;
-					pBind->pNext = pBindList;
-					pBindList = pBind;
-				}
-				else
-				{
-					MacroError("Bad #bind%s: %s", parse ? "" : "_noparse", szLine);
-				}
+				MacroError("Bad #bind%s: %s", parse ? "" : "_noparse", szLine);
 			}
 		}
-		else if (!_strnicmp(szLine, "#engine ", 8))
-		{
-			std::string_view lineView{ szLine };
-			std::string strLine = std::string{ lineView.substr(8) } + " noauto";
+	}
+	else if (!_strnicmp(szLine, "#engine ", 8))
+	{
+		std::string_view lineView{ szLine };
+		std::string strLine = std::string{ lineView.substr(8) } + " noauto";
 
-			strcpy_s(szLine, Linelen, strLine.c_str());
-			EngineCommand(pLocalPlayer, szLine);
-		}
-		else if (!_strnicmp(szLine, "#chat ", 6))
-		{
-			szLine += 5;
-			while (szLine[0] == ' ') szLine++;
-			if (!_stricmp(szLine, "say"))   gEventChat = gEventChat | CHAT_SAY;
-			if (!_stricmp(szLine, "tell"))  gEventChat = gEventChat | CHAT_TELL;
-			if (!_stricmp(szLine, "ooc"))   gEventChat = gEventChat | CHAT_OOC;
-			if (!_stricmp(szLine, "shout")) gEventChat = gEventChat | CHAT_SHOUT;
-			if (!_stricmp(szLine, "auc"))   gEventChat = gEventChat | CHAT_AUC;
-			if (!_stricmp(szLine, "guild")) gEventChat = gEventChat | CHAT_GUILD;
-			if (!_stricmp(szLine, "group")) gEventChat = gEventChat | CHAT_GROUP;
-			if (!_stricmp(szLine, "raid"))  gEventChat = gEventChat | CHAT_RAID;
-			if (!_stricmp(szLine, "chat"))  gEventChat = gEventChat | CHAT_CHAT;
-		}
-		else if (szLine[1] == '!')
+		strcpy_s(szLine, Linelen, strLine.c_str());
+		EngineCommand(pLocalPlayer, szLine);
+	}
+	else if (!_strnicmp(szLine, "#chat ", 6))
+	{
+		szLine += 5;
+		while (szLine[0] == ' ') szLine++;
+		if (!_stricmp(szLine, "say"))   gEventChat = gEventChat | CHAT_SAY;
+		if (!_stricmp(szLine, "tell"))  gEventChat = gEventChat | CHAT_TELL;
+		if (!_stricmp(szLine, "ooc"))   gEventChat = gEventChat | CHAT_OOC;
+		if (!_stricmp(szLine, "shout")) gEventChat = gEventChat | CHAT_SHOUT;
+		if (!_stricmp(szLine, "auc"))   gEventChat = gEventChat | CHAT_AUC;
+		if (!_stricmp(szLine, "guild")) gEventChat = gEventChat | CHAT_GUILD;
+		if (!_stricmp(szLine, "group")) gEventChat = gEventChat | CHAT_GROUP;
+		if (!_stricmp(szLine, "raid"))  gEventChat = gEventChat | CHAT_RAID;
+		if (!_stricmp(szLine, "chat"))  gEventChat = gEventChat | CHAT_CHAT;
+	}
+	else if (szLine[1] == '!')
+	{
+		// Like: #!/usr/local/bin/LegacyMQ2
+		// ignore.
+	}
+	else
+	{
+		MacroError("Unknown # command: %s", szLine);
+		return false;
+	}
+
+	return true;
+}
+
+// ***************************************************************************
+// Function:    AddMacroLine
+// Description: Add a line to the MacroBlock
+// ***************************************************************************
+bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineNumber, int localLine)
+{
+	// replace all tabs with spaces
+	if ((szLine[0] == 0) || (szLine[0] == '|'))
+		return true;
+
+	MQDefine* pDef = pDefines;
+
+	if (szLine[0] != '#')
+	{
+		while (pDef)
 		{
-			// Like: #!/usr/local/bin/LegacyMQ2
-			// ignore.
+			while (strstr(szLine, pDef->szName))
+			{
+				char szNew[MAX_STRING] = { 0 };
+				strncpy_s(szNew, szLine, strstr(szLine, pDef->szName) - szLine);
+				strcat_s(szNew, pDef->szReplace);
+				strcat_s(szNew, strstr(szLine, pDef->szName) + strlen(pDef->szName));
+				strcpy_s(szLine, Linelen, szNew);
+			}
+			pDef = pDef->pNext;
 		}
-		else
-		{
-			MacroError("Unknown # command: %s", szLine);
+	}
+	else
+	{
+		bool included;
+		if (!ProcessMacroDirective(szLine, Linelen, LineNumber, included))
 			return false;
-		}
+
+		if (included)
+			return true;
 	}
 
+	// Lines are indexed by their position in the macro rather than by LineNumber, which also
+	// counts the blank and comment lines that were skipped.
+	const int LineIndex = gMacroBlock->Line.next_index();
+
 	if ((!_stricmp(szLine, "Sub Event_Chat")) || (!_strnicmp(szLine, "Sub Event_Chat(", 15)))
 	{
-		gEventFunc[EVENT_CHAT] = *LineNumber;
+		gEventFunc[EVENT_CHAT] = LineIndex;
 	}
 	else if ((!_stricmp(szLine, "Sub Event_Timer")) || (!_strnicmp(szLine, "Sub Event_Timer(", 16)))
 	{
-		gEventFunc[EVENT_TIMER] = *LineNumber;
+		gEventFunc[EVENT_TIMER] = LineIndex;
 	}
 	else
 	{
@@ -819,7 +1047,7 @@ bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineN
 		{
 			if (!_stricmp(szLine, pEvent->szName))
 			{
-				pEvent->pEventFunc = *LineNumber;
+				pEvent->pEventFunc = LineIndex;
 			}
 			else
 			{
@@ -828,37 +1056,110 @@ bool AddMacroLine(const char* FileName, char* szLine, size_t Linelen, int* LineN
 
 				if (!_strnicmp(szLine, szNameP, strlen(szNameP)))
 				{
-					pEvent->pEventFunc = *LineNumber;
+					pEvent->pEventFunc = LineIndex;
 				}
 			}
 			pEvent = pEvent->pNext;
 		}
 	}
 
-	auto [iter, success] = gMacroBlock->Line.emplace(
-		std::piecewise_construct,
-		std::forward_as_tuple(*LineNumber),
-		std::forward_as_tuple(szLine, FileName, localLine));
-	if (!success)
-	{
-		MacroError("Duplicate line number detected! %s@%d", FileName, localLine);
-	}
-
-#ifdef MQ2_PROFILING
-	iter->second.ExecutionCount = 0;
-	iter->second.ExecutionTime = 0;
-#endif
+	gMacroBlock->Line.emplace_back(szLine, FileName, localLine);
 
 	static const std::regex subrx("^sub (\\w+)", std::regex_constants::icase);
 	std::cmatch submatch;
 	if (std::regex_search(szLine, submatch, subrx))
 	{
-		gMacroSubLookupMap[submatch.str(1)] = *LineNumber;
+		gMacroSubLookupMap[submatch.str(1)] = LineIndex;
 	}
 
 	return true;
 }
 
+// ***************************************************************************
+// Function:    ResolveMacroLines
+// Description: Pairs up the {} blocks of a loaded macro and finds the end of
+//              every /while and /for, so that branching and looping can jump
+//              straight to their target instead of searching for it. These
+//              are the same searches FailIf, MarkWhile, /break and /continue
+//              do, anything left unresolved is still searched for at runtime
+//              so that the same errors are reported. The command each line
+//              runs is bound here as well.
+// ***************************************************************************
+static void ResolveMacroLines(MQMacroLineTable& Lines)
+{
+	std::vector<int> openBlocks;
+
+	for (auto& [index, line] : Lines)
+	{
+		const std::string& command = line.Command;
+
+		pCommandAPI->BindMacroLine(line);
+
+		if (command[0] == '}' && !openBlocks.empty())
+		{
+			Lines.at(openBlocks.back()).BlockEnd = index;
+			openBlocks.pop_back();
+		}
+
+		// blocks can't run into another sub, leave them unpaired.
+		if (!_strnicmp(command.c_str(), "sub ", 4))
+			openBlocks.clear();
+
+		if (!command.empty() && command.back() == '{')
+			openBlocks.push_back(index);
+	}
+
+	for (auto iter = Lines.rbegin(); iter != Lines.rend(); ++iter)
+	{
+		auto& [index, line] = *iter;
+		if (!line.BlockEnd)
+			continue;
+
+		// } else { continues the chain, so it ends wherever the next block's chain ends.
+		const MQMacroLine& blockEnd = Lines.at(line.BlockEnd);
+		line.ChainEnd = !blockEnd.Command.empty() && blockEnd.Command.back() == '{' ? blockEnd.ChainEnd : line.BlockEnd;
+
+		if (index > 1 && !_strnicmp(line.Command.c_str(), "/while", 6)
+			&& (line.Command[6] == ' ' || line.Command[6] == '('))
+		{
+			line.LoopStart = index - 1;
+			line.LoopEnd = line.BlockEnd;
+		}
+	}
+
+	// the /next of a /for is stored in the /for's LoopEnd
+	for (auto iter = Lines.begin(); iter != Lines.end(); ++iter)
+	{
+		auto& [index, line] = *iter;
+		if (_strnicmp(line.Command.c_str(), "/for ", 5))
+			continue;
+
+		char forVar[MAX_STRING] = { 0 };
+		GetArg(forVar, line.Command.c_str(), 2);
+
+		for (auto next = std::next(iter); next != Lines.end(); ++next)
+		{
+			const char* command = next->second.Command.c_str();
+
+			if (!_strnicmp(command, "/next", 5))
+			{
+				char nextVar[MAX_STRING] = { 0 };
+				GetArg(nextVar, command, 2);
+
+				if (!_stricmp(nextVar, forVar))
+				{
+					line.LoopEnd = next->first;
+					break;
+				}
+			}
+			else if (!_strnicmp(command, "Sub ", 4))
+			{
+				break;
+			}
+		}
+	}
+}
+
 static MQMacroBlockPtr AddMacroBlock(std::string Name)
 {
 	auto macroBlock = std::make_shared<MQMacroBlock>(Name);
@@ -971,6 +1272,146 @@ int GetMacroBlockCount()
 	return static_cast<int>(MacroBlockMap.size());
 }
 
+// ***************************************************************************
+// Function:    ApplyMacroImage
+// Description: Fills the current macro block from a saved macro image. The
+//              directives are run again for their side effects, the lines
+//              and the sub and event lookups are taken as they were saved.
+// ***************************************************************************
+static bool ApplyMacroImage(MQMacroImage& image)
+{
+	if (image.EventFuncs.size() != NUM_EVENTS)
+		return false;
+
+	for (const std::string& directive : image.Directives)
+	{
+		if (directive.size() >= MAX_STRING)
+			return false;
+
+		char szDirective[MAX_STRING] = { 0 };
+		strcpy_s(szDirective, directive.c_str());
+
+		char* szLine = szDirective;
+		int LineNumber = 0;
+		bool included;
+
+		if (!ProcessMacroDirective(szLine, MAX_STRING, &LineNumber, included))
+			return false;
+	}
+
+	std::copy(image.EventFuncs.begin(), image.EventFuncs.end(), std::begin(gEventFunc));
+
+	// The #events were replayed in the same order, so pEventList lines up with what was saved.
+	MQEventList* pEvent = pEventList;
+	for (int eventFunc : image.CustomEventFuncs)
+	{
+		if (!pEvent)
+			return false;
+
+		pEvent->pEventFunc = eventFunc;
+		pEvent = pEvent->pNext;
+	}
+
+	if (pEvent)
+		return false;
+
+	MQMacroLineTable& Lines = gMacroBlock->Line;
+	Lines.reserve(image.Lines.size());
+
+	for (MQMacroImage::Line& line : image.Lines)
+	{
+		Lines.emplace_back(std::move(line.Command), image.SourceFiles[line.SourceFile], line.LineNumber);
+	}
+
+	for (auto& [name, index] : image.Subs)
+	{
+		gMacroSubLookupMap.emplace(std::move(name), index);
+	}
+
+	return true;
+}
+
+// ***************************************************************************
+// Function:    DiscardMacroImage
+// Description: Undoes what a failed ApplyMacroImage left behind, so that the
+//              macro can be loaded from source instead.
+// ***************************************************************************
+static void DiscardMacroImage()
+{
+	while (pEventList)
+	{
+		MQEventList* pEventL = pEventList->pNext;
+		delete pEventList;
+
+		pEventList = pEventL;
+	}
+
+	while (pBindList)
+	{
+		MQBindList* pBindL = pBindList->pNext;
+		delete pBindList;
+
+		pBindList = pBindL;
+	}
+
+	pEventBlech->Reset();
+
+	for (int& i : gEventFunc)
+	{
+		i = 0;
+	}
+
+	gEventChat = 0;
+	gWarning = false;
+	gMaxTurbo = 80;
+	gTurboBudget = gDefaultTurboBudget;
+	gTurbo = true;
+
+	gMacroBlock->Line.clear();
+	gMacroSubLookupMap.clear();
+}
+
+// ***************************************************************************
+// Function:    SaveMacroImage
+// Description: Saves the macro that was just loaded from source so that the
+//              next /macro can load it from its image.
+// ***************************************************************************
+static void SaveMacroImage(const std::filesystem::path& macFilePath, MQMacroImageRecorder& recorder)
+{
+	MQMacroImage image;
+	image.Files = std::move(recorder.Files);
+	image.Directives = std::move(recorder.Directives);
+
+	std::unordered_map<std::string_view, uint32_t> sourceFileIndex;
+	image.Lines.reserve(gMacroBlock->Line.size());
+
+	for (const auto& [index, line] : gMacroBlock->Line)
+	{
+		auto [iter, added] = sourceFileIndex.try_emplace(line.SourceFile, static_cast<uint32_t>(image.SourceFiles.size()));
+		if (added)
+			image.SourceFiles.push_back(line.SourceFile);
+
+		image.Lines.push_back({ iter->second, line.LineNumber, line.Command });
+	}
+
+	for (const auto& [name, index] : gMacroSubLookupMap)
+	{
+		image.Subs.emplace_back(name, index);
+	}
+
+	image.EventFuncs.assign(std::begin(gEventFunc), std::end(gEventFunc));
+
+	for (MQEventList* pEvent = pEventList; pEvent; pEvent = pEvent->pNext)
+	{
+		image.CustomEventFuncs.push_back(pEvent->pEventFunc);
+	}
+
+	if (!WriteMacroImage(macFilePath, image))
+	{
+		DebugSpew("Macro - Couldn't save the macro image for %s", macFilePath.string().c_str());
+	}
+}
+
 // ***************************************************************************
 // Function:    Macro
 // Description: Our '/macro' command
@@ -1013,6 +1454,8 @@ void Macro(PlayerClient* pChar, const char* szLine)
 	gMacroBlock = AddMacroBlock(szLine);
 
 	gMaxTurbo = 80;
+	gTurboBudget = gDefaultTurboBudget;
+	gTurboStats = MQTurboStats();
 	gTurbo = true;
 
 	char szTemp[MAX_STRING] = { 0 };
@@ -1030,63 +1473,100 @@ void Macro(PlayerClient* pChar, const char* szLine)
 		macFilePath = mq::internal_paths::Macros / macFilePath;
 	}
 
-	FILE* fMacro = _fsopen(macFilePath.string().c_str(), "rt", _SH_DENYNO);
-
-	if (fMacro == nullptr)
-	{
-		FatalError("Couldn't open macro file: %s", macFilePath.string().c_str());
-		gszMacroName[0] = 0;
-		gRunning = 0;
-		return;
-	}
-
 	gEventChat = 0;
-	strcpy_s(gszMacroName, szTemp);
-	DebugSpew("Macro - Loading macro: %s", macFilePath.string().c_str());
-
-	int LineIndex = 0;
-	int LocalLine = 0;
 	gMacroSubLookupMap.clear();
 
 	const std::string strMacroName = macFilePath.filename().string();
 
-	while (!feof(fMacro))
+	bool loadedImage = false;
+	MQMacroImage image;
+	if (gbUseMacroImages && ReadMacroImage(macFilePath, image))
 	{
-		fgets(szTemp, MAX_STRING, fMacro);
-		CleanMacroLine(szTemp);
+		strcpy_s(gszMacroName, szTemp);
+		DebugSpew("Macro - Loading macro image: %s", macFilePath.string().c_str());
 
-		LineIndex++;
-		LocalLine++;
-
-		if (!strncmp(szTemp, "|**", 3))
+		loadedImage = ApplyMacroImage(image);
+		if (!loadedImage)
 		{
-			InBlockComment = true;
+			// A stale image shouldn't stop a macro that still loads from source.
+			DebugSpew("Macro - Rejected the macro image for %s, loading from source", macFilePath.string().c_str());
+			DiscardMacroImage();
 		}
+	}
 
-		if (!InBlockComment)
+	if (!loadedImage)
+	{
+		MQMacroImageRecorder recorder;
+		if (gbUseMacroImages)
 		{
-			if (!AddMacroLine(strMacroName.c_str(), szTemp, MAX_STRING, &LineIndex, LocalLine))
-			{
-				MacroError("Unable to add macro line.");
-				fclose(fMacro);
+			recorder.AddFile(macFilePath);
+			pMacroImageRecorder = &recorder;
+		}
 
-				gszMacroName[0] = 0;
-				gRunning = 0;
-				return;
-			}
+		FILE* fMacro = _fsopen(macFilePath.string().c_str(), "rt", _SH_DENYNO);
+
+		if (fMacro == nullptr)
+		{
+			FatalError("Couldn't open macro file: %s", macFilePath.string().c_str());
+			pMacroImageRecorder = nullptr;
+			gszMacroName[0] = 0;
+			gRunning = 0;
+			return;
 		}
-		else
+
+		strcpy_s(gszMacroName, szTemp);
+		DebugSpew("Macro - Loading macro: %s", macFilePath.string().c_str());
+
+		int LineIndex = 0;
+		int LocalLine = 0;
+
+		while (!feof(fMacro))
 		{
-			DebugSpew("Macro - BlockComment: %s", szTemp);
+			fgets(szTemp, MAX_STRING, fMacro);
+			CleanMacroLine(szTemp);
 
-			if (!strncmp(&szTemp[strlen(szTemp) - 3], "**|", 3))
+			LineIndex++;
+			LocalLine++;
+
+			if (!strncmp(szTemp, "|**", 3))
 			{
-				InBlockComment = false;
+				InBlockComment = true;
+			}
+
+			if (!InBlockComment)
+			{
+				if (!AddMacroLine(strMacroName.c_str(), szTemp, MAX_STRING, &LineIndex, LocalLine))
+				{
+					MacroError("Unable to add macro line.");
+					fclose(fMacro);
+
+					pMacroImageRecorder = nullptr;
+					gszMacroName[0] = 0;
+					gRunning = 0;
+					return;
+				}
+			}
+			else
+			{
+				DebugSpew("Macro - BlockComment: %s", szTemp);
+
+				if (!strncmp(&szTemp[strlen(szTemp) - 3], "**|", 3))
+				{
+					InBlockComment = false;
+				}
 			}
 		}
+
+		fclose(fMacro);
+		pMacroImageRecorder = nullptr;
+
+		if (gbUseMacroImages && recorder.Cacheable)
+		{
+			SaveMacroImage(macFilePath, recorder);
+		}
 	}
 
-	fclose(fMacro);
+	ResolveMacroLines(gMacroBlock->Line);
 
 	while (pDefines)
 	{
@@ -1214,7 +1694,7 @@ void Goto(PlayerClient* pChar, const char* szLine)
 		return;
 	}
 
-	std::map<int, MQMacroLine>::reverse_iterator ri(goto_line);
+	MQMacroLineTable::reverse_iterator ri(goto_line);
 
 	// search up first we only search until we find a "Sub "
 	for (; ri != gMacroBlock->Line.rend(); ri++)
@@ -1257,7 +1737,7 @@ void Goto(PlayerClient* pChar, const char* szLine)
 
 char* GetSubFromLine(int Line, char* szSub, size_t Sublen)
 {
-	std::map<int, MQMacroLine>::reverse_iterator ri(gMacroBlock->Line.find(Line));
+	MQMacroLineTable::reverse_iterator ri(gMacroBlock->Line.find(Line));
 
 	for (; ri != gMacroBlock->Line.rend(); ri++)
 	{
@@ -1591,6 +2071,7 @@ void Call(PlayerClient*, const char* szLine)
 
 	// Prep to call the Sub
 	MQMacroStack* pStack = new MQMacroStack(MacroLine);
+	InitMacroStackVariables(pStack, MacroLine);
 
 	gMacroBlock->CurrIndex = MacroLine;
 	if (gMacroStack && gMacroBlock->BindStackIndex != -1)
@@ -1767,6 +2248,9 @@ static void MarkWhile(const char* szCommand, MQLoop& loop)
 		{
 			loop.firstLine = lineIter->second.LoopStart;
 			loop.lastLine = lineIter->second.LoopEnd;
+
+			// the } only loops back once the /while has run
+			gMacroBlock->Line.at(loop.lastLine).LoopStart = loop.firstLine;
 			return;
 		}
 
@@ -2022,6 +2506,8 @@ void DoEvents(PlayerClient* pChar, const char* szLine)
 		gMacroBlock->CurrIndex = gEventFunc[pEvent->Type];
 	}
 
+	InitMacroStackVariables(pStack, gMacroBlock->CurrIndex);
+
 	DebugSpewNoFile("DoEvents - Deleted event: %d %s", pEvent->Type, pEvent->Name.c_str());
 
 	delete pEvent;
@@ -2284,6 +2770,34 @@ void Next(PlayerClient* pChar, const char* szLine)
 	}
 }
 
+// Returns the /next of the /for loop being run if it was found when the macro was loaded
+// and it is the one that searching forward from the current line would find.
+static int GetResolvedNext(const MQLoop& loop)
+{
+	if (loop.type != MQLoop::Type::For || loop.firstLine >= gMacroBlock->CurrIndex)
+		return 0;
+
+	auto forIter = gMacroBlock->Line.find(loop.firstLine);
+	if (forIter == gMacroBlock->Line.end())
+		return 0;
+
+	const int nextLine = forIter->second.LoopEnd;
+	if (nextLine <= gMacroBlock->CurrIndex)
+		return 0;
+
+	const char* line = gMacroBlock->Line.at(nextLine).Command.c_str();
+	if (_strnicmp(line, "/next", 5))
+		return 0;
+
+	char for_var[MAX_STRING];
+	GetArg(for_var, line, 2);
+
+	if (_stricmp(for_var, loop.forVariable.c_str()))
+		return 0;
+
+	return nextLine;
+}
+
 // ***************************************************************************
 // Function:    Continue
 // Description: Our '/continue' command
@@ -2317,6 +2831,12 @@ void Continue(PlayerClient* pChar, const char* szLine)
 		gMacroBlock->CurrIndex = i->first;
 		return;
 	}
+	else if (const int nextLine = GetResolvedNext(loop))
+	{
+		loop.lastLine = nextLine;
+		gMacroBlock->CurrIndex = nextLine - 1;
+		return;
+	}
 
 	auto i = gMacroBlock->Line.find(gMacroBlock->CurrIndex);
 	while (++i != gMacroBlock->Line.end())
@@ -2375,6 +2895,13 @@ void Break(PlayerClient* pChar, const char* szLine)
 		return;
 	}
 
+	if (const int nextLine = GetResolvedNext(loop))
+	{
+		gMacroBlock->CurrIndex = nextLine;
+		PopMacroLoop();
+		return;
+	}
+
 	auto i = gMacroBlock->Line.find(gMacroBlock->CurrIndex);
 	while (++i != gMacroBlock->Line.end())
 	{
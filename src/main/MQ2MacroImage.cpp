@@ -0,0 +1,430 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "pch.h"
+#include "MQ2Main.h"
+#include "MQ2MacroImage.h"
+
+#include <wil/resource.h>
+
+#include <fstream>
+
+namespace mq {
+
+MQMacroImageRecorder* pMacroImageRecorder = nullptr;
+
+// Bump the version whenever the layout changes, or when loading a macro from source changes in
+// a way that makes images written by an older build wrong.
+static constexpr char MacroImageMagic[4] = { 'M', 'Q', 'M', 'I' };
+static constexpr uint32_t MacroImageVersion = 1;
+static constexpr uint64_t MaxMacroImageSize = 256 * 1024 * 1024;
+
+static std::filesystem::path GetMacroImagePath(const std::filesystem::path& macroFile)
+{
+	std::filesystem::path imagePath = macroFile;
+	imagePath += ".mqi";
+	return imagePath;
+}
+
+// FNV-1a. It only has to tell a changed file from an unchanged one, not resist tampering.
+static bool HashFile(const std::filesystem::path& path, uint64_t& hash)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	uint64_t value = 14695981039346656037ull;
+	char buffer[16384];
+
+	while (file)
+	{
+		file.read(buffer, sizeof(buffer));
+		const std::streamsize count = file.gcount();
+
+		for (std::streamsize i = 0; i < count; ++i)
+		{
+			value ^= static_cast<uint8_t>(buffer[i]);
+			value *= 1099511628211ull;
+		}
+	}
+
+	if (file.bad())
+		return false;
+
+	hash = value;
+	return true;
+}
+
+static bool GetFileState(MQMacroImage::File& file)
+{
+	std::error_code ec;
+	file.Exists = std::filesystem::is_regular_file(file.Path, ec);
+	if (!file.Exists)
+		return true;
+
+	file.Size = std::filesystem::file_size(file.Path, ec);
+	if (ec)
+		return false;
+
+	const auto writeTime = std::filesystem::last_write_time(file.Path, ec);
+	if (ec)
+		return false;
+
+	file.WriteTime = writeTime.time_since_epoch().count();
+	return true;
+}
+
+static bool IsFileUnchanged(const MQMacroImage::File& saved)
+{
+	MQMacroImage::File current;
+	current.Path = saved.Path;
+
+	if (!GetFileState(current) || current.Exists != saved.Exists)
+		return false;
+
+	if (!current.Exists)
+		return true;
+
+	if (current.Size != saved.Size)
+		return false;
+
+	if (current.WriteTime == saved.WriteTime)
+		return true;
+
+	// Files that were copied over or touched without being edited keep their contents.
+	return HashFile(current.Path, current.Hash) && current.Hash == saved.Hash;
+}
+
+void MQMacroImageRecorder::AddFile(const std::filesystem::path& path)
+{
+	for (const MQMacroImage::File& file : Files)
+	{
+		if (file.Path == path)
+			return;
+	}
+
+	MQMacroImage::File& file = Files.emplace_back();
+	file.Path = path;
+
+	if (!GetFileState(file))
+		Cacheable = false;
+}
+
+//============================================================================
+
+class MacroImageWriter
+{
+public:
+	template <typename T>
+	void Write(T value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		m_data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void WriteString(std::string_view value)
+	{
+		Write(static_cast<uint32_t>(value.size()));
+		m_data.append(value);
+	}
+
+	void WriteCount(size_t count)
+	{
+		Write(static_cast<uint32_t>(count));
+	}
+
+	const std::string& GetData() const { return m_data; }
+
+private:
+	std::string m_data;
+};
+
+// Reads from the mapped image. Running past the end marks the reader as failed and makes every
+// read after that return an empty value, so the caller only has to check once at the end.
+class MacroImageReader
+{
+public:
+	MacroImageReader(const uint8_t* data, size_t size)
+		: m_pos(data)
+		, m_end(data + size)
+	{
+	}
+
+	template <typename T>
+	T Read()
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+
+		T value{};
+		if (!Require(sizeof(T)))
+			return value;
+
+		memcpy(&value, m_pos, sizeof(T));
+		m_pos += sizeof(T);
+		return value;
+	}
+
+	std::string_view ReadString()
+	{
+		const uint32_t length = Read<uint32_t>();
+		if (!Require(length))
+			return {};
+
+		std::string_view value(reinterpret_cast<const char*>(m_pos), length);
+		m_pos += length;
+		return value;
+	}
+
+	// Every element takes at least one byte, so a count larger than what is left is corrupt.
+	// Checking it here keeps a bad image from reserving a huge amount of memory.
+	uint32_t ReadCount()
+	{
+		const uint32_t count = Read<uint32_t>();
+		if (!Require(count))
+			return 0;
+
+		return count;
+	}
+
+	bool IsValid() const { return m_valid; }
+	bool AtEnd() const { return m_pos == m_end; }
+
+private:
+	bool Require(size_t size)
+	{
+		if (m_valid && static_cast<size_t>(m_end - m_pos) >= size)
+			return true;
+
+		m_valid = false;
+		m_pos = m_end;
+		return false;
+	}
+
+	const uint8_t* m_pos;
+	const uint8_t* m_end;
+	bool m_valid = true;
+};
+
+static std::filesystem::path ReadPath(MacroImageReader& reader)
+{
+	std::string_view path = reader.ReadString();
+	return std::filesystem::u8path(path.begin(), path.end());
+}
+
+//============================================================================
+
+bool ReadMacroImage(const std::filesystem::path& macroFile, MQMacroImage& image)
+{
+	const std::filesystem::path imagePath = GetMacroImagePath(macroFile);
+
+	wil::unique_hfile hFile(::CreateFileW(imagePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+	if (!hFile)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!::GetFileSizeEx(hFile.get(), &fileSize)
+		|| fileSize.QuadPart < static_cast<LONGLONG>(sizeof(MacroImageMagic))
+		|| fileSize.QuadPart > static_cast<LONGLONG>(MaxMacroImageSize))
+	{
+		return false;
+	}
+
+	wil::unique_handle hMapping(::CreateFileMappingW(hFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+	if (!hMapping)
+		return false;
+
+	wil::unique_mapview_ptr<uint8_t> view(static_cast<uint8_t*>(::MapViewOfFile(hMapping.get(), FILE_MAP_READ, 0, 0, 0)));
+	if (!view)
+		return false;
+
+	MacroImageReader reader(view.get(), static_cast<size_t>(fileSize.QuadPart));
+
+	char magic[4];
+	for (char& c : magic)
+		c = reader.Read<char>();
+
+	if (memcmp(magic, MacroImageMagic, sizeof(magic)) != 0
+		|| reader.Read<uint32_t>() != MacroImageVersion
+		|| reader.ReadString() != internal_paths::Macros)
+	{
+		return false;
+	}
+
+	// The files come first so that a stale image is rejected before the rest of it is copied.
+	const uint32_t fileCount = reader.ReadCount();
+	image.Files.resize(fileCount);
+
+	for (MQMacroImage::File& file : image.Files)
+	{
+		file.Path = ReadPath(reader);
+		file.Exists = reader.Read<uint8_t>() != 0;
+		file.Size = reader.Read<uint64_t>();
+		file.WriteTime = reader.Read<int64_t>();
+		file.Hash = reader.Read<uint64_t>();
+
+		if (!reader.IsValid() || !IsFileUnchanged(file))
+			return false;
+	}
+
+	const uint32_t directiveCount = reader.ReadCount();
+	image.Directives.reserve(directiveCount);
+	for (uint32_t i = 0; i < directiveCount; ++i)
+		image.Directives.emplace_back(reader.ReadString());
+
+	const uint32_t sourceFileCount = reader.ReadCount();
+	image.SourceFiles.reserve(sourceFileCount);
+	for (uint32_t i = 0; i < sourceFileCount; ++i)
+		image.SourceFiles.emplace_back(reader.ReadString());
+
+	const uint32_t lineCount = reader.ReadCount();
+	image.Lines.resize(lineCount);
+	for (MQMacroImage::Line& line : image.Lines)
+	{
+		line.SourceFile = reader.Read<uint32_t>();
+		line.LineNumber = reader.Read<int32_t>();
+		line.Command = reader.ReadString();
+
+		// Blank lines are dropped while loading, so an empty command is most likely a corrupt image.
+		// Rejecting it loads the macro from source instead.
+		if (line.SourceFile >= image.SourceFiles.size() || line.Command.empty())
+			return false;
+	}
+
+	const uint32_t subCount = reader.ReadCount();
+	image.Subs.reserve(subCount);
+	for (uint32_t i = 0; i < subCount; ++i)
+	{
+		std::string name{ reader.ReadString() };
+		int lineNumber = reader.Read<int32_t>();
+
+		if (lineNumber < 1 || lineNumber > static_cast<int>(lineCount))
+			return false;
+
+		image.Subs.emplace_back(std::move(name), lineNumber);
+	}
+
+	const uint32_t eventCount = reader.ReadCount();
+	image.EventFuncs.reserve(eventCount);
+	for (uint32_t i = 0; i < eventCount; ++i)
+		image.EventFuncs.push_back(reader.Read<int32_t>());
+
+	const uint32_t customEventCount = reader.ReadCount();
+	image.CustomEventFuncs.reserve(customEventCount);
+	for (uint32_t i = 0; i < customEventCount; ++i)
+		image.CustomEventFuncs.push_back(reader.Read<int32_t>());
+
+	return reader.IsValid() && reader.AtEnd();
+}
+
+bool WriteMacroImage(const std::filesystem::path& macroFile, MQMacroImage& image)
+{
+	for (MQMacroImage::File& file : image.Files)
+	{
+		if (!file.Exists)
+			continue;
+
+		MQMacroImage::File current;
+		current.Path = file.Path;
+
+		if (!GetFileState(current)
+			|| !current.Exists
+			|| current.Size != file.Size
+			|| current.WriteTime != file.WriteTime
+			|| !HashFile(file.Path, file.Hash))
+		{
+			return false;
+		}
+	}
+
+	MacroImageWriter writer;
+	for (char c : MacroImageMagic)
+		writer.Write(c);
+	writer.Write(MacroImageVersion);
+	writer.WriteString(internal_paths::Macros);
+
+	writer.WriteCount(image.Files.size());
+	for (const MQMacroImage::File& file : image.Files)
+	{
+		writer.WriteString(file.Path.u8string());
+		writer.Write(static_cast<uint8_t>(file.Exists ? 1 : 0));
+		writer.Write(file.Size);
+		writer.Write(file.WriteTime);
+		writer.Write(file.Hash);
+	}
+
+	writer.WriteCount(image.Directives.size());
+	for (const std::string& directive : image.Directives)
+		writer.WriteString(directive);
+
+	writer.WriteCount(image.SourceFiles.size());
+	for (const std::string& sourceFile : image.SourceFiles)
+		writer.WriteString(sourceFile);
+
+	writer.WriteCount(image.Lines.size());
+	for (const MQMacroImage::Line& line : image.Lines)
+	{
+		writer.Write(line.SourceFile);
+		writer.Write(static_cast<int32_t>(line.LineNumber));
+		writer.WriteString(line.Command);
+	}
+
+	writer.WriteCount(image.Subs.size());
+	for (const auto& [name, lineNumber] : image.Subs)
+	{
+		writer.WriteString(name);
+		writer.Write(static_cast<int32_t>(lineNumber));
+	}
+
+	writer.WriteCount(image.EventFuncs.size());
+	for (int lineNumber : image.EventFuncs)
+		writer.Write(static_cast<int32_t>(lineNumber));
+
+	writer.WriteCount(image.CustomEventFuncs.size());
+	for (int lineNumber : image.CustomEventFuncs)
+		writer.Write(static_cast<int32_t>(lineNumber));
+
+	// Write to a temporary file and move it into place so that another client starting the same
+	// macro never maps a half written image.
+	const std::filesystem::path imagePath = GetMacroImagePath(macroFile);
+	std::filesystem::path tempPath = imagePath;
+	tempPath += fmt::format(".{}.tmp", ::GetCurrentProcessId());
+
+	const std::string& data = writer.GetData();
+	bool written;
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		file.write(data.data(), static_cast<std::streamsize>(data.size()));
+		file.close();
+		written = !file.fail();
+	}
+
+	std::error_code ec;
+	if (written)
+		std::filesystem::rename(tempPath, imagePath, ec);
+	if (!written || ec)
+	{
+		std::filesystem::remove(tempPath, ec);
+		return false;
+	}
+
+	return true;
+}
+
+//============================================================================
+
+} // namespace mq
@@ -0,0 +1,91 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#ifndef MQ2MAIN_EXPORTS
+#error This header should only be included from the MQ2Main project
+#endif
+
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mq {
+
+//============================================================================
+
+// A macro after its #include and #define lines have been processed. It is saved next to the
+// macro so that the next /macro can skip reading and preprocessing the source files as long as
+// none of them changed.
+struct MQMacroImage
+{
+	struct File
+	{
+		std::filesystem::path Path;
+		bool Exists = false;
+		uint64_t Size = 0;
+		int64_t WriteTime = 0;
+		uint64_t Hash = 0;
+	};
+
+	struct Line
+	{
+		uint32_t SourceFile = 0;                       // index into SourceFiles
+		int LineNumber = 0;
+		std::string Command;
+	};
+
+	// Every file that was read, plus include paths that were tried but didn't exist.
+	std::vector<File> Files;
+
+	// The # lines that have side effects other than adding a line (#event, #bind, #turbo, ...).
+	// They are replayed in order when the image is loaded.
+	std::vector<std::string> Directives;
+
+	std::vector<std::string> SourceFiles;
+	std::vector<Line> Lines;
+	std::vector<std::pair<std::string, int>> Subs;     // gMacroSubLookupMap
+	std::vector<int> EventFuncs;                       // gEventFunc
+	std::vector<int> CustomEventFuncs;                 // pEventFunc of each #event, in pEventList order
+};
+
+// Collects what a macro being loaded from source depends on. Only set while that happens and
+// macro images are enabled.
+struct MQMacroImageRecorder
+{
+	// false if the result depends on something other than the files, like data in an #include.
+	bool Cacheable = true;
+
+	// The size and time of each file are taken when it is added, before it is read, so that a
+	// file that changes while the macro loads isn't saved as unchanged.
+	std::vector<MQMacroImage::File> Files;
+	std::vector<std::string> Directives;
+
+	void AddFile(const std::filesystem::path& path);
+};
+extern MQMacroImageRecorder* pMacroImageRecorder;
+
+// Reads the image saved for a macro. Returns false if there is none, it can't be read, or any
+// of the files it was built from changed.
+bool ReadMacroImage(const std::filesystem::path& macroFile, MQMacroImage& image);
+
+// Saves the image for a macro. The files in image.Files are hashed first, nothing is saved if
+// any of them changed since they were added to the recorder.
+bool WriteMacroImage(const std::filesystem::path& macroFile, MQMacroImage& image);
+
+//============================================================================
+
+} // namespace mq
@@ -155,10 +155,13 @@ void InitializeLogging()
 
 	SPDLOG_DEBUG("Logging Initialized");
 	eqlib::InitializeLogging(new_logger);
+
+	InitializeDebugSpewLog();
 }
 
 void ShutdownLogging()
 {
+	ShutdownDebugSpewLog();
 	eqlib::ShutdownLogging();
 	spdlog::shutdown();
 }
@@ -399,6 +402,10 @@ bool ParseINIFile(const std::string& iniFile)
 	gbIgnoreAlertRecursion   = GetPrivateProfileBool("MacroQuest", "IgnoreAlertRecursion", gbIgnoreAlertRecursion, iniFile);
 	gbShowCurrentCamera      = GetPrivateProfileBool("MacroQuest", "ShowCurrentCamera", gbShowCurrentCamera, iniFile);
 	gTurboLimit              = GetPrivateProfileInt("MacroQuest", "TurboLimit", gTurboLimit, iniFile);
+	gDefaultTurboBudget      = GetPrivateProfileInt("MacroQuest", "TurboBudget", gDefaultTurboBudget, iniFile);
+	gbUseMacroImages         = GetPrivateProfileBool("MacroQuest", "UseMacroImages", gbUseMacroImages, iniFile);
+	gbFrameMemoization       = GetPrivateProfileBool("MacroQuest", "FrameMemoization", gbFrameMemoization, iniFile);
+	gbBatchWriteChatColor    = GetPrivateProfileBool("MacroQuest", "BatchWriteChatColor", gbBatchWriteChatColor, iniFile);
 	gCreateMQ2NewsWindow     = GetPrivateProfileBool("MacroQuest", "CreateMQ2NewsWindow", gCreateMQ2NewsWindow, iniFile);
 	gNetStatusXPos           = GetPrivateProfileInt("MacroQuest", "NetStatusXPos", gNetStatusXPos, iniFile);
 	gNetStatusYPos           = GetPrivateProfileInt("MacroQuest", "NetStatusYPos", gNetStatusYPos, iniFile);
@@ -434,6 +441,10 @@ bool ParseINIFile(const std::string& iniFile)
 		WritePrivateProfileBool("MacroQuest", "IgnoreAlertRecursion", gbIgnoreAlertRecursion, iniFile);
 		WritePrivateProfileBool("MacroQuest", "ShowCurrentCamera", gbShowCurrentCamera, iniFile);
 		WritePrivateProfileInt("MacroQuest", "TurboLimit", gTurboLimit, iniFile);
+		WritePrivateProfileInt("MacroQuest", "TurboBudget", gDefaultTurboBudget, iniFile);
+		WritePrivateProfileBool("MacroQuest", "UseMacroImages", gbUseMacroImages, iniFile);
+		WritePrivateProfileBool("MacroQuest", "FrameMemoization", gbFrameMemoization, iniFile);
+		WritePrivateProfileBool("MacroQuest", "BatchWriteChatColor", gbBatchWriteChatColor, iniFile);
 		WritePrivateProfileBool("MacroQuest", "CreateMQ2NewsWindow", gCreateMQ2NewsWindow, iniFile);
 		WritePrivateProfileInt("MacroQuest", "NetStatusXPos", gNetStatusXPos, iniFile);
 		WritePrivateProfileInt("MacroQuest", "NetStatusYPos", gNetStatusYPos, iniFile);
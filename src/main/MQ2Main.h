@@ -81,6 +81,10 @@ namespace mq {
 // Initialize/shutdown subsystems
 void ShutdownMQ2Benchmarks();
 void InitializeMQ2Benchmarks();
+void BenchmarkCalculate(int iterations);
+
+// Macro engine
+bool EvaluateDelayCondition(bool force, bool& conditionMet);
 
 void InitializeDisplayHook();
 void ShutdownDisplayHook();
@@ -103,6 +107,8 @@ MQLIB_API void DebugSpew(const char* szFormat, ...);
 MQLIB_API void DebugSpewAlways(const char* szFormat, ...);
 MQLIB_API void DebugSpewAlwaysFile(const char* szFormat, ...);
 MQLIB_API void DebugSpewNoFile(const char* szFormat, ...);
+void InitializeDebugSpewLog();
+void ShutdownDebugSpewLog();
 
 /* SPAWN HANDLING */
 MQLIB_API bool SetNameSpriteState(SPAWNINFO* pSpawn, bool Show);
@@ -443,6 +449,16 @@ using ObservedSpawnPtr = MQEQObjectPtr<PlayerClient>;
 MQLIB_API void AddObservedEQObject(const std::shared_ptr<MQTransient>& Object);
 MQLIB_API void InvalidateObservedEQObject(void* Object);
 
+struct MQObservedObjectStats
+{
+	size_t Observers = 0;          // registered observers, including expired ones not swept yet
+	size_t LiveObservers = 0;
+	size_t Objects = 0;            // distinct addresses being observed
+	uint64_t Invalidated = 0;      // observers invalidated since startup
+	uint64_t Sweeps = 0;
+};
+MQObservedObjectStats GetObservedObjectStats();
+
 // A.k.a. "Door target"
 MQLIB_API void SetSwitchTarget(EQSwitch* pSwitch);
 MQLIB_API EQSwitch* GetSwitchByID(int id);
@@ -454,7 +470,16 @@ MQLIB_API void ClearSearchSpawn(MQSpawnSearch* pSearchSpawn);
 MQLIB_API SPAWNINFO* NthNearestSpawn(MQSpawnSearch* pSearchSpawn, int Nth, SPAWNINFO* pOrigin, bool IncludeOrigin = false);
 MQLIB_API int CountMatchingSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pOrigin, bool IncludeOrigin = false);
 MQLIB_API SPAWNINFO* SearchThroughSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar);
+// Compiles the search on every call, use an MQSpawnSearchProgram to match one search against many spawns.
 MQLIB_API bool SpawnMatchesSearch(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar, SPAWNINFO* pSpawn);
+MQLIB_OBJECT SPAWNINFO* NthNearestSpawn(const MQSpawnSearchProgram& search, int Nth, SPAWNINFO* pOrigin, bool IncludeOrigin = false);
+MQLIB_OBJECT int CountMatchingSpawns(const MQSpawnSearchProgram& search, SPAWNINFO* pOrigin, bool IncludeOrigin = false);
+MQLIB_OBJECT SPAWNINFO* SearchThroughSpawns(const MQSpawnSearchProgram& search, SPAWNINFO* pChar);
+
+// Parses and compiles a search the same way as ClearSearchSpawn followed by ParseSearchSpawn. The
+// result is cached by the search text until the next zone, and is only valid until the next call.
+MQLIB_OBJECT const MQSpawnSearchProgram& GetSpawnSearchProgram(std::string_view search, double defaultRadius = 10000.0);
+void ClearSpawnSearchCache();
 MQLIB_API bool SearchSpawnMatchesSearchSpawn(MQSpawnSearch* pSearchSpawn1, MQSpawnSearch* pSearchSpawn2);
 MQLIB_API const char* ParseSearchSpawnArgs(char* szArg, const char* szRest, MQSpawnSearch* pSearchSpawn);
 MQLIB_API void ParseSearchSpawn(const char* Buffer, MQSpawnSearch* pSearchSpawn);
@@ -680,6 +705,7 @@ MQLIB_API bool WillFitInInventory(ItemClient* pContent);
 /* MQ2ANONYMIZE */
 void InitializeAnonymizer();
 void ShutdownAnonymizer();
+void PulseAnonymizer();
 MQLIB_API bool IsAnonymized();
 MQLIB_OBJECT CXStr Anonymize(const CXStr& Text);
 MQLIB_OBJECT CXStr& PluginAnonymize(CXStr& Text);
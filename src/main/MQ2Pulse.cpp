@@ -95,19 +95,11 @@ static bool DoNextCommand(MQMacroBlockPtr pBlock)
 
 	if (gDelay && gDelayCondition[0])
 	{
-		char szCond[MAX_STRING];
-		strcpy_s(szCond, gDelayCondition);
-
-		ParseMacroData(szCond, MAX_STRING);
-
-		double Result;
-		if (!Calculate(szCond, Result))
-		{
-			FatalError("Failed to parse /delay condition '%s', non-numeric encountered", szCond);
+		bool conditionMet;
+		if (!EvaluateDelayCondition(false, conditionMet))
 			return false;
-		}
 
-		if (Result != 0)
+		if (conditionMet)
 		{
 			DebugSpewNoFile("/delay ending early, conditions met");
 			gDelay = 0;
@@ -116,7 +108,7 @@ static bool DoNextCommand(MQMacroBlockPtr pBlock)
 
 	if (!gDelay && pBlock && !pBlock->Paused && (!gMQPauseOnChat || pEverQuestInfo->KeyboardMode) && gMacroStack)
 	{
-		const MQMacroLine& ml = pBlock->Line.at(pBlock->CurrIndex);
+		MQMacroLine& ml = pBlock->Line.at(pBlock->CurrIndex);
 
 		if (pBlock->BindStackIndex == pBlock->CurrIndex)
 		{
@@ -133,7 +125,7 @@ static bool DoNextCommand(MQMacroBlockPtr pBlock)
 
 		if (gbInZone && !gZoning)
 		{
-			DoCommand(ml.Command.c_str(), false);
+			pCommandAPI->DoMacroLine(ml);
 			MQMacroBlockPtr pCurrentBlock = GetCurrentMacroBlock();
 
 			if (!pCurrentBlock)
@@ -169,8 +161,8 @@ static bool DoNextCommand(MQMacroBlockPtr pBlock)
 #ifdef MQ2_PROFILING
 			LARGE_INTEGER AfterCommand;
 			QueryPerformanceCounter(&AfterCommand);
-			pCurrentBlock->Line[ThisMacroBlock].ExecutionCount++;
-			pCurrentBlock->Line[ThisMacroBlock].ExecutionTime += AfterCommand.QuadPart - BeforeCommand.QuadPart;
+			pCurrentBlock->Line.at(ThisMacroBlock).ExecutionCount++;
+			pCurrentBlock->Line.at(ThisMacroBlock).ExecutionTime += AfterCommand.QuadPart - BeforeCommand.QuadPart;
 #endif
 
 			const int lastindex = pCurrentBlock->Line.rbegin()->first;
@@ -679,6 +671,9 @@ static HeartbeatState Heartbeat()
 
 	BeatCount++;
 
+	// The game had a frame to change things since the last pulse.
+	InvalidateFrameMemo();
+
 	if (bFirstHeartBeat)
 	{
 		LastGetTick = Tick;
@@ -722,6 +717,7 @@ static HeartbeatState Heartbeat()
 	}
 
 	UpdateMQ2SpawnSort();
+	PulseAnonymizer();
 
 	DebugTry(DrawHUD());
 	DebugTry(PulseMQ2AutoInventory());
@@ -747,24 +743,67 @@ static HeartbeatState Heartbeat()
 		return HeartbeatNormal;
 	}
 
-	int CurTurbo = 0;
-
 	MQMacroBlockPtr pBlock = GetNextMacroBlock();
-	while (bRunNextCommand)
-	{
-		if (!pBlock)
-			break;
-		if (!DoNextCommand(pBlock))
-			break;
-		if (gbUnload)
-			return HeartbeatUnload;
-		if (!gTurbo)
-			break;
-		if (++CurTurbo > gMaxTurbo)
-			break;
-
-		// re-fetch current macro block in case one of the previous instructions changed it
-		pBlock = GetCurrentMacroBlock();
+	if (pBlock && bRunNextCommand)
+	{
+		// With a time budget the line count only acts as a safety cap, so cheap lines can run
+		// past the usual #turbo count while expensive ones stop early.
+		const auto budget = std::chrono::microseconds(gTurboBudget);
+		const int maxTurbo = gTurboBudget > 0 ? std::max(gMaxTurbo, gTurboLimit) : gMaxTurbo;
+
+		int CurTurbo = 0;
+		uint32_t linesRun = 0;
+		bool deferred = false;
+
+		EnterMQ2Benchmark(bmMacroTurbo);
+		const auto start = std::chrono::steady_clock::now();
+
+		while (bRunNextCommand)
+		{
+			if (!pBlock)
+				break;
+			if (!DoNextCommand(pBlock))
+				break;
+			++linesRun;
+			if (gbUnload)
+			{
+				ExitMQ2Benchmark(bmMacroTurbo);
+				return HeartbeatUnload;
+			}
+			if (!gTurbo)
+				break;
+
+			if (++CurTurbo > maxTurbo)
+			{
+				deferred = true;
+				break;
+			}
+
+			if (gTurboBudget > 0 && std::chrono::steady_clock::now() - start >= budget)
+			{
+				deferred = true;
+				break;
+			}
+
+			// re-fetch current macro block in case one of the previous instructions changed it
+			pBlock = GetCurrentMacroBlock();
+		}
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+		ExitMQ2Benchmark(bmMacroTurbo);
+
+		if (linesRun > 0)
+		{
+			gTurboStats.LastLines = linesRun;
+			gTurboStats.LastTime = elapsed;
+			gTurboStats.LastDeferred = deferred;
+
+			gTurboStats.Frames++;
+			gTurboStats.TotalLines += linesRun;
+			gTurboStats.TotalTime += elapsed;
+			if (deferred)
+				gTurboStats.DeferredFrames++;
+		}
 	}
 
 	pCommandAPI->PulseCommands();
@@ -16,6 +16,7 @@
 #include "MQ2Main.h"
 #include "MQDataAPI.h"
 #include "MQPluginHandler.h"
+#include "mq/base/Sort.h"
 
 namespace mq {
 
@@ -23,6 +24,7 @@ static void Spawns_Initialize();
 static void Spawns_Shutdown();
 static void Spawns_Pulse();
 static void Spawns_BeginZone();
+static void Spawns_SpawnAdded(SPAWNINFO* pSpawn);
 static void Spawns_SpawnRemoved(SPAWNINFO* pSpawn);
 
 static MQModule gSpawnsModule = {
@@ -35,7 +37,7 @@ static MQModule gSpawnsModule = {
 	nullptr,                      // UpdateImGui
 	nullptr,                      // Zoned
 	nullptr,                      // WriteChatColor
-	nullptr,                      // SpawnAdded
+	Spawns_SpawnAdded,            // SpawnAdded
 	Spawns_SpawnRemoved,          // SpawnRemoved
 	Spawns_BeginZone,             // BeginZone
 };
@@ -44,6 +46,13 @@ MQModule* GetSpawnsModule() { return &gSpawnsModule; }
 // Global spawn array, sorted by distance.
 std::vector<MQSpawnArrayItem> gSpawnsArray;
 
+// Spawns by location. Positions are refreshed once per pulse, the slack covers how far a spawn
+// can move between pulses.
+SpatialGrid<SPAWNINFO> gSpawnGrid(100.0f, 50.0f);
+
+// Spawn fields by index, rebuilt every pulse. Spawns added since then are at the end.
+MQSpawnSnapshot gSpawnSnapshot;
+
 // Our last known combat state
 static ECombatState s_combatState = eCombatState_Standing;
 
@@ -893,40 +902,333 @@ static void ProcessPendingGroundItems()
 
 #pragma endregion
 
-void UpdateMQ2SpawnSort()
+#pragma region Spawn Index
+
+// Spawns by id and by each kind of name, kept up to date by the spawn add and remove hooks. A
+// spawn can be renamed while it is around (when it dies, or when a pet is named), so the names
+// are checked again every pulse. Until the first pulse has built the index, lookups fall back to
+// walking the spawn list.
+
+static constexpr size_t SpawnNameKindCount = 3;
+static constexpr uint32_t MaxDenseSpawnID = 0xffff;
+
+struct SpawnIndexEntry
 {
-	EnterMQ2Benchmark(bmUpdateSpawnSort);
+	uint32_t SpawnID = 0;
 
-	EQP_DistArray = nullptr;
-	gSpawnCount = 0;
-	gSpawnsArray.clear();
+	// The names as they were when the spawn was indexed, to notice when they change.
+	std::string Name;
+	std::string DisplayedName;
 
-	float myX = 0, myY = 0;
-	if (pControlledPlayer)
+	// The lower case keys that the spawn is filed under, by SpawnNameKind.
+	std::string Keys[SpawnNameKindCount];
+};
+
+static std::unordered_map<SPAWNINFO*, SpawnIndexEntry> s_indexedSpawns;
+static std::unordered_map<std::string, std::vector<SPAWNINFO*>> s_spawnsByName[SpawnNameKindCount];
+static std::vector<SPAWNINFO*> s_spawnsByID;                   // ids up to MaxDenseSpawnID
+static std::unordered_map<uint32_t, SPAWNINFO*> s_spawnsByLargeID;
+static bool s_spawnIndexReady = false;
+
+static void MakeSpawnNameKey(std::string& key, std::string_view name, SpawnNameKind kind)
+{
+	key.clear();
+
+	for (char ch : name)
 	{
-		myX = pControlledPlayer->X;
-		myY = pControlledPlayer->Y;
+		if (kind == SpawnNameKind::CleanName)
+		{
+			// Same as CleanupName(szName, BufferSize, false, false).
+			if ((ch >= '0' && ch <= '9') || ch == '#')
+				continue;
+			if (ch == '_')
+				ch = ' ';
+		}
+
+		key.push_back(static_cast<char>(tolower(static_cast<unsigned char>(ch))));
 	}
+}
 
-	// we need to make sure the spawn manager is valid here because this can get called from login pulse before the spawn manager is valid
-	if (pSpawnManager)
+static std::string_view GetSpawnName(SPAWNINFO* pSpawn, SpawnNameKind kind)
+{
+	return kind == SpawnNameKind::DisplayedName ? pSpawn->DisplayedName : pSpawn->Name;
+}
+
+static void IndexSpawnNames(SPAWNINFO* pSpawn, SpawnIndexEntry& entry)
+{
+	entry.Name = pSpawn->Name;
+	entry.DisplayedName = pSpawn->DisplayedName;
+
+	for (size_t kind = 0; kind < SpawnNameKindCount; ++kind)
 	{
-		SPAWNINFO* pSpawn = pSpawnManager->FirstSpawn;
-		while (pSpawn)
+		MakeSpawnNameKey(entry.Keys[kind], GetSpawnName(pSpawn, static_cast<SpawnNameKind>(kind)),
+			static_cast<SpawnNameKind>(kind));
+		s_spawnsByName[kind][entry.Keys[kind]].push_back(pSpawn);
+	}
+}
+
+static void UnindexSpawnNames(SPAWNINFO* pSpawn, const SpawnIndexEntry& entry)
+{
+	for (size_t kind = 0; kind < SpawnNameKindCount; ++kind)
+	{
+		auto iter = s_spawnsByName[kind].find(entry.Keys[kind]);
+		if (iter == s_spawnsByName[kind].end())
+			continue;
+
+		std::vector<SPAWNINFO*>& spawns = iter->second;
+		spawns.erase(std::remove(std::begin(spawns), std::end(spawns), pSpawn), std::end(spawns));
+
+		if (spawns.empty())
+			s_spawnsByName[kind].erase(iter);
+	}
+}
+
+static void UnindexSpawn(SPAWNINFO* pSpawn)
+{
+	auto iter = s_indexedSpawns.find(pSpawn);
+	if (iter == s_indexedSpawns.end())
+		return;
+
+	const uint32_t spawnID = iter->second.SpawnID;
+	UnindexSpawnNames(pSpawn, iter->second);
+	s_indexedSpawns.erase(iter);
+
+	// Only clear the id if it hasn't been given to a newer spawn already.
+	if (spawnID <= MaxDenseSpawnID)
+	{
+		if (spawnID < s_spawnsByID.size() && s_spawnsByID[spawnID] == pSpawn)
+			s_spawnsByID[spawnID] = nullptr;
+	}
+	else
+	{
+		auto idIter = s_spawnsByLargeID.find(spawnID);
+		if (idIter != s_spawnsByLargeID.end() && idIter->second == pSpawn)
+			s_spawnsByLargeID.erase(idIter);
+	}
+}
+
+static void IndexSpawn(SPAWNINFO* pSpawn)
+{
+	UnindexSpawn(pSpawn);
+
+	SpawnIndexEntry& entry = s_indexedSpawns[pSpawn];
+	IndexSpawnNames(pSpawn, entry);
+
+	const uint32_t spawnID = pSpawn->SpawnID;
+	entry.SpawnID = spawnID;
+
+	if (spawnID <= MaxDenseSpawnID)
+	{
+		if (spawnID >= s_spawnsByID.size())
+			s_spawnsByID.resize(spawnID + 1, nullptr);
+		s_spawnsByID[spawnID] = pSpawn;
+	}
+	else
+	{
+		s_spawnsByLargeID[spawnID] = pSpawn;
+	}
+}
+
+static void ClearSpawnIndex()
+{
+	s_indexedSpawns.clear();
+	for (auto& spawnsByName : s_spawnsByName)
+		spawnsByName.clear();
+	s_spawnsByID.clear();
+	s_spawnsByLargeID.clear();
+
+	// lookups go back to the spawn manager until the index is rebuilt
+	s_spawnIndexReady = false;
+}
+
+static void RebuildSpawnIndex()
+{
+	ClearSpawnIndex();
+
+	for (SPAWNINFO* pSpawn = pSpawnManager->FirstSpawn; pSpawn; pSpawn = pSpawn->pNext)
+		IndexSpawn(pSpawn);
+
+	s_spawnIndexReady = true;
+}
+
+// Re-file the spawns whose names changed since they were indexed.
+static void UpdateSpawnIndexNames()
+{
+	for (auto& [pSpawn, entry] : s_indexedSpawns)
+	{
+		if (entry.Name != pSpawn->Name || entry.DisplayedName != pSpawn->DisplayedName)
 		{
-			float distSq = GetDistanceSquared(myX, myY, pSpawn->X, pSpawn->Y);
+			UnindexSpawnNames(pSpawn, entry);
+			IndexSpawnNames(pSpawn, entry);
+		}
+	}
+}
 
-			gSpawnsArray.emplace_back(pSpawn, distSq);
-			pSpawn = pSpawn->pNext;
+PlayerClient* FindSpawnByID(uint32_t spawnID)
+{
+	if (!s_spawnIndexReady)
+		return pSpawnManager ? pSpawnManager->GetSpawnByID(spawnID) : nullptr;
+
+	if (spawnID <= MaxDenseSpawnID)
+		return spawnID < s_spawnsByID.size() ? s_spawnsByID[spawnID] : nullptr;
+
+	auto iter = s_spawnsByLargeID.find(spawnID);
+	return iter != s_spawnsByLargeID.end() ? iter->second : nullptr;
+}
+
+template <typename Visit>
+static void ForEachSpawnByName(std::string_view name, SpawnNameKind kind, Visit&& visit)
+{
+	// Lookups only come from the main thread, so the key buffer can be shared.
+	static std::string s_key;
+	MakeSpawnNameKey(s_key, name, kind);
+
+	if (!s_spawnIndexReady)
+	{
+		std::string spawnKey;
+
+		for (SPAWNINFO* pSpawn = pSpawnManager ? pSpawnManager->FirstSpawn : nullptr; pSpawn; pSpawn = pSpawn->pNext)
+		{
+			MakeSpawnNameKey(spawnKey, GetSpawnName(pSpawn, kind), kind);
+
+			if (spawnKey == s_key && !visit(pSpawn))
+				return;
 		}
+
+		return;
 	}
 
-	std::sort(std::begin(gSpawnsArray), std::end(gSpawnsArray), MQRankFloatCompare);
+	auto iter = s_spawnsByName[static_cast<size_t>(kind)].find(s_key);
+	if (iter == s_spawnsByName[static_cast<size_t>(kind)].end())
+		return;
+
+	for (SPAWNINFO* pSpawn : iter->second)
+	{
+		if (!visit(pSpawn))
+			return;
+	}
+}
+
+PlayerClient* FindSpawnByName(std::string_view name, SpawnNameKind kind)
+{
+	SPAWNINFO* pFound = nullptr;
+
+	ForEachSpawnByName(name, kind, [&](SPAWNINFO* pSpawn) { pFound = pSpawn; return false; });
+
+	return pFound;
+}
+
+std::vector<PlayerClient*> FindSpawnsByName(std::string_view name, SpawnNameKind kind)
+{
+	std::vector<PlayerClient*> spawns;
 
+	ForEachSpawnByName(name, kind, [&](SPAWNINFO* pSpawn) { spawns.push_back(pSpawn); return true; });
+
+	return spawns;
+}
+
+#pragma endregion
+
+void MQSpawnSnapshot::Add(SPAWNINFO* pSpawn)
+{
+	Spawns.push_back(pSpawn);
+	X.push_back(pSpawn->X);
+	Y.push_back(pSpawn->Y);
+	Level.push_back(static_cast<uint8_t>(std::clamp<int>(pSpawn->Level, 0, 255)));
+}
+
+static void UpdateSpawnArrayGlobals()
+{
 	gSpawnCount = static_cast<int>(gSpawnsArray.size());
 	EQP_DistArray = gSpawnCount > 0 ? &gSpawnsArray[0] : nullptr;
+}
 
-	ExitMQ2Benchmark(bmUpdateSpawnSort);
+static void GetSpawnSortOrigin(float& myX, float& myY)
+{
+	myX = 0;
+	myY = 0;
+
+	if (pControlledPlayer)
+	{
+		myX = pControlledPlayer->X;
+		myY = pControlledPlayer->Y;
+	}
+}
+
+void UpdateMQ2SpawnSort()
+{
+	MQScopedBenchmark bm(bmUpdateSpawnSort);
+
+	// we need to make sure the spawn manager is valid here because this can get called from login pulse before the spawn manager is valid
+	if (!pSpawnManager)
+	{
+		gSpawnsArray.clear();
+		gSpawnGrid.Clear();
+		gSpawnSnapshot.Clear();
+		ClearSpawnIndex();
+		UpdateSpawnArrayGlobals();
+		return;
+	}
+
+	// The array is kept in step with the spawn list by the add and remove hooks. Refreshing the grid
+	// walks the list anyway, so use it to check that the hooks didn't miss anything, and start over
+	// from the list if they did.
+	gSpawnGrid.BeginRefresh();
+
+	size_t spawnCount = 0;
+	bool missed = false;
+
+	for (SPAWNINFO* pSpawn = pSpawnManager->FirstSpawn; pSpawn; pSpawn = pSpawn->pNext)
+	{
+		missed |= gSpawnGrid.Update(pSpawn, pSpawn->X, pSpawn->Y);
+		++spawnCount;
+	}
+
+	missed |= gSpawnGrid.EndRefresh() != 0;
+
+	if (missed || spawnCount != gSpawnsArray.size() || !s_spawnIndexReady)
+	{
+		gSpawnsArray.clear();
+
+		for (SPAWNINFO* pSpawn = pSpawnManager->FirstSpawn; pSpawn; pSpawn = pSpawn->pNext)
+			gSpawnsArray.emplace_back(pSpawn, 0.0f);
+
+		RebuildSpawnIndex();
+	}
+	else
+	{
+		UpdateSpawnIndexNames();
+	}
+
+	// Take the snapshot first, so that the distances are computed in a loop over plain arrays
+	// instead of following a pointer for every spawn.
+	const size_t count = gSpawnsArray.size();
+	gSpawnSnapshot.Clear();
+
+	for (size_t i = 0; i < count; ++i)
+		gSpawnSnapshot.Add(gSpawnsArray[i].GetSpawn());
+
+	float myX, myY;
+	GetSpawnSortOrigin(myX, myY);
+
+	static std::vector<float> s_spawnDistSq;
+	s_spawnDistSq.resize(count);
+
+	for (size_t i = 0; i < count; ++i)
+		s_spawnDistSq[i] = GetDistanceSquared(myX, myY, gSpawnSnapshot.X[i], gSpawnSnapshot.Y[i]);
+
+	for (size_t i = 0; i < count; ++i)
+		gSpawnsArray[i].SetDistanceSquared(s_spawnDistSq[i]);
+
+	// The order from the last pulse is usually close, so this is mostly a pass that finds nothing
+	// to move. A full sort is only needed after a big change, like the spawns being rebuilt above
+	// or the player porting.
+	if (!InsertionSort(gSpawnsArray, MQRankFloatCompare, count * 4))
+	{
+		std::sort(std::begin(gSpawnsArray), std::end(gSpawnsArray), MQRankFloatCompare);
+	}
+
+	UpdateSpawnArrayGlobals();
 }
 
 bool IsTargetable(SPAWNINFO* pSpawn)
@@ -1047,6 +1349,9 @@ static void Spawns_Shutdown()
 	EQP_DistArray = nullptr;
 	gSpawnCount = 0;
 	gSpawnsArray.clear();
+	gSpawnGrid.Clear();
+	gSpawnSnapshot.Clear();
+	ClearSpawnIndex();
 
 	RemoveMQ2Benchmark(bmUpdateSpawnSort);
 	RemoveMQ2Benchmark(bmUpdateSpawnCaptions);
@@ -1098,10 +1403,39 @@ static void Spawns_Pulse()
 static void Spawns_BeginZone()
 {
 	gSpawnsArray.clear();
+	gSpawnGrid.Clear();
+	gSpawnSnapshot.Clear();
+	ClearSpawnIndex();
+	UpdateSpawnArrayGlobals();
+
+	ClearSpawnSearchCache();
+}
+
+static void Spawns_SpawnAdded(SPAWNINFO* pSpawn)
+{
+	if (!gSpawnGrid.Update(pSpawn, pSpawn->X, pSpawn->Y))
+		return;
+
+	float myX, myY;
+	GetSpawnSortOrigin(myX, myY);
+
+	// Keep the array sorted until the next pulse updates it.
+	MQSpawnArrayItem item(pSpawn, GetDistanceSquared(myX, myY, pSpawn->X, pSpawn->Y));
+	gSpawnsArray.insert(
+		std::upper_bound(std::begin(gSpawnsArray), std::end(gSpawnsArray), item, MQRankFloatCompare),
+		item);
+
+	gSpawnSnapshot.Add(pSpawn);
+	IndexSpawn(pSpawn);
+	UpdateSpawnArrayGlobals();
 }
 
 static void Spawns_SpawnRemoved(SPAWNINFO* pSpawn)
 {
+	gSpawnGrid.Remove(pSpawn);
+	gSpawnSnapshot.Remove(pSpawn);
+	UnindexSpawn(pSpawn);
+
 	if (gSpawnsArray.empty())
 		return;
 
@@ -1109,6 +1443,8 @@ static void Spawns_SpawnRemoved(SPAWNINFO* pSpawn)
 		std::remove_if(std::begin(gSpawnsArray), std::end(gSpawnsArray),
 			[pSpawn](const MQSpawnArrayItem& item) { return item.GetSpawn() == pSpawn; }),
 		std::end(gSpawnsArray));
+
+	UpdateSpawnArrayGlobals();
 }
 
 } // namespace mq
@@ -17,14 +17,20 @@
 
 #include "MQ2Mercenaries.h"
 #include "MQ2Utilities.h"
+#include "MQCalculator.h"
 
 #include <mq/api/Items.h>
+#include <mq/base/RingBuffer.h>
+#include <mq/base/SimdFilters.h>
 #include <mq/base/WString.h>
 
 #include <DbgHelp.h>
 #include <PathCch.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <random>
+#include <thread>
 
 #ifdef _DEBUG
 #define DBG_SPEW // enable DebugSpew messages in debug builds
@@ -39,27 +45,244 @@ namespace mq {
 // Description: Outputs text to debugger, usage is same as printf ;)
 //***************************************************************************
 
-static void LogToFile(const char* szOutput)
+// Appends a line to DebugSpew.log, opening and closing the file to do it. Only used when the
+// DebugSpewLog writer isn't running.
+static void WriteDebugSpewFile(std::string_view prefix, std::string_view output)
 {
-	FILE* fOut = nullptr;
-
 	const std::filesystem::path pathDebugSpew = std::filesystem::path(mq::internal_paths::Logs) / "DebugSpew.log";
-	fOut = _fsopen(pathDebugSpew.string().c_str(), "at", _SH_DENYWR);
+	FILE* fOut = _fsopen(pathDebugSpew.string().c_str(), "at", _SH_DENYWR);
 
 	if (!fOut)
 		return;
 
+	fprintf(fOut, "%.*s%.*s\r\n", static_cast<int>(prefix.length()), prefix.data(),
+		static_cast<int>(output.length()), output.data());
+	fclose(fOut);
+}
+
+// Writes the lines for DebugSpew.log on a thread of its own, so that logging to the file doesn't
+// stall whoever is logging. Lines are handed to the writer through a ring buffer that any thread
+// can add to without taking a lock. The writer keeps the file open, and writes and flushes whatever
+// has been queued in one go.
+//
+// If lines come in faster than they can be written and the buffer fills up, new lines are dropped
+// (they still go to the debugger) and the file gets a note saying how many were lost.
+class DebugSpewLog
+{
+public:
+	DebugSpewLog() = default;
+
+	~DebugSpewLog()
+	{
+		// If the process exits without shutting down, the writer thread is already gone.
+		if (m_thread.joinable())
+			m_thread.detach();
+	}
+
+	DebugSpewLog(const DebugSpewLog&) = delete;
+	DebugSpewLog& operator=(const DebugSpewLog&) = delete;
+
+	// Starts the writer, once the log path is known.
+	void Start()
+	{
+		if (m_thread.joinable())
+			return;
+
+		m_path = (std::filesystem::path(mq::internal_paths::Logs) / "DebugSpew.log").string();
+		m_stopping = false;
+		m_thread = std::thread([this]() { Run(); });
+		m_running.store(true, std::memory_order_release);
+	}
+
+	// Writes out everything that was queued and stops the writer.
+	void Stop()
+	{
+		if (!m_thread.joinable())
+			return;
+
+		m_running.store(false);
+
+		// Let lines that got past the check in Write finish queueing, so the writer sees them
+		// before it stops. Anything written after this sees the writer isn't running.
+		while (m_writers.load() != 0)
+			std::this_thread::yield();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+
+		m_wake.notify_one();
+		m_thread.join();
+	}
+
+	// Queues a line for the file. Returns false if the writer isn't running, in which case the line
+	// needs to be written some other way.
+	bool Write(std::string_view prefix, std::string_view output)
+	{
+		ScopedWriter writer(m_writers);
+
+		if (!m_running.load())
+			return false;
+
+		const bool queued = m_queue.TryPush(
+			[&](Entry& entry)
+			{
+				entry.Length = prefix.length() + output.length();
+
+				char* text = entry.Text;
+				if (entry.Length > sizeof(entry.Text))
+				{
+					entry.LongText.resize(entry.Length);
+					text = entry.LongText.data();
+				}
+
+				memcpy(text, prefix.data(), prefix.length());
+				memcpy(text + prefix.length(), output.data(), output.length());
+			});
+
+		if (!queued)
+		{
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		if (m_writerWaiting.load())
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_wake.notify_one();
+		}
+
+		return true;
+	}
+
+private:
+	static constexpr size_t QueueSize = 1024;
+
+	// Counts the threads that are in Write, so that Stop can wait for them.
+	class ScopedWriter
+	{
+	public:
+		explicit ScopedWriter(std::atomic<uint32_t>& writers) : m_writers(writers) { ++m_writers; }
+		~ScopedWriter() { --m_writers; }
+
+		ScopedWriter(const ScopedWriter&) = delete;
+		ScopedWriter& operator=(const ScopedWriter&) = delete;
+
+	private:
+		std::atomic<uint32_t>& m_writers;
+	};
+
+	struct Entry
+	{
+		size_t Length = 0;
+		char Text[488];
+		std::string LongText;                           // lines that don't fit in Text
+	};
+
+	void Run()
+	{
+		FILE* file = nullptr;
+		fmt::memory_buffer buffer;
+
+		for (;;)
+		{
+			bool stopping;
+
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+
+				// Set before checking the queue, so that a line queued after the check wakes us up.
+				m_writerWaiting.store(true);
+				m_wake.wait_for(lock, std::chrono::milliseconds(250),
+					[this]() { return m_stopping || !m_queue.IsEmpty(); });
+				m_writerWaiting.store(false);
+
+				stopping = m_stopping;
+			}
+
+			WriteQueued(file, buffer);
+
+			if (stopping)
+				break;
+		}
+
+		if (file)
+			fclose(file);
+	}
+
+	void WriteQueued(FILE*& file, fmt::memory_buffer& buffer)
+	{
+		buffer.clear();
+
+		if (const uint32_t dropped = m_dropped.exchange(0, std::memory_order_relaxed))
+			fmt::format_to(fmt::appender(buffer), "DebugSpewLog: {} lines were dropped, the log was falling behind\n\r\n", dropped);
+
+		while (m_queue.TryPop(
+			[&buffer](Entry& entry)
+			{
+				const char* text = entry.Length > sizeof(entry.Text) ? entry.LongText.data() : entry.Text;
+				buffer.append(text, text + entry.Length);
+				buffer.append(std::string_view("\r\n"));
+			}))
+		{
+		}
+
+		if (buffer.size() == 0)
+			return;
+
+		// Other clients can write to the file in between batches.
+		if (!file)
+			file = _fsopen(m_path.c_str(), "at", _SH_DENYNO);
+
+		if (file)
+		{
+			fwrite(buffer.data(), 1, buffer.size(), file);
+			fflush(file);
+		}
+	}
+
+	MpscRingBuffer<Entry> m_queue{ QueueSize };
+	std::atomic<uint32_t> m_dropped{ 0 };
+	std::atomic<bool> m_running{ false };
+	std::atomic<uint32_t> m_writers{ 0 };
+	std::atomic<bool> m_writerWaiting{ false };
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_stopping = false;                            // guarded by m_mutex
+	std::thread m_thread;
+	std::string m_path;
+};
+
+static DebugSpewLog s_debugSpewLog;
+
+void InitializeDebugSpewLog()
+{
+	s_debugSpewLog.Start();
+}
+
+void ShutdownDebugSpewLog()
+{
+	s_debugSpewLog.Stop();
+}
+
+static void LogToFile(std::string_view output)
+{
+	std::string_view prefix;
+
 #ifdef DBG_CHARNAME
 	char Name[256] = "Unknown";
 	if (pLocalPC)
 	{
 		strcpy_s(Name, pLocalPC->Name);
 	}
-	fprintf(fOut, "%s - ", Name);
+	strcat_s(Name, " - ");
+	prefix = Name;
 #endif
 
-	fprintf(fOut, "%s\r\n", szOutput);
-	fclose(fOut);
+	if (!s_debugSpewLog.Write(prefix, output))
+		WriteDebugSpewFile(prefix, output);
 }
 
 static void DebugSpewImpl(bool always, bool logToFile, const char* szFormat, va_list vaList)
@@ -67,21 +290,33 @@ static void DebugSpewImpl(bool always, bool logToFile, const char* szFormat, va_
 	if (!always && gFilterDebug)
 		return;
 
-	// _vscprintf doesn't count // terminating '\0'
-	int len = _vscprintf(szFormat, vaList) + 1;
-	size_t theLen = len + 32;
+	// Most lines fit on the stack, longer ones are formatted again into a buffer that fits.
+	char szBuffer[MAX_STRING];
+	char* szOutput = szBuffer;
+	std::unique_ptr<char[]> longOutput;
 
-	auto out = std::make_unique<char[]>(theLen);
-	char* szOutput = out.get();
+	va_list vaCopy;
+	va_copy(vaCopy, vaList);
+	int len = vsnprintf(szBuffer, sizeof(szBuffer) - 1, szFormat, vaCopy);
+	va_end(vaCopy);
 
-	vsprintf_s(szOutput, theLen, szFormat, vaList);
+	if (len < 0)
+		return;
+
+	if (static_cast<size_t>(len) >= sizeof(szBuffer) - 1)
+	{
+		longOutput = std::make_unique<char[]>(len + 2);
+		szOutput = longOutput.get();
+		vsnprintf(szOutput, len + 1, szFormat, vaList);
+	}
 
-	strcat_s(szOutput, theLen, "\n");
+	szOutput[len] = '\n';
+	szOutput[len + 1] = '\0';
 	OutputDebugString(szOutput);
 
 	if (logToFile)
 	{
-		LogToFile(szOutput);
+		LogToFile(std::string_view(szOutput, len + 1));
 	}
 }
 
@@ -1729,6 +1964,8 @@ void ClearSearchSpawn(MQSpawnSearch* pSearchSpawn)
 
 	*pSearchSpawn = MQSpawnSearch();
 
+	// z is where the player is until the search gives one
+	pSearchSpawn->bKnownZ = false;
 	if (pControlledPlayer)
 		pSearchSpawn->zLoc = pControlledPlayer->Z;
 	else if (pLocalPlayer)
@@ -1988,601 +2225,172 @@ bool LoadCfgFile(const char* Filename, bool Delayed)
 	return false;
 }
 
-enum eCalcOp
-{
-	CO_NUMBER = 0,
-	CO_OPENPARENS = 1,
-	CO_CLOSEPARENS = 2,
-	CO_ADD = 3,
-	CO_SUBTRACT = 4,
-	CO_MULTIPLY = 5,
-	CO_DIVIDE = 6,
-	CO_IDIVIDE = 7,
-	CO_LAND = 8,
-	CO_AND = 9,
-	CO_LOR = 10,
-	CO_OR = 11,
-	CO_XOR = 12,
-	CO_EQUAL = 13,
-	CO_NOTEQUAL = 14,
-	CO_GREATER = 15,
-	CO_NOTGREATER = 16,
-	CO_LESS = 17,
-	CO_NOTLESS = 18,
-	CO_MODULUS = 19,
-	CO_POWER = 20,
-	CO_LNOT = 21,
-	CO_NOT = 22,
-	CO_SHL = 23,
-	CO_SHR = 24,
-	CO_NEGATE = 25,
-	CO_TOTAL = 26,
-};
-
-int CalcOpPrecedence[CO_TOTAL] =
-{
-	0,
-	0,
-	0,
-	9,    // add
-	9,    // subtract
-	10,   // multiply
-	10,   // divide
-	10,   // integer divide
-	2,    // logical and
-	5,    // bitwise and
-	1,    // logical or
-	3,    // bitwise or
-	4,    // bitwise xor
-	6,    // equal
-	6,    // not equal
-	7,    // greater
-	7,    // not greater
-	7,    // less
-	7,    // not less
-	10,   // modulus
-	11,   // power
-	12,   // logical not
-	12,   // bitwise not
-	8,    // shl
-	8,    // shr
-	12,   // negate
-};
+void ReportCalculateError(const char* szMessage)
+{
+	FatalError("%s", szMessage);
+}
 
-struct CalcOp
+bool Calculate(const char* szFormula, double& Result)
 {
-	eCalcOp Op;
-	double Value;
-};
+	char Buffer[MAX_STRING] = { 0 };
+	PrepareFormula(szFormula, Buffer, MAX_STRING);
+
+	bool Ret;
+	Benchmark(bmCalculate, Ret = CompiledCalculate(Buffer, Result));
+	return Ret;
+}
 
-bool EvaluateRPN(CalcOp* pList, int Size, double& Result)
+// Compares FastCalculate against the compiled formulas on a set of typical macro conditions.
+void BenchmarkCalculate(int iterations)
 {
-	if (!Size)
-		return false;
+	iterations = std::max(iterations, 1);
+
+	auto runPass = [&](bool compiled)
+	{
+		double total = 0;
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < iterations; ++i)
+		{
+			for (size_t formula = 0; formula < CalculateBenchmarkFormulaCount; ++formula)
+			{
+				char Buffer[MAX_STRING];
+				PrepareFormula(CalculateBenchmarkFormulas[formula], Buffer, MAX_STRING);
+
+				double Result = 0;
+				if (compiled ? CompiledCalculate(Buffer, Result) : FastCalculate(Buffer, Result))
+					total += Result;
+			}
+		}
+
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+		return std::make_pair(elapsed, total);
+	};
+
+	auto [fastTime, fastTotal] = runPass(false);
+	auto [compiledTime, compiledTotal] = runPass(true);
 
-	std::unique_ptr<double[]> stackPtr = std::make_unique<double[]>(Size / 2 + 2);
-	double* pStack = stackPtr.get();
+	const double count = static_cast<double>(iterations) * CalculateBenchmarkFormulaCount;
 
-	int nStack = 0;
+	WriteChatf("Calculate: \at%d\ax formulas x \at%d\ax iterations", static_cast<int>(CalculateBenchmarkFormulaCount), iterations);
+	WriteChatf("  FastCalculate: \at%.3f\axms (\at%.3f\axus per call)",
+		fastTime.count() / 1000.0, fastTime.count() / count);
+	WriteChatf("  Compiled:      \at%.3f\axms (\at%.3f\axus per call)",
+		compiledTime.count() / 1000.0, compiledTime.count() / count);
 
-#define StackEmpty()           (nStack==0)
-#define StackTop()             (pStack[nStack])
-#define StackSetTop(do_assign) {pStack[nStack]##do_assign;}
-#define StackPush(val)         {nStack++;pStack[nStack]=val;}
-#define StackPop()             {if (!nStack) {FatalError("Illegal arithmetic in calculation"); return 0;}; nStack--;}
+	if (fastTotal != compiledTotal)
+		WriteChatf("\arResults differ: %f vs %f", fastTotal, compiledTotal);
+}
 
-#define BinaryIntOp(op)        {int RightSide=(int)StackTop();StackPop();StackSetTop(=(double)(((int)StackTop())##op##RightSide));}
-#define BinaryOp(op)           {double RightSide=StackTop();StackPop();StackSetTop(=StackTop()##op##RightSide);}
-#define BinaryAssign(op)       {double RightSide=StackTop();StackPop();StackSetTop(##op##=RightSide);}
+bool PlayerHasAAAbility(int AAIndex)
+{
+	for (int i = 0; i < AA_CHAR_MAX_REAL; i++)
+	{
+		if (pLocalPC->GetAlternateAbilityId(i) == AAIndex)
+			return true;
+	}
+	return false;
+}
 
-#define UnaryIntOp(op)         {StackSetTop(=op##((int)StackTop()));}
-#define UnaryOp(op)            {StackSetTop(=op##(StackTop()));}
+int GetAAIndexByName(const char* AAName)
+{
+	int level = pLocalPlayer ? pLocalPlayer->Level : -1;
 
-	for (int i = 0; i < Size; i++)
+	// check bought aa's first
+	for (int nAbility = 0; nAbility < AA_CHAR_MAX_REAL; nAbility++)
 	{
-		switch (pList[i].Op)
+		if (CAltAbilityData* pAbility = GetAAById(pLocalPC->GetAlternateAbilityId(nAbility), level))
 		{
-		case CO_NUMBER:
-			StackPush(pList[i].Value);
-			break;
-		case CO_ADD:
-			BinaryAssign(+);
-			break;
-		case CO_MULTIPLY:
-			BinaryAssign(*);
-			break;
-		case CO_SUBTRACT:
-			BinaryAssign(-);
-			break;
-		case CO_NEGATE:
-			UnaryOp(-);
-			break;
-		case CO_DIVIDE:
-			if (StackTop())
-			{
-				BinaryAssign(/ );
-			}
-			else
+			if (const char* pName = pCDBStr->GetString(pAbility->nName, eAltAbilityName))
 			{
-				//printf("Divide by zero error\n");
-				FatalError("Divide by zero in calculation");
-				return false;
+				if (!_stricmp(AAName, pName))
+				{
+					return pAbility->Index;
+				}
 			}
-			break;
+		}
+	}
 
-		case CO_IDIVIDE://TODO: SPECIAL HANDLING
+	// not found? fine lets check them all then...
+	for (int nAbility = 0; nAbility < NUM_ALT_ABILITIES; nAbility++)
+	{
+		if (CAltAbilityData* pAbility = GetAAById(nAbility, level))
 		{
-			int Right = (int)StackTop();
-			if (Right)
-			{
-				StackPop();
-				int Left = (int)StackTop();
-				Left /= Right;
-				StackSetTop(= Left);
-			}
-			else
+			if (const char* pName = pCDBStr->GetString(pAbility->nName, eAltAbilityName))
 			{
-				//printf("Integer divide by zero error\n");
-				FatalError("Divide by zero in calculation");
-				return false;
+				if (!_stricmp(AAName, pName))
+				{
+					return pAbility->Index;
+				}
 			}
 		}
-		break;
+	}
 
-		case CO_MODULUS://TODO: SPECIAL HANDLING
+	return 0;
+}
+
+int GetAAIndexByID(int ID)
+{
+	// check our bought aa's first
+	for (int nAbility = 0; nAbility < AA_CHAR_MAX_REAL; nAbility++)
+	{
+		if (CAltAbilityData* pAbility = GetAAById(pLocalPC->GetAlternateAbilityId(nAbility)))
 		{
-			int Right = (int)StackTop();
-			if (Right)
-			{
-				StackPop();
-				int Left = (int)StackTop();
-				Left %= Right;
-				StackSetTop(= Left);
-			}
-			else
+			if (pAbility->ID == ID)
 			{
-				//printf("Modulus by zero error\n");
-				FatalError("Modulus by zero in calculation");
-				return false;
+				return pAbility->Index;
 			}
 		}
-		break;
+	}
 
-		case CO_LAND:
-			BinaryOp(&&);
-			break;
-		case CO_LOR:
-			BinaryOp(|| );
-			break;
-		case CO_EQUAL:
-			BinaryOp(== );
-			break;
-		case CO_NOTEQUAL:
-			BinaryOp(!= );
-			break;
-		case CO_GREATER:
-			BinaryOp(> );
-			break;
-		case CO_NOTGREATER:
-			BinaryOp(<= );
-			break;
-		case CO_LESS:
-			BinaryOp(< );
-			break;
-		case CO_NOTLESS:
-			BinaryOp(>= );
-			break;
-		case CO_SHL:
-			BinaryIntOp(<< );
-			break;
-		case CO_SHR:
-			BinaryIntOp(>> );
-			break;
-		case CO_AND:
-			BinaryIntOp(&);
-			break;
-		case CO_OR:
-			BinaryIntOp(| );
-			break;
-		case CO_XOR:
-			BinaryIntOp(^);
-			break;
-		case CO_LNOT:
-			UnaryIntOp(!);
-			break;
-		case CO_NOT:
-			UnaryIntOp(~);
-			break;
-		case CO_POWER:
+	// didnt find it? fine we go through them all then...
+	for (int nAbility = 0; nAbility < NUM_ALT_ABILITIES; nAbility++)
+	{
+		if (CAltAbilityData* pAbility = GetAAById(nAbility))
 		{
-			double RightSide = StackTop();
-			StackPop();
-			StackSetTop(= pow(StackTop(), RightSide));
-		}
-		break;
+			if (pAbility->ID == ID)
+			{
+				return pAbility->Index;
+			}
 		}
 	}
 
-	Result = StackTop();
-
-#undef StackEmpty
-#undef StackTop
-#undef StackPush
-#undef StackPop
+	return 0;
+}
 
-	return true;
+bool IsPCNear(SPAWNINFO* pSpawn, float Radius)
+{
+	SPAWNINFO* pClose = pSpawnList;
+	while (pClose)
+	{
+		if (!IsInGroup(pClose) && (pClose->Type == SPAWN_PLAYER))
+		{
+			if ((pClose != pSpawn) && (Distance3DToSpawn(pClose, pSpawn) < Radius))
+				return true;
+		}
+		pClose = pClose->pNext;
+	}
+	return false;
 }
 
-bool FastCalculate(char* szFormula, double& Result)
+/*
+ * Returns group member including self
+ */
+bool IsInGroup(SPAWNINFO* pSpawn, bool bCorpse /* = false */)
 {
-	//DebugSpew("FastCalculate(%s)",szFormula);
-	if (!szFormula || !szFormula[0])
+	if (pSpawn == nullptr)
 		return false;
 
-	int Length = (int)strlen(szFormula);
-	int MaxOps = (Length + 1);
-
-	std::unique_ptr<CalcOp[]> OpsList = std::make_unique<CalcOp[]>(MaxOps);
-	CalcOp* pOpList = OpsList.get();
-	memset(pOpList, 0, sizeof(CalcOp) * MaxOps);
-
-	std::unique_ptr<eCalcOp[]> Stack = std::make_unique<eCalcOp[]>(MaxOps);
-	eCalcOp* pStack = Stack.get();
-	memset(pStack, 0, sizeof(eCalcOp) * MaxOps);
-
-	int nOps = 0;
-	int nStack = 0;
-	char* pEnd = szFormula + Length;
-	char CurrentToken[MAX_STRING] = { 0 };
-	char* pToken = &CurrentToken[0];
-
-#define OpToList(op)         { pOpList[nOps].Op = op; nOps++; }
-#define ValueToList(val)     { pOpList[nOps].Value = val; nOps++; }
-#define StackEmpty()         (nStack == 0)
-#define StackTop()           (pStack[nStack])
-#define StackPush(op)        { nStack++; pStack[nStack] = op; }
-#define StackPop()           { if (!nStack) { FatalError("Illegal arithmetic in calculation"); return 0; } nStack--;}
-#define HasPrecedence(a,b)   ( CalcOpPrecedence[a] >= CalcOpPrecedence[b])
-#define MoveStack(op) {                                                                        \
-	while (!StackEmpty() && StackTop() != CO_OPENPARENS && HasPrecedence(StackTop(), op)) {    \
-		OpToList(StackTop());                                                                  \
-		StackPop();                                                                            \
-	}                                                                                          \
-}
-#define FinishString()       { if (pToken != &CurrentToken[0]) { *pToken = 0; ValueToList(GetDoubleFromString(CurrentToken, 0)); pToken = &CurrentToken[0]; *pToken=0; }}
-#define NewOp(op)            { FinishString(); MoveStack(op); StackPush(op); }
-#define NextChar(ch)         { *pToken = ch; pToken++; }
-
-	bool WasParen = false;
-	for (char* pCur = szFormula; pCur < pEnd; pCur++)
-	{
-		switch (*pCur)
-		{
-		case ' ':
-			continue;
-		case '(':
-			FinishString();
-			StackPush(CO_OPENPARENS);
-			break;
-		case ')':
-			FinishString();
-			while (StackTop() != CO_OPENPARENS)
-			{
-				OpToList(StackTop());
-				StackPop();
-			}
-			StackPop();
-			WasParen = true;
-			continue;
-		case '+':
-			if (pCur[1] != '+')
-				NewOp(CO_ADD);
-			break;
-		case '-':
-			if (pCur[1] == '-')
-			{
-				pCur++;
-				NewOp(CO_ADD);
-			}
-			else
-			{
-				if (CurrentToken[0] || WasParen)
-				{
-					NewOp(CO_SUBTRACT);
-				}
-				else
-					NewOp(CO_NEGATE);
-			}
-			break;
-		case '*':
-			NewOp(CO_MULTIPLY);
-			break;
-		case '\\':
-			NewOp(CO_IDIVIDE);
-			break;
-		case '/':
-			NewOp(CO_DIVIDE);
-			break;
-		case '|':
-			if (pCur[1] == '|')
-			{
-				// Logical OR
-				++pCur;
-				NewOp(CO_LOR);
-			}
-			else
-			{
-				// Bitwise OR
-				NewOp(CO_OR);
-			}
-			break;
-		case '%':
-			NewOp(CO_MODULUS);
-			break;
-		case '~':
-			NewOp(CO_NOT);
-			break;
-		case '&':
-			if (pCur[1] == '&')
-			{
-				// Logical AND
-				++pCur;
-				NewOp(CO_LAND);
-			}
-			else
-			{
-				// Bitwise AND
-				NewOp(CO_AND);
-			}
-			break;
-		case '^':
-			if (pCur[1] == '^')
-			{
-				// XOR
-				++pCur;
-				NewOp(CO_XOR);
-			}
-			else
-			{
-				// POWER
-				NewOp(CO_POWER);
-			}
-			break;
-		case '!':
-			if (pCur[1] == '=')
-			{
-				++pCur;
-				NewOp(CO_NOTEQUAL);
-			}
-			else
-			{
-				NewOp(CO_LNOT);
-			}
-			break;
-		case '=':
-			if (pCur[1] == '=')
-			{
-				++pCur;
-				NewOp(CO_EQUAL);
-			}
-			else
-			{
-				//printf("Unparsable: '%c'\n",*pCur);
-				// error
-				return false;
-			}
-			break;
-		case '<':
-			if (pCur[1] == '=')
-			{
-				++pCur;
-				NewOp(CO_NOTGREATER);
-			}
-			else if (pCur[1] == '<')
-			{
-				++pCur;
-				NewOp(CO_SHL);
-			}
-			else
-			{
-				NewOp(CO_LESS);
-			}
-			break;
-		case '>':
-			if (pCur[1] == '=')
-			{
-				++pCur;
-				NewOp(CO_NOTLESS);
-			}
-			else if (pCur[1] == '>')
-			{
-				++pCur;
-				NewOp(CO_SHR);
-			}
-			else
-			{
-				NewOp(CO_GREATER);
-			}
-			break;
-		case '.':
-		case '1':
-		case '2':
-		case '3':
-		case '4':
-		case '5':
-		case '6':
-		case '7':
-		case '8':
-		case '9':
-		case '0':
-			NextChar(*pCur);
-			break;
-		default:
-		{
-			//printf("Unparsable: '%c'\n",*pCur);
-			FatalError("Unparsable in Calculation: '%c'", *pCur);
-			// unparsable
-			return false;
-		}
-		}
-		WasParen = false;
-	}
-	FinishString();
-
-	while (!StackEmpty())
-	{
-		OpToList(StackTop());
-		StackPop();
-	}
-
-	return EvaluateRPN(pOpList, nOps, Result);
-}
-
-bool Calculate(const char* szFormula, double& Result)
-{
-	char Buffer[MAX_STRING] = { 0 };
-	strcpy_s(Buffer, szFormula);
-	_strupr_s(Buffer);
-
-	while (char* pNull = strstr(Buffer, "NULL"))
-	{
-		pNull[0] = '0';
-		pNull[1] = '.';
-		pNull[2] = '0';
-		pNull[3] = '0';
-	}
-
-	while (char* pTrue = strstr(Buffer, "TRUE"))
-	{
-		pTrue[0] = '1';
-		pTrue[1] = '.';
-		pTrue[2] = '0';
-		pTrue[3] = '0';
-	}
-
-	while (char* pFalse = strstr(Buffer, "FALSE"))
-	{
-		pFalse[0] = '0';
-		pFalse[1] = '.';
-		pFalse[2] = '0';
-		pFalse[3] = '0';
-		pFalse[4] = '0';
-	}
-
-	bool Ret;
-	Benchmark(bmCalculate, Ret = FastCalculate(Buffer, Result));
-	return Ret;
-}
-
-bool PlayerHasAAAbility(int AAIndex)
-{
-	for (int i = 0; i < AA_CHAR_MAX_REAL; i++)
-	{
-		if (pLocalPC->GetAlternateAbilityId(i) == AAIndex)
-			return true;
-	}
-	return false;
-}
-
-int GetAAIndexByName(const char* AAName)
-{
-	int level = pLocalPlayer ? pLocalPlayer->Level : -1;
-
-	// check bought aa's first
-	for (int nAbility = 0; nAbility < AA_CHAR_MAX_REAL; nAbility++)
-	{
-		if (CAltAbilityData* pAbility = GetAAById(pLocalPC->GetAlternateAbilityId(nAbility), level))
-		{
-			if (const char* pName = pCDBStr->GetString(pAbility->nName, eAltAbilityName))
-			{
-				if (!_stricmp(AAName, pName))
-				{
-					return pAbility->Index;
-				}
-			}
-		}
-	}
-
-	// not found? fine lets check them all then...
-	for (int nAbility = 0; nAbility < NUM_ALT_ABILITIES; nAbility++)
-	{
-		if (CAltAbilityData* pAbility = GetAAById(nAbility, level))
-		{
-			if (const char* pName = pCDBStr->GetString(pAbility->nName, eAltAbilityName))
-			{
-				if (!_stricmp(AAName, pName))
-				{
-					return pAbility->Index;
-				}
-			}
-		}
-	}
-
-	return 0;
-}
-
-int GetAAIndexByID(int ID)
-{
-	// check our bought aa's first
-	for (int nAbility = 0; nAbility < AA_CHAR_MAX_REAL; nAbility++)
-	{
-		if (CAltAbilityData* pAbility = GetAAById(pLocalPC->GetAlternateAbilityId(nAbility)))
-		{
-			if (pAbility->ID == ID)
-			{
-				return pAbility->Index;
-			}
-		}
-	}
-
-	// didnt find it? fine we go through them all then...
-	for (int nAbility = 0; nAbility < NUM_ALT_ABILITIES; nAbility++)
-	{
-		if (CAltAbilityData* pAbility = GetAAById(nAbility))
-		{
-			if (pAbility->ID == ID)
-			{
-				return pAbility->Index;
-			}
-		}
-	}
-
-	return 0;
-}
-
-bool IsPCNear(SPAWNINFO* pSpawn, float Radius)
-{
-	SPAWNINFO* pClose = pSpawnList;
-	while (pClose)
-	{
-		if (!IsInGroup(pClose) && (pClose->Type == SPAWN_PLAYER))
-		{
-			if ((pClose != pSpawn) && (Distance3DToSpawn(pClose, pSpawn) < Radius))
-				return true;
-		}
-		pClose = pClose->pNext;
-	}
-	return false;
-}
-
-/*
- * Returns group member including self
- */
-bool IsInGroup(SPAWNINFO* pSpawn, bool bCorpse /* = false */)
-{
-	if (pSpawn == nullptr)
-		return false;
-
-	if (!pLocalPC->Group)
-		return false;
-	if (pSpawn == pLocalPC->pSpawn)
-		return true;
-
-	for (int i = 1; i < MAX_GROUP_SIZE; i++)
-	{
-		if (CGroupMember* pMember = pLocalPC->Group->GetGroupMember(i))
-		{
-			if (!bCorpse)
+	if (!pLocalPC->Group)
+		return false;
+	if (pSpawn == pLocalPC->pSpawn)
+		return true;
+
+	for (int i = 1; i < MAX_GROUP_SIZE; i++)
+	{
+		if (CGroupMember* pMember = pLocalPC->Group->GetGroupMember(i))
+		{
+			if (!bCorpse)
 			{
 				if (!_stricmp(pMember->GetName(), pSpawn->Name))
 				{
@@ -2951,84 +2759,186 @@ char* FormatSearchSpawn(char* Buffer, size_t BufferSize, MQSpawnSearch* pSearchS
 	return Buffer;
 }
 
-SPAWNINFO* NthNearestSpawn(MQSpawnSearch* pSearchSpawn, int Nth, SPAWNINFO* pOrigin, bool IncludeOrigin)
+// A search with a radius can only match the spawns near the center of the search, which can be
+// found in gSpawnGrid. Returns false if the radius is too large for that to be worth it.
+static bool GetSearchArea(const MQSpawnSearchProgram& search, SPAWNINFO* pOrigin, float& x, float& y, float& radius)
 {
-	if (!pSearchSpawn || Nth == 0 || !pOrigin)
-		return nullptr;
+	if (search.GetRadius() >= 10000.0f)
+		return false;
+
+	if (search.HasKnownLocation())
+	{
+		x = search.GetX();
+		y = search.GetY();
+	}
+	else
+	{
+		x = pOrigin->X;
+		y = pOrigin->Y;
+	}
+
+	// The radius is 3d, so anything within it is also within it in 2d.
+	radius = (std::max)(static_cast<float>(search.GetRadius()), 0.0f);
 
-	std::vector<MQSpawnArrayItem> spawnSet;
-	spawnSet.reserve(gSpawnsArray.size());
+	return gSpawnGrid.CellsInRadius(radius) < gSpawnGrid.size();
+}
 
-	for (const MQSpawnArrayItem& item : gSpawnsArray)
+// Calls visit(SPAWNINFO*) for the spawns in gSpawnSnapshot that are in the level range and radius of
+// the search. The snapshot can be a pulse old, so the radius is widened by the slack of gSpawnGrid,
+// and every spawn still has to be matched against the search.
+template <typename Visit>
+static void ForEachSnapshotCandidate(const MQSpawnSearchProgram& search, SPAWNINFO* pOrigin, Visit&& visit)
+{
+	const size_t count = gSpawnSnapshot.size();
+
+	// Not shared between calls, matching a spawn can start another search.
+	std::vector<uint8_t> candidates(count, 1);
+
+	if (search.GetMinLevel() > 0 || search.GetMaxLevel() != 0)
+	{
+		const int minLevel = (std::max)(search.GetMinLevel(), 0);
+		const int maxLevel = search.GetMaxLevel() != 0 ? (std::min)(search.GetMaxLevel(), 255) : 255;
+		if (minLevel > maxLevel)
+			return;
+
+		FilterInRange(gSpawnSnapshot.Level.data(), count, static_cast<uint8_t>(minLevel),
+			static_cast<uint8_t>(maxLevel), candidates.data());
+	}
+
+	if (search.GetRadius() < 10000.0f)
+	{
+		const float x = search.HasKnownLocation() ? search.GetX() : pOrigin->X;
+		const float y = search.HasKnownLocation() ? search.GetY() : pOrigin->Y;
+		const float reach = (std::max)(static_cast<float>(search.GetRadius()), 0.0f) + gSpawnGrid.GetSlack();
+
+		FilterWithinDistance(gSpawnSnapshot.X.data(), gSpawnSnapshot.Y.data(), count, x, y,
+			reach * reach, candidates.data());
+	}
+
+	for (size_t i = 0; i < count && i < gSpawnSnapshot.size(); ++i)
 	{
-		SPAWNINFO* pSpawn = item.GetSpawn();
+		if (candidates[i] && gSpawnSnapshot.Spawns[i])
+			visit(gSpawnSnapshot.Spawns[i]);
+	}
+}
+
+SPAWNINFO* NthNearestSpawn(const MQSpawnSearchProgram& search, int Nth, SPAWNINFO* pOrigin, bool IncludeOrigin)
+{
+	if (Nth < 1 || !pOrigin)
+		return nullptr;
 
+	// The Nth nearest matches so far, the farthest of them on top. Anything that isn't closer than
+	// that can be skipped without checking if it matches.
+	std::vector<MQSpawnArrayItem> nearest;
+	nearest.reserve((std::min)(static_cast<size_t>(Nth), gSpawnsArray.size()));
+
+	auto visit = [&](SPAWNINFO* pSpawn)
+	{
 		if (!IncludeOrigin && pSpawn == pOrigin)
-			continue;
+			return;
 
-		if (SpawnMatchesSearch(pSearchSpawn, pOrigin, pSpawn))
-		{
-			float distSq = Get3DDistanceSquared(pOrigin->X, pOrigin->Y, pOrigin->Z,
-				pSpawn->X, pSpawn->Y, pSpawn->Z);
+		float distSq = Get3DDistanceSquared(pOrigin->X, pOrigin->Y, pOrigin->Z,
+			pSpawn->X, pSpawn->Y, pSpawn->Z);
+
+		if (static_cast<int>(nearest.size()) == Nth && distSq >= nearest.front().GetDistanceSquared())
+			return;
+
+		if (!search.Matches(pOrigin, pSpawn))
+			return;
 
-			// Spawn matches our search, add it to our set.
-			spawnSet.emplace_back(pSpawn, distSq);
+		if (static_cast<int>(nearest.size()) == Nth)
+		{
+			std::pop_heap(std::begin(nearest), std::end(nearest), MQRankFloatCompare);
+			nearest.pop_back();
 		}
+
+		nearest.emplace_back(pSpawn, distSq);
+		std::push_heap(std::begin(nearest), std::end(nearest), MQRankFloatCompare);
+	};
+
+	float x, y, radius;
+	if (!GetSearchArea(search, pOrigin, x, y, radius))
+	{
+		ForEachSnapshotCandidate(search, pOrigin, visit);
+	}
+	else if (search.HasKnownLocation())
+	{
+		// Centered somewhere other than the origin, so the order of the cells doesn't help.
+		gSpawnGrid.ForEachInRadius(x, y, radius, visit);
+	}
+	else
+	{
+		// Stop once nothing that is left can be closer than the Nth nearest match.
+		gSpawnGrid.ForEachByDistance(x, y, radius, visit,
+			[&](float distance)
+			{
+				return static_cast<int>(nearest.size()) == Nth
+					&& nearest.front().GetDistanceSquared() <= distance * distance;
+			});
 	}
 
-	if (Nth > static_cast<int>(spawnSet.size()))
+	if (Nth > static_cast<int>(nearest.size()))
 	{
 		return nullptr;
 	}
 
-	// sort our list
-	std::sort(std::begin(spawnSet), std::end(spawnSet), MQRankFloatCompare);
-
 	// get our Nth nearest
-	return spawnSet[Nth - 1].GetSpawn();
+	return nearest.front().GetSpawn();
 }
 
-int CountMatchingSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pOrigin, bool IncludeOrigin)
+SPAWNINFO* NthNearestSpawn(MQSpawnSearch* pSearchSpawn, int Nth, SPAWNINFO* pOrigin, bool IncludeOrigin)
 {
-	if (!pSearchSpawn || !pOrigin)
+	if (!pSearchSpawn || Nth < 1 || !pOrigin)
+		return nullptr;
+
+	return NthNearestSpawn(MQSpawnSearchProgram(*pSearchSpawn), Nth, pOrigin, IncludeOrigin);
+}
+
+int CountMatchingSpawns(const MQSpawnSearchProgram& search, SPAWNINFO* pOrigin, bool IncludeOrigin)
+{
+	if (!pOrigin)
 		return 0;
 
 	int TotalMatching = 0;
-	SPAWNINFO* pSpawn = pSpawnList;
 
-	if (IncludeOrigin)
+	float x, y, radius;
+	if (GetSearchArea(search, pOrigin, x, y, radius))
 	{
-		while (pSpawn)
-		{
-			if (SpawnMatchesSearch(pSearchSpawn, pOrigin, pSpawn))
+		gSpawnGrid.ForEachInRadius(x, y, radius,
+			[&](SPAWNINFO* pSpawn)
 			{
-				TotalMatching++;
-			}
-			pSpawn = pSpawn->pNext;
-		}
+				if ((IncludeOrigin || pSpawn != pOrigin) && search.Matches(pOrigin, pSpawn))
+					TotalMatching++;
+			});
+
+		return TotalMatching;
 	}
-	else
-	{
-		while (pSpawn)
+
+	ForEachSnapshotCandidate(search, pOrigin,
+		[&](SPAWNINFO* pSpawn)
 		{
-			if (pSpawn != pOrigin && SpawnMatchesSearch(pSearchSpawn, pOrigin, pSpawn))
-			{
-				// matches search, add to our set
+			if ((IncludeOrigin || pSpawn != pOrigin) && search.Matches(pOrigin, pSpawn))
 				TotalMatching++;
-			}
-			pSpawn = pSpawn->pNext;
-		}
-	}
+		});
+
 	return TotalMatching;
 }
 
-SPAWNINFO* SearchThroughSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar)
+int CountMatchingSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pOrigin, bool IncludeOrigin)
+{
+	if (!pSearchSpawn || !pOrigin)
+		return 0;
+
+	return CountMatchingSpawns(MQSpawnSearchProgram(*pSearchSpawn), pOrigin, IncludeOrigin);
+}
+
+SPAWNINFO* SearchThroughSpawns(const MQSpawnSearchProgram& search, SPAWNINFO* pChar)
 {
 	SPAWNINFO* pFromSpawn = nullptr;
 
-	if (pSearchSpawn->FromSpawnID > 0 && (pSearchSpawn->bTargNext || pSearchSpawn->bTargPrev))
+	if (search.GetFromSpawnID() > 0 && (search.IsTargNext() || search.IsTargPrev()))
 	{
-		pFromSpawn = GetSpawnByID(pSearchSpawn->FromSpawnID);
+		pFromSpawn = GetSpawnByID(search.GetFromSpawnID());
 		if (!pFromSpawn) return nullptr;
 		for (int index = 0; index < (int)gSpawnsArray.size(); index++)
 		{
@@ -3036,7 +2946,7 @@ SPAWNINFO* SearchThroughSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar)
 
 			if (item.GetSpawn() == pFromSpawn)
 			{
-				if (pSearchSpawn->bTargPrev)
+				if (search.IsTargPrev())
 				{
 					index--;
 					for (; index >= 0; index--)
@@ -3044,7 +2954,7 @@ SPAWNINFO* SearchThroughSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar)
 						SPAWNINFO* pPrevSpawn = gSpawnsArray[index].GetSpawn();
 
 						if (pPrevSpawn
-							&& SpawnMatchesSearch(pSearchSpawn, pFromSpawn, pPrevSpawn))
+							&& search.Matches(pFromSpawn, pPrevSpawn))
 						{
 							return pPrevSpawn;
 						}
@@ -3058,7 +2968,7 @@ SPAWNINFO* SearchThroughSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar)
 						SPAWNINFO* pNextSpawn = gSpawnsArray[index].GetSpawn();
 
 						if (pNextSpawn
-							&& SpawnMatchesSearch(pSearchSpawn, pFromSpawn, pNextSpawn))
+							&& search.Matches(pFromSpawn, pNextSpawn))
 						{
 							return pNextSpawn;
 						}
@@ -3069,7 +2979,84 @@ SPAWNINFO* SearchThroughSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar)
 		}
 	}
 
-	return NthNearestSpawn(pSearchSpawn, 1, pChar, true);
+	return NthNearestSpawn(search, 1, pChar, true);
+}
+
+SPAWNINFO* SearchThroughSpawns(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar)
+{
+	return SearchThroughSpawns(MQSpawnSearchProgram(*pSearchSpawn), pChar);
+}
+
+//----------------------------------------------------------------------------
+// Compiled spawn searches, by search text. The spawn TLOs parse the same few searches every
+// time a macro line runs, so they are parsed and compiled once and kept until the next zone.
+
+struct CachedSpawnSearch
+{
+	MQSpawnSearchProgram Program;
+	bool KnownZ;
+	int64_t LocalGuildID;                          // "guild" is the guild we were in when parsed
+};
+
+static std::map<double, std::map<std::string, CachedSpawnSearch, std::less<>>> s_spawnSearchCache;
+static size_t s_spawnSearchCacheSize = 0;
+static constexpr size_t MaxCachedSpawnSearches = 1024;
+
+void ClearSpawnSearchCache()
+{
+	s_spawnSearchCache.clear();
+	s_spawnSearchCacheSize = 0;
+}
+
+const MQSpawnSearchProgram& GetSpawnSearchProgram(std::string_view search, double defaultRadius)
+{
+	// ParseSearchSpawn does this, even when the search doesn't need to be parsed.
+	bRunNextCommand = true;
+
+	const int64_t localGuildID = pLocalPC ? pLocalPC->GuildID : 0;
+
+	auto& searches = s_spawnSearchCache[defaultRadius];
+	auto iter = searches.find(search);
+
+	if (iter == std::end(searches) || iter->second.LocalGuildID != localGuildID)
+	{
+		if (iter != std::end(searches))
+		{
+			searches.erase(iter);
+			--s_spawnSearchCacheSize;
+		}
+		else if (s_spawnSearchCacheSize >= MaxCachedSpawnSearches)
+		{
+			// Something is generating a lot of different searches, start over rather than keep them all.
+			for (auto& [radius, cached] : s_spawnSearchCache)
+				cached.clear();
+			s_spawnSearchCacheSize = 0;
+		}
+
+		std::string text{ search };
+
+		MQSpawnSearch ssSpawn;
+		ClearSearchSpawn(&ssSpawn);
+		ssSpawn.FRadius = defaultRadius;
+		ParseSearchSpawn(text.c_str(), &ssSpawn);
+
+		iter = searches.emplace(std::move(text),
+			CachedSpawnSearch{ MQSpawnSearchProgram(ssSpawn), ssSpawn.bKnownZ, localGuildID }).first;
+		++s_spawnSearchCacheSize;
+	}
+
+	CachedSpawnSearch& cached = iter->second;
+
+	// Without a z in the search, z is wherever we are now.
+	if (!cached.KnownZ)
+	{
+		if (pControlledPlayer)
+			cached.Program.SetZ(pControlledPlayer->Z);
+		else if (pLocalPlayer)
+			cached.Program.SetZ(pLocalPlayer->Z);
+	}
+
+	return cached.Program;
 }
 
 bool SearchSpawnMatchesSearchSpawn(MQSpawnSearch* pSearchSpawn1, MQSpawnSearch* pSearchSpawn2)
@@ -3188,58 +3175,288 @@ bool SearchSpawnMatchesSearchSpawn(MQSpawnSearch* pSearchSpawn1, MQSpawnSearch*
 	return true;
 }
 
-bool SpawnMatchesSearch(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar, SPAWNINFO* pSpawn)
+enum class MQSpawnSearchProgram::Op : uint8_t
+{
+	// Fields of the spawn
+	SpawnID,
+	NotID,
+	Type,
+	MinLevel,
+	MaxLevel,
+	Guild,
+	NoGuild,
+	LFG,
+	Trader,
+	PlayerState,
+	GM,
+	NpcGM,
+	Merchant,
+	Banker,
+	TributeMaster,
+	Knight,
+	Tank,
+	Healer,
+	Dps,
+	Slower,
+
+	// Distance
+	Radius,
+	LocationRadius,
+	ZFilter,
+	ZRadius,
+
+	// Lookups
+	Targetable,
+	Group,
+	NoGroup,
+	Fellowship,
+	Raid,
+	Named,
+	XTarHater,
+	Light,
+
+	// Strings
+	Class,
+	BodyType,
+	Race,
+	Name,
+
+	// Searches of their own
+	Alert,
+	NoAlert,
+	NotNearAlert,
+	NearAlert,
+	NoPCNear,
+	LoS,
+};
+
+// Case insensitive search for a needle that is already lower case.
+static bool ContainsLowered(std::string_view haystack, std::string_view needle)
 {
-	if (pSearchSpawn == nullptr || pChar == nullptr || pSpawn == nullptr || !pLocalPC)
+	auto iter = std::search(std::begin(haystack), std::end(haystack), std::begin(needle), std::end(needle),
+		[](char c, char lower) { return static_cast<char>(::tolower(static_cast<unsigned char>(c))) == lower; });
+	return iter != std::end(haystack);
+}
+
+static bool EqualsLowered(std::string_view value, std::string_view lower)
+{
+	return value.size() == lower.size()
+		&& std::equal(std::begin(value), std::end(value), std::begin(lower),
+			[](char c, char lower) { return static_cast<char>(::tolower(static_cast<unsigned char>(c))) == lower; });
+}
+
+template <typename Describe>
+bool MQSpawnSearchProgram::DescriptionCheck::Matches(int id, Describe&& describe) const
+{
+	constexpr int MaxRemembered = 4096;
+
+	auto check = [&]()
+	{
+		const char* description = describe(id);
+		return description != nullptr && ci_equals(description, Value);
+	};
+
+	if (id < 0 || id >= MaxRemembered)
+		return check();
+
+	if (static_cast<size_t>(id) >= Results.size())
+		Results.resize(id + 1, 0);
+
+	if (Results[id] == 0)
+		Results[id] = check() ? 1 : -1;
+
+	return Results[id] > 0;
+}
+
+MQSpawnSearchProgram::MQSpawnSearchProgram(const MQSpawnSearch& search)
+	: m_spawnType(search.SpawnType)
+	, m_minLevel(search.MinLevel)
+	, m_maxLevel(search.MaxLevel)
+	, m_spawnID(search.SpawnID)
+	, m_notID(search.NotID)
+	, m_fromSpawnID(search.FromSpawnID)
+	, m_guildID(search.GuildID)
+	, m_playerState(search.PlayerState)
+	, m_pcNearRadius(search.Radius)
+	, m_fRadius(search.FRadius)
+	, m_zRadius(search.ZRadius)
+	, m_xLoc(search.xLoc)
+	, m_yLoc(search.yLoc)
+	, m_zLoc(search.zLoc)
+	, m_knownLocation(search.bKnownLocation)
+	, m_noPet(search.bNoPet)
+	, m_targNext(search.bTargNext)
+	, m_targPrev(search.bTargPrev)
+	, m_exactName(search.bExactName)
+	, m_alertList(search.AlertList)
+	, m_noAlertList(search.NoAlertList)
+	, m_nearAlertList(search.NearAlertList)
+	, m_notNearAlertList(search.NotNearAlertList)
+	, m_name(search.szName)
+	, m_light(search.szLight)
+{
+	m_class.Value = search.szClass;
+	m_bodyType.Value = search.szBodyType;
+	m_race.Value = search.szRace;
+
+	std::transform(std::begin(m_name), std::end(m_name), std::begin(m_name),
+		[](char c) { return static_cast<char>(::tolower(static_cast<unsigned char>(c))); });
+
+	// The order here is the order the checks run in: the ones that only look at the spawn come
+	// first, starting with those that reject the most spawns. The string compares are next to last
+	// because they remember their results. Alerts, nopcnear and line of sight search other spawns or
+	// the world, so they only run on what is left.
+	if (search.bSpawnID)
+		m_ops.push_back(Op::SpawnID);
+	m_ops.push_back(Op::NotID);
+	if (search.SpawnType != NONE || search.bNoPet)
+		m_ops.push_back(Op::Type);
+	if (search.MinLevel)
+		m_ops.push_back(Op::MinLevel);
+	if (search.MaxLevel)
+		m_ops.push_back(Op::MaxLevel);
+	if (search.GuildID != -1)
+		m_ops.push_back(Op::Guild);
+	if (search.bNoGuild)
+		m_ops.push_back(Op::NoGuild);
+	if (search.bLFG)
+		m_ops.push_back(Op::LFG);
+	if (search.bTrader)
+		m_ops.push_back(Op::Trader);
+	if (search.PlayerState)
+		m_ops.push_back(Op::PlayerState);
+	if (search.bGM)
+		m_ops.push_back(search.SpawnType == NPC ? Op::NpcGM : Op::GM);
+	if (search.bMerchant)
+		m_ops.push_back(Op::Merchant);
+	if (search.bBanker)
+		m_ops.push_back(Op::Banker);
+	if (search.bTributeMaster)
+		m_ops.push_back(Op::TributeMaster);
+
+	if (search.SpawnType != NPC)
+	{
+		if (search.bKnight)
+			m_ops.push_back(Op::Knight);
+		if (search.bTank)
+			m_ops.push_back(Op::Tank);
+		if (search.bHealer)
+			m_ops.push_back(Op::Healer);
+		if (search.bDps)
+			m_ops.push_back(Op::Dps);
+		if (search.bSlower)
+			m_ops.push_back(Op::Slower);
+	}
+
+	if (search.FRadius < 10000.0f)
+		m_ops.push_back(search.bKnownLocation ? Op::LocationRadius : Op::Radius);
+	m_ops.push_back(Op::ZFilter);
+	if (search.ZRadius < 10000.0f)
+		m_ops.push_back(Op::ZRadius);
+
+	if (search.bTargetable)
+		m_ops.push_back(Op::Targetable);
+	if (search.bGroup)
+		m_ops.push_back(Op::Group);
+	if (search.bNoGroup)
+		m_ops.push_back(Op::NoGroup);
+	if (search.bFellowship)
+		m_ops.push_back(Op::Fellowship);
+	if (search.bRaid)
+		m_ops.push_back(Op::Raid);
+	if (search.bNamed)
+		m_ops.push_back(Op::Named);
+	if (search.bXTarHater)
+		m_ops.push_back(Op::XTarHater);
+	if (search.bLight)
+		m_ops.push_back(Op::Light);
+
+	if (search.szClass[0])
+		m_ops.push_back(Op::Class);
+	if (search.szBodyType[0])
+		m_ops.push_back(Op::BodyType);
+	if (search.szRace[0])
+		m_ops.push_back(Op::Race);
+	if (search.szName[0])
+		m_ops.push_back(Op::Name);
+
+	if (search.bAlert)
+		m_ops.push_back(Op::Alert);
+	if (search.bNoAlert)
+		m_ops.push_back(Op::NoAlert);
+	if (search.bNotNearAlert)
+		m_ops.push_back(Op::NotNearAlert);
+	if (search.bNearAlert)
+		m_ops.push_back(Op::NearAlert);
+	if (search.Radius > 0.0f)
+		m_ops.push_back(Op::NoPCNear);
+	if (search.bLoS)
+		m_ops.push_back(Op::LoS);
+}
+
+bool MQSpawnSearchProgram::Matches(SPAWNINFO* pChar, SPAWNINFO* pSpawn) const
+{
+	if (pChar == nullptr || pSpawn == nullptr || !pLocalPC)
 		return false;
 
+	for (Op op : m_ops)
+	{
+		if (!Run(op, pChar, pSpawn))
+			return false;
+	}
+
+	return true;
+}
+
+bool MQSpawnSearchProgram::MatchesType(SPAWNINFO* pSpawn) const
+{
 	eSpawnType SpawnType = GetSpawnType(pSpawn);
 
 	if (SpawnType == PET)
 	{
-		if (pSearchSpawn->bNoPet)
+		if (m_noPet)
 			return false;
 
-		if (pSearchSpawn->SpawnType == NPCPET || pSearchSpawn->SpawnType == PCPET || pSearchSpawn->SpawnType == NPC)
+		if (m_spawnType == NPCPET || m_spawnType == PCPET || m_spawnType == NPC)
 		{
 			if (SPAWNINFO* pTheMaster = GetSpawnByID(pSpawn->MasterID))
 			{
 				if (pTheMaster->Type != SPAWN_PLAYER)
 				{
-					if (pSearchSpawn->SpawnType == PCPET)
+					if (m_spawnType == PCPET)
 						return false;
 				}
-				else if (pSearchSpawn->SpawnType != PCPET)
+				else if (m_spawnType != PCPET)
 				{
 					return false;
 				}
 			}
-			else if (pSearchSpawn->SpawnType == PCPET)
+			else if (m_spawnType == PCPET)
 			{
 				return false;
 			}
 
-			SpawnType = pSearchSpawn->SpawnType;
+			SpawnType = m_spawnType;
 		}
 	}
 
-	if (pSearchSpawn->SpawnType != SpawnType && pSearchSpawn->SpawnType != NONE)
+	if (m_spawnType != SpawnType && m_spawnType != NONE)
 	{
-		if (pSearchSpawn->SpawnType == NPCCORPSE)
+		if (m_spawnType == NPCCORPSE)
 		{
 			if (SpawnType != CORPSE || pSpawn->Deity)
 			{
 				return false;
 			}
 		}
-		else if (pSearchSpawn->SpawnType == PCCORPSE)
+		else if (m_spawnType == PCCORPSE)
 		{
 			if (SpawnType != CORPSE || !pSpawn->Deity)
 			{
 				return false;
 			}
 		}
-		else if (pSearchSpawn->SpawnType == NPC && SpawnType == UNTARGETABLE)
+		else if (m_spawnType == NPC && SpawnType == UNTARGETABLE)
 		{
 			return false;
 		}
@@ -3247,106 +3464,152 @@ bool SpawnMatchesSearch(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar, SPAWNINFO
 		// if the search type is not npc or the mob type is UNT, continue?
 		// stupid /who
 
-		else if (pSearchSpawn->SpawnType != NPC || SpawnType != UNTARGETABLE)
+		else if (m_spawnType != NPC || SpawnType != UNTARGETABLE)
 		{
 			return false;
 		}
 	}
 
-	if (pSearchSpawn->MinLevel && pSpawn->Level < pSearchSpawn->MinLevel)
-		return false;
-	if (pSearchSpawn->MaxLevel && pSpawn->Level > pSearchSpawn->MaxLevel)
-		return false;
-	if (pSearchSpawn->NotID == pSpawn->SpawnID)
-		return false;
-	if (pSearchSpawn->bSpawnID && pSearchSpawn->SpawnID != pSpawn->SpawnID)
-		return false;
-	if (pSearchSpawn->GuildID != -1 && pSearchSpawn->GuildID != pSpawn->GuildID)
-		return false;
+	return true;
+}
 
-	if (pSearchSpawn->bGM && pSearchSpawn->SpawnType != NPC)
+bool MQSpawnSearchProgram::MatchesName(SPAWNINFO* pSpawn) const
+{
+	if (!pSpawn->Name[0])
+		return true;
+
+	if (!ContainsLowered(pSpawn->Name, m_name))
 	{
-		if (!pSpawn->GM)
+		char szCleanName[EQ_MAX_NAME] = { 0 };
+		strcpy_s(szCleanName, pSpawn->Name);
+		CleanupName(szCleanName, sizeof(szCleanName), false);
+
+		if (!ContainsLowered(szCleanName, m_name))
 			return false;
 	}
 
-	if (pSearchSpawn->bGM && pSearchSpawn->SpawnType == NPC)
+	if (m_exactName)
 	{
-		if (pSpawn->GetClass() < 20 || pSpawn->GetClass() > 35)
+		char szCleanName[EQ_MAX_NAME] = { 0 };
+		strcpy_s(szCleanName, pSpawn->Name);
+		CleanupName(szCleanName, sizeof(szCleanName), false, !gbExactSearchCleanNames);
+
+		if (!EqualsLowered(szCleanName, m_name))
 			return false;
 	}
 
-	if (pSearchSpawn->bNamed && !IsNamed(pSpawn))
-		return false;
-	if (pSearchSpawn->bMerchant && pSpawn->GetClass() != 41)
-		return false;
-	if (pSearchSpawn->bBanker && pSpawn->GetClass() != 40)
-		return false;
-	if (pSearchSpawn->bTributeMaster && pSpawn->GetClass() != 63)
-		return false;
-	if (pSearchSpawn->bNoGuild && (pSpawn->GuildID != -1 && pSpawn->GuildID != 0))
-		return false;
+	return true;
+}
 
-	if (pSearchSpawn->bKnight && pSearchSpawn->SpawnType != NPC)
+bool MQSpawnSearchProgram::Run(Op op, SPAWNINFO* pChar, SPAWNINFO* pSpawn) const
+{
+	switch (op)
 	{
-		if (pSpawn->GetClass() != Paladin
-			&& pSpawn->GetClass() != Shadowknight)
-		{
-			return false;
-		}
-	}
+	case Op::SpawnID:
+		return m_spawnID == pSpawn->SpawnID;
 
-	if (pSearchSpawn->bTank && pSearchSpawn->SpawnType != NPC)
-	{
-		if (pSpawn->GetClass() != Paladin
-			&& pSpawn->GetClass() != Shadowknight
-			&& pSpawn->GetClass() != Warrior)
-		{
-			return false;
-		}
-	}
+	case Op::NotID:
+		return m_notID != pSpawn->SpawnID;
 
-	if (pSearchSpawn->bHealer && pSearchSpawn->SpawnType != NPC)
-	{
-		if (pSpawn->GetClass() != Cleric
-			&& pSpawn->GetClass() != Druid
-			&& pSpawn->GetClass() != Shaman)
-		{
-			return false;
-		}
-	}
+	case Op::Type:
+		return MatchesType(pSpawn);
 
-	if (pSearchSpawn->bDps && pSearchSpawn->SpawnType != NPC)
-	{
-		if (pSpawn->GetClass() != Ranger
-			&& pSpawn->GetClass() != Rogue
-			&& pSpawn->GetClass() != Wizard
-			&& pSpawn->GetClass() != Berserker)
-		{
-			return false;
-		}
-	}
+	case Op::MinLevel:
+		return pSpawn->Level >= m_minLevel;
 
-	if (pSearchSpawn->bSlower && pSearchSpawn->SpawnType != NPC)
-	{
-		if (pSpawn->GetClass() != Shaman
-			&& pSpawn->GetClass() != Enchanter
-			&& pSpawn->GetClass() != Beastlord
-			&& pSpawn->GetClass() != Bard)
-		{
-			return false;
-		}
-	}
+	case Op::MaxLevel:
+		return pSpawn->Level <= m_maxLevel;
 
-	if (pSearchSpawn->bLFG && !pSpawn->LFG)
-		return false;
-	if (pSearchSpawn->bTrader && !pSpawn->Trader)
-		return false;
+	case Op::Guild:
+		return m_guildID == pSpawn->GuildID;
 
-	if (pSearchSpawn->bXTarHater)
-	{
-		bool foundhater = false;
+	case Op::NoGuild:
+		return pSpawn->GuildID == -1 || pSpawn->GuildID == 0;
+
+	case Op::LFG:
+		return pSpawn->LFG != 0;
+
+	case Op::Trader:
+		return pSpawn->Trader != 0;
+
+	case Op::PlayerState:
+		// if player state isn't 0 and we have that bit set
+		return (pSpawn->PlayerState & m_playerState) != 0;
+
+	case Op::GM:
+		return pSpawn->GM != 0;
+
+	case Op::NpcGM:
+		return pSpawn->GetClass() >= 20 && pSpawn->GetClass() <= 35;
+
+	case Op::Merchant:
+		return pSpawn->GetClass() == 41;
+
+	case Op::Banker:
+		return pSpawn->GetClass() == 40;
+
+	case Op::TributeMaster:
+		return pSpawn->GetClass() == 63;
+
+	case Op::Knight:
+		return pSpawn->GetClass() == Paladin
+			|| pSpawn->GetClass() == Shadowknight;
+
+	case Op::Tank:
+		return pSpawn->GetClass() == Paladin
+			|| pSpawn->GetClass() == Shadowknight
+			|| pSpawn->GetClass() == Warrior;
+
+	case Op::Healer:
+		return pSpawn->GetClass() == Cleric
+			|| pSpawn->GetClass() == Druid
+			|| pSpawn->GetClass() == Shaman;
+
+	case Op::Dps:
+		return pSpawn->GetClass() == Ranger
+			|| pSpawn->GetClass() == Rogue
+			|| pSpawn->GetClass() == Wizard
+			|| pSpawn->GetClass() == Berserker;
+
+	case Op::Slower:
+		return pSpawn->GetClass() == Shaman
+			|| pSpawn->GetClass() == Enchanter
+			|| pSpawn->GetClass() == Beastlord
+			|| pSpawn->GetClass() == Bard;
+
+	case Op::Radius:
+		return Distance3DToSpawn(pChar, pSpawn) <= m_fRadius;
+
+	case Op::LocationRadius:
+		return (m_xLoc == pSpawn->X && m_yLoc == pSpawn->Y)
+			|| Distance3DToPoint(pSpawn, m_xLoc, m_yLoc, m_zLoc) <= m_fRadius;
+
+	case Op::ZFilter:
+		return gZFilter >= 10000.0f
+			|| (pSpawn->Z <= m_zLoc + gZFilter && pSpawn->Z >= m_zLoc - gZFilter);
 
+	case Op::ZRadius:
+		return pSpawn->Z <= m_zLoc + m_zRadius && pSpawn->Z >= m_zLoc - m_zRadius;
+
+	case Op::Targetable:
+		return IsTargetable(pSpawn);
+
+	case Op::Group:
+		return IsInGroup(pSpawn, m_spawnType == PCCORPSE || pSpawn->Type == SPAWN_CORPSE);
+
+	case Op::NoGroup:
+		return !IsInGroup(pSpawn);
+
+	case Op::Fellowship:
+		return IsInFellowship(pSpawn, m_spawnType == PCCORPSE || pSpawn->Type == SPAWN_CORPSE);
+
+	case Op::Raid:
+		return IsInRaid(pSpawn, m_spawnType == PCCORPSE || pSpawn->Type == SPAWN_CORPSE);
+
+	case Op::Named:
+		return IsNamed(pSpawn);
+
+	case Op::XTarHater:
 		for (const ExtendedTargetSlot& xts : *pLocalPC->pExtendedTargetList)
 		{
 			if (xts.xTargetType == XTARGET_AUTO_HATER
@@ -3357,120 +3620,63 @@ bool SpawnMatchesSearch(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar, SPAWNINFO
 				if (pXTargetSpawn != nullptr
 					&& pXTargetSpawn->SpawnID == pSpawn->SpawnID)
 				{
-					foundhater = true;
+					return true;
 				}
 			}
 		}
+		return false;
 
-		if (!foundhater)
-		{
+	case Op::Light: {
+		const char* pLight = GetLightForSpawn(pSpawn);
+		if (!_stricmp(pLight, "NONE"))
 			return false;
-		}
+		return m_light.empty() || !_stricmp(pLight, m_light.c_str());
 	}
 
-	if (pSearchSpawn->bNoGroup && IsInGroup(pSpawn))
-	{
-		return false;
-	}
+	case Op::Class:
+		return m_class.Matches(pSpawn->GetClass(), [](int id) { return GetClassDesc(id); });
 
-	if (pSearchSpawn->bGroup && !IsInGroup(pSpawn, pSearchSpawn->SpawnType == PCCORPSE || pSpawn->Type == SPAWN_CORPSE))
-	{
-		return false;
-	}
+	case Op::BodyType:
+		return m_bodyType.Matches(GetBodyType(pSpawn), [](int id) { return GetBodyTypeDesc(id); });
 
-	if (pSearchSpawn->bFellowship && !IsInFellowship(pSpawn, pSearchSpawn->SpawnType == PCCORPSE || pSpawn->Type == SPAWN_CORPSE))
-	{
-		return false;
-	}
+	case Op::Race:
+		return m_race.Matches(pSpawn->GetRace(), [](int id) { return pEverQuest->GetRaceDesc(id); });
 
-	if (pSearchSpawn->bRaid && !IsInRaid(pSpawn, pSearchSpawn->SpawnType == PCCORPSE || pSpawn->Type == SPAWN_CORPSE))
-	{
-		return false;
-	}
+	case Op::Name:
+		return MatchesName(pSpawn);
 
-	if (pSearchSpawn->bKnownLocation)
-	{
-		if ((pSearchSpawn->xLoc != pSpawn->X || pSearchSpawn->yLoc != pSpawn->Y))
-		{
-			if (pSearchSpawn->FRadius < 10000.0f
-				&& Distance3DToPoint(pSpawn, pSearchSpawn->xLoc, pSearchSpawn->yLoc, pSearchSpawn->zLoc)>pSearchSpawn->FRadius)
-			{
-				return false;
-			}
-		}
-	}
-	else if (pSearchSpawn->FRadius < 10000.0f && Distance3DToSpawn(pChar, pSpawn)>pSearchSpawn->FRadius)
-	{
-		return false;
-	}
+	case Op::Alert:
+		return !CAlerts.AlertExist(m_alertList) || IsAlert(pChar, pSpawn, m_alertList);
 
-	if (pSearchSpawn->Radius > 0.0f && IsPCNear(pSpawn, pSearchSpawn->Radius))
-		return false;
-	if (gZFilter < 10000.0f && ((pSpawn->Z > pSearchSpawn->zLoc + gZFilter) || (pSpawn->Z < pSearchSpawn->zLoc - gZFilter)))
-		return false;
-	if (pSearchSpawn->ZRadius < 10000.0f && (pSpawn->Z > pSearchSpawn->zLoc + pSearchSpawn->ZRadius || pSpawn->Z < pSearchSpawn->zLoc - pSearchSpawn->ZRadius))
-		return false;
-	if (pSearchSpawn->bLight)
-	{
-		const char* pLight = GetLightForSpawn(pSpawn);
-		if (!_stricmp(pLight, "NONE"))
-			return false;
-		if (pSearchSpawn->szLight[0] && _stricmp(pLight, pSearchSpawn->szLight))
-			return false;
-	}
-	if ((pSearchSpawn->bAlert) && CAlerts.AlertExist(pSearchSpawn->AlertList))
-	{
-		if (!IsAlert(pChar, pSpawn, pSearchSpawn->AlertList))
-			return false;
-	}
-	if ((pSearchSpawn->bNoAlert) && CAlerts.AlertExist(pSearchSpawn->NoAlertList))
-	{
-		if (IsAlert(pChar, pSpawn, pSearchSpawn->NoAlertList))
-			return false;
-	}
-	if (pSearchSpawn->bNotNearAlert && GetClosestAlert(pSpawn, pSearchSpawn->NotNearAlertList))
-		return false;
-	if (pSearchSpawn->bNearAlert && !GetClosestAlert(pSpawn, pSearchSpawn->NearAlertList))
-		return false;
-	if (pSearchSpawn->szClass[0] && _stricmp(pSearchSpawn->szClass, GetClassDesc(pSpawn->GetClass())))
-		return false;
-	if (pSearchSpawn->szBodyType[0] && _stricmp(pSearchSpawn->szBodyType, GetBodyTypeDesc(GetBodyType(pSpawn))))
-		return false;
-	if (pSearchSpawn->szRace[0] && _stricmp(pSearchSpawn->szRace, pEverQuest->GetRaceDesc(pSpawn->GetRace())))
-		return false;
-	if (pSearchSpawn->bLoS && !pControlledPlayer->CanSee(*pSpawn))
-		return false;
-	if (pSearchSpawn->bTargetable && !IsTargetable(pSpawn))
-		return false;
-	if (pSearchSpawn->PlayerState && !(pSpawn->PlayerState & pSearchSpawn->PlayerState)) // if player state isn't 0 and we have that bit set
-		return false;
+	case Op::NoAlert:
+		return !CAlerts.AlertExist(m_noAlertList) || !IsAlert(pChar, pSpawn, m_noAlertList);
 
-	if (pSearchSpawn->szName[0] && pSpawn->Name[0])
-	{
-		if (ci_find_substr(pSpawn->Name, pSearchSpawn->szName) == -1)
-		{
-			char szCleanName[EQ_MAX_NAME] = { 0 };
-			strcpy_s(szCleanName, pSpawn->Name);
-			CleanupName(szCleanName, sizeof(szCleanName), false);
+	case Op::NotNearAlert:
+		return !GetClosestAlert(pSpawn, m_notNearAlertList);
 
-			if (ci_find_substr(szCleanName, pSearchSpawn->szName) == -1)
-				return false;
-		}
+	case Op::NearAlert:
+		return GetClosestAlert(pSpawn, m_nearAlertList);
 
-		if (pSearchSpawn->bExactName)
-		{
-			char szCleanName[EQ_MAX_NAME] = { 0 };
-			strcpy_s(szCleanName, pSpawn->Name);
-			CleanupName(szCleanName, sizeof(szCleanName), false, !gbExactSearchCleanNames);
+	case Op::NoPCNear:
+		return !IsPCNear(pSpawn, m_pcNearRadius);
 
-			if (!ci_equals(szCleanName, pSearchSpawn->szName))
-				return false;
-		}
+	case Op::LoS:
+		return pControlledPlayer->CanSee(*pSpawn);
 	}
 
 	return true;
 }
 
+// Compiles the search on every call. Code that matches the same search against many spawns
+// should build an MQSpawnSearchProgram once and call Matches on it instead.
+bool SpawnMatchesSearch(MQSpawnSearch* pSearchSpawn, SPAWNINFO* pChar, SPAWNINFO* pSpawn)
+{
+	if (pSearchSpawn == nullptr || pChar == nullptr || pSpawn == nullptr || !pLocalPC)
+		return false;
+
+	return MQSpawnSearchProgram(*pSearchSpawn).Matches(pChar, pSpawn);
+}
+
 const char* ParseSearchSpawnArgs(char* szArg, const char* szRest, MQSpawnSearch* pSearchSpawn)
 {
 	if (szArg && pSearchSpawn)
@@ -3675,6 +3881,7 @@ const char* ParseSearchSpawnArgs(char* szArg, const char* szRest, MQSpawnSearch*
 			}
 			else
 			{
+				pSearchSpawn->bKnownZ = true;
 				szRest = GetNextArg(szRest, 3);
 			}
 		}
@@ -3898,27 +4105,60 @@ bool GetClosestAlert(SPAWNINFO* pChar, uint32_t id)
 	return pClosest != nullptr;
 }
 
+// Alert lists compiled into spawn search programs, by list id. A list is compiled again the
+// first time it is used after any alert list changes. Alert searches can check other alert lists,
+// so entries are kept in a map where compiling one list doesn't move the others.
+struct CompiledAlertList
+{
+	uint32_t Generation = 0;
+	std::vector<std::pair<uint32_t, MQSpawnSearchProgram>> Searches; // spawn id the search is limited to, 0 = any
+};
+
+static std::map<uint32_t, CompiledAlertList> s_alertPrograms;
+
+static const CompiledAlertList* GetAlertPrograms(uint32_t id)
+{
+	const uint32_t generation = CAlerts.GetGeneration();
+
+	auto iter = s_alertPrograms.find(id);
+	if (iter != s_alertPrograms.end() && iter->second.Generation == generation)
+		return &iter->second;
+
+	std::vector<MQSpawnSearch> alerts;
+	if (!CAlerts.GetAlert(id, alerts))
+		return nullptr;
+
+	CompiledAlertList& compiled = s_alertPrograms[id];
+	compiled.Generation = generation;
+	compiled.Searches.clear();
+	compiled.Searches.reserve(alerts.size());
+
+	for (MQSpawnSearch& search : alerts)
+	{
+		// IsAlert checks the spawn id before running the program.
+		const uint32_t spawnID = search.SpawnID;
+		search.bSpawnID = false;
+
+		compiled.Searches.emplace_back(spawnID, MQSpawnSearchProgram(search));
+	}
+
+	return &compiled;
+}
+
 bool IsAlert(SPAWNINFO* pChar, SPAWNINFO* pSpawn, uint32_t id)
 {
 	if (pSpawn == nullptr)
 		return false;
 
-	MQSpawnSearch SearchSpawn;
-
-	std::vector<MQSpawnSearch> alerts;
-	if (CAlerts.GetAlert(id, alerts))
+	if (const CompiledAlertList* alerts = GetAlertPrograms(id))
 	{
-		for (auto& search : alerts)
+		for (const auto& [spawnID, search] : alerts->Searches)
 		{
-			if (search.SpawnID > 0 && search.SpawnID != pSpawn->SpawnID)
+			if (spawnID > 0 && spawnID != pSpawn->SpawnID)
 				continue;
 
-			// FIXME
-			memcpy(&SearchSpawn, &search, sizeof(MQSpawnSearch));
-			SearchSpawn.SpawnID = pSpawn->SpawnID;
-
 			// if this spawn matches, it's true. This is an implied logical or
-			if (SpawnMatchesSearch(&SearchSpawn, pChar, pSpawn))
+			if (search.Matches(pChar, pSpawn))
 				return true;
 		}
 	}
@@ -4370,9 +4610,11 @@ void SuperWhoDisplay(SPAWNINFO* pChar, MQSpawnSearch* pSearchSpawn, DWORD Color)
 	if (!pOrigin)
 		pOrigin = pChar;
 
+	MQSpawnSearchProgram search(*pSearchSpawn);
+
 	while (pSpawn)
 	{
-		if (SpawnMatchesSearch(pSearchSpawn, pOrigin, pSpawn))
+		if (search.Matches(pOrigin, pSpawn))
 		{
 			// matches search, add to our set
 			SpawnSet.push_back(pSpawn);
@@ -0,0 +1,1046 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// The formula calculator behind Calculate. This file only depends on mq/base, so that
+// tests/CalcBenchmark can build it outside of the game. Don't include pch.h here.
+
+#include "MQCalculator.h"
+
+#include <mq/base/Common.h>
+#include <mq/base/String.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace mq {
+
+static void CalcError(const char* szFormat, ...)
+{
+	char szMessage[MAX_STRING] = { 0 };
+
+	va_list vaList;
+	va_start(vaList, szFormat);
+	vsnprintf(szMessage, sizeof(szMessage), szFormat, vaList);
+	va_end(vaList);
+
+	ReportCalculateError(szMessage);
+}
+
+enum eCalcOp
+{
+	CO_NUMBER = 0,
+	CO_OPENPARENS = 1,
+	CO_CLOSEPARENS = 2,
+	CO_ADD = 3,
+	CO_SUBTRACT = 4,
+	CO_MULTIPLY = 5,
+	CO_DIVIDE = 6,
+	CO_IDIVIDE = 7,
+	CO_LAND = 8,
+	CO_AND = 9,
+	CO_LOR = 10,
+	CO_OR = 11,
+	CO_XOR = 12,
+	CO_EQUAL = 13,
+	CO_NOTEQUAL = 14,
+	CO_GREATER = 15,
+	CO_NOTGREATER = 16,
+	CO_LESS = 17,
+	CO_NOTLESS = 18,
+	CO_MODULUS = 19,
+	CO_POWER = 20,
+	CO_LNOT = 21,
+	CO_NOT = 22,
+	CO_SHL = 23,
+	CO_SHR = 24,
+	CO_NEGATE = 25,
+	CO_TOTAL = 26,
+};
+
+int CalcOpPrecedence[CO_TOTAL] =
+{
+	0,
+	0,
+	0,
+	9,    // add
+	9,    // subtract
+	10,   // multiply
+	10,   // divide
+	10,   // integer divide
+	2,    // logical and
+	5,    // bitwise and
+	1,    // logical or
+	3,    // bitwise or
+	4,    // bitwise xor
+	6,    // equal
+	6,    // not equal
+	7,    // greater
+	7,    // not greater
+	7,    // less
+	7,    // not less
+	10,   // modulus
+	11,   // power
+	12,   // logical not
+	12,   // bitwise not
+	8,    // shl
+	8,    // shr
+	12,   // negate
+};
+
+struct CalcOp
+{
+	eCalcOp Op;
+	double Value;
+};
+
+bool EvaluateRPN(CalcOp* pList, int Size, double& Result)
+{
+	if (!Size)
+		return false;
+
+	std::unique_ptr<double[]> stackPtr = std::make_unique<double[]>(Size / 2 + 2);
+	double* pStack = stackPtr.get();
+
+	int nStack = 0;
+
+#define StackEmpty()           (nStack==0)
+#define StackTop()             (pStack[nStack])
+#define StackSetTop(do_assign) {pStack[nStack]##do_assign;}
+#define StackPush(val)         {nStack++;pStack[nStack]=val;}
+#define StackPop()             {if (!nStack) {CalcError("Illegal arithmetic in calculation"); return 0;}; nStack--;}
+
+#define BinaryIntOp(op)        {int RightSide=(int)StackTop();StackPop();StackSetTop(=(double)(((int)StackTop())##op##RightSide));}
+#define BinaryOp(op)           {double RightSide=StackTop();StackPop();StackSetTop(=StackTop()##op##RightSide);}
+#define BinaryAssign(op)       {double RightSide=StackTop();StackPop();StackSetTop(##op##=RightSide);}
+
+#define UnaryIntOp(op)         {StackSetTop(=op##((int)StackTop()));}
+#define UnaryOp(op)            {StackSetTop(=op##(StackTop()));}
+
+	for (int i = 0; i < Size; i++)
+	{
+		switch (pList[i].Op)
+		{
+		case CO_NUMBER:
+			StackPush(pList[i].Value);
+			break;
+		case CO_ADD:
+			BinaryAssign(+);
+			break;
+		case CO_MULTIPLY:
+			BinaryAssign(*);
+			break;
+		case CO_SUBTRACT:
+			BinaryAssign(-);
+			break;
+		case CO_NEGATE:
+			UnaryOp(-);
+			break;
+		case CO_DIVIDE:
+			if (StackTop())
+			{
+				BinaryAssign(/ );
+			}
+			else
+			{
+				//printf("Divide by zero error\n");
+				CalcError("Divide by zero in calculation");
+				return false;
+			}
+			break;
+
+		case CO_IDIVIDE://TODO: SPECIAL HANDLING
+		{
+			int Right = (int)StackTop();
+			if (Right)
+			{
+				StackPop();
+				int Left = (int)StackTop();
+				Left /= Right;
+				StackSetTop(= Left);
+			}
+			else
+			{
+				//printf("Integer divide by zero error\n");
+				CalcError("Divide by zero in calculation");
+				return false;
+			}
+		}
+		break;
+
+		case CO_MODULUS://TODO: SPECIAL HANDLING
+		{
+			int Right = (int)StackTop();
+			if (Right)
+			{
+				StackPop();
+				int Left = (int)StackTop();
+				Left %= Right;
+				StackSetTop(= Left);
+			}
+			else
+			{
+				//printf("Modulus by zero error\n");
+				CalcError("Modulus by zero in calculation");
+				return false;
+			}
+		}
+		break;
+
+		case CO_LAND:
+			BinaryOp(&&);
+			break;
+		case CO_LOR:
+			BinaryOp(|| );
+			break;
+		case CO_EQUAL:
+			BinaryOp(== );
+			break;
+		case CO_NOTEQUAL:
+			BinaryOp(!= );
+			break;
+		case CO_GREATER:
+			BinaryOp(> );
+			break;
+		case CO_NOTGREATER:
+			BinaryOp(<= );
+			break;
+		case CO_LESS:
+			BinaryOp(< );
+			break;
+		case CO_NOTLESS:
+			BinaryOp(>= );
+			break;
+		case CO_SHL:
+			BinaryIntOp(<< );
+			break;
+		case CO_SHR:
+			BinaryIntOp(>> );
+			break;
+		case CO_AND:
+			BinaryIntOp(&);
+			break;
+		case CO_OR:
+			BinaryIntOp(| );
+			break;
+		case CO_XOR:
+			BinaryIntOp(^);
+			break;
+		case CO_LNOT:
+			UnaryIntOp(!);
+			break;
+		case CO_NOT:
+			UnaryIntOp(~);
+			break;
+		case CO_POWER:
+		{
+			double RightSide = StackTop();
+			StackPop();
+			StackSetTop(= pow(StackTop(), RightSide));
+		}
+		break;
+		}
+	}
+
+	Result = StackTop();
+
+#undef StackEmpty
+#undef StackTop
+#undef StackPush
+#undef StackPop
+
+	return true;
+}
+
+bool FastCalculate(char* szFormula, double& Result)
+{
+	//DebugSpew("FastCalculate(%s)",szFormula);
+	if (!szFormula || !szFormula[0])
+		return false;
+
+	int Length = (int)strlen(szFormula);
+	int MaxOps = (Length + 1);
+
+	std::unique_ptr<CalcOp[]> OpsList = std::make_unique<CalcOp[]>(MaxOps);
+	CalcOp* pOpList = OpsList.get();
+	memset(pOpList, 0, sizeof(CalcOp) * MaxOps);
+
+	std::unique_ptr<eCalcOp[]> Stack = std::make_unique<eCalcOp[]>(MaxOps);
+	eCalcOp* pStack = Stack.get();
+	memset(pStack, 0, sizeof(eCalcOp) * MaxOps);
+
+	int nOps = 0;
+	int nStack = 0;
+	char* pEnd = szFormula + Length;
+	char CurrentToken[MAX_STRING] = { 0 };
+	char* pToken = &CurrentToken[0];
+
+#define OpToList(op)         { pOpList[nOps].Op = op; nOps++; }
+#define ValueToList(val)     { pOpList[nOps].Value = val; nOps++; }
+#define StackEmpty()         (nStack == 0)
+#define StackTop()           (pStack[nStack])
+#define StackPush(op)        { nStack++; pStack[nStack] = op; }
+#define StackPop()           { if (!nStack) { CalcError("Illegal arithmetic in calculation"); return 0; } nStack--;}
+#define HasPrecedence(a,b)   ( CalcOpPrecedence[a] >= CalcOpPrecedence[b])
+#define MoveStack(op) {                                                                        \
+	while (!StackEmpty() && StackTop() != CO_OPENPARENS && HasPrecedence(StackTop(), op)) {    \
+		OpToList(StackTop());                                                                  \
+		StackPop();                                                                            \
+	}                                                                                          \
+}
+#define FinishString()       { if (pToken != &CurrentToken[0]) { *pToken = 0; ValueToList(GetDoubleFromString(CurrentToken, 0)); pToken = &CurrentToken[0]; *pToken=0; }}
+#define NewOp(op)            { FinishString(); MoveStack(op); StackPush(op); }
+#define NextChar(ch)         { *pToken = ch; pToken++; }
+
+	bool WasParen = false;
+	for (char* pCur = szFormula; pCur < pEnd; pCur++)
+	{
+		switch (*pCur)
+		{
+		case ' ':
+			continue;
+		case '(':
+			FinishString();
+			StackPush(CO_OPENPARENS);
+			break;
+		case ')':
+			FinishString();
+			while (StackTop() != CO_OPENPARENS)
+			{
+				OpToList(StackTop());
+				StackPop();
+			}
+			StackPop();
+			WasParen = true;
+			continue;
+		case '+':
+			if (pCur[1] != '+')
+				NewOp(CO_ADD);
+			break;
+		case '-':
+			if (pCur[1] == '-')
+			{
+				pCur++;
+				NewOp(CO_ADD);
+			}
+			else
+			{
+				if (CurrentToken[0] || WasParen)
+				{
+					NewOp(CO_SUBTRACT);
+				}
+				else
+					NewOp(CO_NEGATE);
+			}
+			break;
+		case '*':
+			NewOp(CO_MULTIPLY);
+			break;
+		case '\\':
+			NewOp(CO_IDIVIDE);
+			break;
+		case '/':
+			NewOp(CO_DIVIDE);
+			break;
+		case '|':
+			if (pCur[1] == '|')
+			{
+				// Logical OR
+				++pCur;
+				NewOp(CO_LOR);
+			}
+			else
+			{
+				// Bitwise OR
+				NewOp(CO_OR);
+			}
+			break;
+		case '%':
+			NewOp(CO_MODULUS);
+			break;
+		case '~':
+			NewOp(CO_NOT);
+			break;
+		case '&':
+			if (pCur[1] == '&')
+			{
+				// Logical AND
+				++pCur;
+				NewOp(CO_LAND);
+			}
+			else
+			{
+				// Bitwise AND
+				NewOp(CO_AND);
+			}
+			break;
+		case '^':
+			if (pCur[1] == '^')
+			{
+				// XOR
+				++pCur;
+				NewOp(CO_XOR);
+			}
+			else
+			{
+				// POWER
+				NewOp(CO_POWER);
+			}
+			break;
+		case '!':
+			if (pCur[1] == '=')
+			{
+				++pCur;
+				NewOp(CO_NOTEQUAL);
+			}
+			else
+			{
+				NewOp(CO_LNOT);
+			}
+			break;
+		case '=':
+			if (pCur[1] == '=')
+			{
+				++pCur;
+				NewOp(CO_EQUAL);
+			}
+			else
+			{
+				//printf("Unparsable: '%c'\n",*pCur);
+				// error
+				return false;
+			}
+			break;
+		case '<':
+			if (pCur[1] == '=')
+			{
+				++pCur;
+				NewOp(CO_NOTGREATER);
+			}
+			else if (pCur[1] == '<')
+			{
+				++pCur;
+				NewOp(CO_SHL);
+			}
+			else
+			{
+				NewOp(CO_LESS);
+			}
+			break;
+		case '>':
+			if (pCur[1] == '=')
+			{
+				++pCur;
+				NewOp(CO_NOTLESS);
+			}
+			else if (pCur[1] == '>')
+			{
+				++pCur;
+				NewOp(CO_SHR);
+			}
+			else
+			{
+				NewOp(CO_GREATER);
+			}
+			break;
+		case '.':
+		case '1':
+		case '2':
+		case '3':
+		case '4':
+		case '5':
+		case '6':
+		case '7':
+		case '8':
+		case '9':
+		case '0':
+			NextChar(*pCur);
+			break;
+		default:
+		{
+			//printf("Unparsable: '%c'\n",*pCur);
+			CalcError("Unparsable in Calculation: '%c'", *pCur);
+			// unparsable
+			return false;
+		}
+		}
+		WasParen = false;
+	}
+	FinishString();
+
+	while (!StackEmpty())
+	{
+		OpToList(StackTop());
+		StackPop();
+	}
+
+	return EvaluateRPN(pOpList, nOps, Result);
+}
+
+//----------------------------------------------------------------------------
+// Compiled formulas
+//
+// Conditions are evaluated over and over with the same structure and only the numbers
+// changing (/if (${Me.PctHPs} < 50) becomes "(87 < 50)", "(86 < 50)", ...). A formula is
+// tokenized into a shape where every number is a slot, and the shape is compiled once
+// into an RPN program that is kept in an LRU. Evaluating a cached formula only has to
+// tokenize it and run the program, with no shunting-yard and no allocations.
+//
+// Anything the compiler can't prove will evaluate cleanly (unparsable characters,
+// unbalanced parentheses, stack underflow) goes through FastCalculate so that the same
+// errors are reported.
+
+struct CalcInstruction
+{
+	uint8_t Op;                  // eCalcOp
+	bool Negate = false;         // CO_NUMBER followed by CO_NEGATE, folded into the load
+	uint16_t Slot = 0;           // CO_NUMBER: index of the number in the formula
+};
+
+struct CalcProgram
+{
+	std::string Shape;
+	std::vector<CalcInstruction> Code;
+	int MaxDepth = 0;
+	bool UseFastCalculate = false;
+};
+
+static constexpr int MaxCalcSlots = 128;
+static constexpr size_t MaxCalcPrograms = 512;
+
+class CalcProgramCache
+{
+public:
+	std::shared_ptr<const CalcProgram> Get(std::string_view shape)
+	{
+		{
+			std::scoped_lock lock(m_mutex);
+
+			auto iter = m_programs.find(shape);
+			if (iter != m_programs.end())
+			{
+				m_lru.splice(m_lru.begin(), m_lru, iter->second);
+				return *iter->second;
+			}
+		}
+
+		std::shared_ptr<const CalcProgram> program = Compile(shape);
+
+		std::scoped_lock lock(m_mutex);
+
+		if (m_programs.find(shape) == m_programs.end())
+		{
+			if (m_lru.size() >= MaxCalcPrograms)
+			{
+				m_programs.erase(m_lru.back()->Shape);
+				m_lru.pop_back();
+			}
+
+			m_lru.push_front(program);
+			m_programs.emplace(program->Shape, m_lru.begin());
+		}
+
+		return program;
+	}
+
+private:
+	static std::shared_ptr<const CalcProgram> Compile(std::string_view shape)
+	{
+		auto program = std::make_shared<CalcProgram>();
+		program->Shape = shape;
+
+		eCalcOp opStack[MAX_STRING];
+		int nStack = 0;
+		int slot = 0;
+
+		auto emit = [&](eCalcOp op)
+		{
+			CalcInstruction instr;
+			instr.Op = static_cast<uint8_t>(op);
+			program->Code.push_back(instr);
+		};
+
+		// Shunting-yard, same as FastCalculate. Unbalanced parentheses are left to FastCalculate.
+		for (char ch : shape)
+		{
+			eCalcOp op = static_cast<eCalcOp>(ch - 'a');
+
+			switch (op)
+			{
+			case CO_NUMBER:
+			{
+				CalcInstruction instr;
+				instr.Op = CO_NUMBER;
+				instr.Slot = static_cast<uint16_t>(slot++);
+				program->Code.push_back(instr);
+				break;
+			}
+
+			case CO_OPENPARENS:
+				opStack[++nStack] = CO_OPENPARENS;
+				break;
+
+			case CO_CLOSEPARENS:
+				while (nStack > 0 && opStack[nStack] != CO_OPENPARENS)
+					emit(opStack[nStack--]);
+				if (nStack == 0)
+				{
+					program->UseFastCalculate = true;
+					return program;
+				}
+				--nStack;
+				break;
+
+			default:
+				while (nStack > 0 && opStack[nStack] != CO_OPENPARENS
+					&& CalcOpPrecedence[opStack[nStack]] >= CalcOpPrecedence[op])
+				{
+					emit(opStack[nStack--]);
+				}
+				opStack[++nStack] = op;
+				break;
+			}
+		}
+
+		// FastCalculate leaves unmatched open parentheses in the list, where they do nothing.
+		while (nStack > 0)
+		{
+			if (opStack[nStack] != CO_OPENPARENS)
+				emit(opStack[nStack]);
+			--nStack;
+		}
+
+		// Fold negation of a number into the load of that number.
+		std::vector<CalcInstruction> folded;
+		folded.reserve(program->Code.size());
+
+		for (const CalcInstruction& instr : program->Code)
+		{
+			if (instr.Op == CO_NEGATE && !folded.empty() && folded.back().Op == CO_NUMBER)
+				folded.back().Negate = !folded.back().Negate;
+			else
+				folded.push_back(instr);
+		}
+		program->Code = std::move(folded);
+
+		// Walk the stack depth the way EvaluateRPN would. Popping an empty stack is an error
+		// that FastCalculate reports, so those programs are never run directly.
+		int depth = 0;
+		for (const CalcInstruction& instr : program->Code)
+		{
+			switch (instr.Op)
+			{
+			case CO_NUMBER:
+				program->MaxDepth = std::max(program->MaxDepth, ++depth);
+				break;
+
+			case CO_NEGATE:
+			case CO_LNOT:
+			case CO_NOT:
+				break;
+
+			default:
+				if (depth == 0)
+				{
+					program->UseFastCalculate = true;
+					return program;
+				}
+				--depth;
+				break;
+			}
+		}
+
+		if (program->Code.empty())
+			program->UseFastCalculate = true;
+
+		return program;
+	}
+
+	std::mutex m_mutex;
+	std::list<std::shared_ptr<const CalcProgram>> m_lru;
+	std::unordered_map<std::string_view, std::list<std::shared_ptr<const CalcProgram>>::iterator> m_programs;
+};
+
+static CalcProgramCache s_calcProgramCache;
+
+// Splits a formula into its shape and the values of its numbers. This follows the same
+// rules as FastCalculate, including the choice between subtraction and negation.
+static bool TokenizeFormula(const char* szFormula, char* szShape, size_t ShapeLen, double* pValues, int& nValues)
+{
+	size_t nShape = 0;
+	nValues = 0;
+
+	char CurrentToken[MAX_STRING] = { 0 };
+	char* pToken = &CurrentToken[0];
+
+	auto finishString = [&]()
+	{
+		if (pToken == &CurrentToken[0])
+			return true;
+
+		if (nValues == MaxCalcSlots || nShape + 1 >= ShapeLen)
+			return false;
+
+		*pToken = 0;
+		pValues[nValues++] = GetDoubleFromString(CurrentToken, 0);
+		szShape[nShape++] = 'a' + CO_NUMBER;
+
+		pToken = &CurrentToken[0];
+		*pToken = 0;
+		return true;
+	};
+
+	auto newOp = [&](eCalcOp op)
+	{
+		if (!finishString() || nShape + 1 >= ShapeLen)
+			return false;
+
+		szShape[nShape++] = static_cast<char>('a' + op);
+		return true;
+	};
+
+	bool WasParen = false;
+	for (const char* pCur = szFormula; *pCur; pCur++)
+	{
+		bool ok = true;
+
+		switch (*pCur)
+		{
+		case ' ':
+			continue;
+		case '(':
+			ok = newOp(CO_OPENPARENS);
+			break;
+		case ')':
+			if (!newOp(CO_CLOSEPARENS))
+				return false;
+			WasParen = true;
+			continue;
+		case '+':
+			if (pCur[1] != '+')
+				ok = newOp(CO_ADD);
+			break;
+		case '-':
+			if (pCur[1] == '-')
+			{
+				pCur++;
+				ok = newOp(CO_ADD);
+			}
+			else if (CurrentToken[0] || WasParen)
+				ok = newOp(CO_SUBTRACT);
+			else
+				ok = newOp(CO_NEGATE);
+			break;
+		case '*':
+			ok = newOp(CO_MULTIPLY);
+			break;
+		case '\\':
+			ok = newOp(CO_IDIVIDE);
+			break;
+		case '/':
+			ok = newOp(CO_DIVIDE);
+			break;
+		case '|':
+			if (pCur[1] == '|')
+			{
+				++pCur;
+				ok = newOp(CO_LOR);
+			}
+			else
+				ok = newOp(CO_OR);
+			break;
+		case '%':
+			ok = newOp(CO_MODULUS);
+			break;
+		case '~':
+			ok = newOp(CO_NOT);
+			break;
+		case '&':
+			if (pCur[1] == '&')
+			{
+				++pCur;
+				ok = newOp(CO_LAND);
+			}
+			else
+				ok = newOp(CO_AND);
+			break;
+		case '^':
+			if (pCur[1] == '^')
+			{
+				++pCur;
+				ok = newOp(CO_XOR);
+			}
+			else
+				ok = newOp(CO_POWER);
+			break;
+		case '!':
+			if (pCur[1] == '=')
+			{
+				++pCur;
+				ok = newOp(CO_NOTEQUAL);
+			}
+			else
+				ok = newOp(CO_LNOT);
+			break;
+		case '=':
+			if (pCur[1] != '=')
+				return false;
+			++pCur;
+			ok = newOp(CO_EQUAL);
+			break;
+		case '<':
+			if (pCur[1] == '=')
+			{
+				++pCur;
+				ok = newOp(CO_NOTGREATER);
+			}
+			else if (pCur[1] == '<')
+			{
+				++pCur;
+				ok = newOp(CO_SHL);
+			}
+			else
+				ok = newOp(CO_LESS);
+			break;
+		case '>':
+			if (pCur[1] == '=')
+			{
+				++pCur;
+				ok = newOp(CO_NOTLESS);
+			}
+			else if (pCur[1] == '>')
+			{
+				++pCur;
+				ok = newOp(CO_SHR);
+			}
+			else
+				ok = newOp(CO_GREATER);
+			break;
+		case '.':
+		case '0':
+		case '1':
+		case '2':
+		case '3':
+		case '4':
+		case '5':
+		case '6':
+		case '7':
+		case '8':
+		case '9':
+			*pToken++ = *pCur;
+			break;
+		default:
+			return false;
+		}
+
+		if (!ok)
+			return false;
+
+		WasParen = false;
+	}
+
+	if (!finishString())
+		return false;
+
+	szShape[nShape] = 0;
+	return true;
+}
+
+static bool EvaluateCalcProgram(const CalcProgram& program, const double* pValues, double& Result)
+{
+	// Same layout as EvaluateRPN: the stack starts at index 1 and the unused bottom element is
+	// what unary operators see when applied to an empty stack.
+	double localStack[32];
+	std::unique_ptr<double[]> heapStack;
+	double* pStack = &localStack[0];
+
+	if (program.MaxDepth + 1 > lengthof(localStack))
+	{
+		heapStack = std::make_unique<double[]>(program.MaxDepth + 1);
+		pStack = heapStack.get();
+	}
+
+	pStack[0] = 0;
+	int nStack = 0;
+
+	for (const CalcInstruction& instr : program.Code)
+	{
+		double& top = pStack[nStack];
+
+		switch (instr.Op)
+		{
+		case CO_NUMBER:
+			pStack[++nStack] = instr.Negate ? -pValues[instr.Slot] : pValues[instr.Slot];
+			continue;
+		case CO_NEGATE:
+			top = -top;
+			continue;
+		case CO_LNOT:
+			top = !static_cast<int>(top);
+			continue;
+		case CO_NOT:
+			top = ~static_cast<int>(top);
+			continue;
+		default:
+			break;
+		}
+
+		// binary operators, the compiler guarantees there are two values on the stack.
+		double right = top;
+		double& left = pStack[nStack - 1];
+
+		switch (instr.Op)
+		{
+		case CO_ADD: left += right; break;
+		case CO_SUBTRACT: left -= right; break;
+		case CO_MULTIPLY: left *= right; break;
+
+		case CO_DIVIDE:
+			if (!right)
+			{
+				CalcError("Divide by zero in calculation");
+				return false;
+			}
+			left /= right;
+			break;
+
+		case CO_IDIVIDE:
+			if (!static_cast<int>(right))
+			{
+				CalcError("Divide by zero in calculation");
+				return false;
+			}
+			left = static_cast<int>(left) / static_cast<int>(right);
+			break;
+
+		case CO_MODULUS:
+			if (!static_cast<int>(right))
+			{
+				CalcError("Modulus by zero in calculation");
+				return false;
+			}
+			left = static_cast<int>(left) % static_cast<int>(right);
+			break;
+
+		case CO_LAND: left = left && right; break;
+		case CO_LOR: left = left || right; break;
+		case CO_EQUAL: left = left == right; break;
+		case CO_NOTEQUAL: left = left != right; break;
+		case CO_GREATER: left = left > right; break;
+		case CO_NOTGREATER: left = left <= right; break;
+		case CO_LESS: left = left < right; break;
+		case CO_NOTLESS: left = left >= right; break;
+		case CO_SHL: left = static_cast<int>(left) << static_cast<int>(right); break;
+		case CO_SHR: left = static_cast<int>(left) >> static_cast<int>(right); break;
+		case CO_AND: left = static_cast<int>(left) & static_cast<int>(right); break;
+		case CO_OR: left = static_cast<int>(left) | static_cast<int>(right); break;
+		case CO_XOR: left = static_cast<int>(left) ^ static_cast<int>(right); break;
+		case CO_POWER: left = pow(left, right); break;
+		default: break;
+		}
+
+		--nStack;
+	}
+
+	Result = pStack[nStack];
+	return true;
+}
+
+bool CompiledCalculate(char* szFormula, double& Result)
+{
+	if (!szFormula || !szFormula[0])
+		return false;
+
+	char szShape[MAX_STRING];
+	double Values[MaxCalcSlots];
+	int nValues = 0;
+
+	if (!TokenizeFormula(szFormula, szShape, lengthof(szShape), Values, nValues))
+		return FastCalculate(szFormula, Result);
+
+	std::shared_ptr<const CalcProgram> program = s_calcProgramCache.Get(szShape);
+	if (program->UseFastCalculate)
+		return FastCalculate(szFormula, Result);
+
+	return EvaluateCalcProgram(*program, Values, Result);
+}
+
+const char* const CalculateBenchmarkFormulas[] = {
+	"(0.00)",
+	"(!1.00)",
+	"(1234==0.00)",
+	"(87 < 50)",
+	"(45 >= 50 && 0.00 != 0)",
+	"(1.00 && !0.000 && 100>=95)",
+	"((12 > 0) && (45.23 <= 100) || (3 == 1))",
+	"(0.00 || 1.00) && (17 < 120) && (35 > 30)",
+	"((7 % 2) == 1)",
+	"(2 ^ 10 > 1000)",
+	"((65535 & 255) == 255)",
+	"(-1 < 0)",
+	"(1500 - 250 * 2) / 10",
+	"(96.5 < 97 && 22 != 22 || 1.00)",
+	"(3 \\ 2 + 1 > 1)",
+	"(TRUE && NULL != 1)",
+};
+
+const size_t CalculateBenchmarkFormulaCount = lengthof(CalculateBenchmarkFormulas);
+
+void PrepareFormula(const char* szFormula, char* Buffer, size_t BufferLen)
+{
+	strcpy_s(Buffer, BufferLen, szFormula);
+
+	// Nothing to do unless there are letters in the formula
+	if (!std::any_of(Buffer, Buffer + strlen(Buffer), [](char ch) { return isalpha(static_cast<unsigned char>(ch)) != 0; }))
+		return;
+
+	_strupr_s(Buffer, BufferLen);
+
+	while (char* pNull = strstr(Buffer, "NULL"))
+	{
+		pNull[0] = '0';
+		pNull[1] = '.';
+		pNull[2] = '0';
+		pNull[3] = '0';
+	}
+
+	while (char* pTrue = strstr(Buffer, "TRUE"))
+	{
+		pTrue[0] = '1';
+		pTrue[1] = '.';
+		pTrue[2] = '0';
+		pTrue[3] = '0';
+	}
+
+	while (char* pFalse = strstr(Buffer, "FALSE"))
+	{
+		pFalse[0] = '0';
+		pFalse[1] = '.';
+		pFalse[2] = '0';
+		pFalse[3] = '0';
+		pFalse[4] = '0';
+	}
+}
+
+} // namespace mq
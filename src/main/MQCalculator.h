@@ -0,0 +1,41 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace mq {
+
+// Converts a formula to the form the calculator understands: upper case, with NULL, TRUE
+// and FALSE replaced by their values.
+void PrepareFormula(const char* szFormula, char* Buffer, size_t BufferLen);
+
+// Evaluates a prepared formula with the original shunting-yard calculator.
+bool FastCalculate(char* szFormula, double& Result);
+
+// Evaluates a prepared formula with a compiled program for its shape, falling back to
+// FastCalculate for anything that would report an error.
+bool CompiledCalculate(char* szFormula, double& Result);
+
+// Conditions like the ones that macros /if on, after their ${} have been filled in. Used to
+// compare FastCalculate against the compiled programs, none of them report an error.
+extern const char* const CalculateBenchmarkFormulas[];
+extern const size_t CalculateBenchmarkFormulaCount;
+
+// Reports an error in a formula. Not defined by the calculator, whatever links it in
+// decides where the errors go.
+void ReportCalculateError(const char* szMessage);
+
+} // namespace mq
@@ -19,16 +19,6 @@
 
 namespace mq {
 
-struct MQTimedCommand
-{
-	uint64_t         time;
-	std::string      command;
-	MQPluginHandle   pluginHandle;
-
-	MQTimedCommand*  pLast;
-	MQTimedCommand*  pNext;
-};
-
 struct MQCommand
 {
 	std::string      command;
@@ -284,13 +274,7 @@ MQCommandAPI::~MQCommandAPI()
 	}
 
 	m_delayedCommands.clear();
-
-	while (m_pTimedCommands)
-	{
-		MQTimedCommand* pNext = m_pTimedCommands->pNext;
-		delete m_pTimedCommands;
-		m_pTimedCommands = pNext;
-	}
+	m_timedCommands.Clear();
 
 	m_aliases.clear();
 }
@@ -305,6 +289,7 @@ void MQCommandAPI::OnPluginUnloaded(MQPlugin* plugin, const MQPluginHandle& plug
 		if (pCommand->pluginHandle == pluginHandle)
 		{
 			DebugSpew("Removing command left behind by %s: %s", plugin->name.c_str(), pCommand->command.c_str());
+			++m_commandGeneration;
 
 			if (pCommand->pNext)
 				pCommand->pNext->pLast = pCommand->pLast;
@@ -373,21 +358,21 @@ bool MQCommandAPI::InterpretCmd(const char* szFullLine, const MQCommandHandler&
 	return false;
 }
 
-bool MQCommandAPI::DispatchCommand(char* szCommand, char* szArgs, const MQCommandHandler& eqHandler)
+MQCommand* MQCommandAPI::FindDispatchCommand(const char* szCommand, bool inGame) const
 {
-	std::unique_lock lock(m_commandMutex);
+	const size_t length = strlen(szCommand);
 
 	MQCommand* pCommand = m_pCommands;
 	while (pCommand)
 	{
-		if (pCommand->inGameOnly && gGameState != GAMESTATE_INGAME)
+		if (pCommand->inGameOnly && !inGame)
 		{
 			pCommand = pCommand->pNext;
 			continue;
 		}
 
 		// Substring search
-		int Pos = _strnicmp(szCommand, pCommand->command.c_str(), strlen(szCommand));
+		int Pos = _strnicmp(szCommand, pCommand->command.c_str(), length);
 		if (Pos < 0)
 		{
 			// command not found
@@ -395,33 +380,43 @@ bool MQCommandAPI::DispatchCommand(char* szCommand, char* szArgs, const MQComman
 		}
 
 		if (Pos == 0)
-		{
-			lock.unlock();
+			return pCommand;
 
-			// the parser version is 2, or It's not version 2 and we're allowing command parses
-			if (pCommand->parse && (gParserVersion == 2 || (gParserVersion != 2 && bAllowCommandParse)))
-			{
-				ParseMacroParameter(szArgs, MAX_STRING);
-			}
+		pCommand = pCommand->pNext;
+	}
 
-			if (pCommand->eq && eqHandler != nullptr)
-			{
-				strcat_s(szCommand, MAX_STRING, " ");
-				strcat_s(szCommand, MAX_STRING, szArgs);
+	return nullptr;
+}
 
-				eqHandler(pLocalPlayer, szCommand);
-			}
-			else
-			{
-				pCommand->handler(pLocalPlayer, szArgs);
-			}
+bool MQCommandAPI::DispatchCommand(char* szCommand, char* szArgs, const MQCommandHandler& eqHandler)
+{
+	std::unique_lock lock(m_commandMutex);
 
-			return true;
-		}
-		pCommand = pCommand->pNext;
+	MQCommand* pCommand = FindDispatchCommand(szCommand, gGameState == GAMESTATE_INGAME);
+	if (!pCommand)
+		return false;
+
+	lock.unlock();
+
+	// the parser version is 2, or It's not version 2 and we're allowing command parses
+	if (pCommand->parse && (gParserVersion == 2 || (gParserVersion != 2 && bAllowCommandParse)))
+	{
+		ParseMacroParameter(szArgs, MAX_STRING);
 	}
 
-	return false;
+	if (pCommand->eq && eqHandler != nullptr)
+	{
+		strcat_s(szCommand, MAX_STRING, " ");
+		strcat_s(szCommand, MAX_STRING, szArgs);
+
+		eqHandler(pLocalPlayer, szCommand);
+	}
+	else
+	{
+		pCommand->handler(pLocalPlayer, szArgs);
+	}
+
+	return true;
 }
 
 bool MQCommandAPI::DispatchBind(char* szCommand, char* szArgs)
@@ -487,6 +482,7 @@ void MQCommandAPI::DoCommand(const char* szLine, bool delayed,
 	}
 
 	WeDidStuff();
+	InvalidateFrameMemo();
 
 	char szTheCmd[MAX_STRING] = { 0 };
 	strcpy_s(szTheCmd, szLine);
@@ -602,11 +598,96 @@ void MQCommandAPI::DoCommand(const char* szLine, bool delayed,
 	}
 }
 
+// Looks up the command a macro line will run, the same way DoCommand would when in game. Lines
+// that need anything besides a plain dispatch (aliases, blocks, labels, eq commands and binds)
+// are left unbound.
+void MQCommandAPI::BindMacroLine(MQMacroLine& line)
+{
+	std::unique_lock lock(m_commandMutex);
+
+	MQBoundCommand& bound = line.BoundCommand;
+	bound = MQBoundCommand();
+	bound.Generation = m_commandGeneration;
+
+	if (line.Command.length() >= MAX_STRING)
+		return;
+
+	char szArg1[MAX_STRING] = { 0 };
+	GetArg(szArg1, line.Command.c_str(), 1);
+
+	switch (szArg1[0])
+	{
+	case 0:
+	case ':':
+	case '{':
+	case '}':
+	case ';':
+	case '[':
+		return;
+
+	default: break;
+	}
+
+	if (m_aliases.find(szArg1) != m_aliases.end())
+		return;
+
+	// eq commands are forwarded to the client with the whole line, leave those to DoCommand.
+	MQCommand* pCommand = FindDispatchCommand(szArg1, true);
+	if (!pCommand || pCommand->eq)
+		return;
+
+	const char* szArgs = GetNextArg(line.Command.c_str());
+
+	bound.pCommand = pCommand;
+	bound.ArgsOffset = static_cast<uint16_t>(szArgs - line.Command.c_str());
+	bound.ArgsHaveData = strstr(szArgs, "${") != nullptr;
+}
+
+// Runs a macro line. This is the same as DoCommand, but lines with a bound command are
+// dispatched directly.
+void MQCommandAPI::DoMacroLine(MQMacroLine& line)
+{
+	std::unique_lock lock(m_commandMutex);
+
+	if (line.BoundCommand.Generation != m_commandGeneration)
+		BindMacroLine(line);
+
+	const MQBoundCommand& bound = line.BoundCommand;
+	if (!bound.pCommand || gGameState != GAMESTATE_INGAME)
+	{
+		DoCommand(line.Command.c_str(), false);
+		return;
+	}
+
+	WeDidStuff();
+	InvalidateFrameMemo();
+
+	// the handler can end the macro, so don't use the line after calling it.
+	char szOriginalLine[MAX_STRING] = { 0 };
+	strcpy_s(szOriginalLine, line.Command.c_str());
+
+	char szArgs[MAX_STRING] = { 0 };
+	strcpy_s(szArgs, szOriginalLine + bound.ArgsOffset);
+
+	MQCommand* pCommand = bound.pCommand;
+
+	// same rules as DispatchCommand, there is nothing to parse without a ${
+	if (bound.ArgsHaveData && pCommand->parse && (gParserVersion == 2 || bAllowCommandParse))
+	{
+		ParseMacroParameter(szArgs, MAX_STRING);
+	}
+
+	pCommand->handler(pLocalPlayer, szArgs);
+
+	strcpy_s(szLastCommand, szOriginalLine);
+}
+
 bool MQCommandAPI::AddCommand(std::string_view command, MQCommandHandler handler,
 	bool EQ /* = false */, bool Parse /* = true */, bool InGame /* = false */,
 	const MQPluginHandle& pluginHandle /* = mqplugin::ThisPluginHandle */)
 {
 	DebugSpew("AddCommand(%.*s)", command.length(), command.data());
+	++m_commandGeneration;
 
 	MQCommand* pCommand = new MQCommand;
 	pCommand->command = command;
@@ -697,6 +778,7 @@ bool MQCommandAPI::RemoveCommand(std::string_view command,
 				m_pCommands = pCommand->pNext;
 			delete pCommand;
 
+			++m_commandGeneration;
 			return true;
 		}
 
@@ -759,6 +841,7 @@ bool MQCommandAPI::AddAlias(const std::string& shortCommand, const std::string&
 	auto [iter2, added] = m_aliases.emplace(std::piecewise_construct,
 		std::forward_as_tuple(shortCommand),
 		std::forward_as_tuple(shortCommand, longCommand, pluginHandle));
+	++m_commandGeneration;
 
 	if (writeToIni)
 	{
@@ -785,6 +868,7 @@ bool MQCommandAPI::RemoveAlias(const std::string& shortCommand,
 	DeletePrivateProfileKey("Aliases", alias.match, mq::internal_paths::MQini);
 	
 	m_aliases.erase(iter);
+	++m_commandGeneration;
 	return true;
 }
 
@@ -859,7 +943,7 @@ void MQCommandAPI::LoadAliases()
 
 void MQCommandAPI::PulseCommands()
 {
-	if (m_delayedCommands.empty() && !m_pTimedCommands)
+	if (m_delayedCommands.empty() && m_timedCommands.empty())
 	{
 		return;
 	}
@@ -881,53 +965,18 @@ void MQCommandAPI::PulseCommands()
 	}
 
 	// handle timed commands
-	uint64_t Now = MQGetTickCount64();
-
-	while (m_pTimedCommands && m_pTimedCommands->time <= Now)
-	{
-		MQTimedCommand* pNext = m_pTimedCommands->pNext;
-		DoCommand(m_pTimedCommands->command.c_str(), false, m_pTimedCommands->pluginHandle);
-
-		delete m_pTimedCommands;
-		m_pTimedCommands = pNext;
-	}
+	m_timedCommands.Process(MQGetTickCount64());
 }
 
 void MQCommandAPI::TimedCommand(const char* command, int msDelay, const MQPluginHandle& pluginHandle /* = mqplugin::ThisPluginHandle */)
 {
 	std::scoped_lock lock(m_commandMutex);
 
-	MQTimedCommand* pNew = new MQTimedCommand;
-	pNew->time = msDelay + MQGetTickCount64();
-	pNew->command = command;
-	pNew->pluginHandle = pluginHandle;
-
-	// insert into list
-	if (!m_pTimedCommands || m_pTimedCommands->time >= pNew->time)
-	{
-		pNew->pNext = m_pTimedCommands;
-		pNew->pLast = nullptr;
-		m_pTimedCommands = pNew;
-		return;
-	}
-
-	MQTimedCommand* pLast = m_pTimedCommands;
-	MQTimedCommand* pNode = m_pTimedCommands->pNext;
-
-	while (pNode)
-	{
-		if (pNew->time <= pNode->time)
+	m_timedCommands.Schedule(msDelay + MQGetTickCount64(),
+		[this, command = std::string(command), pluginHandle]()
 		{
-			break;
-		}
-
-		pLast = pNode;
-		pNode = pNode->pNext;
-	}
-
-	pLast->pNext = pNew;
-	pNew->pLast = pLast;
-	pNew->pNext = pNode;
+			DoCommand(command.c_str(), false, pluginHandle);
+		});
 }
 
 //============================================================================
@@ -1029,6 +1078,7 @@ void MQCommandAPI::Cmd_Alias(const char* szLine)
 	if (ci_equals(szName, "reload"))
 	{
 		m_aliases.clear();
+		++m_commandGeneration;
 
 		LoadAliases();
 		WriteChatf("%d aliases loaded.", m_aliases.size());
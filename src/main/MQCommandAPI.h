@@ -20,6 +20,7 @@
 
 #include "mq/base/PluginHandle.h"
 #include "mq/api/CommandAPI.h"
+#include "mq/base/TimerQueue.h"
 
 #include <mutex>
 
@@ -27,8 +28,8 @@ namespace mq {
 
 //============================================================================
 
-struct MQTimedCommand;
 struct MQCommand;
+struct MQMacroLine;
 
 class MQCommandAPI
 {
@@ -54,6 +55,10 @@ public:
 	bool IsCommand(std::string_view command) const;
 	MQCommand* FindCommand(std::string_view command) const;
 
+	// Macro lines
+	void BindMacroLine(MQMacroLine& line);
+	void DoMacroLine(MQMacroLine& line);
+
 	// Aliases
 	bool AddAlias(const std::string& shortCommand, const std::string& longCommand,
 		bool writeToIni, const MQPluginHandle& pluginHandle = mqplugin::ThisPluginHandle);
@@ -73,6 +78,7 @@ private:
 	void LoadAliases();
 	void RewriteAliases();
 
+	MQCommand* FindDispatchCommand(const char* szCommand, bool inGame) const;
 	bool DispatchCommand(char* szCommand, char* szArgs, const MQCommandHandler& eqHandler);
 	bool DispatchBind(char* szCommand, char* szArgs);
 
@@ -102,7 +108,8 @@ private:
 	std::vector<DelayedCommand> m_delayedCommands;
 
 	MQCommand* m_pCommands = nullptr;
-	MQTimedCommand* m_pTimedCommands = nullptr;
+	uint32_t m_commandGeneration = 1;        // changes whenever commands or aliases do
+	TimerQueue m_timedCommands;
 
 	std::recursive_mutex m_commandMutex;
 };
@@ -1795,6 +1795,7 @@ bool CMQ2Alerts::RemoveAlertFromList(uint32_t Id, MQSpawnSearch* pSearchSpawn)
 			if (SearchSpawnMatchesSearchSpawn(pSearch, pSearchSpawn))
 			{
 				alertMap.erase(iter);
+				++m_generation;
 				return true;
 			}
 		}
@@ -1822,6 +1823,7 @@ bool CMQ2Alerts::AddNewAlertList(uint32_t Id, MQSpawnSearch* pSearchSpawn)
 	}
 
 	m_alertMap[Id].push_back(*pSearchSpawn);
+	++m_generation;
 	return true;
 }
 
@@ -1835,6 +1837,7 @@ void CMQ2Alerts::FreeAlerts(uint32_t id)
 	if (alertIter != m_alertMap.end())
 	{
 		m_alertMap.erase(alertIter);
+		++m_generation;
 		WriteChatf("Alert list %d cleared.", id);
 	}
 	else
@@ -1877,6 +1880,13 @@ bool CMQ2Alerts::AlertExist(uint32_t List)
 	return m_alertMap.find(List) != m_alertMap.end();
 }
 
+uint32_t CMQ2Alerts::GetGeneration() const
+{
+	std::scoped_lock lock(m_mutex);
+
+	return m_generation;
+}
+
 bool CMQ2Alerts::ListAlerts(char* szOut, size_t max)
 {
 	std::scoped_lock lock(m_mutex);
@@ -18,15 +18,133 @@
 #include "MQCommandAPI.h"
 #include "MQDataAPI.h"
 
+#include "mq/base/StringArena.h"
+
+#include <numeric>
+
 namespace mq {
 
-std::vector<std::weak_ptr<MQTransient>> s_objectMap;
-std::mutex s_objectMapMutex;
 uint32_t bmParseMacroData;
 
 static void SetGameStateDataAPI(int);
+static void ZoneChangedDataAPI();
 static void UnloadPluginDataAPI(const char*);
 
+// State of the ${} expression that is being evaluated on this thread. The strings that members
+// and TLOs return live in the arena until the next outermost evaluation starts, which is as
+// long as the contents of DataTypeTemp used to last.
+struct MQEvaluationContext
+{
+	StringArena Strings;
+	int Depth = 0;
+};
+
+static thread_local MQEvaluationContext s_evaluation;
+
+// Marks an outermost evaluation: ParseMacroData, ParseMQ2DataPortion or a compiled expression.
+// Anything evaluated from inside a member joins the evaluation that is already running.
+class MQScopedEvaluation
+{
+public:
+	MQScopedEvaluation()
+	{
+		if (s_evaluation.Depth++ == 0)
+			s_evaluation.Strings.Reset();
+	}
+
+	~MQScopedEvaluation()
+	{
+		--s_evaluation.Depth;
+	}
+
+	MQScopedEvaluation(const MQScopedEvaluation&) = delete;
+	MQScopedEvaluation& operator=(const MQScopedEvaluation&) = delete;
+};
+
+// Gives a TLO or member a DataTypeTemp of its own for the duration of the call, so that it can't
+// overwrite the value it is operating on or a result that a nested evaluation returned. The
+// buffer goes back to the arena right away unless the result points into memory that was
+// allocated during the call.
+class MQScopedDataTypeTemp
+{
+public:
+	explicit MQScopedDataTypeTemp(const MQTypeVar& result)
+		: m_result(result)
+		, m_marker(s_evaluation.Strings.GetMarker())
+	{
+		char* buffer = s_evaluation.Strings.Allocate(SGlobalBuffer::bufferSize);
+		buffer[0] = 0;
+
+		DataTypeTemp.push_buffer(buffer);
+	}
+
+	~MQScopedDataTypeTemp()
+	{
+		DataTypeTemp.pop_buffer();
+
+		if (!m_result.IsType(MQVarPtr::VariantIdx::Ptr)
+			|| !s_evaluation.Strings.AllocatedSince(m_marker, std::get<void*>(m_result.Data)))
+		{
+			s_evaluation.Strings.Rewind(m_marker);
+		}
+	}
+
+	MQScopedDataTypeTemp(const MQScopedDataTypeTemp&) = delete;
+	MQScopedDataTypeTemp& operator=(const MQScopedDataTypeTemp&) = delete;
+
+private:
+	const MQTypeVar& m_result;
+	StringArena::Marker m_marker;
+};
+
+// Bumped to invalidate everything in the frame memo at once. A memoized result is only used if
+// it was stored during the current generation.
+static std::atomic<uint32_t> s_frameMemoGeneration{ 1 };
+
+void InvalidateFrameMemo()
+{
+	++s_frameMemoGeneration;
+}
+
+// Invalidates the frame memo once a method returns. Methods are how an expression changes game
+// state, so nothing memoized before or during one can be trusted afterwards.
+class MQScopedMethodCall
+{
+public:
+	explicit MQScopedMethodCall(bool isMethod)
+		: m_isMethod(isMethod)
+	{
+	}
+
+	~MQScopedMethodCall()
+	{
+		if (m_isMethod)
+			InvalidateFrameMemo();
+	}
+
+	MQScopedMethodCall(const MQScopedMethodCall&) = delete;
+	MQScopedMethodCall& operator=(const MQScopedMethodCall&) = delete;
+
+private:
+	bool m_isMethod;
+};
+
+char* StoreEvaluationString(std::string_view value)
+{
+	// Outside of an evaluation, results go where they always have. The lua plugin relies on this
+	// to keep them in a buffer of its own.
+	if (s_evaluation.Depth == 0)
+	{
+		const size_t length = std::min(value.length(), DataTypeTemp.size() - 1);
+		memcpy(&DataTypeTemp[0], value.data(), length);
+		DataTypeTemp[length] = 0;
+
+		return &DataTypeTemp[0];
+	}
+
+	return s_evaluation.Strings.Store(value);
+}
+
 static MQModule s_DataAPIModule = {
 	"DataAPI",                      // Name
 	false,                          // CanUnload
@@ -39,8 +157,8 @@ static MQModule s_DataAPIModule = {
 	nullptr,
 	nullptr,
 	nullptr,
-	nullptr,
-	nullptr,
+	ZoneChangedDataAPI,             // BeginZone
+	ZoneChangedDataAPI,             // EndZone
 	nullptr,
 	UnloadPluginDataAPI
 };
@@ -56,55 +174,187 @@ struct MQDataTypeRegistration
 //============================================================================
 // Observed objects (Why are these here under MQDataAPI?)
 
-// This guarantees the validity of all weak pointers inside the map, while keeping the size from growing without bound as we add pointers
-static void PruneObservedEQObjects()
+// The observers of EQ objects, keyed by the address of the object they observe so that
+// invalidating an object only visits its own observers. Transients that don't report an
+// address are kept in a separate list and compared one by one, like before.
+//
+// Once an address is invalidated its observers are dropped, they can never match again, and a
+// new object at the same address starts with an empty list. Expired observers are removed from
+// a list whenever it is added to, and from the whole registry once it has doubled in size since
+// the last sweep, so that pruning costs O(1) per add.
+class MQObservedObjectRegistry
 {
-	std::scoped_lock lock(s_objectMapMutex);
+public:
+	void Add(const std::shared_ptr<MQTransient>& object)
+	{
+		std::scoped_lock lock(m_mutex);
 
-	s_objectMap.erase(std::remove_if(
-		std::begin(s_objectMap),
-		std::end(s_objectMap),
-		[](const std::weak_ptr<MQTransient>& weak)
+		if (void* address = object->GetObservedAddress())
 		{
-			return weak.expired();
-		}),
-		std::end(s_objectMap));
-}
+			Observers& observers = m_observers[address];
+			m_size -= RemoveExpired(observers);
+			observers.emplace_back(object);
+		}
+		else
+		{
+			m_unaddressed.emplace_back(object);
+		}
 
-static void SetGameStateDataAPI(int)
-{
-	PruneObservedEQObjects();
+		if (++m_size >= m_sweepSize)
+			SweepLocked();
+	}
+
+	void Invalidate(void* address)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		auto iter = m_observers.find(address);
+		if (iter != m_observers.end())
+		{
+			InvalidateObservers(iter->second);
+
+			m_size -= iter->second.size();
+			m_observers.erase(iter);
+		}
+
+		for (const std::weak_ptr<MQTransient>& weak : m_unaddressed)
+		{
+			std::shared_ptr<MQTransient> object = weak.lock();
+			if (object && *object == address)
+			{
+				object->Invalidate();
+				++m_invalidated;
+			}
+		}
+	}
+
+	void InvalidateAll()
+	{
+		std::scoped_lock lock(m_mutex);
+
+		for (const auto& [address, observers] : m_observers)
+			InvalidateObservers(observers);
+		InvalidateObservers(m_unaddressed);
+
+		m_observers.clear();
+		m_unaddressed.clear();
+		m_size = 0;
+	}
+
+	// Drops the observers whose objects no longer exist.
+	void Sweep()
+	{
+		std::scoped_lock lock(m_mutex);
+
+		SweepLocked();
+	}
+
+	MQObservedObjectStats GetStats() const
+	{
+		std::scoped_lock lock(m_mutex);
+
+		MQObservedObjectStats stats;
+		stats.Observers = m_size;
+		stats.Objects = m_observers.size();
+		stats.Invalidated = m_invalidated;
+		stats.Sweeps = m_sweeps;
+
+		for (const auto& [address, observers] : m_observers)
+			stats.LiveObservers += CountLive(observers);
+		stats.LiveObservers += CountLive(m_unaddressed);
+
+		return stats;
+	}
+
+private:
+	using Observers = std::vector<std::weak_ptr<MQTransient>>;
+
+	static constexpr size_t MinSweepSize = 256;
+
+	void SweepLocked()
+	{
+		for (auto iter = m_observers.begin(); iter != m_observers.end();)
+		{
+			m_size -= RemoveExpired(iter->second);
+
+			if (iter->second.empty())
+				iter = m_observers.erase(iter);
+			else
+				++iter;
+		}
 
-	std::scoped_lock lock(s_objectMapMutex);
+		m_size -= RemoveExpired(m_unaddressed);
 
-	for (const auto& weak : s_objectMap)
+		m_sweepSize = (std::max)(MinSweepSize, m_size * 2);
+		++m_sweeps;
+	}
+
+	static size_t RemoveExpired(Observers& observers)
+	{
+		const size_t size = observers.size();
+
+		observers.erase(std::remove_if(observers.begin(), observers.end(),
+			[](const std::weak_ptr<MQTransient>& weak) { return weak.expired(); }), observers.end());
+
+		return size - observers.size();
+	}
+
+	static size_t CountLive(const Observers& observers)
+	{
+		return std::count_if(observers.begin(), observers.end(),
+			[](const std::weak_ptr<MQTransient>& weak) { return !weak.expired(); });
+	}
+
+	void InvalidateObservers(const Observers& observers)
 	{
-		weak.lock()->Invalidate();
+		for (const std::weak_ptr<MQTransient>& weak : observers)
+		{
+			if (std::shared_ptr<MQTransient> object = weak.lock())
+			{
+				object->Invalidate();
+				++m_invalidated;
+			}
+		}
 	}
+
+	mutable std::mutex m_mutex;
+	std::unordered_map<const void*, Observers> m_observers;
+	Observers m_unaddressed;
+
+	size_t m_size = 0;
+	size_t m_sweepSize = MinSweepSize;
+	uint64_t m_invalidated = 0;
+	uint64_t m_sweeps = 0;
+};
+
+static MQObservedObjectRegistry s_observedObjects;
+
+static void SetGameStateDataAPI(int)
+{
+	InvalidateFrameMemo();
+	s_observedObjects.InvalidateAll();
+}
+
+static void ZoneChangedDataAPI()
+{
+	InvalidateFrameMemo();
 }
 
 // don't need a dropper because it will remove itself once the shared_ptr destroys itself
 void AddObservedEQObject(const std::shared_ptr<MQTransient>& Object)
 {
-	PruneObservedEQObjects();
-
-	std::scoped_lock lock(s_objectMapMutex);
-
-	s_objectMap.emplace_back(Object);
+	s_observedObjects.Add(Object);
 }
 
 // but we do need an invalidation method, which takes a void pointer because all we need to care about is the address of the object being invalidated
 void InvalidateObservedEQObject(void* Object)
 {
-	PruneObservedEQObjects();
-
-	std::scoped_lock lock(s_objectMapMutex);
+	s_observedObjects.Invalidate(Object);
+}
 
-	for (const auto& weak : s_objectMap)
-	{
-		if (*weak.lock() == Object)
-			weak.lock()->Invalidate();
-	}
+MQObservedObjectStats GetObservedObjectStats()
+{
+	return s_observedObjects.GetStats();
 }
 
 void UnloadPluginDataAPI(const char* Name)
@@ -112,7 +362,7 @@ void UnloadPluginDataAPI(const char* Name)
 	// if we attempt to prune objects held by plugins after the plugin
 	// is unloaded, we get a crash. Force a pruning every time a plugin
 	// is unloaded to prevent that.
-	PruneObservedEQObjects();
+	s_observedObjects.Sweep();
 }
 
 //============================================================================
@@ -162,6 +412,12 @@ bool MQDataAPI::AddDataType(MQ2Type& Type, const MQPluginHandle& pluginHandle)
 	TypeRec rec = { &Type, pluginHandle };
 
 	auto result = m_dataTypeMap.emplace(Type.GetName(), rec);
+	if (result.second)
+	{
+		ClearCompiledDataExpressions();
+		m_typeDispatchValid = false;
+	}
+
 	return result.second;
 }
 
@@ -183,6 +439,8 @@ bool MQDataAPI::RemoveDataType(MQ2Type& Type, const MQPluginHandle& pluginHandle
 
 	// The type existed. Erase it.
 	m_dataTypeMap.erase(iter);
+	ClearCompiledDataExpressions();
+	m_typeDispatchValid = false;
 	return true;
 }
 
@@ -222,6 +480,7 @@ bool MQDataAPI::AddTopLevelObject(const char* szName, MQTopLevelObjectFunction F
 
 	// put the new item into the map
 	m_tloMap.emplace(szName, std::move(rec));
+	ClearCompiledDataExpressions();
 	return true;
 }
 
@@ -244,6 +503,7 @@ bool MQDataAPI::RemoveTopLevelObject(const char* szName, const MQPluginHandle& p
 	}
 
 	m_tloMap.erase(iter);
+	ClearCompiledDataExpressions();
 	return true;
 }
 
@@ -258,6 +518,17 @@ MQTopLevelObject* MQDataAPI::FindTopLevelObject(const char* szName) const
 	return iter->second.tlo.get();
 }
 
+bool MQDataAPI::SetTopLevelObjectFrameStable(const char* szName, bool frameStable /* = true */)
+{
+	std::scoped_lock lock(m_mutex);
+
+	auto iter = m_tloMap.find(szName);
+	if (iter == m_tloMap.end())
+		return false;
+
+	iter->second.tlo->FrameStable = frameStable;
+	return true;
+}
 
 bool MQDataAPI::AddTypeExtension(const char* szName, MQ2Type* extension, const MQPluginHandle& pluginHandle)
 {
@@ -275,6 +546,7 @@ bool MQDataAPI::AddTypeExtension(const char* szName, MQ2Type* extension, const M
 
 	// insert extension into the record
 	record.push_back(rec);
+	m_typeDispatchValid = false;
 	return true;
 }
 
@@ -303,11 +575,115 @@ bool MQDataAPI::RemoveTypeExtension(const char* szName, MQ2Type* extension, cons
 	if (record.empty())
 		m_typeExtensions.erase(iter);
 
+	m_typeDispatchValid = false;
 	return true;
 }
 
+const MQDataAPI::TypeDispatch* MQDataAPI::GetTypeDispatch(MQ2Type* type) const
+{
+	if (!m_typeDispatchValid || m_typeDispatchGeneration != MQ2Type::GetMembersGeneration())
+		BuildTypeDispatch();
+
+	auto iter = m_typeDispatch.find(type);
+	if (iter == m_typeDispatch.end())
+		return nullptr;
+
+	return iter->second.get();
+}
+
+void MQDataAPI::BuildTypeDispatch() const
+{
+	std::scoped_lock lock(m_mutex);
+
+	m_typeDispatch.clear();
+	m_typeDispatchGeneration = MQ2Type::GetMembersGeneration();
+	m_typeDispatchValid = true;
+
+	auto addNames = [](std::unordered_set<std::string>& names, MQ2Type* type)
+	{
+		if (!type)
+			return;
+
+		for (std::string& name : type->GetMemberNames())
+			names.insert(std::move(name));
+		for (std::string& name : type->GetMethodNames())
+			names.insert(std::move(name));
+	};
+
+	for (const auto& [name, rec] : m_dataTypeMap)
+	{
+		auto dispatch = std::make_unique<TypeDispatch>();
+
+		auto extIter = m_typeExtensions.find(name);
+		if (extIter != m_typeExtensions.end() && !extIter->second.empty())
+		{
+			dispatch->hasExtensions = true;
+
+			for (const ExtensionRec& ext : extIter->second)
+			{
+				CollectExtensionMembers(ext.extentionType, *dispatch, 0);
+
+				addNames(dispatch->names, ext.extentionType);
+				addNames(dispatch->names, ext.extentionType->GetParent());
+			}
+
+			// whatever no extension claims is left to the type itself
+			for (std::string& member : rec.type->GetMemberNames())
+				dispatch->members.emplace(std::move(member), rec.type);
+
+			if (MQ2Type* pParent = rec.type->GetParent())
+			{
+				for (std::string& member : pParent->GetMemberNames())
+					dispatch->members.emplace(std::move(member), rec.type);
+			}
+
+			addNames(dispatch->names, rec.type);
+			addNames(dispatch->names, rec.type->GetParent());
+		}
+
+		m_typeDispatch.emplace(rec.type, std::move(dispatch));
+	}
+}
+
+void MQDataAPI::CollectExtensionMembers(MQ2Type* type, TypeDispatch& dispatch, int depth) const
+{
+	// arbitrary limit to avoid infinite looping with cyclical extensions
+	if (depth > 10)
+		return;
+
+	// extensions of the extension come first, members already claimed keep their owner.
+	auto extIter = m_typeExtensions.find(type->GetName());
+	if (extIter != m_typeExtensions.end())
+	{
+		for (const ExtensionRec& rec : extIter->second)
+			CollectExtensionMembers(rec.extentionType, dispatch, depth + 1);
+	}
+
+	for (std::string& member : type->GetMemberNames())
+		dispatch.members.emplace(std::move(member), type);
+
+	// inherited members are answered by the extension's GetMember too
+	if (MQ2Type* pParent = type->GetParent())
+	{
+		for (std::string& member : pParent->GetMemberNames())
+			dispatch.members.emplace(std::move(member), type);
+	}
+}
+
 bool MQDataAPI::FindMacroDataMember(MQ2Type* Type, const std::string& strMember) const
 {
+	if (const TypeDispatch* dispatch = GetTypeDispatch(Type))
+	{
+		if (dispatch->hasExtensions)
+			return dispatch->names.count(strMember) != 0;
+
+		if (Type->CanEvaluateMethodOrMember(strMember))
+			return true;
+
+		MQ2Type* pParent = Type->GetParent();
+		return pParent && pParent->CanEvaluateMethodOrMember(strMember);
+	}
+
 	// search for extensions on this type
 	auto extIter = m_typeExtensions.find(Type->GetName());
 	if (extIter != m_typeExtensions.end())
@@ -343,6 +719,52 @@ bool MQDataAPI::FindMacroDataMember(MQ2Type* Type, const std::string& strMember)
 // -1 = no exists, 0 = fail, 1 = success
 MQDataAPI::EvaluateResult MQDataAPI::EvaluateMacroDataMember(MQ2Type* type, MQVarPtr& VarPtr,
 	MQTypeVar& Result, const std::string& Member, char* pIndex, bool checkFirst) const
+{
+	MQScopedMethodCall methodCall(gbFrameMemoization && type->FindMethod(Member));
+
+	if (checkFirst)
+		return EvaluateMacroDataMemberByName(type, VarPtr, Result, Member, pIndex, true);
+
+	const TypeDispatch* dispatch = GetTypeDispatch(type);
+	if (!dispatch)
+		return EvaluateMacroDataMemberByName(type, VarPtr, Result, Member, pIndex, false);
+
+	// The dispatch table can be rebuilt by anything GetMember does, so take what we need first.
+	const bool hasExtensions = dispatch->hasExtensions;
+	MQ2Type* owner = type;
+	bool known = false;
+
+	if (hasExtensions)
+	{
+		auto iter = dispatch->members.find(Member);
+		if (iter != dispatch->members.end())
+		{
+			owner = iter->second;
+			known = true;
+		}
+	}
+
+	if (owner != type)
+	{
+		return owner->GetMember(std::move(VarPtr), Member.c_str(), pIndex, Result)
+			? EvaluateResult::Success : EvaluateResult::Failure;
+	}
+
+	if (type->GetMember(std::move(VarPtr), Member.c_str(), pIndex, Result))
+	{
+		return EvaluateResult::Success;
+	}
+
+	if (!hasExtensions)
+	{
+		known = type->FindMember(Member) || type->InheritedMember(Member);
+	}
+
+	return known ? EvaluateResult::Failure : EvaluateResult::NotFound;
+}
+
+MQDataAPI::EvaluateResult MQDataAPI::EvaluateMacroDataMemberByName(MQ2Type* type, MQVarPtr& VarPtr,
+	MQTypeVar& Result, const std::string& Member, char* pIndex, bool checkFirst) const
 {
 	// search for extensions on this type
 	auto extIter = m_typeExtensions.find(type->GetName());
@@ -354,7 +776,7 @@ MQDataAPI::EvaluateResult MQDataAPI::EvaluateMacroDataMember(MQ2Type* type, MQVa
 			MQ2Type* ext = rec.extentionType;
 
 			// optimize for failure case, check if exists first
-			auto result = EvaluateMacroDataMember(ext, VarPtr, Result, Member, pIndex, true);
+			auto result = EvaluateMacroDataMemberByName(ext, VarPtr, Result, Member, pIndex, true);
 			if (result != EvaluateResult::NotFound)
 				return result;
 		}
@@ -482,7 +904,13 @@ static bool CallFunction(const char* name, const char* args)
 				WriteChatf("\ayWARNING: Delays in subs called with variable syntax are ignored: (\ao%s\ay) Line \ao%i\ay called (\ao%s\ay) from (\a-o%s\ay) Line \a-o%i\ay (\a-o%s\ay) ", ml.SourceFile.c_str(), ml.LineNumber, ml.Command.c_str(), ml_saved.SourceFile.c_str(), ml_saved.LineNumber, ml_saved.Command.c_str());
 			}
 		}
-		DoCommand(&subBlock->second.Command[0], false);
+		{
+			// The sub runs inside the evaluation that called it, so the arena wouldn't be reset until it
+			// returns. Free what each line used once it is done, /return copies its value elsewhere.
+			StringArena::Scope lineScope(s_evaluation.Strings);
+
+			DoCommand(&subBlock->second.Command[0], false);
+		}
 
 		if (!gMacroBlock)
 			break;
@@ -502,6 +930,26 @@ static bool CallFunction(const char* name, const char* args)
 	return false;
 }
 
+static bool EvaluateMacroVariable(MQDataVar* DataVar, char* pIndex, MQTypeVar& Result)
+{
+	if (pIndex[0])
+	{
+		if (DataVar->Var.Type == datatypes::pArrayType)
+		{
+			auto dataArray = DataVar->Var.Get<datatypes::CDataArray>();
+
+			if (!dataArray->GetElement(pIndex, Result))
+				return false;
+		}
+	}
+	else
+	{
+		Result = DataVar->Var;
+	}
+
+	return true;
+}
+
 bool MQDataAPI::EvaluateDataExpression(MQTypeVar& Result, const char* pStart, char* pIndex,
 	bool allowFunction/* = false*/) const
 {
@@ -516,33 +964,22 @@ bool MQDataAPI::EvaluateDataExpression(MQTypeVar& Result, const char* pStart, ch
 
 		if (MQTopLevelObject* tlo = FindTopLevelObject(pStart))
 		{
+			MQScopedDataTypeTemp temp(Result);
+
 			if (!tlo->Function(pIndex, Result))
 				return false;
 		}
 		else if (MQDataVar* DataVar = FindMacroVariable(pStart))
 		{
-			if (pIndex[0])
-			{
-				if (DataVar->Var.Type == datatypes::pArrayType)
-				{
-					auto dataArray = DataVar->Var.Get<datatypes::CDataArray>();
-
-					if (!dataArray->GetElement(pIndex, Result))
-						return false;
-				}
-			}
-			else
-			{
-				Result = DataVar->Var;
-			}
+			if (!EvaluateMacroVariable(DataVar, pIndex, Result))
+				return false;
 		}
 		else if (allowFunction && FunctionExists(pStart))
 		{
 			if (!CallFunction(pStart, pIndex))
 				return false;
 
-			strcpy_s(DataTypeTemp, gMacroStack->Return.c_str());
-			Result.Ptr = &DataTypeTemp[0];
+			Result.Ptr = StoreEvaluationString(gMacroStack->Return);
 			Result.Type = datatypes::pStringType;
 		}
 		else
@@ -564,6 +1001,7 @@ bool MQDataAPI::EvaluateDataExpression(MQTypeVar& Result, const char* pStart, ch
 	{
 		MQVarPtr VarPtr = Result;
 		MQ2Type* pType = Result.Type;
+		MQScopedDataTypeTemp temp(Result);
 
 		auto result = EvaluateMacroDataMember(pType, std::move(VarPtr), Result, pStart, pIndex, false);
 		if (result == EvaluateResult::NotFound)
@@ -601,6 +1039,7 @@ void MQDataAPI::RegisterTopLevelObjects()
 	AddTopLevelObject("Plugin", datatypes::MQ2PluginType::dataPlugin);
 	AddTopLevelObject("Select", datatypes::dataSelect);
 	AddTopLevelObject("SubDefined", datatypes::dataSubDefined);
+	AddTopLevelObject("Turbo", datatypes::MQ2TurboType::dataTurbo);
 
 	// EQ Types
 	AddTopLevelObject("Achievement", datatypes::MQ2AchievementManagerType::dataAchievement);
@@ -658,10 +1097,18 @@ void MQDataAPI::RegisterTopLevelObjects()
 	AddTopLevelObject("TeleportationItem", datatypes::MQ2KeyRingType::dataTeleportationItem);
 #endif
 #endif // HAS_KEYRING_WINDOW
+
+	// TLOs that only read game state, see MQ2Type::SetMemberFrameStable.
+	for (const char* tlo : { "Group", "Me", "NearestSpawn", "Pet", "Spawn", "SpawnCount", "Target" })
+	{
+		SetTopLevelObjectFrameStable(tlo);
+	}
 }
 
 bool MQDataAPI::ParseMQ2DataPortion(char* szOriginal, MQTypeVar& Result) const
 {
+	MQScopedEvaluation evaluation;
+
 	Result.Type = nullptr;
 	Result.Int64 = 0;
 
@@ -747,120 +1194,741 @@ bool MQDataAPI::ParseMQ2DataPortion(char* szOriginal, MQTypeVar& Result) const
 				return false;
 			}
 
-			if (pNewType == datatypes::pTypeType)
-			{
-				Result.Ptr = Result.Type;
-				Result.Type = datatypes::pTypeType;
-			}
-			else
-			{
-				Result.Type = pNewType;
-			}
+			if (pNewType == datatypes::pTypeType)
+			{
+				Result.Ptr = Result.Type;
+				Result.Type = datatypes::pTypeType;
+			}
+			else
+			{
+				Result.Type = pNewType;
+			}
+
+			if (pPos[1] == '.')
+			{
+				++pPos;
+				pStart = &pPos[1];
+			}
+			else if (!pPos[1])
+			{
+				//Result.Type->ToString(Result.VarPtr,szCurrent);
+				return true;
+			}
+			else
+			{
+				MQ2DataError("Invalid character found after typecast ')%s'", &pPos[1]);
+				return false;
+			}
+		}
+		else
+		{
+			if (*pPos == '[')
+			{
+				// index
+				*pPos = 0;
+				++pPos;
+				functionAllowed = true;
+				Quote = false;
+				bool BeginParam = true;
+
+				while (true)
+				{
+					if (*pPos == 0)
+					{
+						MQ2DataError("Unmatched bracket or invalid character following bracket found in index: '%s'", pIndex);
+						return false;
+					}
+
+					if (BeginParam)
+					{
+						BeginParam = false;
+						if (*pPos == '\"')
+						{
+							Quote = true;
+							++pPos;
+							continue;
+						}
+					}
+
+					if (Quote)
+					{
+						if (*pPos == '\"')
+						{
+							if (pPos[1] == ']' || pPos[1] == ',')
+							{
+								Quote = false;
+								++pPos;
+								continue;
+							}
+						}
+					}
+					else
+					{
+						if (*pPos == ']')
+						{
+							if (pPos[1] == '.' || pPos[1] == '(' || pPos[1] == 0)
+								break;// valid end
+						}
+						else if (*pPos == ',')
+							BeginParam = true;
+					}
+
+					*pIndex = *pPos;
+					++pIndex;
+					++pPos;
+				}
+
+				*pIndex = 0;
+				pIndex = &Index[0];
+				*pPos = 0;
+			}
+			else
+			{
+				if (*pPos == '.')
+				{
+					// end of this one, but more to come!
+					*pPos = 0;
+					if (pStart == pPos)
+					{
+						if (!Result.Type)
+						{
+							MQ2DataError("Encountered member access without object");
+							return false;
+						}
+
+						return true;
+					}
+
+					if (!EvaluateDataExpression(Result, pStart, pIndex))
+						return false;
+
+					pStart = &pPos[1];
+					Index[0] = 0;
+				}
+			}
+		}
+		++pPos;
+	}
+}
+
+//============================================================================
+// Compiled data expressions
+//
+// A data expression (the text between ${ and }) is compiled into a list of steps that
+// mirrors what ParseMQ2DataPortion does while scanning: evaluate a name with an optional
+// index, or apply a typecast. TLOs and typecast types are resolved at compile time, so
+// evaluating a cached expression only has to walk the steps. Macro variables can come and
+// go, so those are looked up when evaluating, through a cache of the slot they were found in.
+
+struct MQDataAPI::CompiledDataExpression
+{
+	enum class StepType
+	{
+		Evaluate,
+		Cast,
+	};
+
+	struct Step
+	{
+		StepType type = StepType::Evaluate;
+		std::string name;                       // TLO, variable or member name
+		std::string index;                      // contents of [], with quotes removed
+		MQTopLevelObject* tlo = nullptr;        // resolved TLO, only for the first step
+		MQ2Type* castType = nullptr;            // target type of a typecast
+		bool allowFunction = false;
+
+		// where the variable was last found, only for the first step
+		mutable MQVariableLookupCache variableCache;
+
+		// True if both steps do the same thing to the same value.
+		bool SameAs(const Step& other) const
+		{
+			return type == other.type
+				&& name == other.name
+				&& index == other.index
+				&& tlo == other.tlo
+				&& castType == other.castType
+				&& allowFunction == other.allowFunction;
+		}
+	};
+
+	std::string source;
+	std::vector<Step> steps;
+
+	// Expressions that fail to compile are handed to the original parser instead, so that
+	// they produce the same errors.
+	bool useParser = false;
+
+	// The result of the last evaluation, if every step was frame stable and the result is a plain
+	// value. Only used on the main thread.
+	mutable uint32_t memoGeneration = 0;
+	mutable MQTypeVar memoResult;
+	mutable std::string memoString;
+	mutable FrameMemoStats* memoStats = nullptr;
+};
+
+// The cache is keyed by expression text after inner ${} have been substituted, so expressions
+// with changing indexes like ${Spawn[${i}].ID} add an entry for every value. To keep it bounded
+// without losing the expressions that are in use, it is kept in two generations of up to half
+// this size each. When the current one is full it becomes the previous one and the old previous
+// one is dropped. Anything found in the previous one moves back to the current one, so only
+// expressions that weren't used for a whole generation are thrown away.
+static constexpr size_t MaxCompiledDataExpressions = 8192;
+
+std::shared_ptr<MQDataAPI::CompiledDataExpression> MQDataAPI::CompileDataExpression(std::string_view expression) const
+{
+	using StepType = CompiledDataExpression::StepType;
+
+	auto expr = std::make_shared<CompiledDataExpression>();
+	expr->source = expression;
+
+	auto useParser = [&expr]()
+	{
+		expr->steps.clear();
+		expr->useParser = true;
+		return expr;
+	};
+
+	// The original parser works in a MAX_STRING buffer, so let it handle anything that won't fit.
+	if (expr->source.length() >= MAX_STRING)
+		return useParser();
+
+	const char* pPos = expr->source.c_str();
+	const char* pStart = pPos;
+	const char* pNameEnd = nullptr;
+	std::string index;
+	bool functionAllowed = false;
+
+	auto addEvaluate = [&](const char* pEnd, bool allowFunction)
+	{
+		CompiledDataExpression::Step step;
+		step.name.assign(pStart, (pNameEnd ? pNameEnd : pEnd) - pStart);
+		step.index = index;
+		step.allowFunction = allowFunction;
+
+		if (expr->steps.empty())
+			step.tlo = FindTopLevelObject(step.name.c_str());
+
+		expr->steps.push_back(std::move(step));
+	};
+
+	while (true)
+	{
+		if (*pPos == 0)
+		{
+			if (pStart == pPos)
+			{
+				if (expr->steps.empty())
+					return useParser();
+
+				return expr;
+			}
+
+			addEvaluate(pPos, functionAllowed);
+			return expr;
+		}
+
+		if (*pPos == '(')
+		{
+			if (pStart == pPos)
+			{
+				if (expr->steps.empty())
+					return useParser();
+
+				return expr;
+			}
+
+			addEvaluate(pPos, false);
+
+			++pPos;
+			const char* pType = pPos;
+
+			while (*pPos != ')')
+			{
+				if (!*pPos)
+					return useParser();
+				++pPos;
+			}
+
+			CompiledDataExpression::Step step;
+			step.type = StepType::Cast;
+			step.castType = FindDataType(std::string(pType, pPos - pType).c_str());
+			if (!step.castType)
+				return useParser();
+
+			expr->steps.push_back(std::move(step));
+
+			// Note: the index is intentionally not reset here, the original parser doesn't either.
+			if (pPos[1] == '.')
+			{
+				++pPos;
+				pStart = &pPos[1];
+				pNameEnd = nullptr;
+			}
+			else if (!pPos[1])
+			{
+				return expr;
+			}
+			else
+			{
+				return useParser();
+			}
+		}
+		else if (*pPos == '[')
+		{
+			pNameEnd = pPos;
+			++pPos;
+			functionAllowed = true;
+			bool Quote = false;
+			bool BeginParam = true;
+			index.clear();
+
+			while (true)
+			{
+				if (*pPos == 0)
+					return useParser();
+
+				if (BeginParam)
+				{
+					BeginParam = false;
+					if (*pPos == '\"')
+					{
+						Quote = true;
+						++pPos;
+						continue;
+					}
+				}
+
+				if (Quote)
+				{
+					if (*pPos == '\"')
+					{
+						if (pPos[1] == ']' || pPos[1] == ',')
+						{
+							Quote = false;
+							++pPos;
+							continue;
+						}
+					}
+				}
+				else
+				{
+					if (*pPos == ']')
+					{
+						if (pPos[1] == '.' || pPos[1] == '(' || pPos[1] == 0)
+							break;
+					}
+					else if (*pPos == ',')
+						BeginParam = true;
+				}
+
+				index.push_back(*pPos);
+				++pPos;
+			}
+		}
+		else if (*pPos == '.')
+		{
+			if (pStart == pPos)
+			{
+				if (expr->steps.empty())
+					return useParser();
+
+				return expr;
+			}
+
+			addEvaluate(pPos, false);
+
+			pStart = &pPos[1];
+			pNameEnd = nullptr;
+			index.clear();
+		}
+
+		++pPos;
+	}
+}
+
+bool MQDataAPI::EvaluateCompiledDataExpression(const CompiledDataExpression& expr, MQTypeVar& Result) const
+{
+	using StepType = CompiledDataExpression::StepType;
+	MQScopedEvaluation evaluation;
+
+	Result.Type = nullptr;
+	Result.Int64 = 0;
+
+	// Expressions that start at a frame stable TLO can be answered from the memo. Whether the
+	// members are frame stable depends on the types that the steps before them return, so that
+	// is checked as they are evaluated.
+	const uint32_t memoGeneration = s_frameMemoGeneration.load(std::memory_order_relaxed);
+	bool memoize = gbFrameMemoization && !expr.steps.empty() && expr.steps[0].tlo
+		&& expr.steps[0].tlo->FrameStable && IsMainThread();
+
+	if (memoize && expr.memoGeneration == memoGeneration)
+	{
+		++expr.memoStats->Hits;
+
+		Result = expr.memoResult;
+		if (Result.Type == datatypes::pStringType)
+			Result.Ptr = StoreEvaluationString(expr.memoString);
+
+		return true;
+	}
+
+	for (size_t i = 0; i < expr.steps.size(); ++i)
+	{
+		const CompiledDataExpression::Step& step = expr.steps[i];
+
+		if (memoize && Result.Type && step.type == StepType::Evaluate
+			&& !Result.Type->IsMemberFrameStable(step.name))
+		{
+			memoize = false;
+		}
+
+		if (!EvaluateCompiledStep(expr, i, Result))
+			return false;
+	}
+
+	if (memoize)
+		StoreFrameMemo(expr, Result, memoGeneration);
+
+	return true;
+}
+
+bool MQDataAPI::EvaluateCompiledStep(const CompiledDataExpression& expr, size_t index, MQTypeVar& Result) const
+{
+	const CompiledDataExpression::Step& step = expr.steps[index];
+
+	if (step.type == CompiledDataExpression::StepType::Cast)
+	{
+		if (!Result.Type)
+			return false;
+
+		if (step.castType == datatypes::pTypeType)
+		{
+			Result.Ptr = Result.Type;
+			Result.Type = datatypes::pTypeType;
+		}
+		else
+		{
+			Result.Type = step.castType;
+		}
+
+		return true;
+	}
+
+	// Datatypes receive the index as a mutable buffer, so each step gets a fresh copy.
+	char Index[MAX_STRING];
+	strcpy_s(Index, step.index.c_str());
+
+	if (!Result.Type)
+	{
+		if (step.tlo)
+		{
+			MQScopedDataTypeTemp temp(Result);
+
+			if (!step.tlo->Function(Index, Result))
+				return false;
+		}
+		else if (!gWarning && !gUndeclaredVars.empty() && gUndeclaredVars.count(step.name))
+		{
+			return false;
+		}
+		else if (MQDataVar* DataVar = FindMacroVariable(step.name, step.variableCache))
+		{
+			if (!EvaluateMacroVariable(DataVar, Index, Result))
+				return false;
+		}
+		else if (!EvaluateDataExpression(Result, step.name.c_str(), Index, step.allowFunction))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		MQVarPtr VarPtr = Result;
+		MQ2Type* pType = Result.Type;
+		MQScopedDataTypeTemp temp(Result);
+
+		auto result = EvaluateMacroDataMember(pType, VarPtr, Result, step.name, Index, false);
+		if (result == EvaluateResult::NotFound)
+			MQ2DataError("No such '%s' member '%s'", pType->GetName(), step.name.c_str());
+
+		if (result != EvaluateResult::Success)
+			return false;
+	}
+
+	return true;
+}
+
+void MQDataAPI::StoreFrameMemo(const CompiledDataExpression& expr, const MQTypeVar& Result, uint32_t generation) const
+{
+	using namespace datatypes;
+
+	// Only plain values are kept. Anything that points at game data could be freed before the
+	// memo is invalidated, and strings are copied because they live in the evaluation's arena.
+	if (Result.Type == pStringType)
+	{
+		const char* str = static_cast<const char*>(Result.Ptr);
+		expr.memoString = str ? str : "";
+	}
+	else if (Result.Type != pIntType && Result.Type != pInt64Type && Result.Type != pFloatType
+		&& Result.Type != pDoubleType && Result.Type != pBoolType && Result.Type != pByteType)
+	{
+		return;
+	}
+
+	if (!expr.memoStats)
+	{
+		std::string path;
+		for (const CompiledDataExpression::Step& step : expr.steps)
+		{
+			if (step.type != CompiledDataExpression::StepType::Evaluate)
+				continue;
+
+			if (!path.empty())
+				path += '.';
+			path += step.name;
+		}
+
+		expr.memoStats = &m_frameMemoStats[path];
+	}
+
+	++expr.memoStats->Misses;
+
+	expr.memoResult = Result;
+	expr.memoGeneration = generation;
+}
+
+std::vector<std::pair<std::string, MQDataAPI::FrameMemoStats>> MQDataAPI::GetFrameMemoStats() const
+{
+	return { m_frameMemoStats.begin(), m_frameMemoStats.end() };
+}
+
+std::shared_ptr<MQDataAPI::CompiledDataExpression> MQDataAPI::GetCompiledDataExpression(std::string_view expression) const
+{
+	std::shared_ptr<CompiledDataExpression> expr;
+	uint32_t generation;
+
+	{
+		std::scoped_lock lock(m_compiledMutex);
+
+		auto iter = m_compiledExpressions.find(expression);
+		if (iter != m_compiledExpressions.end())
+		{
+			expr = iter->second;
+		}
+		else
+		{
+			iter = m_previousCompiledExpressions.find(expression);
+			if (iter != m_previousCompiledExpressions.end())
+			{
+				expr = std::move(iter->second);
+				m_previousCompiledExpressions.erase(iter);
+
+				StoreCompiledDataExpression(expr);
+			}
+		}
+
+		generation = m_compiledGeneration;
+	}
+
+	if (!expr)
+	{
+		expr = CompileDataExpression(expression);
+
+		std::scoped_lock lock(m_compiledMutex);
+
+		// Don't keep the result if something it depends on was removed while we were compiling.
+		if (generation == m_compiledGeneration)
+			StoreCompiledDataExpression(expr);
+	}
+
+	return expr;
+}
+
+// Adds an expression to the current generation of the cache. m_compiledMutex must be held.
+void MQDataAPI::StoreCompiledDataExpression(std::shared_ptr<CompiledDataExpression> expr) const
+{
+	if (m_compiledExpressions.size() >= MaxCompiledDataExpressions / 2)
+	{
+		m_previousCompiledExpressions = std::move(m_compiledExpressions);
+		m_compiledExpressions.clear();
+	}
+
+	const std::string_view key = expr->source;
+	m_compiledExpressions.emplace(key, std::move(expr));
+}
+
+bool MQDataAPI::ParseCompiledDataPortion(std::string_view expression, MQTypeVar& Result) const
+{
+	std::shared_ptr<CompiledDataExpression> expr = GetCompiledDataExpression(expression);
+
+	if (expr->useParser)
+	{
+		char szBuffer[MAX_STRING] = { 0 };
+		strncpy_s(szBuffer, expression.data(), std::min<size_t>(expression.length(), MAX_STRING - 1));
+
+		return ParseMQ2DataPortion(szBuffer, Result);
+	}
+
+	return EvaluateCompiledDataExpression(*expr, Result);
+}
+
+void MQDataAPI::ClearCompiledDataExpressions() const
+{
+	std::scoped_lock lock(m_compiledMutex);
+
+	m_compiledExpressions.clear();
+	m_previousCompiledExpressions.clear();
+	++m_compiledGeneration;
+}
+
+//============================================================================
+// Batches of data expressions
+//
+// The compiled steps of every expression in a batch are merged into a prefix tree, so that
+// Me.Buff[1].Name and Me.Buff[1].Duration evaluate Me and Buff[1] once and then each apply
+// their last member to the same buff.
+
+struct MQDataAPI::DataExpressionBatchNode
+{
+	// The step is expr->steps[step], the first expression that reached this node.
+	const CompiledDataExpression* expr = nullptr;
+	size_t step = 0;
+
+	std::vector<std::unique_ptr<DataExpressionBatchNode>> children;
+
+	// The expressions that end with this step.
+	std::vector<size_t> expressions;
+};
+
+// Removes the ${ and } around an expression, if the whole thing is a single ${}.
+static std::string_view StripDataExpressionBraces(std::string_view expression)
+{
+	if (expression.length() < 3 || expression.substr(0, 2) != "${" || expression.back() != '}')
+		return expression;
+
+	int depth = 0;
+	for (size_t i = 1; i < expression.length(); ++i)
+	{
+		if (expression[i] == '{')
+		{
+			++depth;
+		}
+		else if (expression[i] == '}' && --depth == 0)
+		{
+			if (i != expression.length() - 1)
+				break;
+
+			return expression.substr(2, expression.length() - 3);
+		}
+	}
+
+	return expression;
+}
+
+std::vector<std::string> MQDataAPI::ParseDataPortions(const std::vector<std::string>& expressions) const
+{
+	std::vector<std::string> results(expressions.size(), "NULL");
+	std::vector<std::shared_ptr<CompiledDataExpression>> compiled(expressions.size());
+	DataExpressionBatchNode root;
+
+	char szBuffer[MAX_STRING];
+
+	for (size_t i = 0; i < expressions.size(); ++i)
+	{
+		std::string_view expression = StripDataExpressionBraces(expressions[i]);
+
+		// Inner ${} are substituted first, the same as ParseMacroData would.
+		if (expression.find("${") != std::string_view::npos)
+		{
+			strncpy_s(szBuffer, expression.data(), std::min<size_t>(expression.length(), MAX_STRING - 1));
+			ParseMacroData(szBuffer, MAX_STRING);
+			expression = szBuffer;
+		}
+
+		compiled[i] = GetCompiledDataExpression(expression);
+		if (compiled[i]->useParser)
+			continue;
+
+		DataExpressionBatchNode* node = &root;
+		for (size_t stepIndex = 0; stepIndex < compiled[i]->steps.size(); ++stepIndex)
+		{
+			const CompiledDataExpression::Step& step = compiled[i]->steps[stepIndex];
+
+			auto iter = std::find_if(node->children.begin(), node->children.end(),
+				[&step](const std::unique_ptr<DataExpressionBatchNode>& child)
+				{
+					return child->expr->steps[child->step].SameAs(step);
+				});
 
-			if (pPos[1] == '.')
-			{
-				++pPos;
-				pStart = &pPos[1];
-			}
-			else if (!pPos[1])
+			if (iter == node->children.end())
 			{
-				//Result.Type->ToString(Result.VarPtr,szCurrent);
-				return true;
-			}
-			else
-			{
-				MQ2DataError("Invalid character found after typecast ')%s'", &pPos[1]);
-				return false;
+				auto child = std::make_unique<DataExpressionBatchNode>();
+				child->expr = compiled[i].get();
+				child->step = stepIndex;
+
+				node->children.push_back(std::move(child));
+				iter = std::prev(node->children.end());
 			}
+
+			node = iter->get();
 		}
-		else
-		{
-			if (*pPos == '[')
-			{
-				// index
-				*pPos = 0;
-				++pPos;
-				functionAllowed = true;
-				Quote = false;
-				bool BeginParam = true;
 
-				while (true)
-				{
-					if (*pPos == 0)
-					{
-						MQ2DataError("Unmatched bracket or invalid character following bracket found in index: '%s'", pIndex);
-						return false;
-					}
+		node->expressions.push_back(i);
+	}
 
-					if (BeginParam)
-					{
-						BeginParam = false;
-						if (*pPos == '\"')
-						{
-							Quote = true;
-							++pPos;
-							continue;
-						}
-					}
+	MQScopedEvaluation evaluation;
 
-					if (Quote)
-					{
-						if (*pPos == '\"')
-						{
-							if (pPos[1] == ']' || pPos[1] == ',')
-							{
-								Quote = false;
-								++pPos;
-								continue;
-							}
-						}
-					}
-					else
-					{
-						if (*pPos == ']')
-						{
-							if (pPos[1] == '.' || pPos[1] == '(' || pPos[1] == 0)
-								break;// valid end
-						}
-						else if (*pPos == ',')
-							BeginParam = true;
-					}
+	// Expressions that didn't compile go through the original parser one by one.
+	for (size_t i = 0; i < compiled.size(); ++i)
+	{
+		if (!compiled[i]->useParser)
+			continue;
 
-					*pIndex = *pPos;
-					++pIndex;
-					++pPos;
-				}
+		const StringArena::Marker marker = s_evaluation.Strings.GetMarker();
+		strncpy_s(szBuffer, compiled[i]->source.c_str(), std::min<size_t>(compiled[i]->source.length(), MAX_STRING - 1));
 
-				*pIndex = 0;
-				pIndex = &Index[0];
-				*pPos = 0;
-			}
-			else
-			{
-				if (*pPos == '.')
-				{
-					// end of this one, but more to come!
-					*pPos = 0;
-					if (pStart == pPos)
-					{
-						if (!Result.Type)
-						{
-							MQ2DataError("Encountered member access without object");
-							return false;
-						}
+		MQTypeVar Result;
+		if (ParseMQ2DataPortion(szBuffer, Result) && Result.Type && Result.Type->ToString(Result.VarPtr, szBuffer))
+			results[i] = szBuffer;
 
-						return true;
-					}
+		s_evaluation.Strings.Rewind(marker);
+	}
 
-					if (!EvaluateDataExpression(Result, pStart, pIndex))
-						return false;
+	MQTypeVar Result;
+	Result.Type = nullptr;
+	Result.Int64 = 0;
 
-					pStart = &pPos[1];
-					Index[0] = 0;
-				}
+	EvaluateDataExpressionBatch(root, Result, results);
+	return results;
+}
+
+void MQDataAPI::EvaluateDataExpressionBatch(const DataExpressionBatchNode& node, const MQTypeVar& value,
+	std::vector<std::string>& results) const
+{
+	char szResult[MAX_STRING];
+
+	for (const std::unique_ptr<DataExpressionBatchNode>& child : node.children)
+	{
+		// Nothing that this step or the ones after it return is needed once their results have
+		// been converted to text, so their strings can go back to the arena.
+		const StringArena::Marker marker = s_evaluation.Strings.GetMarker();
+
+		MQTypeVar Result = value;
+		if (EvaluateCompiledStep(*child->expr, child->step, Result))
+		{
+			for (size_t index : child->expressions)
+			{
+				szResult[0] = 0;
+
+				if (Result.Type && Result.Type->ToString(Result.VarPtr, szResult))
+					results[index] = szResult;
 			}
+
+			EvaluateDataExpressionBatch(*child, Result, results);
 		}
-		++pPos;
+
+		s_evaluation.Strings.Rewind(marker);
 	}
 }
 
@@ -992,20 +2060,16 @@ std::string GetMacroVarData(std::string_view strVarToParse)
 		// Strip the ${ and } off of the variable to pass it to ParseMQ2DataPortion
 		strVarToParse = strVarToParse.substr(2, strVarToParse.length() - 3);
 
-		// TODO:  Check to see if this exceeds MAX_STRING and error.
-		// Create a place to hold our "current" string and make sure its long enough to pass on (these
-		// functions expect a string buffer of MAX_STRING length).
-		std::string currentStr{ strVarToParse };
-		currentStr.resize(MAX_STRING);
-
 		MQTypeVar Result;
 
+		// ToString expects a buffer of MAX_STRING length.
+		char szResult[MAX_STRING];
+		szResult[0] = 0;
+
 		// If the parse was successful and there is a result type and we could convert that type to a string
-		if (pDataAPI->ParseMQ2DataPortion(&currentStr[0], Result) && Result.Type && Result.Type->ToString(Result.VarPtr, &currentStr[0]))
+		if (pDataAPI->ParseCompiledDataPortion(strVarToParse, Result) && Result.Type && Result.Type->ToString(Result.VarPtr, szResult))
 		{
-			// Set our return whatever szCurrent was modified to be (removing the additional null terminators
-			// due to the above resize)
-			strReturn = currentStr.erase(currentStr.find('\0'));
+			strReturn = szResult;
 		}
 	}
 	return strReturn;
@@ -1455,6 +2519,7 @@ std::string ModifyMacroString(std::string_view strOriginal, bool bParseOnce, Mod
 bool ParseMacroData(char* szOriginal, size_t BufferSize)
 {
 	MQScopedBenchmark bm(bmParseMacroData);
+	MQScopedEvaluation evaluation;
 
 	if (gParserVersion == 2)
 	{
@@ -1567,7 +2632,7 @@ bool ParseMacroData(char* szOriginal, size_t BufferSize)
 		{
 			MQTypeVar Result;
 
-			if (!pDataAPI->ParseMQ2DataPortion(szCurrent, Result) || !Result.Type || !Result.Type->ToString(Result.VarPtr, szCurrent))
+			if (!pDataAPI->ParseCompiledDataPortion(szCurrent, Result) || !Result.Type || !Result.Type->ToString(Result.VarPtr, szCurrent))
 			{
 				strcpy_s(szCurrent, "NULL");
 			}
@@ -1624,9 +2689,176 @@ bool ParseMacroData(char* szOriginal, size_t BufferSize)
 
 namespace datatypes {
 
+//============================================================================
+// MQTypeMemberIndex
+
+// The names of a type's members (or methods) placed with a perfect hash: the names are split
+// into small buckets, and each bucket gets the displacement that moves all of its names into
+// slots nobody else uses. A lookup is one hash of the name, two table reads and one compare,
+// whether the name exists or not.
+class MQTypeMemberIndex
+{
+public:
+	MQTypeMemberIndex(const std::unordered_map<std::string, int>& names,
+		const std::vector<std::unique_ptr<MQTypeMember>>& members)
+	{
+		// The names are copied so that the index doesn't depend on how long the strings that
+		// were passed to AddMember live.
+		std::vector<Key> keys;
+		keys.reserve(names.size());
+
+		for (const auto& [name, index] : names)
+		{
+			m_names += name;
+			keys.push_back({ name, members[index].get(), Hash(name) });
+		}
+
+		if (keys.empty())
+			return;
+
+		size_t offset = 0;
+		for (Key& key : keys)
+		{
+			key.Name = std::string_view(m_names).substr(offset, key.Name.size());
+			offset += key.Name.size();
+		}
+
+		// Start at a load of at most 80% and double the table in the unlikely case that some
+		// bucket can't be placed.
+		uint32_t slotCount = 1;
+		while (slotCount < keys.size() + keys.size() / 4)
+			slotCount <<= 1;
+
+		while (!Build(keys, slotCount))
+			slotCount <<= 1;
+	}
+
+	MQTypeMember* Find(std::string_view name) const
+	{
+		if (m_slots.empty())
+			return nullptr;
+
+		const uint64_t hash = Hash(name);
+		const Slot& slot = m_slots[SlotIndex(hash, m_displacements[BucketIndex(hash)])];
+
+		return slot.Member && slot.Name == name ? slot.Member : nullptr;
+	}
+
+private:
+	struct Key
+	{
+		std::string_view Name;
+		MQTypeMember* Member;
+		uint64_t Hash;
+	};
+
+	struct Slot
+	{
+		std::string_view Name;
+		MQTypeMember* Member = nullptr;
+	};
+
+	static constexpr uint32_t MaxDisplacement = 1 << 16;
+
+	static uint64_t Hash(std::string_view name)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (char c : name)
+		{
+			hash ^= static_cast<uint8_t>(c);
+			hash *= 1099511628211ull;
+		}
+
+		return hash;
+	}
+
+	uint32_t BucketIndex(uint64_t hash) const
+	{
+		return static_cast<uint32_t>(((hash >> 32) * m_bucketCount) >> 32);
+	}
+
+	uint32_t SlotIndex(uint64_t hash, uint32_t displacement) const
+	{
+		// splitmix64 finalizer, so that every displacement gives an unrelated set of slots
+		uint64_t value = hash + (displacement + 1) * 0x9e3779b97f4a7c15ull;
+		value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+		value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+		value ^= value >> 31;
+
+		return static_cast<uint32_t>(value) & m_slotMask;
+	}
+
+	bool Build(const std::vector<Key>& keys, uint32_t slotCount)
+	{
+		m_bucketCount = std::max<uint32_t>(1, static_cast<uint32_t>(keys.size() / 2));
+		m_slotMask = slotCount - 1;
+		m_displacements.assign(m_bucketCount, 0);
+		m_slots.assign(slotCount, Slot());
+
+		std::vector<std::vector<uint32_t>> buckets(m_bucketCount);
+		for (uint32_t i = 0; i < keys.size(); ++i)
+			buckets[BucketIndex(keys[i].Hash)].push_back(i);
+
+		// Place the largest buckets first, while the table is still mostly empty.
+		std::vector<uint32_t> order(m_bucketCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(),
+			[&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+		std::vector<uint32_t> positions;
+		for (uint32_t bucket : order)
+		{
+			const std::vector<uint32_t>& bucketKeys = buckets[bucket];
+			if (bucketKeys.empty())
+				break;
+
+			bool placed = false;
+			for (uint32_t displacement = 0; displacement < MaxDisplacement && !placed; ++displacement)
+			{
+				positions.clear();
+				placed = true;
+
+				for (uint32_t key : bucketKeys)
+				{
+					const uint32_t position = SlotIndex(keys[key].Hash, displacement);
+					if (m_slots[position].Member
+						|| std::find(positions.begin(), positions.end(), position) != positions.end())
+					{
+						placed = false;
+						break;
+					}
+
+					positions.push_back(position);
+				}
+
+				if (placed)
+				{
+					m_displacements[bucket] = displacement;
+
+					for (size_t i = 0; i < bucketKeys.size(); ++i)
+						m_slots[positions[i]] = { keys[bucketKeys[i]].Name, keys[bucketKeys[i]].Member };
+				}
+			}
+
+			if (!placed)
+				return false;
+		}
+
+		return true;
+	}
+
+	std::string m_names;
+	uint32_t m_bucketCount = 0;
+	uint32_t m_slotMask = 0;
+	std::vector<uint32_t> m_displacements;
+	std::vector<Slot> m_slots;
+};
+
 //============================================================================
 // MQ2Type
 
+static std::atomic<uint32_t> s_membersGeneration{ 0 };
+
 MQ2Type::MQ2Type(std::string_view newName, const MQPluginHandle& pluginHandle /* = mqplugin::ThisPluginHandle */)
 {
 	m_typeName = newName;
@@ -1667,73 +2899,114 @@ const char* MQ2Type::GetMemberName(int ID) const
 	return nullptr;
 }
 
-bool MQ2Type::GetMemberID(const char* Name, int& result) const
+const MQTypeMemberIndex* MQ2Type::GetIndex(std::atomic<const MQTypeMemberIndex*>& index,
+	const std::unordered_map<std::string, int>& names, const std::vector<std::unique_ptr<MQTypeMember>>& members) const
 {
+	if (const MQTypeMemberIndex* pIndex = index.load(std::memory_order_acquire))
+		return pIndex;
+
 	std::scoped_lock lock(m_mutex);
 
-	auto iter = MemberMap.find(Name);
-	if (iter == MemberMap.end())
+	// another thread may have built it while we waited for the lock
+	const MQTypeMemberIndex* pIndex = index.load(std::memory_order_relaxed);
+	if (!pIndex)
+	{
+		pIndex = m_indexes.emplace_back(std::make_unique<MQTypeMemberIndex>(names, members)).get();
+		index.store(pIndex, std::memory_order_release);
+	}
+
+	return pIndex;
+}
+
+bool MQ2Type::GetMemberID(const char* Name, int& result) const
+{
+	MQTypeMember* pMember = GetIndex(m_memberIndex, MemberMap, Members)->Find(Name);
+	if (!pMember)
 		return false;
 
-	int index = iter->second;
-	result = Members[index]->ID;
+	result = pMember->ID;
 	return true;
 }
 
 mq::MQTypeMember* MQ2Type::FindMember(const char* Name)
 {
-	std::scoped_lock lock(m_mutex);
+	return GetIndex(m_memberIndex, MemberMap, Members)->Find(Name);
+}
 
-	auto iter = MemberMap.find(Name);
-	if (iter == MemberMap.end())
-		return nullptr;
+mq::MQTypeMember* MQ2Type::FindMember(const std::string& Name)
+{
+	return GetIndex(m_memberIndex, MemberMap, Members)->Find(Name);
+}
 
-	int index = MemberMap[Name];
-	return Members[index].get();
+mq::MQTypeMember* MQ2Type::FindMethod(const char* Name)
+{
+	return GetIndex(m_methodIndex, MethodMap, Methods)->Find(Name);
 }
 
-mq::MQTypeMember* MQ2Type::FindMember(const std::string& Name)
+mq::MQTypeMember* MQ2Type::FindMethod(const std::string& Name)
 {
-	std::scoped_lock lock(m_mutex);
+	return GetIndex(m_methodIndex, MethodMap, Methods)->Find(Name);
+}
 
-	auto iter = MemberMap.find(Name);
-	if (iter == MemberMap.end())
-		return nullptr;
+bool MQ2Type::CanEvaluateMethodOrMember(const std::string& Name)
+{
+	// exists in method map?
+	return FindMember(Name) != nullptr || FindMethod(Name) != nullptr;
+}
+
+bool MQ2Type::IsMemberFrameStable(const std::string& Name)
+{
+	MQ2Type* pType = this;
+	int limit = 10; // arbitrary limit to avoid infinite looping with cyclical references
+
+	// GetMember falls back to the parent for members the type doesn't have, so that's where
+	// the answer comes from.
+	while (pType && limit-- > 0)
+	{
+		if (MQTypeMember* pMember = pType->FindMember(Name))
+			return pMember->FrameStable;
+
+		pType = pType->m_parent;
+	}
 
-	int index = MemberMap[Name];
-	return Members[index].get();
+	return false;
 }
 
-mq::MQTypeMember* MQ2Type::FindMethod(const char* Name)
+std::vector<std::string> MQ2Type::GetMemberNames() const
 {
 	std::scoped_lock lock(m_mutex);
 
-	auto iter = MethodMap.find(Name);
-	if (iter == MethodMap.end())
-		return nullptr;
+	std::vector<std::string> names;
+	names.reserve(MemberMap.size());
 
-	int index = iter->second;
-	return Methods[index].get();
+	for (const auto& [name, index] : MemberMap)
+		names.push_back(name);
+
+	return names;
 }
 
-mq::MQTypeMember* MQ2Type::FindMethod(const std::string& Name)
+std::vector<std::string> MQ2Type::GetMethodNames() const
 {
 	std::scoped_lock lock(m_mutex);
 
-	auto iter = MethodMap.find(Name);
-	if (iter == MethodMap.end())
-		return nullptr;
+	std::vector<std::string> names;
+	names.reserve(MethodMap.size());
 
-	int index = iter->second;
-	return Methods[index].get();
+	for (const auto& [name, index] : MethodMap)
+		names.push_back(name);
+
+	return names;
 }
 
-bool MQ2Type::CanEvaluateMethodOrMember(const std::string& Name)
+uint32_t MQ2Type::GetMembersGeneration()
 {
-	std::scoped_lock lock(m_mutex);
+	return s_membersGeneration.load(std::memory_order_acquire);
+}
 
-	// exists in method map?
-	return MemberMap.count(Name) != 0 || MethodMap.count(Name) != 0;
+void MQ2Type::SetInheritance(MQ2Type* pNewInherit)
+{
+	m_parent = pNewInherit;
+	++s_membersGeneration;
 }
 
 bool MQ2Type::AddMember(int id, const char* Name)
@@ -1762,6 +3035,20 @@ bool MQ2Type::AddMember(int id, const char* Name)
 
 	Members[index] = std::make_unique<MQTypeMember>(id, Name, 0);
 	MemberMap[Name] = index;
+	m_memberIndex.store(nullptr, std::memory_order_release);
+	++s_membersGeneration;
+	return true;
+}
+
+bool MQ2Type::SetMemberFrameStable(const char* Name, bool frameStable /* = true */)
+{
+	std::scoped_lock lock(m_mutex);
+
+	auto iter = MemberMap.find(Name);
+	if (iter == MemberMap.end() || !Members[iter->second])
+		return false;
+
+	Members[iter->second]->FrameStable = frameStable;
 	return true;
 }
 
@@ -1778,7 +3065,9 @@ bool MQ2Type::RemoveMember(const char* Name)
 
 	if (index < 0)
 		return false;
-	Members[index].reset();
+	m_removedMembers.push_back(std::move(Members[index]));
+	m_memberIndex.store(nullptr, std::memory_order_release);
+	++s_membersGeneration;
 	return true;
 }
 
@@ -1808,6 +3097,8 @@ bool MQ2Type::AddMethod(int ID, const char* Name)
 
 	Methods[index] = std::make_unique<MQTypeMember>(ID, Name, 1);
 	MethodMap[Name] = index;
+	m_methodIndex.store(nullptr, std::memory_order_release);
+	++s_membersGeneration;
 	return true;
 }
 
@@ -1824,7 +3115,9 @@ bool MQ2Type::RemoveMethod(const char* Name)
 
 	if (index < 0)
 		return false;
-	Methods[index].reset();
+	m_removedMembers.push_back(std::move(Methods[index]));
+	m_methodIndex.store(nullptr, std::memory_order_release);
+	++s_membersGeneration;
 	return true;
 }
 
@@ -1871,6 +3164,13 @@ char* ParseMacroParameter(char* szOriginal, size_t BufferSize)
 	return szOriginal;
 }
 
+std::vector<std::string> EvaluateDataExpressions(const std::vector<std::string>& expressions)
+{
+	MQScopedBenchmark bm(bmParseMacroData);
+
+	return pDataAPI->ParseDataPortions(expressions);
+}
+
 bool FindMacroDataMember(MQ2Type* Type, const std::string& Member)
 {
 	return pDataAPI->FindMacroDataMember(Type, Member);
@@ -22,8 +22,11 @@
 #include "mq/base/PluginHandle.h"
 #include "mq/api/MacroAPI.h"
 
+#include <map>
 #include <memory>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace mq {
 
@@ -43,6 +46,9 @@ public:
 
 	MQTopLevelObject* FindTopLevelObject(const char* szName) const;
 
+	// See MQ2Type::SetMemberFrameStable.
+	bool SetTopLevelObjectFrameStable(const char* szName, bool frameStable = true);
+
 	// DataTypes
 	bool AddDataType(MQ2Type& TypeInstance, const MQPluginHandle& pluginHandle = mqplugin::ThisPluginHandle);
 	bool RemoveDataType(MQ2Type& TypeInstance, const MQPluginHandle& pluginHandle = mqplugin::ThisPluginHandle);
@@ -86,9 +92,39 @@ public:
 
 	bool ParseMQ2DataPortion(char* szOriginal, MQTypeVar& Result) const;
 
+	// Same as ParseMQ2DataPortion, but the expression is compiled once and cached by its text, so
+	// repeated evaluations skip the scanning and the TLO/typecast lookups.
+	bool ParseCompiledDataPortion(std::string_view expression, MQTypeVar& Result) const;
+	void ClearCompiledDataExpressions() const;
+
+	// Evaluates many expressions at once and returns the text of their results. Steps that the
+	// expressions have in common are only evaluated once. See EvaluateDataExpressions.
+	std::vector<std::string> ParseDataPortions(const std::vector<std::string>& expressions) const;
+
+	// How often a member path (TLO.Member.Member, without indexes) was answered from the frame
+	// memo, and how often it had to be evaluated.
+	struct FrameMemoStats
+	{
+		uint64_t Hits = 0;
+		uint64_t Misses = 0;
+	};
+	std::vector<std::pair<std::string, FrameMemoStats>> GetFrameMemoStats() const;
+
 private:
 	void RegisterTopLevelObjects();
 
+	struct CompiledDataExpression;
+	std::shared_ptr<CompiledDataExpression> CompileDataExpression(std::string_view expression) const;
+	std::shared_ptr<CompiledDataExpression> GetCompiledDataExpression(std::string_view expression) const;
+	void StoreCompiledDataExpression(std::shared_ptr<CompiledDataExpression> expr) const;
+	bool EvaluateCompiledDataExpression(const CompiledDataExpression& expr, MQTypeVar& Result) const;
+	bool EvaluateCompiledStep(const CompiledDataExpression& expr, size_t index, MQTypeVar& Result) const;
+	void StoreFrameMemo(const CompiledDataExpression& expr, const MQTypeVar& Result, uint32_t generation) const;
+
+	struct DataExpressionBatchNode;
+	void EvaluateDataExpressionBatch(const DataExpressionBatchNode& node, const MQTypeVar& value,
+		std::vector<std::string>& results) const;
+
 	struct TLORec
 	{
 		std::unique_ptr<MQTopLevelObject> tlo;
@@ -110,7 +146,44 @@ private:
 	};
 	std::unordered_map<std::string, std::vector<ExtensionRec>> m_typeExtensions;
 
+	// A registered type merged with its extensions, so that evaluating a member takes one lookup
+	// by the type's address and one by the member's name, no matter how many extensions there are.
+	struct TypeDispatch
+	{
+		bool hasExtensions = false;
+
+		// Member name -> the extension (or the type itself) whose GetMember answers it, in the
+		// order EvaluateMacroDataMember would have tried them.
+		std::unordered_map<std::string, MQ2Type*> members;
+
+		// Every member and method name FindMacroDataMember accepts.
+		std::unordered_set<std::string> names;
+	};
+
+	// Returns nullptr for types that aren't registered, those are still looked up by name.
+	const TypeDispatch* GetTypeDispatch(MQ2Type* type) const;
+	void BuildTypeDispatch() const;
+	void CollectExtensionMembers(MQ2Type* type, TypeDispatch& dispatch, int depth) const;
+	EvaluateResult EvaluateMacroDataMemberByName(MQ2Type* type, MQVarPtr& VarPtr, MQTypeVar& Result,
+		const std::string& Member, char* pIndex, bool checkFirst) const;
+
+	// Rebuilt when types or extensions are added or removed, or when any type's members change.
+	mutable std::unordered_map<const MQ2Type*, std::unique_ptr<TypeDispatch>> m_typeDispatch;
+	mutable bool m_typeDispatchValid = false;
+	mutable uint32_t m_typeDispatchGeneration = 0;
+
 	mutable std::recursive_mutex m_mutex;
+
+	// Keys are views into the source text owned by the compiled expression. When the current map
+	// fills up it replaces the previous one, and expressions found in the previous one move back.
+	mutable std::unordered_map<std::string_view, std::shared_ptr<CompiledDataExpression>> m_compiledExpressions;
+	mutable std::unordered_map<std::string_view, std::shared_ptr<CompiledDataExpression>> m_previousCompiledExpressions;
+	mutable std::mutex m_compiledMutex;
+	mutable uint32_t m_compiledGeneration = 0;
+
+	// The memo is only used on the main thread, so these aren't locked. Entries are never removed
+	// because compiled expressions point at them.
+	mutable std::map<std::string, FrameMemoStats> m_frameMemoStats;
 };
 
 extern MQDataAPI* pDataAPI;
@@ -130,5 +203,21 @@ MQDataVar** FindVariableScope(const char* Name);
 bool DeleteMQ2DataVariable(const char* Name);
 void ClearMQ2DataVariables(MQDataVar** ppHead);
 
+// Where a variable name was last found. Compiled expressions keep one of these per variable so
+// that finding it again doesn't need to look the name up.
+struct MQVariableLookupCache
+{
+	uint32_t GlobalGeneration = 0;
+	MQDataVar* pGlobal = nullptr;
+	uint32_t LayoutId = 0;
+	int LayoutSize = 0;
+	int Slot = -1;
+};
+
+MQDataVar* FindMacroVariable(std::string_view Name, MQVariableLookupCache& cache);
+
+// Gives a new stack frame the variable layout of the sub it runs.
+void InitMacroStackVariables(MQMacroStack* pStack, int SubLine);
+
 
 } // namespace mq
@@ -15,6 +15,7 @@
 #include "pch.h"
 #include "MQ2Main.h"
 
+#include <mq/base/StringArena.h>
 #include <mq/utils/OS.h>
 
 #include <spdlog/spdlog.h>
@@ -83,6 +84,7 @@ uint32_t bmPluginsReloadUI = 0;
 uint32_t bmPluginsDrawHUD = 0;
 uint32_t bmPluginsSetGameState = 0;
 uint32_t bmCalculate = 0;
+uint32_t bmMacroTurbo = 0;
 uint32_t bmBeginZone = 0;
 uint32_t bmEndZone = 0;
 
@@ -508,6 +510,7 @@ int LoadPlugin(std::string_view pluginName, bool save)
 	pPlugin->LoadPlugin        = (fMQLoadPlugin)GetProcAddress(pPlugin->hModule, "OnLoadPlugin");
 	pPlugin->UnloadPlugin      = (fMQUnloadPlugin)GetProcAddress(pPlugin->hModule, "OnUnloadPlugin");
 	pPlugin->GetPluginInterface = (fMQGetPluginInterface)GetProcAddress(pPlugin->hModule, "GetPluginInterface");
+	pPlugin->WriteChatColorBatch = (fMQWriteChatColorBatch)GetProcAddress(pPlugin->hModule, "OnWriteChatColorBatch");
 
 	float* ftmp = (float*)GetProcAddress(pPlugin->hModule, "?MQ2Version@@3MA");
 	if (ftmp)
@@ -740,6 +743,52 @@ void ForEachPlugin(Callback&& callback)
 	}
 }
 
+// With gbBatchWriteChatColor, the lines written during a frame are collected here and handed to
+// the modules and plugins that export OnWriteChatColorBatch all at once on the next pulse. The
+// rest still get their OnWriteChatColor called when the line is written, so anything that reacts
+// to a line (lua events, for one) sees it in order with the chat that comes in from EQ.
+//
+// Lines written while a batch is being delivered go into the other one, so the batch being
+// delivered doesn't change under the subscribers.
+struct MQChatBatch
+{
+	StringArena Strings{ 16 * 1024 };
+	std::vector<MQChatLine> Lines;
+};
+
+static MQChatBatch s_chatBatches[2];
+static size_t s_currentChatBatch = 0;
+static bool s_chatBatchingStopped = false;           // set during shutdown, lines go straight out
+
+static void FlushWriteChatColorBatch()
+{
+	MQChatBatch& batch = s_chatBatches[s_currentChatBatch];
+	if (batch.Lines.empty())
+		return;
+
+	MQScopedBenchmark bm(bmWriteChatColor);
+
+	s_currentChatBatch = 1 - s_currentChatBatch;
+
+	const MQChatLine* lines = batch.Lines.data();
+	const size_t count = batch.Lines.size();
+
+	ForEachModule([&](const MQModule* module)
+		{
+			if (module->WriteChatColorBatch)
+				module->WriteChatColorBatch(lines, count);
+		});
+
+	ForEachPlugin([&](const MQPlugin* plugin)
+		{
+			if (plugin->WriteChatColorBatch)
+				plugin->WriteChatColorBatch(lines, count);
+		});
+
+	batch.Lines.clear();
+	batch.Strings.Reset();
+}
+
 void PluginsWriteChatColor(const char* Line, int Color, int Filter)
 {
 	if (!s_pluginsInitialized)
@@ -751,6 +800,38 @@ void PluginsWriteChatColor(const char* Line, int Color, int Filter)
 
 	MQScopedBenchmark bm(bmWriteChatColor);
 
+	if (gbBatchWriteChatColor && !s_chatBatchingStopped)
+	{
+		// The batch keeps both versions of the line, the plain text is made once for everyone.
+		MQChatBatch& batch = s_chatBatches[s_currentChatBatch];
+		const size_t len = strlen(Line);
+
+		char* plainText = batch.Strings.Allocate(len + 1);
+		StripMQChat(Line, plainText);
+
+		if (len)
+		{
+			CheckChatForEvent(plainText);
+
+			DebugSpew("WriteChatColor(%s)", Line);
+		}
+
+		batch.Lines.push_back({ batch.Strings.Store(Line), plainText, static_cast<uint32_t>(Color), static_cast<uint32_t>(Filter) });
+
+		ForEachModule([&](const MQModule* module)
+			{
+				if (module->WriteChatColor && !module->WriteChatColorBatch)
+					module->WriteChatColor(Line, Color, Filter);
+			});
+
+		ForEachPlugin([&](const MQPlugin* plugin)
+			{
+				if (plugin->WriteChatColor && !plugin->WriteChatColorBatch)
+					plugin->WriteChatColor(Line, Color, Filter);
+			});
+		return;
+	}
+
 	if (size_t len = strlen(Line))
 	{
 		std::unique_ptr<char[]> plainText = std::make_unique<char[]>(len + 1);
@@ -801,6 +882,8 @@ void PulsePlugins()
 
 	PluginDebug("PulsePlugins()");
 
+	FlushWriteChatColorBatch();
+
 	ForEachModule([](const MQModule* module)
 		{
 			if (module->Pulse)
@@ -1434,11 +1517,13 @@ void InitializePlugins()
 	bmPluginsDrawHUD = AddMQ2Benchmark("PluginsDrawHUD");
 	bmPluginsSetGameState = AddMQ2Benchmark("PluginsSetGameState");
 	bmCalculate = AddMQ2Benchmark("Calculate");
+	bmMacroTurbo = AddMQ2Benchmark("MacroTurbo");
 	bmBeginZone = AddMQ2Benchmark("BeginZone");
 	bmEndZone = AddMQ2Benchmark("EndZone");
 
 	// lock plugin list before manipulating it
 	std::scoped_lock lock(s_pluginsMutex);
+	s_chatBatchingStopped = false;
 	s_pluginsInitialized = true;
 
 	DebugSpew("Initializing plugins");
@@ -1455,9 +1540,13 @@ void InitializePlugins()
 
 void ShutdownPlugins()
 {
+	// Nothing will pulse again to deliver a batch, so deliver what's queued and stop batching.
+	FlushWriteChatColorBatch();
+	s_chatBatchingStopped = true;
 	s_pluginsInitialized = false;
 
 	UnloadPlugins();
+	FlushWriteChatColorBatch();
 	RemoveCommand("/plugin");
 }
 
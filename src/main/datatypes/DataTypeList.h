@@ -88,6 +88,7 @@ DATATYPE(MQ2TaskType, pTaskType, nullptr);
 DATATYPE(MQ2TicksType, pTicksType, nullptr);
 DATATYPE(MQ2TimeStampType, pTimeStampType, nullptr);
 DATATYPE(MQ2TimerType, pTimerType, nullptr);
+DATATYPE(MQ2TurboType, pTurboType, nullptr);
 DATATYPE(MQ2WindowType, pWindowType, nullptr);
 DATATYPE(MQ2MenuType, pMenuType, nullptr);
 DATATYPE(MQ2XTargetType, pXTargetType, pSpawnType);
@@ -711,6 +711,13 @@ MQ2CharacterType::MQ2CharacterType() : MQ2Type("character")
 	ScopedTypeMethod(CharacterMethods, Sit);
 	ScopedTypeMethod(CharacterMethods, Dismount);
 	ScopedTypeMethod(CharacterMethods, StopCast);
+
+	for (const char* member : { "CurrentHPs", "MaxHPs", "PctHPs", "CurrentMana", "MaxMana", "PctMana",
+		"CurrentEndurance", "MaxEndurance", "PctEndurance", "Combat", "Moving", "Stunned", "Zoning",
+		"AmIGroupLeader", "GroupSize", "XTarget", "XTHaterCount", "PctAggro", "CountBuffs", "FreeBuffSlots" })
+	{
+		SetMemberFrameStable(member);
+	}
 }
 
 bool MQ2CharacterType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest)
@@ -815,6 +815,20 @@ public:
 	static bool dataMacro(const char* szIndex, MQTypeVar& Ret);
 };
 
+//============================================================================
+// MQ2TurboType
+
+class MQ2TurboType : public MQ2Type
+{
+public:
+	MQ2TurboType();
+
+	bool GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest) override;
+	bool ToString(MQVarPtr VarPtr, char* Destination) override;
+
+	static bool dataTurbo(const char* szIndex, MQTypeVar& Ret);
+};
+
 //============================================================================
 // MQ2ZoneType
 
@@ -65,6 +65,12 @@ MQ2GroupType::MQ2GroupType() : MQ2Type("group")
 	ScopedTypeMember(GroupMembers, Injured);
 	ScopedTypeMember(GroupMembers, LowMana);
 	ScopedTypeMember(GroupMembers, Cleric);
+
+	for (const char* member : { "Member", "Members", "Leader", "GroupSize", "MainTank", "MainAssist", "Puller",
+		"AnyoneMissing", "Present", "AvgHPs", "Injured", "LowMana" })
+	{
+		SetMemberFrameStable(member);
+	}
 }
 
 bool MQ2GroupType::ToString(MQVarPtr VarPtr, char* Destination)
@@ -502,6 +508,12 @@ MQ2GroupMemberType::MQ2GroupMemberType() : MQ2Type("groupmember")
 	ScopedTypeMember(GroupMemberMembers, Offline);
 	ScopedTypeMember(GroupMemberMembers, OtherZone);
 	ScopedTypeMember(GroupMemberMembers, Present);
+
+	for (const char* member : { "Name", "Leader", "Spawn", "Level", "MainTank", "MainAssist", "Puller",
+		"PctAggro", "Index", "Offline", "OtherZone", "Present" })
+	{
+		SetMemberFrameStable(member);
+	}
 }
 
 bool MQ2GroupMemberType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest)
@@ -459,19 +459,22 @@ bool MQ2ItemType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQ
 		Dest.Type = pIntType;
 		return true;
 
-	case ItemMembers::Type:
-		DataTypeTemp[0] = '\0';
+	case ItemMembers::Type: {
+		const char* typeName = "";
+		char szUnknown[32];
+
 		if (pItem->GetType() == ITEMTYPE_NORMAL)
 		{
 			uint8_t itemClass = pItem->GetItemClass();
 
 			if (itemClass < MAX_ITEMCLASSES && szItemClasses[itemClass] != nullptr)
 			{
-				strcpy_s(DataTypeTemp, szItemClasses[itemClass]);
+				typeName = szItemClasses[itemClass];
 			}
 			else
 			{
-				sprintf_s(DataTypeTemp, "*UnknownItemClass%d", itemClass);
+				sprintf_s(szUnknown, "*UnknownItemClass%d", itemClass);
+				typeName = szUnknown;
 			}
 		}
 		else if (pItem->GetType() == ITEMTYPE_PACK)
@@ -480,21 +483,23 @@ bool MQ2ItemType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQ
 
 			if (combine < MAX_COMBINES && szCombineTypes[combine] != nullptr)
 			{
-				strcpy_s(DataTypeTemp, szCombineTypes[combine]);
+				typeName = szCombineTypes[combine];
 			}
 			else
 			{
-				sprintf_s(DataTypeTemp, "*UnknownCombine%d", combine);
+				sprintf_s(szUnknown, "*UnknownCombine%d", combine);
+				typeName = szUnknown;
 			}
 		}
 		else if (pItem->GetType() == ITEMTYPE_BOOK)
 		{
-			strcpy_s(DataTypeTemp, "Book");
+			typeName = "Book";
 		}
 
-		Dest.Ptr = &DataTypeTemp[0];
+		Dest.Ptr = StoreEvaluationString(typeName);
 		Dest.Type = pStringType;
 		return true;
+	}
 
 	case ItemMembers::Charges:
 		if (pItem->GetType() != ITEMTYPE_NORMAL)
@@ -322,6 +322,14 @@ MQ2SpawnType::MQ2SpawnType() : MQ2Type("spawn")
 	ScopedTypeMethod(SpawnMethods, DoAssist);
 	ScopedTypeMethod(SpawnMethods, LeftClick);
 	ScopedTypeMethod(SpawnMethods, RightClick);
+
+	for (const char* member : { "ID", "Name", "CleanName", "DisplayName", "Level", "Type", "X", "Y", "Z",
+		"Distance", "Distance3D", "CurrentHPs", "MaxHPs", "PctHPs", "CurrentMana", "MaxMana", "PctMana",
+		"CurrentEndurance", "MaxEndurance", "PctEndurance", "ConColor", "Standing", "Sitting", "Feigning",
+		"Dead", "Stunned", "Moving", "Invis", "Named", "Aggressive", "Targetable", "LineOfSight" })
+	{
+		SetMemberFrameStable(member);
+	}
 }
 
 bool MQ2SpawnType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest)
@@ -966,17 +974,13 @@ bool MQ2SpawnType::GetMember(SPAWNINFO* pSpawn, const char* Member, char* Index,
 
 		if (Index[0])
 		{
-			MQSpawnSearch ssSpawn;
-			ClearSearchSpawn(&ssSpawn);
-			ssSpawn.FRadius = 999999.0f;
-
+			const char* pSearch = "";
 			int nth = 0;
 
-			if (char* pSearch = strchr(Index, ','))
+			if (char* pComma = strchr(Index, ','))
 			{
-				*pSearch = 0;
-				++pSearch;
-				ParseSearchSpawn(pSearch, &ssSpawn);
+				*pComma = 0;
+				pSearch = pComma + 1;
 
 				nth = GetIntFromString(Index, nth);
 			}
@@ -989,11 +993,13 @@ bool MQ2SpawnType::GetMember(SPAWNINFO* pSpawn, const char* Member, char* Index,
 				else
 				{
 					nth = 1;
-					ParseSearchSpawn(Index, &ssSpawn);
+					pSearch = Index;
 				}
 			}
 
-			if (SPAWNINFO* pNearest = NthNearestSpawn(&ssSpawn, nth, pSpawn))
+			const MQSpawnSearchProgram& search = GetSpawnSearchProgram(pSearch, 999999.0f);
+
+			if (SPAWNINFO* pNearest = NthNearestSpawn(search, nth, pSpawn))
 			{
 				Dest = MakeTypeVar(pNearest);
 				return true;
@@ -1372,8 +1378,7 @@ bool MQ2SpawnType::GetMember(SPAWNINFO* pSpawn, const char* Member, char* Index,
 		return false;
 
 	case SpawnMembers::ActorDef:
-		strcpy_s(DataTypeTemp, pSpawn->mActorClient.ActorDef);
-		Dest.Ptr = &DataTypeTemp[0];
+		Dest.Ptr = StoreEvaluationString(pSpawn->mActorClient.ActorDef);
 		Dest.Type = pStringType;
 		return true;
 
@@ -1638,12 +1643,7 @@ bool MQ2SpawnType::dataSpawn(const char* szIndex, MQTypeVar& Ret)
 			return true;
 		}
 
-		// set up search spawn
-		MQSpawnSearch ssSpawn;
-		ClearSearchSpawn(&ssSpawn);
-		ParseSearchSpawn(szIndex, &ssSpawn);
-
-		SPAWNINFO* pSearchSpawn = SearchThroughSpawns(&ssSpawn, pControlledPlayer);
+		SPAWNINFO* pSearchSpawn = SearchThroughSpawns(GetSpawnSearchProgram(szIndex), pControlledPlayer);
 		Ret = pSpawnType->MakeTypeVar(pSearchSpawn);
 		return true;
 	}
@@ -1657,10 +1657,7 @@ bool MQ2SpawnType::dataSpawnCount(const char* szIndex, MQTypeVar& Ret)
 {
 	if (szIndex[0])
 	{
-		MQSpawnSearch ssSpawn;
-		ClearSearchSpawn(&ssSpawn);
-		ParseSearchSpawn(szIndex, &ssSpawn);
-		Ret.DWord = CountMatchingSpawns(&ssSpawn, pLocalPlayer, true);
+		Ret.DWord = CountMatchingSpawns(GetSpawnSearchProgram(szIndex), pLocalPlayer, true);
 		Ret.Type = pIntType;
 		return true;
 	}
@@ -1723,22 +1720,12 @@ bool MQ2SpawnType::dataNearestSpawn(const char* szIndex, MQTypeVar& Ret)
 {
 	if (szIndex[0])
 	{
-		MQSpawnSearch ssSpawn;
-		ClearSearchSpawn(&ssSpawn);
-		ssSpawn.FRadius = MAX_SEARCH_RADIUS;
-
+		const char* pSearch = "";
 		int nth = 0;
 
-		if (strchr(szIndex, ',') != nullptr)
+		if (const char* pComma = strchr(szIndex, ','))
 		{
-			char szTemp[MAX_STRING];
-			strcpy_s(szTemp, szIndex);
-
-			char* pSearch = strchr(szTemp, ',');
-			*pSearch = 0;
-			++pSearch;
-
-			ParseSearchSpawn(pSearch, &ssSpawn);
+			pSearch = pComma + 1;
 			nth = GetIntFromString(szIndex, nth);
 		}
 		else
@@ -1750,26 +1737,28 @@ bool MQ2SpawnType::dataNearestSpawn(const char* szIndex, MQTypeVar& Ret)
 			else
 			{
 				nth = 1;
-				ParseSearchSpawn(szIndex, &ssSpawn);
+				pSearch = szIndex;
 			}
 		}
 
+		const MQSpawnSearchProgram& search = GetSpawnSearchProgram(pSearch, MAX_SEARCH_RADIUS);
+
 		float FRadiusSq = 0.0f;
-		bool checkDistance = ssSpawn.FRadius != MAX_SEARCH_RADIUS;
+		bool checkDistance = search.GetRadius() != MAX_SEARCH_RADIUS;
 		if (checkDistance)
 		{
-			FRadiusSq = static_cast<float>(ssSpawn.FRadius * ssSpawn.FRadius);
+			FRadiusSq = static_cast<float>(search.GetRadius() * search.GetRadius());
 		}
 
 		for (const MQSpawnArrayItem& spawnItem : gSpawnsArray)
 		{
 			if (checkDistance && spawnItem.GetDistanceSquared() > FRadiusSq)
 			{
-				if (!ssSpawn.bKnownLocation)
+				if (!search.HasKnownLocation())
 					return false;
 			}
 
-			if (SpawnMatchesSearch(&ssSpawn, pControlledPlayer, spawnItem.GetSpawn()))
+			if (search.Matches(pControlledPlayer, spawnItem.GetSpawn()))
 			{
 				if (--nth == 0)
 				{
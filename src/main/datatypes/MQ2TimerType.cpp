@@ -55,11 +55,11 @@ bool MQ2TimerType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, M
 		switch (static_cast<TimerMethods>(pMethod->ID))
 		{
 		case TimerMethods::Expire:
-			pTimer->Current = 0;
+			pTimer->SetCurrent(0);
 			return true;
 
 		case TimerMethods::Reset:
-			pTimer->Current = pTimer->Original;
+			pTimer->SetCurrent(pTimer->Original);
 			return true;
 
 		case TimerMethods::Set:
@@ -81,7 +81,7 @@ bool MQ2TimerType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, M
 	switch (static_cast<TimerMembers>(pMember->ID))
 	{
 	case TimerMembers::Value:
-		Dest.DWord = pTimer->Current;
+		Dest.DWord = pTimer->GetCurrent();
 		Dest.Type = pIntType;
 		return true;
 
@@ -99,7 +99,7 @@ bool MQ2TimerType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, M
 bool MQ2TimerType::ToString(MQVarPtr VarPtr, char* Destination)
 {
 	MQTimer* pTimer = reinterpret_cast<MQTimer*>(VarPtr.Ptr);
-	_ultoa_s(pTimer->Current, Destination, MAX_STRING, 10);
+	_ultoa_s(pTimer->GetCurrent(), Destination, MAX_STRING, 10);
 	return true;
 }
 
@@ -126,6 +126,7 @@ void MQ2TimerType::FreeVariable(MQVarPtr& VarPtr)
 		if (pVar->pNext)
 			pVar->pNext->pPrev = pVar->pPrev;
 
+		pVar->SetCurrent(0);
 		delete pVar;
 	}
 }
@@ -135,14 +136,13 @@ bool MQ2TimerType::FromData(MQVarPtr& VarPtr, const MQTypeVar& Source)
 	MQTimer* pTimer = reinterpret_cast<MQTimer*>(VarPtr.Ptr);
 	if (Source.Type == pFloatType)
 	{
-		pTimer->Current = (DWORD)Source.Float;
-		pTimer->Original = pTimer->Current;
+		pTimer->Original = (DWORD)Source.Float;
 	}
 	else
 	{
-		pTimer->Current = Source.DWord;
-		pTimer->Original = pTimer->Current;
+		pTimer->Original = Source.DWord;
 	}
+	pTimer->SetCurrent(pTimer->Original);
 	return true;
 }
 
@@ -160,8 +160,8 @@ bool MQ2TimerType::FromString(MQVarPtr& VarPtr, const char* Source)
 	case 'S':
 		VarValue *= 10;
 	}
-	pTimer->Current = (DWORD)VarValue;
-	pTimer->Original = pTimer->Current;
+	pTimer->Original = (DWORD)VarValue;
+	pTimer->SetCurrent(pTimer->Original);
 	return true;
 }
 
@@ -0,0 +1,125 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "pch.h"
+#include "MQ2DataTypes.h"
+
+namespace mq::datatypes {
+
+enum class TurboMembers
+{
+	Enabled = 1,
+	MaxLines,
+	Budget,
+	Lines,
+	Time,
+	Deferred,
+	Frames,
+	DeferredFrames,
+	TotalLines,
+	TotalTime,
+};
+
+MQ2TurboType::MQ2TurboType() : MQ2Type("turbo")
+{
+	ScopedTypeMember(TurboMembers, Enabled);
+	ScopedTypeMember(TurboMembers, MaxLines);
+	ScopedTypeMember(TurboMembers, Budget);
+	ScopedTypeMember(TurboMembers, Lines);
+	ScopedTypeMember(TurboMembers, Time);
+	ScopedTypeMember(TurboMembers, Deferred);
+	ScopedTypeMember(TurboMembers, Frames);
+	ScopedTypeMember(TurboMembers, DeferredFrames);
+	ScopedTypeMember(TurboMembers, TotalLines);
+	ScopedTypeMember(TurboMembers, TotalTime);
+}
+
+bool MQ2TurboType::GetMember(MQVarPtr VarPtr, const char* Member, char* Index, MQTypeVar& Dest)
+{
+	MQTypeMember* pMember = MQ2TurboType::FindMember(Member);
+	if (!pMember)
+		return false;
+
+	switch (static_cast<TurboMembers>(pMember->ID))
+	{
+	case TurboMembers::Enabled:
+		Dest.Type = pBoolType;
+		Dest.Set(gTurbo);
+		return true;
+
+	case TurboMembers::MaxLines:
+		Dest.Type = pIntType;
+		Dest.DWord = gTurboBudget > 0 ? std::max(gMaxTurbo, gTurboLimit) : gMaxTurbo;
+		return true;
+
+	case TurboMembers::Budget:
+		Dest.Type = pIntType;
+		Dest.DWord = gTurboBudget;
+		return true;
+
+	case TurboMembers::Lines:
+		Dest.Type = pIntType;
+		Dest.DWord = gTurboStats.LastLines;
+		return true;
+
+	case TurboMembers::Time:
+		Dest.Type = pInt64Type;
+		Dest.Int64 = gTurboStats.LastTime.count();
+		return true;
+
+	case TurboMembers::Deferred:
+		Dest.Type = pBoolType;
+		Dest.Set(gTurboStats.LastDeferred);
+		return true;
+
+	case TurboMembers::Frames:
+		Dest.Type = pInt64Type;
+		Dest.UInt64 = gTurboStats.Frames;
+		return true;
+
+	case TurboMembers::DeferredFrames:
+		Dest.Type = pInt64Type;
+		Dest.UInt64 = gTurboStats.DeferredFrames;
+		return true;
+
+	case TurboMembers::TotalLines:
+		Dest.Type = pInt64Type;
+		Dest.UInt64 = gTurboStats.TotalLines;
+		return true;
+
+	case TurboMembers::TotalTime:
+		Dest.Type = pInt64Type;
+		Dest.Int64 = gTurboStats.TotalTime.count();
+		return true;
+
+	default: break;
+	}
+
+	return false;
+}
+
+bool MQ2TurboType::ToString(MQVarPtr VarPtr, char* Destination)
+{
+	_ultoa_s(gTurboStats.LastLines, Destination, MAX_STRING, 10);
+	return true;
+}
+
+bool MQ2TurboType::dataTurbo(const char* szIndex, MQTypeVar& Ret)
+{
+	Ret.Ptr = nullptr;
+	Ret.Type = pTurboType;
+	return true;
+}
+
+} // namespace mq::datatypes
@@ -16,6 +16,7 @@
 
 #include <vector>
 #include <list>
+#include <memory>
 #include <string>
 #include <mq/imgui/ImGuiUtils.h>
 
@@ -632,10 +633,7 @@ PLUGIN_API void SetGameState(int GameState)
 	}
 }
 
-// This is called every time WriteChatColor is called by MQ2Main or any plugin,
-// IGNORING FILTERS, IF YOU NEED THEM MAKE SURE TO IMPLEMENT THEM. IF YOU DONT
-// CALL CEverQuest::dsp_chat MAKE SURE TO IMPLEMENT EVENTS HERE
-PLUGIN_API DWORD OnWriteChatColor(char* Line, DWORD Color, DWORD Filter)
+static bool EnsureChatWindowVisible()
 {
 	if (!MQChatWnd)
 	{
@@ -646,12 +644,16 @@ PLUGIN_API DWORD OnWriteChatColor(char* Line, DWORD Color, DWORD Filter)
 
 		if (!MQChatWnd)
 		{
-			return 0;
+			return false;
 		}
 	}
 
 	MQChatWnd->SetVisible(true);
+	return true;
+}
 
+static bool IsChatLineFiltered(const char* Line)
+{
 	MQFilter* pFilter = gpFilters;
 	while (pFilter)
 	{
@@ -659,27 +661,72 @@ PLUGIN_API DWORD OnWriteChatColor(char* Line, DWORD Color, DWORD Filter)
 		{
 			if (!_strnicmp(Line, pFilter->FilterText, pFilter->Length))
 			{
-				return 0;
+				return true;
 			}
 		}
 		pFilter = pFilter->pNext;
 	}
 
+	return false;
+}
+
+static void QueueChatLine(const char* Line, DWORD Color, char* szProcessed)
+{
 	Color = pChatManager->GetRGBAFromIndex(Color);
-	char* szProcessed = new char[MAX_STRING];
 
-	int pos = MQToSTML(Line, szProcessed, MAX_STRING - 4, Color);
+	MQToSTML(Line, szProcessed, MAX_STRING - 4, Color);
 
 	CXStr text = szProcessed;
 	text.append("<br>");
 
 	ConvertItemTags(text);
 	sPendingChat.push_back(text);
+}
+
+// This is called every time WriteChatColor is called by MQ2Main or any plugin,
+// IGNORING FILTERS, IF YOU NEED THEM MAKE SURE TO IMPLEMENT THEM. IF YOU DONT
+// CALL CEverQuest::dsp_chat MAKE SURE TO IMPLEMENT EVENTS HERE
+PLUGIN_API DWORD OnWriteChatColor(char* Line, DWORD Color, DWORD Filter)
+{
+	if (!EnsureChatWindowVisible() || IsChatLineFiltered(Line))
+	{
+		return 0;
+	}
+
+	char* szProcessed = new char[MAX_STRING];
+	QueueChatLine(Line, Color, szProcessed);
 
 	delete[] szProcessed;
 	return 0;
 }
 
+// Called once per frame with the lines written since the last one when BatchWriteChatColor is
+// on, so the window is only checked once and the conversion buffer is shared by all of them.
+PLUGIN_API void OnWriteChatColorBatch(const MQChatLine* Lines, size_t Count)
+{
+	if (!EnsureChatWindowVisible())
+	{
+		return;
+	}
+
+	std::unique_ptr<char[]> szProcessed;
+
+	for (size_t i = 0; i < Count; ++i)
+	{
+		if (IsChatLineFiltered(Lines[i].Line))
+		{
+			continue;
+		}
+
+		if (!szProcessed)
+		{
+			szProcessed = std::make_unique<char[]>(MAX_STRING);
+		}
+
+		QueueChatLine(Lines[i].Line, Lines[i].Color, szProcessed.get());
+	}
+}
+
 PLUGIN_API void OnPulse()
 {
 	if (GetGameState() == GAMESTATE_CHARSELECT && !MQChatWnd && !bNoCharSelect)
@@ -37,11 +37,17 @@ static unsigned int CALLBACK LuaVarProcess(char* VarName, char* Value, size_t Va
 
 //----------------------------------------------------------------------------
 
+// Shared by the event processors of every script, so that each line is only scanned once for
+// all of their events instead of being fed to every one of their Blechs.
+static BlechFilter s_eventFilter;
+
 LuaEventProcessor::LuaEventProcessor(LuaThread* thread)
 	: m_thread(thread)
 	, m_blech(std::make_unique<Blech>('#', '|', LuaVarProcess))
 	, m_blechStripped(std::make_unique<Blech>('#', '|', LuaVarProcess))
 {
+	m_blech->SetFilter(&s_eventFilter);
+	m_blechStripped->SetFilter(&s_eventFilter);
 }
 
 LuaEventProcessor::~LuaEventProcessor()
@@ -77,6 +77,34 @@ static std::string lua_Parse(sol::this_state s, const char* text)
 	return buffer;
 }
 
+static sol::table lua_ParseBatch(sol::this_state s, sol::table expressions)
+{
+	std::vector<std::string> input;
+	input.reserve(expressions.size());
+
+	for (size_t i = 1; i <= expressions.size(); ++i)
+	{
+		auto expression = expressions.get<sol::optional<std::string>>(i);
+		if (!expression)
+		{
+			luaL_argerror(s, 1, "Expected a list of strings");
+			return {};
+		}
+
+		input.push_back(std::move(*expression));
+	}
+
+	auto old_parser = std::exchange(gParserVersion, 2);
+	std::vector<std::string> results = EvaluateDataExpressions(input);
+	gParserVersion = old_parser;
+
+	sol::table output = sol::state_view(s).create_table(static_cast<int>(results.size()), 0);
+	for (size_t i = 0; i < results.size(); ++i)
+		output[i + 1] = std::move(results[i]);
+
+	return output;
+}
+
 #pragma endregion
 
 //============================================================================
@@ -523,6 +551,7 @@ void RegisterBindings_MQ(LuaThread* thread, sol::table& mq)
 	mq.set_function("join",                      &lua_join);
 	mq.set_function("gettime",                   &lua_gettime);
 	mq.set_function("parse",                     &lua_Parse);
+	mq.set_function("parseBatch",                &lua_ParseBatch);
 	mq.set_function("pickle",                    &lua_pickle);
 	mq.set_function("unpickle",                  &lua_unpickle);
 
@@ -93,6 +93,8 @@ char mapshowStr[MAX_STRING] = { "" };
 char maphideStr[MAX_STRING] = { "" };
 MQSpawnSearch MapFilterCustom;
 MQSpawnSearch MapFilterNamed;
+MQSpawnSearchProgram MapFilterCustomProgram{ MapFilterCustom };
+MQSpawnSearchProgram MapFilterNamedProgram{ MapFilterNamed };
 
 MapFilterOption MapFilterInvalidOption =
 	{ nullptr,        false, MapFilter::Invalid, MQColor(255, 255, 255), MapFilter::Invalid, 0, nullptr };
@@ -348,6 +350,7 @@ PLUGIN_API void InitializePlugin()
 	AddMQ2Data("MapSpawn", dataMapSpawn);
 	ClearSearchSpawn(&MapFilterNamed);
 	ParseSearchSpawn("#", &MapFilterNamed);
+	MapFilterNamedProgram = MQSpawnSearchProgram(MapFilterNamed);
 
 	AddSettingsPanel("plugins/Map", DrawMapSettingsPanel);
 }
@@ -127,6 +127,11 @@ extern char maphideStr[MAX_STRING];
 extern MQSpawnSearch MapFilterCustom;
 extern MQSpawnSearch MapFilterNamed;
 
+// The filter searches compiled, these are what the spawns are matched against. Rebuild them
+// whenever the searches above change.
+extern MQSpawnSearchProgram MapFilterCustomProgram;
+extern MQSpawnSearchProgram MapFilterNamedProgram;
+
 extern std::vector<MapFilterOption> MapFilterOptions;
 extern MapFilterOption MapFilterInvalidOption;
 
@@ -534,12 +534,13 @@ int MapHighlight(MQSpawnSearch* pSearch)
 
 	uint32_t Count = 0;
 	MAPSPAWN* pMapSpawn = gpActiveMapObjects;
+	MQSpawnSearchProgram search(*pSearch);
 
 	while (pMapSpawn)
 	{
 		// update!
 		SPAWNINFO* pSpawn = pMapSpawn->GetSpawn();
-		if (pSpawn && SpawnMatchesSearch(pSearch, pLocalPlayer, pSpawn))
+		if (pSpawn && search.Matches(pLocalPlayer, pSpawn))
 		{
 			pMapSpawn->SetHighlight(true);
 			Count++;
@@ -555,11 +556,12 @@ int MapHide(MQSpawnSearch& Search)
 {
 	MapObject* pMapSpawn = gpActiveMapObjects;
 	uint32_t Count = 0;
+	MQSpawnSearchProgram search(Search);
 
 	while (pMapSpawn)
 	{
 		SPAWNINFO* pSpawn = pMapSpawn->GetSpawn();
-		if (pSpawn && SpawnMatchesSearch(&Search, pLocalPlayer, pSpawn))
+		if (pSpawn && search.Matches(pLocalPlayer, pSpawn))
 		{
 			MapObject* pNext = pMapSpawn->GetNext();
 			RemoveMapObject(pMapSpawn);
@@ -579,11 +581,12 @@ int MapShow(MQSpawnSearch& Search)
 {
 	SPAWNINFO* pSpawn = (SPAWNINFO*)pSpawnList;
 	uint32_t Count = 0;
+	MQSpawnSearchProgram search(Search);
 
 	while (pSpawn)
 	{
 		if (FindMapObject(pSpawn)
-			== nullptr && SpawnMatchesSearch(&Search, pLocalPlayer, pSpawn))
+			== nullptr && search.Matches(pLocalPlayer, pSpawn))
 		{
 			AddSpawn(pSpawn, true);
 			Count++;
@@ -125,6 +125,7 @@ void MapFilterSetting(PlayerClient* pChar, MapFilter nMapFilter, const char* szV
 			{
 				pMapFilter->Enabled = true;
 				ParseSearchSpawn(szValue, &MapFilterCustom);
+				MapFilterCustomProgram = MQSpawnSearchProgram(MapFilterCustom);
 
 				WriteChatf("%s is now set to: %s", pMapFilter->szName, FormatSearchSpawn(Buff, sizeof(Buff), &MapFilterCustom));
 			}
@@ -693,7 +693,7 @@ MapFilter MapObjectSpawn::GetMapFilter() const
 	case NPC:
 		if (IsOptionEnabled(MapFilter::Named))
 		{
-			if (SpawnMatchesSearch(&MapFilterNamed, pLocalPlayer, m_spawn))
+			if (MapFilterNamedProgram.Matches(pLocalPlayer, m_spawn))
 			{
 				return MapFilter::Named;
 			}
@@ -738,7 +738,7 @@ static bool CanDisplaySpawnObject(eSpawnType type, SPAWNINFO* spawn)
 
 	if (IsOptionEnabled(MapFilter::Custom))
 	{
-		return SpawnMatchesSearch(&MapFilterCustom, pLocalPlayer, spawn);
+		return MapFilterCustomProgram.Matches(pLocalPlayer, spawn);
 	}
 
 	switch (type)
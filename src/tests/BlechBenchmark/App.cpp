@@ -0,0 +1,212 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Feeds a chat log through the same Blech setup that MacroQuest uses for chat events, once with
+// every Blech fed every line and once with the Blechs sharing a BlechFilter, and compares the time
+// it takes and the events that matched.
+//
+// Usage: BlechBenchmark <eqlog.txt> [scripts] [passes]
+//
+// The log is an EverQuest log file, the timestamps are stripped. Scripts is how many Lua scripts
+// with events to simulate (default 15), each gets its own pair of Blechs like LuaEventProcessor.
+
+#include <windows.h>
+
+#include "blech/Blech.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Events like the ones that raid macros and scripts register.
+static const char* s_events[] = {
+	"#1# tells you, '#2#'",
+	"#1# tells the group, '#2#'",
+	"#1# tells the raid,  '#2#'",
+	"#1# tells the guild, '#2#'",
+	"#1# says, '#2#'",
+	"#*#You have been slain by#*#",
+	"#*#You have entered #1#.",
+	"#*#LOADING, PLEASE WAIT...#*#",
+	"Your #1# spell has worn off of #2#.",
+	"#*#Your target resisted the #1# spell#*#",
+	"#*#Your spell is interrupted#*#",
+	"#*#You are stunned#*#",
+	"#*#You can't see your target#*#",
+	"#*#Your target is too far away#*#",
+	"#1# hits YOU for #2# points of damage.",
+	"#*#has been awakened by#*#",
+	"#1# has been slain by #2#!",
+	"#*#You gain experience#*#",
+	"#*#invites you to join a group#*#",
+	"#1# is now your group leader.",
+	"#*#You have been summoned!#*#",
+	"#*#begins to cast#*#Complete Heal#*#",
+	"#*#Your #1# has been disrupted#*#",
+	"#*#has fallen to the ground#*#",
+	"You feel yourself starting to appear.",
+	"#*#You are no longer feigning death#*#",
+	"#*#bodies begin to#*#",
+	"#*#looks at you with a sneer#*#",
+	"#*#|${Me.CleanName}| ducks#*#",
+	"#*#Your faction standing with #1# has been adjusted#*#",
+};
+
+static unsigned int s_matches = 0;
+
+static void CALLBACK EventCallback(unsigned int ID, void* pData, PBLECHVALUE pValues)
+{
+	++s_matches;
+}
+
+static unsigned int CALLBACK VariableValue(char* VarName, char* Value, size_t ValueLen)
+{
+	strcpy_s(Value, ValueLen, "Tester");
+	return static_cast<unsigned int>(strlen(Value));
+}
+
+struct Matchers
+{
+	std::vector<std::unique_ptr<Blech>> blechs;
+
+	Matchers(int scripts, BlechFilter* pFilter)
+	{
+		const size_t eventCount = sizeof(s_events) / sizeof(s_events[0]);
+
+		// The two MQ2Main Blechs: macro events, and the one that plugins add to.
+		AddBlech(pFilter);
+		AddBlech(pFilter);
+
+		for (size_t i = 0; i < eventCount; ++i)
+			blechs[i % 2]->AddEvent(s_events[i], EventCallback);
+
+		// Each script has a handful of events, with and without links.
+		for (int script = 0; script < scripts; ++script)
+		{
+			Blech& blech = AddBlech(pFilter);
+			Blech& blechStripped = AddBlech(pFilter);
+
+			for (size_t i = 0; i < 6; ++i)
+			{
+				const char* event = s_events[(script * 7 + i * 5) % eventCount];
+				(i % 3 == 0 ? blech : blechStripped).AddEvent(event, EventCallback);
+			}
+		}
+	}
+
+	Blech& AddBlech(BlechFilter* pFilter)
+	{
+		blechs.push_back(std::make_unique<Blech>('#', '|', VariableValue));
+		blechs.back()->SetFilter(pFilter);
+		return *blechs.back();
+	}
+
+	void Feed(const std::vector<std::string>& lines)
+	{
+		char buffer[2048];
+
+		for (const std::string& line : lines)
+		{
+			strncpy_s(buffer, line.c_str(), _TRUNCATE);
+
+			for (std::unique_ptr<Blech>& blech : blechs)
+				blech->Feed(buffer, sizeof(buffer));
+		}
+	}
+};
+
+static std::vector<std::string> LoadLog(const char* path)
+{
+	std::vector<std::string> lines;
+	std::ifstream file(path);
+	std::string line;
+
+	while (std::getline(file, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		// [Mon Jan 01 00:00:00 2024] text
+		if (!line.empty() && line[0] == '[')
+		{
+			size_t end = line.find("] ");
+			if (end != std::string::npos)
+				line.erase(0, end + 2);
+		}
+
+		if (!line.empty())
+			lines.push_back(line);
+	}
+
+	return lines;
+}
+
+static double Run(const std::vector<std::string>& lines, int scripts, int passes, BlechFilter* pFilter, unsigned int& matches)
+{
+	Matchers matchers(scripts, pFilter);
+
+	s_matches = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	for (int pass = 0; pass < passes; ++pass)
+		matchers.Feed(lines);
+
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	matches = s_matches;
+
+	return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		printf("Usage: %s <eqlog.txt> [scripts] [passes]\n", argv[0]);
+		return 1;
+	}
+
+	const std::vector<std::string> lines = LoadLog(argv[1]);
+	const int scripts = argc > 2 ? atoi(argv[2]) : 15;
+	const int passes = argc > 3 ? atoi(argv[3]) : 10;
+
+	if (lines.empty())
+	{
+		printf("No lines in %s\n", argv[1]);
+		return 1;
+	}
+
+	printf("%zu lines, %d scripts, %d passes\n", lines.size(), scripts, passes);
+
+	unsigned int oldMatches = 0;
+	const double oldTime = Run(lines, scripts, passes, nullptr, oldMatches);
+
+	BlechFilter filter;
+	unsigned int newMatches = 0;
+	const double newTime = Run(lines, scripts, passes, &filter, newMatches);
+
+	const double lineCount = static_cast<double>(lines.size()) * passes;
+	printf("every Blech:   %10.2f ms  %8.3f us/line  %u matches\n", oldTime, oldTime * 1000.0 / lineCount, oldMatches);
+	printf("shared filter: %10.2f ms  %8.3f us/line  %u matches\n", newTime, newTime * 1000.0 / lineCount, newMatches);
+
+	if (oldMatches != newMatches)
+	{
+		printf("MISMATCH: the filter changed which events matched\n");
+		return 2;
+	}
+
+	return 0;
+}
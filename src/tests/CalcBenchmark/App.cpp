@@ -0,0 +1,157 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Runs formulas through the calculator that Calculate uses, once with FastCalculate and once with
+// the compiled programs, and compares the time it takes and the results.
+//
+// Usage: CalcBenchmark [passes] [formulas.txt]
+//
+// Without a file, a set of typical macro conditions is used. The file has one formula per line,
+// as they look after ${} substitution. Passes is how many times every formula is evaluated
+// (default 100000).
+
+#include "main/MQCalculator.h"
+
+#include <mq/base/Common.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// In-game, a formula error ends the macro, so the shared formulas don't have one. Here errors
+// are only counted, so the error path is compared as well.
+static const char* s_errorFormulas[] = {
+	"(${Me.PctHPs} < 50)",
+};
+
+static unsigned int s_errors = 0;
+
+namespace mq {
+
+void ReportCalculateError(const char* szMessage)
+{
+	++s_errors;
+}
+
+} // namespace mq
+
+static std::vector<std::string> LoadFormulas(const char* path)
+{
+	std::vector<std::string> formulas;
+	std::ifstream file(path);
+	std::string line;
+
+	while (std::getline(file, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		if (!line.empty())
+			formulas.push_back(line);
+	}
+
+	return formulas;
+}
+
+struct PassResult
+{
+	double Time = 0;
+	std::vector<double> Results;
+	std::vector<bool> Succeeded;
+	unsigned int Errors = 0;
+};
+
+static PassResult Run(const std::vector<std::string>& formulas, int passes, bool compiled)
+{
+	PassResult result;
+	result.Results.resize(formulas.size());
+	result.Succeeded.resize(formulas.size());
+
+	s_errors = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	for (int pass = 0; pass < passes; ++pass)
+	{
+		for (size_t i = 0; i < formulas.size(); ++i)
+		{
+			char buffer[MAX_STRING];
+			mq::PrepareFormula(formulas[i].c_str(), buffer, sizeof(buffer));
+
+			double value = 0;
+			result.Succeeded[i] = compiled ? mq::CompiledCalculate(buffer, value) : mq::FastCalculate(buffer, value);
+			result.Results[i] = value;
+		}
+	}
+
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	result.Time = std::chrono::duration<double, std::milli>(elapsed).count();
+	result.Errors = s_errors;
+
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	const int passes = argc > 1 ? atoi(argv[1]) : 100000;
+
+	std::vector<std::string> formulas;
+	if (argc > 2)
+	{
+		formulas = LoadFormulas(argv[2]);
+	}
+	else
+	{
+		formulas.assign(mq::CalculateBenchmarkFormulas, mq::CalculateBenchmarkFormulas + mq::CalculateBenchmarkFormulaCount);
+		formulas.insert(formulas.end(), std::begin(s_errorFormulas), std::end(s_errorFormulas));
+	}
+
+	if (formulas.empty() || passes < 1)
+	{
+		printf("Usage: %s [passes] [formulas.txt]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%zu formulas, %d passes\n", formulas.size(), passes);
+
+	const PassResult fast = Run(formulas, passes, false);
+	const PassResult compiled = Run(formulas, passes, true);
+
+	const double count = static_cast<double>(formulas.size()) * passes;
+	printf("FastCalculate: %10.2f ms  %8.3f us/formula  %u errors\n", fast.Time, fast.Time * 1000.0 / count, fast.Errors);
+	printf("compiled:      %10.2f ms  %8.3f us/formula  %u errors\n", compiled.Time, compiled.Time * 1000.0 / count, compiled.Errors);
+
+	int mismatches = 0;
+	for (size_t i = 0; i < formulas.size(); ++i)
+	{
+		if (fast.Succeeded[i] != compiled.Succeeded[i]
+			|| (fast.Succeeded[i] && fast.Results[i] != compiled.Results[i]))
+		{
+			printf("MISMATCH: %s = %f (%s) vs %f (%s)\n", formulas[i].c_str(),
+				fast.Results[i], fast.Succeeded[i] ? "ok" : "failed",
+				compiled.Results[i], compiled.Succeeded[i] ? "ok" : "failed");
+			++mismatches;
+		}
+	}
+
+	if (mismatches != 0 || fast.Errors != compiled.Errors)
+	{
+		printf("MISMATCH: the compiled programs changed the results\n");
+		return 2;
+	}
+
+	return 0;
+}
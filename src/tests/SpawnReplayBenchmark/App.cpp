@@ -0,0 +1,446 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Replays spawn movement through the same steps that UpdateMQ2SpawnSort and the spawn add and
+// remove hooks take, and compares them with rebuilding and sorting the spawn array every pulse
+// like it used to. The spawn grid is checked against a search of every spawn along the way.
+//
+// Usage: SpawnReplayBenchmark [movement.txt]
+//        SpawnReplayBenchmark [spawns] [pulses]
+//
+// The movement file has one line per spawn per pulse: "pulse id x y". Id 0 is the player, the
+// distances are sorted from there. A spawn that isn't in a pulse has despawned. Without a file,
+// spawns wander around a zone (default 1000 spawns over 2000 pulses), with a few of them spawning
+// and despawning and the player porting now and then.
+
+#include <mq/base/SpatialGrid.h>
+#include <mq/base/Sort.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ReplaySpawn
+{
+	int ID = 0;
+	float X = 0;
+	float Y = 0;
+};
+
+struct ReplayPulse
+{
+	float X = 0;
+	float Y = 0;
+	std::vector<ReplaySpawn> Spawns;
+};
+
+// Stands in for MQSpawnArrayItem.
+struct SpawnArrayItem
+{
+	ReplaySpawn* Spawn = nullptr;
+	float DistSq = 0;
+};
+
+static bool SpawnArrayCompare(const SpawnArrayItem& A, const SpawnArrayItem& B)
+{
+	return A.DistSq < B.DistSq;
+}
+
+static float GetDistanceSquared(float x1, float y1, float x2, float y2)
+{
+	const float dX = x1 - x2;
+	const float dY = y1 - y2;
+	return dX * dX + dY * dY;
+}
+
+// Same as gSpawnGrid.
+constexpr float SpawnGridCellSize = 100.0f;
+constexpr float SpawnGridSlack = 50.0f;
+
+// Radius of the searches that are checked against the grid.
+constexpr float SearchRadius = 250.0f;
+
+static std::vector<ReplayPulse> LoadMovement(const char* path)
+{
+	std::vector<ReplayPulse> pulses;
+	std::ifstream file(path);
+	std::string line;
+	int lastPulse = -1;
+
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		int pulse, id;
+		float x, y;
+
+		if (!(stream >> pulse >> id >> x >> y))
+			continue;
+
+		if (pulse != lastPulse)
+		{
+			pulses.emplace_back();
+			lastPulse = pulse;
+		}
+
+		if (id == 0)
+		{
+			pulses.back().X = x;
+			pulses.back().Y = y;
+		}
+		else
+		{
+			pulses.back().Spawns.push_back({ id, x, y });
+		}
+	}
+
+	return pulses;
+}
+
+static std::vector<ReplayPulse> MakeMovement(int spawnCount, int pulseCount)
+{
+	constexpr float ZoneSize = 4000.0f;
+
+	std::mt19937 rng(12345);
+	std::uniform_real_distribution<float> position(-ZoneSize / 2, ZoneSize / 2);
+	std::uniform_real_distribution<float> step(-3.0f, 3.0f);
+	std::uniform_int_distribution<int> percent(0, 99);
+
+	std::vector<ReplaySpawn> spawns;
+	int nextID = 1;
+	for (int i = 0; i < spawnCount; ++i)
+		spawns.push_back({ nextID++, position(rng), position(rng) });
+
+	std::vector<ReplayPulse> pulses(pulseCount);
+	float myX = 0, myY = 0;
+
+	for (ReplayPulse& pulse : pulses)
+	{
+		// Most spawns stand still, the rest take a small step.
+		for (ReplaySpawn& spawn : spawns)
+		{
+			if (percent(rng) < 30)
+			{
+				spawn.X += step(rng);
+				spawn.Y += step(rng);
+			}
+		}
+
+		if (!spawns.empty() && percent(rng) < 5)
+		{
+			spawns.erase(spawns.begin() + rng() % spawns.size());
+		}
+
+		if (percent(rng) < 5)
+		{
+			spawns.push_back({ nextID++, position(rng), position(rng) });
+		}
+
+		if (percent(rng) == 0)
+		{
+			myX = position(rng);
+			myY = position(rng);
+		}
+		else
+		{
+			myX += step(rng);
+			myY += step(rng);
+		}
+
+		pulse.X = myX;
+		pulse.Y = myY;
+		pulse.Spawns = spawns;
+	}
+
+	return pulses;
+}
+
+class SpawnReplay
+{
+public:
+	// Time spent on the spawn array in the old and the new way.
+	double FullTime = 0;
+	double IncrementalTime = 0;
+
+	// Time spent searching around the player with the grid and by looking at every spawn.
+	double GridSearchTime = 0;
+	double ScanSearchTime = 0;
+
+	size_t Rebuilds = 0;
+	size_t FullSorts = 0;
+	size_t Mismatches = 0;
+
+	void Run(const std::vector<ReplayPulse>& pulses)
+	{
+		for (size_t i = 0; i < pulses.size(); ++i)
+		{
+			ApplyPulse(pulses[i]);
+			Check(i);
+		}
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	static double Elapsed(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// Moves the spawns to where they are in the pulse, calling the add and remove hooks for the
+	// spawns that came and went, then runs the pulse.
+	void ApplyPulse(const ReplayPulse& pulse)
+	{
+		m_myX = pulse.X;
+		m_myY = pulse.Y;
+
+		std::unordered_map<int, std::unique_ptr<ReplaySpawn>> live;
+		std::vector<ReplaySpawn*> added;
+		m_spawnList.clear();
+
+		for (const ReplaySpawn& spawn : pulse.Spawns)
+		{
+			auto iter = m_spawns.find(spawn.ID);
+			std::unique_ptr<ReplaySpawn> pSpawn;
+
+			if (iter != m_spawns.end())
+			{
+				pSpawn = std::move(iter->second);
+				m_spawns.erase(iter);
+			}
+			else
+			{
+				pSpawn = std::make_unique<ReplaySpawn>();
+				added.push_back(pSpawn.get());
+			}
+
+			*pSpawn = spawn;
+			m_spawnList.push_back(pSpawn.get());
+			live.emplace(spawn.ID, std::move(pSpawn));
+		}
+
+		// What is left has despawned.
+		for (auto& [id, pSpawn] : m_spawns)
+		{
+			auto start = Clock::now();
+			SpawnRemoved(pSpawn.get());
+			IncrementalTime += Elapsed(start);
+		}
+
+		m_spawns = std::move(live);
+
+		for (ReplaySpawn* pSpawn : added)
+		{
+			auto start = Clock::now();
+			SpawnAdded(pSpawn);
+			IncrementalTime += Elapsed(start);
+		}
+
+		auto start = Clock::now();
+		UpdateFull();
+		FullTime += Elapsed(start);
+
+		start = Clock::now();
+		UpdateIncremental();
+		IncrementalTime += Elapsed(start);
+	}
+
+	void SpawnAdded(ReplaySpawn* pSpawn)
+	{
+		if (!m_grid.Update(pSpawn, pSpawn->X, pSpawn->Y))
+			return;
+
+		SpawnArrayItem item{ pSpawn, GetDistanceSquared(m_myX, m_myY, pSpawn->X, pSpawn->Y) };
+		m_incremental.insert(
+			std::upper_bound(std::begin(m_incremental), std::end(m_incremental), item, SpawnArrayCompare),
+			item);
+	}
+
+	void SpawnRemoved(ReplaySpawn* pSpawn)
+	{
+		m_grid.Remove(pSpawn);
+
+		m_incremental.erase(
+			std::remove_if(std::begin(m_incremental), std::end(m_incremental),
+				[pSpawn](const SpawnArrayItem& item) { return item.Spawn == pSpawn; }),
+			std::end(m_incremental));
+	}
+
+	// What UpdateMQ2SpawnSort used to do.
+	void UpdateFull()
+	{
+		m_full.clear();
+
+		for (ReplaySpawn* pSpawn : m_spawnList)
+			m_full.push_back({ pSpawn, GetDistanceSquared(m_myX, m_myY, pSpawn->X, pSpawn->Y) });
+
+		std::sort(std::begin(m_full), std::end(m_full), SpawnArrayCompare);
+	}
+
+	// What UpdateMQ2SpawnSort does now.
+	void UpdateIncremental()
+	{
+		m_grid.BeginRefresh();
+
+		bool missed = false;
+		for (ReplaySpawn* pSpawn : m_spawnList)
+			missed |= m_grid.Update(pSpawn, pSpawn->X, pSpawn->Y);
+
+		missed |= m_grid.EndRefresh() != 0;
+
+		if (missed || m_spawnList.size() != m_incremental.size())
+		{
+			m_incremental.clear();
+
+			for (ReplaySpawn* pSpawn : m_spawnList)
+				m_incremental.push_back({ pSpawn, 0.0f });
+
+			++Rebuilds;
+		}
+
+		const size_t count = m_incremental.size();
+		m_spawnX.resize(count);
+		m_spawnY.resize(count);
+		m_spawnDistSq.resize(count);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const ReplaySpawn* pSpawn = m_incremental[i].Spawn;
+			m_spawnX[i] = pSpawn->X;
+			m_spawnY[i] = pSpawn->Y;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+			m_spawnDistSq[i] = GetDistanceSquared(m_myX, m_myY, m_spawnX[i], m_spawnY[i]);
+
+		for (size_t i = 0; i < count; ++i)
+			m_incremental[i].DistSq = m_spawnDistSq[i];
+
+		if (!mq::InsertionSort(m_incremental, SpawnArrayCompare, count * 4))
+		{
+			std::sort(std::begin(m_incremental), std::end(m_incremental), SpawnArrayCompare);
+			++FullSorts;
+		}
+	}
+
+	void Check(size_t pulse)
+	{
+		// Spawns at the same distance can be in either order, so only the distances have to match.
+		bool sorted = m_full.size() == m_incremental.size();
+		for (size_t i = 0; sorted && i < m_full.size(); ++i)
+			sorted = m_full[i].DistSq == m_incremental[i].DistSq;
+
+		if (!sorted)
+		{
+			printf("MISMATCH: pulse %zu: the spawn array is out of order\n", pulse);
+			++Mismatches;
+		}
+
+		const float radiusSq = SearchRadius * SearchRadius;
+
+		auto start = Clock::now();
+		size_t inGrid = 0;
+		m_grid.ForEachInRadius(m_myX, m_myY, SearchRadius,
+			[&](ReplaySpawn* pSpawn)
+			{
+				if (GetDistanceSquared(m_myX, m_myY, pSpawn->X, pSpawn->Y) <= radiusSq)
+					++inGrid;
+			});
+		GridSearchTime += Elapsed(start);
+
+		start = Clock::now();
+		size_t inList = 0;
+		for (ReplaySpawn* pSpawn : m_spawnList)
+		{
+			if (GetDistanceSquared(m_myX, m_myY, pSpawn->X, pSpawn->Y) <= radiusSq)
+				++inList;
+		}
+		ScanSearchTime += Elapsed(start);
+
+		if (inGrid != inList)
+		{
+			printf("MISMATCH: pulse %zu: the grid found %zu spawns in range, there are %zu\n", pulse, inGrid, inList);
+			++Mismatches;
+		}
+	}
+
+	std::unordered_map<int, std::unique_ptr<ReplaySpawn>> m_spawns;
+	std::vector<ReplaySpawn*> m_spawnList;
+	float m_myX = 0;
+	float m_myY = 0;
+
+	std::vector<SpawnArrayItem> m_full;
+	std::vector<SpawnArrayItem> m_incremental;
+	mq::SpatialGrid<ReplaySpawn> m_grid{ SpawnGridCellSize, SpawnGridSlack };
+
+	std::vector<float> m_spawnX;
+	std::vector<float> m_spawnY;
+	std::vector<float> m_spawnDistSq;
+};
+
+int main(int argc, char* argv[])
+{
+	std::vector<ReplayPulse> pulses;
+
+	if (argc == 2)
+	{
+		pulses = LoadMovement(argv[1]);
+	}
+	else
+	{
+		const int spawnCount = argc > 1 ? atoi(argv[1]) : 1000;
+		const int pulseCount = argc > 2 ? atoi(argv[2]) : 2000;
+
+		if (spawnCount >= 0 && pulseCount > 0)
+			pulses = MakeMovement(spawnCount, pulseCount);
+	}
+
+	if (pulses.empty())
+	{
+		printf("Usage: %s [movement.txt]\n", argv[0]);
+		printf("       %s [spawns] [pulses]\n", argv[0]);
+		return 1;
+	}
+
+	size_t spawns = 0;
+	for (const ReplayPulse& pulse : pulses)
+		spawns += pulse.Spawns.size();
+
+	printf("%zu pulses, %.1f spawns per pulse\n", pulses.size(), static_cast<double>(spawns) / pulses.size());
+
+	SpawnReplay replay;
+	replay.Run(pulses);
+
+	const double count = static_cast<double>(pulses.size());
+	printf("full sort:   %10.2f ms  %8.3f us/pulse\n", replay.FullTime, replay.FullTime * 1000.0 / count);
+	printf("incremental: %10.2f ms  %8.3f us/pulse  %zu rebuilds  %zu full sorts\n",
+		replay.IncrementalTime, replay.IncrementalTime * 1000.0 / count, replay.Rebuilds, replay.FullSorts);
+	printf("grid search: %10.2f ms  %8.3f us/pulse\n", replay.GridSearchTime, replay.GridSearchTime * 1000.0 / count);
+	printf("scan search: %10.2f ms  %8.3f us/pulse\n", replay.ScanSearchTime, replay.ScanSearchTime * 1000.0 / count);
+
+	if (replay.Mismatches != 0)
+	{
+		printf("MISMATCH: %zu pulses didn't match\n", replay.Mismatches);
+		return 2;
+	}
+
+	return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Checks the string arena that ${} evaluations allocate their results from.
+//
+// Usage: StringArenaTest
+
+#include "tests/TestChecks.h"
+
+#include <mq/base/StringArena.h>
+
+#include <cstring>
+
+using mq::StringArena;
+using mq::test::Check;
+
+static void TestStoreAndRewind()
+{
+	StringArena arena(256);
+
+	const char* first = arena.Store("first");
+	const StringArena::Marker marker = arena.GetMarker();
+	const char* second = arena.Store("second");
+
+	Check(strcmp(first, "first") == 0 && strcmp(second, "second") == 0, "Store copies the string");
+	Check(!arena.AllocatedSince(marker, first), "AllocatedSince is false for older allocations");
+	Check(arena.AllocatedSince(marker, second), "AllocatedSince is true for newer allocations");
+
+	// Spill into a second chunk and make sure that rewinding goes back to the first.
+	const char* large = arena.Allocate(1024);
+	Check(arena.GetCapacity() > 256, "a large allocation adds a chunk");
+	Check(arena.AllocatedSince(marker, large), "AllocatedSince finds allocations in later chunks");
+
+	arena.Rewind(marker);
+	Check(arena.GetUsed() == marker.used, "Rewind frees everything after the marker");
+	Check(!arena.AllocatedSince(marker, second), "AllocatedSince is false for memory that was rewound");
+	Check(strcmp(first, "first") == 0, "Rewind keeps what was allocated before the marker");
+}
+
+static void TestScope()
+{
+	StringArena arena(256);
+	arena.Store("outer");
+
+	const size_t used = arena.GetUsed();
+	{
+		StringArena::Scope outer(arena);
+		arena.Store("line");
+
+		const size_t lineUsed = arena.GetUsed();
+		{
+			StringArena::Scope inner(arena);
+			arena.Allocate(1024);
+		}
+		Check(arena.GetUsed() == lineUsed, "a nested Scope only frees what was allocated inside it");
+	}
+	Check(arena.GetUsed() == used, "Scope rewinds when it is left");
+}
+
+static void TestReset()
+{
+	StringArena arena(256);
+
+	for (int i = 0; i < 8; ++i)
+		arena.Allocate(200);
+
+	const size_t capacity = arena.GetCapacity();
+
+	arena.Reset();
+	Check(arena.GetUsed() == 0, "Reset frees everything");
+
+	for (int i = 0; i < 8; ++i)
+		arena.Allocate(200);
+
+	Check(arena.GetCapacity() == capacity, "the same work after Reset reuses the chunks");
+}
+
+int main(int argc, char* argv[])
+{
+	TestStoreAndRewind();
+	TestScope();
+	TestReset();
+
+	return mq::test::Finish();
+}
@@ -0,0 +1,52 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Reporting for the test programs in src/tests.
+
+#pragma once
+
+#include <cstdio>
+
+namespace mq::test {
+
+inline int& FailureCount()
+{
+	static int failures = 0;
+	return failures;
+}
+
+// Prints the description of a check that failed and counts it.
+inline void Check(bool condition, const char* description)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", description);
+		++FailureCount();
+	}
+}
+
+// Prints a summary and returns the exit code for main: 0 if every check passed, 2 if not.
+inline int Finish()
+{
+	if (FailureCount() != 0)
+	{
+		printf("%d checks failed\n", FailureCount());
+		return 2;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
+
+} // namespace mq::test
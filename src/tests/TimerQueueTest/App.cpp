@@ -0,0 +1,170 @@
+/*
+ * MacroQuest: The extension platform for EverQuest
+ * Copyright (C) 2002-present MacroQuest Authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License, version 2, as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+// Checks the deadline queue that macro timers and /timed commands are kept in.
+//
+// Usage: TimerQueueTest
+
+#include "tests/TestChecks.h"
+
+#include <mq/base/TimerQueue.h>
+
+#include <string>
+
+using mq::TimerQueue;
+using mq::test::Check;
+
+static void TestOrder()
+{
+	TimerQueue queue;
+	std::string fired;
+
+	queue.Schedule(30, [&] { fired += "c"; });
+	queue.Schedule(10, [&] { fired += "a"; });
+	queue.Schedule(20, [&] { fired += "b1"; });
+	queue.Schedule(20, [&] { fired += "b2"; });
+	queue.Schedule(40, [&] { fired += "d"; });
+
+	Check(queue.NextDeadline() == 10, "NextDeadline is the earliest deadline");
+	Check(queue.Process(5) == 0, "nothing runs before its deadline");
+	Check(queue.Process(30) == 4, "everything that is due runs");
+	Check(fired == "ab1b2c", "callbacks run earliest first, ties in the order they were scheduled");
+	Check(queue.size() == 1 && queue.NextDeadline() == 40, "entries that aren't due stay queued");
+}
+
+static void TestCancelAndReschedule()
+{
+	TimerQueue queue;
+	std::string fired;
+
+	TimerQueue::TimerId a = queue.Schedule(10, [&] { fired += "a"; });
+	TimerQueue::TimerId b = queue.Schedule(20, [&] { fired += "b"; });
+	queue.Schedule(30, [&] { fired += "c"; });
+
+	Check(queue.Cancel(a), "Cancel removes a pending entry");
+	Check(!queue.Cancel(a), "Cancel fails for an entry that is no longer pending");
+	Check(queue.Reschedule(b, 40), "Reschedule moves a pending entry");
+	Check(queue.GetDeadline(b) == 40, "GetDeadline returns the new deadline");
+
+	queue.Process(100);
+	Check(fired == "cb", "cancelled entries don't run and rescheduled entries run at their new deadline");
+	Check(!queue.IsScheduled(b), "an entry that ran is no longer scheduled");
+	Check(queue.empty(), "the queue is empty once everything ran");
+}
+
+static void TestRescheduleFromCallback()
+{
+	TimerQueue queue;
+	int runs = 0;
+
+	std::function<void()> repeat = [&]
+	{
+		++runs;
+		queue.Schedule(0, repeat);
+	};
+	queue.Schedule(0, repeat);
+
+	Check(queue.Process(100) == 1, "a callback that schedules itself only runs once per Process");
+	Check(queue.Process(100) == 1, "the entry it scheduled runs on the next Process");
+	Check(runs == 2, "the callback ran once per Process");
+}
+
+static void TestEarlierEntryFromCallback()
+{
+	TimerQueue queue;
+	std::string fired;
+
+	TimerQueue::TimerId late = TimerQueue::InvalidTimerId;
+
+	// The first callback schedules entries with an earlier deadline than the ones still queued,
+	// which puts them at the top of the heap.
+	queue.Schedule(10, [&]
+	{
+		fired += "a";
+		queue.Schedule(0, [&] { fired += "x"; });
+		late = queue.Schedule(1, [&] { fired += "y"; });
+	});
+	queue.Schedule(20, [&] { fired += "b"; });
+	queue.Schedule(30, [&]
+	{
+		fired += "c";
+		Check(queue.IsScheduled(late), "entries set aside while processing are still scheduled");
+		Check(queue.Reschedule(late, 2), "entries set aside while processing can be rescheduled");
+	});
+	queue.Schedule(40, [&] { fired += "d"; });
+
+	Check(queue.Process(30) == 3, "entries scheduled by a callback don't stop older due entries");
+	Check(fired == "abc", "older due entries run in the same Process");
+	Check(queue.size() == 3 && queue.NextDeadline() == 0, "entries scheduled by a callback stay queued");
+	Check(queue.GetDeadline(late) == 2, "a set aside entry keeps its new deadline");
+
+	Check(queue.Process(30) == 2, "entries scheduled by a callback run on the next Process");
+	Check(fired == "abcxy", "entries scheduled by a callback run in deadline order");
+	Check(queue.size() == 1, "entries that aren't due stay queued");
+}
+
+static void TestCancelFromCallback()
+{
+	TimerQueue queue;
+	std::string fired;
+
+	TimerQueue::TimerId added = TimerQueue::InvalidTimerId;
+	TimerQueue::TimerId b = TimerQueue::InvalidTimerId;
+
+	queue.Schedule(10, [&]
+	{
+		fired += "a";
+		added = queue.Schedule(0, [&] { fired += "x"; });
+		queue.Cancel(b);
+	});
+	b = queue.Schedule(10, [&] { fired += "b"; });
+	queue.Schedule(20, [&]
+	{
+		fired += "c";
+		Check(queue.Cancel(added), "entries set aside while processing can be cancelled");
+	});
+
+	queue.Process(100);
+	queue.Process(100);
+	Check(fired == "ac", "cancelled entries don't run");
+	Check(queue.empty(), "the queue is empty once everything ran or was cancelled");
+}
+
+static void TestClear()
+{
+	TimerQueue queue;
+	int runs = 0;
+
+	queue.Schedule(10, [&]
+	{
+		queue.Schedule(0, [&] { ++runs; });
+		queue.Clear();
+	});
+	queue.Schedule(20, [&] { ++runs; });
+
+	queue.Process(100);
+	Check(runs == 0 && queue.empty(), "Clear from a callback drops everything");
+}
+
+int main(int argc, char* argv[])
+{
+	TestOrder();
+	TestCancelAndReschedule();
+	TestRescheduleFromCallback();
+	TestEarlierEntryFromCallback();
+	TestCancelFromCallback();
+	TestClear();
+
+	return mq::test::Finish();
+}
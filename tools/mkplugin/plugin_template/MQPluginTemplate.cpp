@@ -167,6 +167,11 @@ PLUGIN_API void OnPulse()
  * For a list of Color values, see the constants for USERCOLOR_.  The default is
  * USERCOLOR_DEFAULT.
  *
+ * A plugin that adds many lines at a time can export OnWriteChatColorBatch(const
+ * MQChatLine* Lines, size_t Count) instead. With BatchWriteChatColor=1 in the ini, it
+ * gets all of a frame's lines in one call on the next pulse, and this is not called.
+ * Without OnWriteChatColorBatch, this is always called as soon as the line is written.
+ *
  * @param Line const char* - The line that was passed to WriteChatColor
  * @param Color int - The type of chat text this is to be sent as
  * @param Filter int - (default 0)